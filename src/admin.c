@@ -0,0 +1,190 @@
+
+/** \file admin.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/time.h>
+#include "admin.h"
+#include "conn.h"
+#include "parser.h"
+#include "queue.h"
+#include "users.h"
+#include "stats_shards.h"
+#include "history_budget.h"
+#include "file_cache.h"
+#include "compress.h"
+#include "latency.h"
+#include "logger.h"
+
+/**	Tempo massimo (secondi) per inviare la fotografia ad un client di amministrazione
+ */
+#define ADMIN_SEND_TIMEOUT 1
+
+/**	Attesa (millisecondi) prima di riprovare la accept quando mancano descrittori o memoria
+ */
+#define ADMIN_ACCEPT_BACKOFF 100
+
+extern Queue_t *codaFd;							//Coda dei descrittori condivisa tra listener e thread del pool
+extern users_t* users;							//Struttura dati per la gestione degli utenti
+
+static char admin_path[UNIX_PATH_MAX];		//Path del socket di amministrazione
+static int admin_fd = -1;						//Socket di amministrazione
+static int stop_pipe[2] = { -1, -1 };		//Pipe con cui admin_destroy sveglia il thread
+static pthread_t admin_thread;
+static int running = 0;
+
+/**	Scrive su f la fotografia delle metriche, ritorna -1 in caso di errore di scrittura
+ */
+static int write_metrics(FILE* f) {
+	struct statistics stats;
+	int nreg = 0, nonline = 0;
+	unsigned long hbytes = 0, hspilled = 0, hdropped = 0, chits = 0, cmisses = 0, cin = 0, cout = 0, cusec = 0;
+
+	memset(&stats, 0, sizeof(stats));
+	stats_shards_collect(&stats);
+	num_users_lock(users);
+	get_num_users_reg(users, &nreg);
+	get_num_users_conn(users, &nonline);
+	num_users_unlock(users);
+	history_budget_get_stats(&hbytes, &hspilled, &hdropped);
+	file_cache_get_stats(&chits, &cmisses);
+	compress_get_stats(&cin, &cout, &cusec);
+
+	/* VALORI ISTANTANEI: I MESSAGGI NON ANCORA CONSEGNATI SONO QUELLI IN ATTESA NELLE HISTORY (BACKLOG IN USCITA) */
+	if (fprintf(f, "# TYPE chatty_registered_users gauge\nchatty_registered_users %d\n"
+		"# TYPE chatty_online_users gauge\nchatty_online_users %d\n"
+		"# TYPE chatty_queue_depth gauge\nchatty_queue_depth %lu\n"
+		"# TYPE chatty_outbound_backlog_messages gauge\nchatty_outbound_backlog_messages %ld\n"
+		"# TYPE chatty_outbound_backlog_files gauge\nchatty_outbound_backlog_files %ld\n"
+		"# TYPE chatty_history_bytes gauge\nchatty_history_bytes %lu\n",
+		nreg, nonline, length(codaFd), (long)stats.nnotdelivered, (long)stats.nfilenotdelivered, hbytes) < 0) return -1;
+
+	if (fprintf(f, "# TYPE chatty_delivered_messages_total counter\nchatty_delivered_messages_total %lu\n"
+		"# TYPE chatty_delivered_files_total counter\nchatty_delivered_files_total %lu\n"
+		"# TYPE chatty_errors_total counter\nchatty_errors_total %lu\n"
+		"# TYPE chatty_history_spilled_total counter\nchatty_history_spilled_total %lu\n"
+		"# TYPE chatty_history_dropped_total counter\nchatty_history_dropped_total %lu\n"
+		"# TYPE chatty_file_cache_hits_total counter\nchatty_file_cache_hits_total %lu\n"
+		"# TYPE chatty_file_cache_misses_total counter\nchatty_file_cache_misses_total %lu\n"
+		"# TYPE chatty_compress_in_bytes_total counter\nchatty_compress_in_bytes_total %lu\n"
+		"# TYPE chatty_compress_out_bytes_total counter\nchatty_compress_out_bytes_total %lu\n"
+		"# TYPE chatty_compress_cpu_usec_total counter\nchatty_compress_cpu_usec_total %lu\n",
+		stats.ndelivered, stats.nfiledelivered, stats.nerrors, hspilled, hdropped, chits, cmisses, cin, cout, cusec) < 0) return -1;
+
+	return latency_write_metrics(f);
+}
+
+/**	Invia la fotografia delle metriche al client di amministrazione fd
+ */
+static void serve(int fd) {
+	char* buf = NULL;
+	size_t len = 0;
+	struct timeval tv;
+
+	/* UN CLIENT CHE NON LEGGE BLOCCA SOLO QUESTO THREAD, E PER AL PIÙ ADMIN_SEND_TIMEOUT SECONDI */
+	tv.tv_sec = ADMIN_SEND_TIMEOUT;
+	tv.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	/* LA FOTOGRAFIA VIENE COSTRUITA IN MEMORIA E INVIATA CON UNA SOLA SCRITTURA */
+	FILE* f = open_memstream(&buf, &len);
+	if (f == NULL) return;
+	int err = write_metrics(f);
+	if (fclose(f) == 0 && err == 0) writen(fd, buf, len);
+	if (buf) free(buf);
+}
+
+static void* admin_func(void* arg) {
+	struct pollfd pfd[2];
+	int fdc;
+
+	while (1) {
+		pfd[0].fd = admin_fd;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = stop_pipe[0];
+		pfd[1].events = POLLIN;
+		pfd[0].revents = pfd[1].revents = 0;
+		if (poll(pfd, 2, -1) == -1) {
+			if (errno == EINTR) continue;
+			break;
+		}
+		if (pfd[1].revents) break;
+		if ((fdc = accept(admin_fd, NULL, 0)) == -1) {
+			if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN) continue;
+			if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+				/* LA CONNESSIONE RESTA IN CODA: ASPETTO (SVEGLIABILE DA admin_destroy) INVECE DI RIPROVARE SUBITO */
+				LOGGER(LOGGER_WARN, "accept sul socket di amministrazione fallita: %s", strerror(errno));
+				pfd[1].revents = 0;
+				if (poll(&pfd[1], 1, ADMIN_ACCEPT_BACKOFF) > 0 && pfd[1].revents) break;
+				continue;
+			}
+			LOGGER(LOGGER_ERROR, "accept sul socket di amministrazione fallita: %s, termino il thread", strerror(errno));
+			break;
+		}
+		serve(fdc);
+		close(fdc);
+	}
+
+	return (void*)0;
+}
+
+op_res_t admin_init(char* path) {
+	if (!path)
+		return ILLEGAL_ARGUMENT;
+
+	struct sockaddr_un sa;
+
+	memset(admin_path, '\0', UNIX_PATH_MAX);
+	strncpy(admin_path, path, UNIX_PATH_MAX-1);
+
+	if (pipe(stop_pipe) == -1)
+		return SYSTEM_ERROR;
+	admin_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (admin_fd == -1) {
+		admin_destroy();
+		return SYSTEM_ERROR;
+	}
+	memset(&sa, 0, sizeof(sa));
+	strncpy(sa.sun_path, admin_path, sizeof(sa.sun_path)-1);
+	sa.sun_family = AF_UNIX;
+	/* UN SOCKET RIMASTO DA UN'ESECUZIONE PRECEDENTE VIENE SOSTITUITO */
+	unlink(admin_path);
+	if (bind(admin_fd, (const struct sockaddr*)&sa, sizeof(sa)) == -1 || listen(admin_fd, SOMAXCONN) == -1) {
+		admin_destroy();
+		return SYSTEM_ERROR;
+	}
+
+	if (pthread_create(&admin_thread, NULL, admin_func, NULL) != 0) {
+		admin_destroy();
+		return SYSTEM_ERROR;
+	}
+	running = 1;
+
+	return REQUEST_OK;
+}
+
+void admin_destroy() {
+	if (running) {
+		char c = 0;
+		if (writen(stop_pipe[1], &c, 1) != -1) pthread_join(admin_thread, NULL);
+		running = 0;
+	}
+	if (admin_fd != -1) {
+		close(admin_fd);
+		unlink(admin_path);
+		admin_fd = -1;
+	}
+	for (int i = 0; i < 2; i++) {
+		if (stop_pipe[i] != -1) close(stop_pipe[i]);
+		stop_pipe[i] = -1;
+	}
+}
@@ -0,0 +1,34 @@
+
+/** \file admin.h
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#if !defined(ADMIN_H_)
+#define ADMIN_H_
+
+#include "op_res.h"
+
+/**   Socket di amministrazione
+ *    Un thread dedicato accetta connessioni sul socket AdminPath e ad ognuna invia una fotografia delle metriche
+ *    del server nel formato testuale di Prometheus (contatori, valori istantanei e istogrammi delle latenze),
+ *    poi chiude la connessione. Il thread non usa le strutture del thread listener e non acquisisce la mutex
+ *    delle statistiche: il monitoraggio non rallenta la gestione dei client.
+ *    Esempio: nc -U <AdminPath>
+ */
+
+/**   Crea il socket path e avvia il thread di amministrazione, deve essere chiamata da un solo thread
+ *
+ *    \param path:      path del socket
+ *    \return:          se path == NULL allora ILLEGAL_ARGUMENT
+ *                      se c'è un errore nella creazione del socket o del thread allora SYSTEM_ERROR
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t admin_init(char* path);
+
+/**   Termina il thread di amministrazione e rimuove il socket, deve essere chiamata da un solo thread
+ */
+void admin_destroy();
+
+#endif /* ADMIN_H_ */
@@ -34,11 +34,23 @@
 #include "poolThread.h"
 #include "users.h"
 #include "users_list.h"
+#include "history_budget.h"
+#include "file_store.h"
+#include "disk_io.h"
+#include "file_cache.h"
+#include "uploads.h"
+#include "admin.h"
+#include "logger.h"
+#include "flight_recorder.h"
 #include "message.h"
 
 #define DIM_HASH 1024
 #define NUM_MTX_HASH DIM_HASH/32
 
+#ifndef POOL_TERM
+#define POOL_TERM (void*)-1
+#endif
+
 /**	Se result è uguale a value allora stampa str sullo stderr e se doCleanup > 0 libera la memoria, infine termina
  */
 #define CHECK_EQ(result, value, str, doCleanup)	\
@@ -60,7 +72,7 @@
 /* struttura che memorizza le statistiche del server, struct statistics 
  * e' definita in stats.h.
  */
-struct statistics chattyStats = { 0,0,0,0,0,0,0 };
+struct statistics chattyStats = { 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0 };
 
 /* MUTEX PER CHATTYSTATS */
 pthread_mutex_t chattyStatsMtx = PTHREAD_MUTEX_INITIALIZER;
@@ -89,9 +101,6 @@ int countActiveThreads;
 /* MUTEX ASSOCIATA A countActiveThreads */
 pthread_mutex_t mtx_countActiveThreads = PTHREAD_MUTEX_INITIALIZER;
 
-/* MUTEX PER LA GESTIONE DELLA DIRECTORY */
-pthread_mutex_t dir_mtx = PTHREAD_MUTEX_INITIALIZER;
-
 /**	Chiude il descrittore puntato da fd e libera la memoria 
  */
 static void closeFd(void* fd) {
@@ -104,8 +113,14 @@ static void closeFd(void* fd) {
 /**	Dealloca tutte le strutture dati allocate nello heap, chiude descrittori e pipe, distrugge le mutex
  */
 static void cleanup() {
+	admin_destroy();
 	if (users) users_destroy(users);
+	file_store_destroy();
+	file_cache_destroy();
+	uploads_destroy();
+	disk_io_destroy();
 	if (users_list) users_list_destroy(users_list);
+	history_budget_destroy();
 	if (codaFd) deleteQueue(codaFd, closeFd);
 	if (fd_sig != -1) close(fd_sig);
 	if (fdpipe[0] != -1) close(fdpipe[0]);
@@ -116,6 +131,18 @@ static void cleanup() {
 		}
 		free(fd_mtx);
 	}
+	flight_destroy();
+	logger_destroy();
+}
+
+/**	Termina e attende i primi n thread del pool, da chiamare prima di cleanup negli errori successivi alla loro
+ * 	creazione (i thread usano le strutture dati e i buffer del log che cleanup dealloca)
+ */
+static void stop_pool(pthread_t* pool, int n) {
+	for (int i = 0; i < n; i++)
+		pushQueue(codaFd, POOL_TERM);
+	for (int i = 0; i < n; i++)
+		pthread_join(pool[i], NULL);
 }
 
 /**	Configurazione gestione segnali
@@ -131,7 +158,11 @@ static void signal_handle(sigset_t *s) {
 	if (StatFileName[0] == '\0') {
 		CHECK_EQ(sigaction(SIGUSR1, &sa, NULL), -1, "errore sigaction", 0)
 	}
-	//	Maschero SIGINT, SIGTERM e SIGQUIT e se StatFileName è settato anche SIGUSR1
+	//	Se FlightFileName non è settato ignoro anche SIGUSR2
+	if (FlightFileName[0] == '\0') {
+		CHECK_EQ(sigaction(SIGUSR2, &sa, NULL), -1, "errore sigaction", 0)
+	}
+	//	Maschero SIGINT, SIGTERM e SIGQUIT, se StatFileName è settato anche SIGUSR1 e se FlightFileName è settato anche SIGUSR2
 	//	Per ascoltarli in seguito con la signalfd
 	CHECK_EQ(sigemptyset(&set), -1, "errore sigemptyset", 0)
 	CHECK_EQ(sigaddset(&set, SIGINT), -1, "errore sigaddset", 0)
@@ -140,6 +171,9 @@ static void signal_handle(sigset_t *s) {
 	if (StatFileName[0] != '\0') {
 		CHECK_EQ(sigaddset(&set, SIGUSR1), -1, "errore sigaddset", 0)
 	}
+	if (FlightFileName[0] != '\0') {
+		CHECK_EQ(sigaddset(&set, SIGUSR2), -1, "errore sigaddset", 0)
+	}
 	CHECK_EQ(pthread_sigmask(SIG_SETMASK, &set, NULL), -1, "errore mascheramento segnali", 0)
 	*s = set;
 }
@@ -161,6 +195,9 @@ int main(int argc, char *argv[]) {
 
 	signal_handle(&set);
 
+	/* Avvio del thread del log (dopo aver mascherato i segnali, gestiti solo dal listener) */
+	CHECK_EQ(logger_init((int)LogLevel), -1, "Errore avvio thread del log", 0)
+
 	pthread_t listenerT, pool[ThreadsInPool];
 
 	fdpipe[0] = fdpipe[1] = fd_sig = -1;
@@ -173,7 +210,7 @@ int main(int argc, char *argv[]) {
 	users = users_init(DIM_HASH, NUM_MTX_HASH, MaxConnections);
 	CHECK_EQ(users, NULL, "Errore inizializzazione struttura utenti", 1)
 
-	users_list = users_list_init();
+	users_list = users_list_init(MaxConnections);
 	CHECK_EQ(users_list, NULL, "Errore inizializzazione lista utenti connessi", 1)
 
 	fd_mtx = (pthread_mutex_t*) malloc(MaxConnections*sizeof(pthread_mutex_t));
@@ -192,32 +229,63 @@ int main(int argc, char *argv[]) {
 	if (stat(DirName, &st) == -1) {
 		mkdir(DirName, 0700);
 	}
+
+	/* Avvio dello stadio di I/O su disco */
+	CHECK_NEQ(disk_io_init((FsyncPolicy == 1) ? FSYNC_BATCH : FSYNC_NONE, (DurabilityAck == 1) ? ACK_SYNCED : ACK_WRITTEN), REQUEST_OK, "Errore avvio thread di I/O su disco", 1)
+
+	/* Inizializzazione dello store dei file */
+	CHECK_NEQ(file_store_init(DirName, DIM_HASH, FileShardLevels), REQUEST_OK, "Errore inizializzazione store dei file", 1)
+
+	/* Inizializzazione della tabella dei caricamenti a blocchi */
+	CHECK_NEQ(uploads_init(DirName, DIM_HASH, MaxUploadsPerUser, UploadIdleTimeout), REQUEST_OK, "Errore inizializzazione caricamenti", 1)
+
+	/* Inizializzazione della cache dei file */
+	CHECK_NEQ(file_cache_init(FileCacheSize*1024, DIM_HASH), REQUEST_OK, "Errore inizializzazione cache dei file", 1)
+
+	/* Inizializzazione del budget di memoria delle history */
+	CHECK_NEQ(history_budget_init(MaxHistMemory*1024, (HistOverflowPolicy == 1) ? HIST_DROP : HIST_SPILL, DirName), REQUEST_OK, "Errore inizializzazione budget history", 1)
+	
+	/* Avvio del socket di amministrazione (opzionale) */
+	if (AdminPath[0] != '\0') {
+		CHECK_NEQ(admin_init(AdminPath), REQUEST_OK, "Errore creazione socket di amministrazione", 1)
+	}
 	
 	/* Creazione threads */
 	for (int i = 0; i < ThreadsInPool; i++) {
-		CHECK_NEQ(pthread_create(pool + i, NULL, pool_func, NULL), 0, "Errore creazione thread del pool", 1)
-		printf("Ho creato il thread del pool n %ld\n", pool[i]);
+		if (pthread_create(pool + i, NULL, pool_func, NULL) != 0) {
+			fprintf(stderr, "Errore creazione thread del pool\n");
+			stop_pool(pool, i);
+			cleanup();
+			exit(EXIT_FAILURE);
+		}
+		LOGGER(LOGGER_INFO, "Ho creato il thread del pool n %ld", pool[i]);
 	}
 
-   CHECK_NEQ(pthread_create(&listenerT, NULL, listener, &fd_sig), 0, "Errore creazione thread listener", 1)
-   printf("Ho creato il listener\n");
+	if (pthread_create(&listenerT, NULL, listener, &fd_sig) != 0) {
+		fprintf(stderr, "Errore creazione thread listener\n");
+		stop_pool(pool, ThreadsInPool);
+		cleanup();
+		exit(EXIT_FAILURE);
+	}
+   LOGGER(LOGGER_INFO, "Ho creato il listener");
 	
 	/* Attesa threads */
 	int poolError = 0, res_join = 0;
    int retValuePool[ThreadsInPool];
 	for (int i = 0; i < ThreadsInPool; i++) {
 	   res_join = pthread_join(pool[i], (void**)&retValuePool[i]);
-	   CHECK_NEQ(res_join, 0, "Errore join thread", 1)
+	   /* GLI ALTRI THREAD POTREBBERO ESSERE ANCORA ATTIVI: NON DEALLOCO LE STRUTTURE DATI */
+	   CHECK_NEQ(res_join, 0, "Errore join thread", 0)
 	   if (retValuePool[i] == 0)
-	      printf("il thread del pool n %ld ha terminato con successo\n", pool[i]);
+	      LOGGER(LOGGER_INFO, "il thread del pool n %ld ha terminato con successo", pool[i]);
 	   else if (retValuePool[i] != 0) {
-	      printf("il thread del pool n %ld ha terminato con fallimento\n", pool[i]);
+	      LOGGER(LOGGER_INFO, "il thread del pool n %ld ha terminato con fallimento", pool[i]);
 	      poolError = 1;
 	   }
 	}
 	
 	int listenerError;
-	CHECK_NEQ(pthread_join(listenerT, (void**)&listenerError), 0, "Errore join listener", 1)
+	CHECK_NEQ(pthread_join(listenerT, (void**)&listenerError), 0, "Errore join listener", 0)
 
 	cleanup();
 
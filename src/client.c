@@ -52,7 +52,7 @@ static size_t      msglen=0;
 static void use(const char * filename) {
     fprintf(stderr, 
 	    "use:\n"
-	    " %s -l unix_socket_path -k nick -c nick -[gad] group -t milli -S msg:to -s file:to -R n -h\n"
+	    " %s -l unix_socket_path -k nick -c nick -[gad] group -t milli -P seq:n -S msg:to -s file:to -R n -h\n"
 	    "  -l specifica il socket dove il server e' in ascolto\n"
 	    "  -k specifica il nickname del client\n"
 	    "  -c specifica il nickname che deve essere creato\n"
@@ -62,8 +62,10 @@ static void use(const char * filename) {
 	    "  -d rimuove  'nick' dal gruppo 'group'\n"
 	    "  -L richiede la lista degli utenti online\n"
 	    "  -p richiede di recuperare la history dei messaggi\n"
+	    "  -P richiede i messaggi della history successivi al numero di sequenza 'seq' (al piu' 'n', 0 tutti)\n"
 	    "  -t specifica i millisecondi 'milli' che intercorrono tra la gestione di due comandi consecutivi\n"
 	    "  -S spedisce il messaggio 'msg' al destinatario 'to' che puo' essere un nickname o groupname\n"
+	    "     oppure una lista di nickname separati da ',' (un'unica richiesta per tutti i destinatari)\n"
 	    "  -s come l'opzione -S ma permette di spedire files\n"
 	    "  -R riceve un messaggio da un nickname o groupname, se viene ricevuto un identificatore di file\n"
 	    "     il file viene scaricato dal server. In base al valore di n il comportamento e' diverso, se:\n"
@@ -131,11 +133,17 @@ static int downloadFile(int connfd, char *filename, char *sender) {
     return -1;
 }
 
+// stampa un messaggio testuale, il destinatario solo se non e' l'utente (es. un gruppo)
+static void printText(message_t *m, char *sname) {
+    if (strcmp(m->data.hdr.receiver, sname) == 0) printf("[%s:] %s\n", m->hdr.sender, m->data.buf);
+    else printf("[%s -> %s:] %s\n", m->hdr.sender, m->data.hdr.receiver, m->data.buf);
+}
+
 // gestisce operazioni di tipo richiesta-risposta
 static int execute_requestreply(int connfd, operation_t *o) {
     char *sname = o->sname;
-    char *rname = o->rname?o->rname:"";
     op_t op     = o->op;
+    char *rname = (o->rname && op != POSTTXTMULTI_OP)?o->rname:"";
     message_t msg;
     char  *mappedfile = NULL;
     
@@ -168,6 +176,20 @@ static int execute_requestreply(int connfd, operation_t *o) {
 	} else 
 	    setData(&msg.data, rname, o->msg, o->size);	    
     } 
+    if (op == GETPREVMSGS_AFTER_OP) 
+	setData(&msg.data, rname, o->msg, o->size); // invio il cursore
+    if (op == POSTTXTMULTI_OP) { // [n][n nickname][messaggio]
+	unsigned int n = 1;
+	rname = o->rname;
+	for(char *q = rname; *q; ++q) n += (*q == ',');
+	char *buf = calloc(MULTI_HDR_SIZE(n) + o->size, 1);
+	if (!buf) return -1;
+	memcpy(buf, &n, sizeof(unsigned int));
+	for(unsigned int i = 0; i < n; ++i, rname = strchr(rname, ',') + 1)
+	    strncpy(buf + MULTI_HDR_SIZE(i), rname, strcspn(rname, ",") > MAX_NAME_LENGTH ? MAX_NAME_LENGTH : strcspn(rname, ","));
+	memcpy(buf + MULTI_HDR_SIZE(n), o->msg, o->size);
+	setData(&msg.data, "", buf, MULTI_HDR_SIZE(n) + o->size);
+    }
     
     // spedizione effettiva
     if (sendRequest(connfd, &msg) == -1) {
@@ -236,13 +258,20 @@ static int execute_requestreply(int connfd, operation_t *o) {
 	    printf(" %s\n", &msg.data.buf[p]);
 	}
     } break;
+    case GETPREVMSGS_AFTER_OP: 
     case GETPREVMSGS_OP: { // ... ricevere la lista dei vecchi messaggi
 	if (readData(connfd, &msg.data) <= 0) {
 	    perror("reply data");
 	    return -1; 
 	}	
 	// numero di messaggi che devo ricevere
-	size_t nmsgs = *(size_t*)(msg.data.buf); 
+	size_t nmsgs;
+	if (op == GETPREVMSGS_AFTER_OP) {
+	    history_page_t *page = (history_page_t*)(msg.data.buf);
+	    nmsgs = page->nmsgs;
+	    printf("[messaggi da %lu a %lu, ultimo nella history %lu]\n", page->first_seq, page->last_seq, page->latest_seq);
+	} else
+	    nmsgs = *(size_t*)(msg.data.buf); 
 	char *FILENAMES[nmsgs]; // NOTA: si suppone che nmsgs non sia molto grande
 	size_t nfiles=0;
 	for(size_t i=0;i<nmsgs;++i) {
@@ -257,7 +286,7 @@ static int execute_requestreply(int connfd, operation_t *o) {
 		nfiles++;
 		printf("[%s vuole inviare il file '%s']\n", pmsg.hdr.sender, pmsg.data.buf);
 	    } else 
-		printf("[%s:] %s\n", pmsg.hdr.sender, (char*)pmsg.data.buf);
+		printText(&pmsg, sname);
 	}	    
 
 	// scarico i file che ho ricevuto
@@ -269,6 +298,12 @@ static int execute_requestreply(int connfd, operation_t *o) {
 	    printf("[Il file '%s' e' stato scaricato correttamente]\n",FILENAMES[i]);
 	}
     } break;
+    case POSTTXTMULTI_OP: { // ... ricevere l'esito per ogni destinatario (1 registrato, 0 sconosciuto)
+	if (readData(connfd, &msg.data) <= 0) return -1;
+	unsigned int i = 0;
+	for(char *r = o->rname; r; r = strchr(r, ',') ? strchr(r, ',') + 1 : NULL, ++i)
+	    printf("[%.*s: %d]\n", (int)strcspn(r, ","), r, (msg.data.buf[i/8] >> (i%8)) & 1);
+    } break;
     case POSTTXT_OP:
     case POSTTXTALL_OP:
     case POSTFILE_OP:
@@ -306,7 +341,7 @@ static int execute_receive(int connfd, operation_t *o) {
 		}
 		printf("[Il file '%s' e' stato scaricato correttamente]\n",filename);
 	    } else 
-		printf("[%s:] %s\n", MSGS[i].hdr.sender, (char*)MSGS[i].data.buf);
+		printText(&MSGS[i], sname);
 
 	    if (++c == m) break;
 	}
@@ -320,7 +355,7 @@ static int execute_receive(int connfd, operation_t *o) {
 	}	
 	switch(msg.hdr.op) {
 	case TXT_MESSAGE: {
-	    printf("[%s:] %s\n", msg.hdr.sender, (char*)msg.data.buf);
+	    printText(&msg, sname);
 	} break;
 	case FILE_MESSAGE: {
 	    char *filename = strdup(msg.data.buf);
@@ -343,7 +378,7 @@ static int execute_receive(int connfd, operation_t *o) {
 }
 
 int main(int argc, char *argv[]) {
-    const char optstring[] = "l:k:c:C:g:a:d:t:S:s:R:pLh";
+    const char optstring[] = "l:k:c:C:g:a:d:t:S:s:R:P:pLh";
     int optc;
     char *spath = NULL, *nick = NULL;
     operation_t *ops = NULL;
@@ -442,6 +477,23 @@ int main(int argc, char *argv[]) {
 	    ops[k].size  = 0;
 	    ++k;
 	} break;
+	case 'P': {
+	    nickneeded = 1;
+	    history_cursor_t *cursor = malloc(sizeof(history_cursor_t));
+	    char *p;
+	    if (!cursor) {
+		perror("malloc");
+		return -1;
+	    }
+	    cursor->after_seq = strtoul(optarg, &p, 10);
+	    cursor->max_msgs  = (*p == ':') ? strtoul(p+1, NULL, 10) : 0;
+	    ops[k].sname = nick;
+	    ops[k].rname = NULL;
+	    ops[k].op    = GETPREVMSGS_AFTER_OP;
+	    ops[k].msg   = (char*)cursor;
+	    ops[k].size  = sizeof(history_cursor_t);
+	    ++k;
+	} break;
 	case 'S': {
 	    nickneeded = 1;
 	    char *arg = strdup(optarg);
@@ -460,7 +512,7 @@ int main(int argc, char *argv[]) {
 
 	    ops[k].sname = nick;    
 	    ops[k].rname = strlen(p)?p:NULL;
-	    ops[k].op    = strlen(p)?POSTTXT_OP:POSTTXTALL_OP;
+	    ops[k].op    = strlen(p)?(strchr(p, ',')?POSTTXTMULTI_OP:POSTTXT_OP):POSTTXTALL_OP;
 	    ops[k].msg   = arg;
 	    ops[k].size  = strlen(arg)+1;
 
@@ -0,0 +1,212 @@
+
+/** \file compress.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "compress.h"
+#include "parser.h"
+
+/**	Lunghezza minima di un match
+ */
+#define LZ_MIN_MATCH 4
+
+/**	Distanza massima di un match (l'offset occupa 2 byte)
+ */
+#define LZ_MAX_OFFSET 65535
+
+/**	Bit dell'indice della tabella hash delle posizioni
+ */
+#define LZ_HASH_BITS 12
+
+static unsigned long stat_bytes_in = 0;		//Byte sottoposti a compressione
+static unsigned long stat_bytes_out = 0;		//Byte risultanti
+static unsigned long stat_usec = 0;				//Tempo di CPU speso a comprimere e decomprimere
+
+/**	Tempo di CPU del thread chiamante in microsecondi
+ */
+static unsigned long cpu_usec() {
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == -1) return 0;
+	return (unsigned long)ts.tv_sec*1000000UL + ts.tv_nsec/1000;
+}
+
+/**	Hash dei 4 byte in p
+ */
+static unsigned int hash4(const unsigned char* p) {
+	unsigned int v = (unsigned int)p[0] | (unsigned int)p[1] << 8 | (unsigned int)p[2] << 16 | (unsigned int)p[3] << 24;
+	return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+/**	Scrive in out la parte estesa (byte da 255 e resto) di una lunghezza n >= 15, ritorna -1 se non c'è spazio
+ */
+static int put_length(unsigned char* out, size_t* op, size_t cap, size_t n) {
+	for (n -= 15; n >= 255; n -= 255) {
+		if (*op >= cap) return -1;
+		out[(*op)++] = 255;
+	}
+	if (*op >= cap) return -1;
+	out[(*op)++] = (unsigned char)n;
+	return 0;
+}
+
+/**	Legge la parte estesa di una lunghezza, ritorna -1 se il contenuto compresso è troncato
+ */
+static int get_length(const unsigned char* in, size_t* ip, size_t len, size_t* n) {
+	unsigned char byte;
+	do {
+		if (*ip >= len) return -1;
+		byte = in[(*ip)++];
+		*n += byte;
+	} while (byte == 255);
+	return 0;
+}
+
+/**	Scrive in out un elemento con lit letterali e (se mlen > 0) un match di mlen byte a distanza offset,
+ * 	ritorna -1 se non c'è spazio
+ */
+static int put_sequence(unsigned char* out, size_t* op, size_t cap, const unsigned char* lit, size_t nlit, size_t offset, size_t mlen) {
+	size_t mcode = (mlen > 0) ? mlen - LZ_MIN_MATCH : 0;
+
+	if (*op >= cap) return -1;
+	out[(*op)++] = (unsigned char)(((nlit < 15) ? nlit : 15) << 4 | ((mcode < 15) ? mcode : 15));
+	if (nlit >= 15 && put_length(out, op, cap, nlit) == -1) return -1;
+	if (cap - *op < nlit) return -1;
+	memcpy(out + *op, lit, nlit);
+	*op += nlit;
+	if (mlen == 0) return 0;
+
+	if (cap - *op < 2) return -1;
+	out[(*op)++] = (unsigned char)(offset & 0xFF);
+	out[(*op)++] = (unsigned char)(offset >> 8);
+	if (mcode >= 15 && put_length(out, op, cap, mcode) == -1) return -1;
+	return 0;
+}
+
+/**	Comprime len byte di src in dst (di cap byte), ritorna la lunghezza del contenuto compresso o -1 se non entra in dst
+ */
+static long lz_compress(const unsigned char* src, size_t len, unsigned char* dst, size_t cap) {
+	unsigned int table[1 << LZ_HASH_BITS];		//Ultima posizione (+1) di ogni hash, 0 nessuna
+	size_t ip = 0, anchor = 0, op = 0;
+
+	memset(table, 0, sizeof(table));
+	while (ip + LZ_MIN_MATCH <= len) {
+		unsigned int h = hash4(src + ip);
+		size_t ref = table[h];
+		table[h] = ip + 1;
+		if (ref == 0 || ip - (ref - 1) > LZ_MAX_OFFSET || memcmp(src + ref - 1, src + ip, LZ_MIN_MATCH) != 0) {
+			ip++;
+			continue;
+		}
+		ref--;
+		size_t mlen = LZ_MIN_MATCH;
+		while (ip + mlen < len && src[ref + mlen] == src[ip + mlen]) mlen++;
+		if (put_sequence(dst, &op, cap, src + anchor, ip - anchor, ip - ref, mlen) == -1) return -1;
+		ip += mlen;
+		anchor = ip;
+	}
+	/* L'ULTIMO ELEMENTO CONTIENE SOLO I LETTERALI RIMANENTI */
+	if (put_sequence(dst, &op, cap, src + anchor, len - anchor, 0, 0) == -1) return -1;
+
+	return op;
+}
+
+/**	Decomprime len byte di src in dst (di cap byte), ritorna la lunghezza del contenuto decompresso o -1 se malformato.
+ * 	Se prefix vale 1 la decompressione si ferma dopo i primi cap byte (il resto di src non viene esaminato)
+ */
+static long lz_decompress(const unsigned char* src, size_t len, unsigned char* dst, size_t cap, int prefix) {
+	size_t ip = 0, op = 0;
+
+	while (ip < len) {
+		unsigned char token = src[ip++];
+		size_t nlit = token >> 4;
+		if (nlit == 15 && get_length(src, &ip, len, &nlit) == -1) return -1;
+		if (len - ip < nlit) return -1;
+		if (cap - op < nlit) {
+			if (!prefix) return -1;
+			memcpy(dst + op, src + ip, cap - op);
+			return cap;
+		}
+		memcpy(dst + op, src + ip, nlit);
+		ip += nlit;
+		op += nlit;
+		if (ip == len) break;
+
+		if (len - ip < 2) return -1;
+		size_t offset = (size_t)src[ip] | (size_t)src[ip+1] << 8;
+		ip += 2;
+		size_t mlen = token & 0x0F;
+		if (mlen == 15 && get_length(src, &ip, len, &mlen) == -1) return -1;
+		mlen += LZ_MIN_MATCH;
+		if (offset == 0 || offset > op) return -1;
+		if (cap - op < mlen) {
+			if (!prefix) return -1;
+			mlen = cap - op;
+		}
+		/* IL MATCH PUÒ SOVRAPPORSI AI BYTE CHE STA SCRIVENDO ==> COPIA UN BYTE ALLA VOLTA */
+		for (size_t i = 0; i < mlen; i++, op++)
+			dst[op] = dst[op - offset];
+		if (prefix && op == cap) break;
+	}
+
+	return op;
+}
+
+long compress_buffer(char* src, size_t len, char** dst) {
+	if (!src || !dst || CompressThreshold <= 0 || len < (size_t)CompressThreshold)
+		return 0;
+
+	/* IL CONTENUTO COMPRESSO DEVE ESSERE PIÙ CORTO DELL'ORIGINALE ==> IL BUFFER HA len-1 BYTE */
+	*dst = (char*) malloc(len);
+	if (*dst == NULL)
+		return -1;
+
+	unsigned long start = cpu_usec();
+	long n = lz_compress((unsigned char*)src, len, (unsigned char*)*dst, len - 1);
+	unsigned long elapsed = cpu_usec() - start;
+
+	__sync_add_and_fetch(&stat_bytes_in, len);
+	__sync_add_and_fetch(&stat_bytes_out, (n > 0) ? (unsigned long)n : len);
+	__sync_add_and_fetch(&stat_usec, elapsed);
+
+	if (n <= 0) {
+		free(*dst);
+		*dst = NULL;
+		return 0;
+	}
+
+	return n;
+}
+
+int decompress_buffer(char* src, size_t len, char* dst, size_t raw_len) {
+	if (!src || !dst)
+		return -1;
+
+	unsigned long start = cpu_usec();
+	long n = lz_decompress((unsigned char*)src, len, (unsigned char*)dst, raw_len, 0);
+	__sync_add_and_fetch(&stat_usec, cpu_usec() - start);
+
+	return (n == (long)raw_len) ? 0 : -1;
+}
+
+int decompress_prefix(char* src, size_t len, char* dst, size_t prefix_len) {
+	if (!src || !dst)
+		return -1;
+
+	unsigned long start = cpu_usec();
+	long n = lz_decompress((unsigned char*)src, len, (unsigned char*)dst, prefix_len, 1);
+	__sync_add_and_fetch(&stat_usec, cpu_usec() - start);
+
+	return (n == (long)prefix_len) ? 0 : -1;
+}
+
+void compress_get_stats(unsigned long* bytes_in, unsigned long* bytes_out, unsigned long* usec) {
+	if (bytes_in) *bytes_in = __sync_add_and_fetch(&stat_bytes_in, 0);
+	if (bytes_out) *bytes_out = __sync_add_and_fetch(&stat_bytes_out, 0);
+	if (usec) *usec = __sync_add_and_fetch(&stat_usec, 0);
+}
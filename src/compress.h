@@ -0,0 +1,63 @@
+
+/** \file compress.h
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#if !defined(COMPRESS_H_)
+#define COMPRESS_H_
+
+#include <stddef.h>
+
+/**   Compressione dei messaggi e dei file (lato server)
+ *    Il formato è a blocchi LZ77 nello stile di LZ4: una sequenza di elementi [token][letterali][offset][match], dove
+ *    il token contiene nei 4 bit alti il numero di letterali e nei 4 bit bassi la lunghezza del match meno 4 (il valore
+ *    15 indica che la lunghezza prosegue in byte successivi, sommati finché valgono 255), l'offset è di 2 byte
+ *    little-endian e l'ultimo elemento contiene solo letterali. Vengono compressi solo i contenuti di almeno
+ *    CompressThreshold byte (0 compressione disabilitata) e solo se la compressione riduce la dimensione.
+ *    Tutte le funzioni sono thread-safe.
+ */
+
+/**   Comprime src se la sua lunghezza raggiunge la soglia e la compressione riduce la dimensione
+ *
+ *    \param src:       contenuto da comprimere
+ *    \param len:       lunghezza in byte del contenuto
+ *    \param dst:       indirizzo in cui salvare il contenuto compresso (allocato nello heap, da deallocare con free)
+ *    \return:          se il contenuto è stato compresso allora la lunghezza del contenuto compresso (*dst è valido)
+ *                      se il contenuto non va compresso allora 0
+ *                      se c'è un errore di allocazione della memoria allora -1
+ */
+long compress_buffer(char* src, size_t len, char** dst);
+
+/**   Decomprime src, che deve contenere esattamente raw_len byte una volta decompresso
+ *
+ *    \param src:       contenuto compresso
+ *    \param len:       lunghezza in byte del contenuto compresso
+ *    \param dst:       buffer di almeno raw_len byte in cui salvare il contenuto decompresso
+ *    \param raw_len:   lunghezza in byte del contenuto decompresso
+ *    \return:          se il contenuto compresso è malformato o non corrisponde a raw_len byte allora -1
+ *                      altrimenti 0
+ */
+int decompress_buffer(char* src, size_t len, char* dst, size_t raw_len);
+
+/**   Decomprime solo i primi prefix_len byte del contenuto di src (il resto non viene decompresso)
+ *
+ *    \param src:       contenuto compresso
+ *    \param len:       lunghezza in byte del contenuto compresso
+ *    \param dst:       buffer di almeno prefix_len byte in cui salvare i byte decompressi
+ *    \param prefix_len: numero di byte da decomprimere (al più la lunghezza del contenuto decompresso)
+ *    \return:          se il contenuto compresso è malformato o decompresso è più corto di prefix_len byte allora -1
+ *                      altrimenti 0
+ */
+int decompress_prefix(char* src, size_t len, char* dst, size_t prefix_len);
+
+/**   Restituisce le statistiche della compressione
+ *
+ *    \param bytes_in:  indirizzo in cui salvare i byte sottoposti a compressione
+ *    \param bytes_out: indirizzo in cui salvare i byte risultanti (i contenuti non ridotti contano per intero)
+ *    \param usec:      indirizzo in cui salvare il tempo di CPU (microsecondi) speso a comprimere e decomprimere
+ */
+void compress_get_stats(unsigned long* bytes_in, unsigned long* bytes_out, unsigned long* usec);
+
+#endif /* COMPRESS_H_ */
@@ -0,0 +1,329 @@
+
+/** \file disk_io.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "disk_io.h"
+#include "boundedqueue.h"
+#include "lock_profile.h"
+
+/**	Numero massimo di operazioni in coda (chi accoda un'operazione con la coda piena attende)
+ */
+#define IO_QUEUE_SIZE 256
+
+/**	Numero massimo di operazioni eseguite in un gruppo
+ */
+#define IO_BATCH 32
+
+/**	Lunghezza massima di un path
+ */
+#define IO_PATH_MAX 1200
+
+/**	Operazione su disco
+ */
+typedef struct io_req {
+	int is_unlink;					//1 se l'operazione è una rimozione, 0 se è una scrittura o uno spostamento
+	char path[IO_PATH_MAX];		//Path del file
+	char* src;						//Path del file da spostare in path (NULL se l'operazione non è uno spostamento)
+	char* buf;						//Contenuto da scrivere
+	size_t len;						//Lunghezza del contenuto
+	int done;						//1 se l'operazione ha raggiunto il livello di durabilità richiesto
+	op_res_t result;				//Risultato dell'operazione
+} io_req_t;
+
+static fsync_policy_t fsync_policy = FSYNC_NONE;
+static durability_t durability = ACK_WRITTEN;
+static BQueue_t* io_queue = NULL;							//Coda delle operazioni
+static int running = 0;											//1 se il thread di I/O è attivo
+static int stop = 0;												//1 se il thread di I/O deve terminare
+static pthread_t io_thread;
+static pthread_mutex_t io_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t not_full = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;	//Segnalata quando delle scritture vengono completate
+
+/**	Scrive buf nel file temporaneo path.tmp e lo rinomina in path, ritorna -1 in caso di errore 0 altrimenti
+ */
+static int write_file(char* path, char* buf, size_t len) {
+	char tmp_path[IO_PATH_MAX+8];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd == -1) return -1;
+
+	size_t written = 0;
+	ssize_t n;
+	while (written < len) {
+		if ((n = write(fd, buf + written, len - written)) == -1) {
+			close(fd);
+			unlink(tmp_path);
+			return -1;
+		}
+		written += n;
+	}
+	/* IL CONTENUTO DEVE ESSERE SU DISCO PRIMA DELLA RENAME, ALTRIMENTI DOPO UN CRASH IL FILE POTREBBE ESSERE VUOTO */
+	if ((fsync_policy == FSYNC_BATCH && fsync(fd) == -1) || close(fd) == -1 || rename(tmp_path, path) == -1) {
+		unlink(tmp_path);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**	Sposta il file src in path (se la politica lo prevede src viene prima sincronizzato),
+ * 	ritorna -1 in caso di errore 0 altrimenti
+ */
+static int move_file(char* src, char* path) {
+	if (fsync_policy == FSYNC_BATCH) {
+		int fd = open(src, O_RDONLY);
+		if (fd == -1) return -1;
+		if (fsync(fd) == -1) {
+			close(fd);
+			return -1;
+		}
+		close(fd);
+	}
+
+	return rename(src, path);
+}
+
+/**	Copia in dir la directory che contiene path
+ */
+static void parent_dir(char* path, char* dir) {
+	strncpy(dir, path, IO_PATH_MAX-1);
+	dir[IO_PATH_MAX-1] = '\0';
+	char* slash = strrchr(dir, '/');
+	if (slash != NULL) *slash = '\0';
+	else strcpy(dir, ".");
+}
+
+/**	Sincronizza la directory dir, ritorna -1 in caso di errore 0 altrimenti
+ */
+static int sync_dir(char* dir) {
+	int fd = open(dir, O_RDONLY);
+	if (fd == -1) return -1;
+	int res = fsync(fd);
+	close(fd);
+
+	return res;
+}
+
+/**	Esegue un gruppo di operazioni: prima tutte le scritture e rimozioni, poi (se la politica lo prevede) una sola
+ * 	sincronizzazione per ogni directory coinvolta. Le scritture vengono completate appena raggiungono il livello
+ * 	di durabilità richiesto (una scrittura completata non può più essere acceduta: è allocata dal chiamante)
+ */
+static void execute_batch(io_req_t** batch, int n) {
+	static char dirs[IO_BATCH][IO_PATH_MAX];		//Directory coinvolte nel gruppo (usate solo dal thread di I/O)
+	int dir_of[IO_BATCH];								//Indice in dirs della directory dell'operazione i
+	int dir_err[IO_BATCH];								//1 se la sincronizzazione della directory k è fallita
+	int is_unlink[IO_BATCH];							//Copia del tipo delle operazioni
+	int acked = 0;											//1 se le scritture sono già state completate
+	int num_dirs = 0, i, k;
+
+	for (i = 0; i < n; i++) {
+		is_unlink[i] = batch[i] -> is_unlink;
+		if (is_unlink[i]) {
+			unlink(batch[i] -> path);
+			batch[i] -> result = REQUEST_OK;
+		}
+		else if (batch[i] -> src != NULL) batch[i] -> result = (move_file(batch[i] -> src, batch[i] -> path) == -1) ? SYSTEM_ERROR : REQUEST_OK;
+		else batch[i] -> result = (write_file(batch[i] -> path, batch[i] -> buf, batch[i] -> len) == -1) ? SYSTEM_ERROR : REQUEST_OK;
+	}
+
+	if (fsync_policy == FSYNC_BATCH) {
+		/* RAGGRUPPO LE OPERAZIONI PER DIRECTORY: OGNI DIRECTORY VIENE SINCRONIZZATA UNA SOLA VOLTA */
+		for (i = 0; i < n; i++) {
+			parent_dir(batch[i] -> path, dirs[num_dirs]);
+			for (k = 0; k < num_dirs && strcmp(dirs[k], dirs[num_dirs]) != 0; k++);
+			if (k == num_dirs) num_dirs++;
+			dir_of[i] = k;
+		}
+
+		/* LE SCRITTURE CHE NON ATTENDONO LA SINCRONIZZAZIONE DELLE DIRECTORY POSSONO ESSERE COMPLETATE SUBITO */
+		if (durability == ACK_WRITTEN) {
+			LP_LOCK(LP_IO, 0, &io_mtx);
+			for (i = 0; i < n; i++) {
+				if (!is_unlink[i]) batch[i] -> done = 1;
+			}
+			pthread_cond_broadcast(&done_cond);
+			LP_UNLOCK(LP_IO, 0, &io_mtx);
+			acked = 1;
+		}
+
+		for (k = 0; k < num_dirs; k++)
+			dir_err[k] = (sync_dir(dirs[k]) == -1);
+	}
+
+	/* COMPLETO LE SCRITTURE E DEALLOCO LE RIMOZIONI (NESSUNO LE ATTENDE) */
+	LP_LOCK(LP_IO, 0, &io_mtx);
+	for (i = 0; i < n; i++) {
+		if (is_unlink[i]) free(batch[i]);
+		else if (!acked) {
+			if (fsync_policy == FSYNC_BATCH && dir_err[dir_of[i]]) batch[i] -> result = SYSTEM_ERROR;
+			batch[i] -> done = 1;
+		}
+	}
+	pthread_cond_broadcast(&done_cond);
+	LP_UNLOCK(LP_IO, 0, &io_mtx);
+}
+
+/**	Funzione eseguita dal thread di I/O: estrae dalla coda al più IO_BATCH operazioni alla volta e le esegue
+ */
+static void* io_func(void* arg) {
+	io_req_t* batch[IO_BATCH];
+	int n;
+
+	for (;;) {
+		LP_LOCK(LP_IO, 0, &io_mtx);
+		while (getBQueueLen(io_queue) == 0 && !stop)
+			LP_COND_WAIT(LP_IO, 0, &not_empty, &io_mtx);
+		if (getBQueueLen(io_queue) == 0 && stop) {
+			LP_UNLOCK(LP_IO, 0, &io_mtx);
+			break;
+		}
+		for (n = 0; n < IO_BATCH && getBQueueLen(io_queue) > 0; n++)
+			batch[n] = popBQueue(io_queue);
+		pthread_cond_broadcast(&not_full);
+		LP_UNLOCK(LP_IO, 0, &io_mtx);
+
+		execute_batch(batch, n);
+	}
+
+	return (void*)0;
+}
+
+/**	Accoda l'operazione req attendendo se la coda è piena, ritorna -1 se il thread di I/O non è attivo
+ */
+static int enqueue(io_req_t* req) {
+	LP_LOCK(LP_IO, 0, &io_mtx);
+	if (!running || stop) {
+		LP_UNLOCK(LP_IO, 0, &io_mtx);
+		return -1;
+	}
+	while (pushBQueue(io_queue, req) == -1)
+		LP_COND_WAIT(LP_IO, 0, &not_full, &io_mtx);
+	pthread_cond_signal(&not_empty);
+	LP_UNLOCK(LP_IO, 0, &io_mtx);
+
+	return 0;
+}
+
+op_res_t disk_io_init(fsync_policy_t policy, durability_t ack) {
+	fsync_policy = policy;
+	durability = ack;
+
+	io_queue = initBQueue(IO_QUEUE_SIZE);
+	if (io_queue == NULL)
+		return SYSTEM_ERROR;
+
+	stop = 0;
+	if (pthread_create(&io_thread, NULL, io_func, NULL) != 0) {
+		destroyBQueue(io_queue, NULL);
+		io_queue = NULL;
+		return SYSTEM_ERROR;
+	}
+	running = 1;
+
+	return REQUEST_OK;
+}
+
+void disk_io_destroy() {
+	LP_LOCK(LP_IO, 0, &io_mtx);
+	if (!running) {
+		LP_UNLOCK(LP_IO, 0, &io_mtx);
+		return;
+	}
+	stop = 1;
+	pthread_cond_signal(&not_empty);
+	LP_UNLOCK(LP_IO, 0, &io_mtx);
+
+	pthread_join(io_thread, NULL);
+
+	LP_LOCK(LP_IO, 0, &io_mtx);
+	running = 0;
+	destroyBQueue(io_queue, NULL);
+	io_queue = NULL;
+	LP_UNLOCK(LP_IO, 0, &io_mtx);
+}
+
+op_res_t disk_io_write(char* path, char* buf, size_t len) {
+	if (!path || !buf || strlen(path) >= IO_PATH_MAX)
+		return ILLEGAL_ARGUMENT;
+
+	io_req_t req;
+	memset(&req, 0, sizeof(io_req_t));
+	strncpy(req.path, path, IO_PATH_MAX-1);
+	req.buf = buf;
+	req.len = len;
+
+	/* THREAD DI I/O NON ATTIVO ==> SCRIVO DIRETTAMENTE */
+	if (enqueue(&req) == -1) {
+		char dir[IO_PATH_MAX];
+		parent_dir(path, dir);
+		if (write_file(path, buf, len) == -1 || (fsync_policy == FSYNC_BATCH && sync_dir(dir) == -1))
+			return SYSTEM_ERROR;
+		return REQUEST_OK;
+	}
+
+	LP_LOCK(LP_IO, 0, &io_mtx);
+	while (!req.done)
+		LP_COND_WAIT(LP_IO, 0, &done_cond, &io_mtx);
+	LP_UNLOCK(LP_IO, 0, &io_mtx);
+
+	return req.result;
+}
+
+op_res_t disk_io_rename(char* src, char* path) {
+	if (!src || !path || strlen(path) >= IO_PATH_MAX)
+		return ILLEGAL_ARGUMENT;
+
+	io_req_t req;
+	memset(&req, 0, sizeof(io_req_t));
+	strncpy(req.path, path, IO_PATH_MAX-1);
+	req.src = src;
+
+	/* THREAD DI I/O NON ATTIVO ==> SPOSTO DIRETTAMENTE */
+	if (enqueue(&req) == -1) {
+		char dir[IO_PATH_MAX];
+		parent_dir(path, dir);
+		if (move_file(src, path) == -1 || (fsync_policy == FSYNC_BATCH && sync_dir(dir) == -1))
+			return SYSTEM_ERROR;
+		return REQUEST_OK;
+	}
+
+	LP_LOCK(LP_IO, 0, &io_mtx);
+	while (!req.done)
+		LP_COND_WAIT(LP_IO, 0, &done_cond, &io_mtx);
+	LP_UNLOCK(LP_IO, 0, &io_mtx);
+
+	return req.result;
+}
+
+op_res_t disk_io_unlink(char* path) {
+	if (!path || strlen(path) >= IO_PATH_MAX)
+		return ILLEGAL_ARGUMENT;
+
+	io_req_t* req = (io_req_t*) malloc(sizeof(io_req_t));
+	if (req != NULL) {
+		memset(req, 0, sizeof(io_req_t));
+		req -> is_unlink = 1;
+		strncpy(req -> path, path, IO_PATH_MAX-1);
+	}
+
+	/* THREAD DI I/O NON ATTIVO (O MEMORIA ESAURITA) ==> RIMUOVO DIRETTAMENTE */
+	if (req == NULL || enqueue(req) == -1) {
+		if (req) free(req);
+		unlink(path);
+	}
+
+	return REQUEST_OK;
+}
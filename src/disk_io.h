@@ -0,0 +1,82 @@
+
+/** \file disk_io.h
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#if !defined(DISK_IO_H_)
+#define DISK_IO_H_
+
+#include <stddef.h>
+#include "op_res.h"
+
+/**   Stadio di I/O su disco
+ *    Le scritture e le rimozioni dei file vengono accodate in una coda limitata e servite da un thread dedicato,
+ *    che le esegue a gruppi (batch) e, secondo la politica di fsync, rende persistente l'intero gruppo con una
+ *    sola sincronizzazione per directory. Chi richiede una scrittura attende fino al livello di durabilità
+ *    configurato, le rimozioni non vengono attese.
+ */
+
+/**   Politica di sincronizzazione su disco
+ */
+typedef enum fsync_policy {
+   FSYNC_NONE = 0,                     /**<  Nessuna fsync, i dati vengono scritti nella cache del sistema operativo    */
+   FSYNC_BATCH = 1                     /**<  Alla fine di ogni gruppo di operazioni fsync dei file e delle directory    */
+} fsync_policy_t;
+
+/**   Livello di durabilità raggiunto il quale una scrittura viene considerata completata
+ */
+typedef enum durability {
+   ACK_WRITTEN = 0,                    /**<  Il file è stato scritto (e rinominato) ma non necessariamente sincronizzato  */
+   ACK_SYNCED = 1                      /**<  Il file è stato sincronizzato su disco secondo la politica di fsync         */
+} durability_t;
+
+/**   Avvia il thread di I/O su disco, deve essere chiamata da un solo thread (tipicamente il thread main)
+ *
+ *    \param policy:    politica di sincronizzazione su disco
+ *    \param ack:       livello di durabilità atteso dalle scritture
+ *    \return:          se c'è un errore di allocazione della memoria o nella creazione del thread allora SYSTEM_ERROR
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t disk_io_init(fsync_policy_t policy, durability_t ack);
+
+/**   Esegue le operazioni ancora in coda e termina il thread di I/O su disco, deve essere chiamata da un solo thread
+ */
+void disk_io_destroy();
+
+/**   Scrive len byte di buf nel file path (passando per un file temporaneo, il file compare solo se completo)
+ *    e attende che la scrittura raggiunga il livello di durabilità configurato.
+ *    Se il thread di I/O non è attivo la scrittura viene eseguita dal chiamante
+ *
+ *    \param path:      path del file
+ *    \param buf:       contenuto del file
+ *    \param len:       lunghezza in byte del contenuto
+ *    \return:          se path == NULL || buf == NULL allora ILLEGAL_ARGUMENT
+ *                      se c'è un errore di scrittura su disco allora SYSTEM_ERROR
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t disk_io_write(char* path, char* buf, size_t len);
+
+/**   Sposta il file src (già completo) in path con una rename atomica e attende che lo spostamento raggiunga
+ *    il livello di durabilità configurato (con la politica FSYNC_BATCH src viene sincronizzato prima della rename).
+ *    Lo spostamento viene eseguito dopo le operazioni già in coda sullo stesso path
+ *
+ *    \param src:       path del file da spostare
+ *    \param path:      nuovo path del file
+ *    \return:          se src == NULL || path == NULL allora ILLEGAL_ARGUMENT
+ *                      se la rename fallisce allora SYSTEM_ERROR
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t disk_io_rename(char* src, char* path);
+
+/**   Accoda la rimozione del file path senza attenderne il completamento.
+ *    Le operazioni sono eseguite nell'ordine in cui sono state accodate
+ *
+ *    \param path:      path del file
+ *    \return:          se path == NULL allora ILLEGAL_ARGUMENT
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t disk_io_unlink(char* path);
+
+#endif /* DISK_IO_H_ */
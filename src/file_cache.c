@@ -0,0 +1,188 @@
+
+/** \file file_cache.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "file_cache.h"
+#include "icl_hash.h"
+#include "lock_profile.h"
+
+static long max_bytes = 0;								//Dimensione massima della cache (0 cache disabilitata)
+static long cur_bytes = 0;								//Byte occupati dai file nella cache
+static unsigned long num_hits = 0;					//Richieste servite dalla cache
+static unsigned long num_misses = 0;				//Richieste servite dal disco
+static icl_hash_t* entries = NULL;					//Chiave del file -> elemento della cache
+static file_cache_entry_t* lru_head = NULL;		//Elemento usato più di recente
+static file_cache_entry_t* lru_tail = NULL;		//Elemento usato meno di recente
+static pthread_mutex_t cache_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/**	Dealloca l'elemento
+ */
+static void free_entry(file_cache_entry_t* entry) {
+	if (entry -> key) free(entry -> key);
+	if (entry -> buf) free(entry -> buf);
+	free(entry);
+}
+
+/**	Rilascia un riferimento all'elemento (cache_mtx acquisita)
+ */
+static void unref_entry(file_cache_entry_t* entry) {
+	if (--(entry -> refs) == 0) free_entry(entry);
+}
+
+/**	Rimuove l'elemento dalla lista LRU (cache_mtx acquisita)
+ */
+static void lru_unlink(file_cache_entry_t* entry) {
+	if (entry -> prev) entry -> prev -> next = entry -> next;
+	else lru_head = entry -> next;
+	if (entry -> next) entry -> next -> prev = entry -> prev;
+	else lru_tail = entry -> prev;
+	entry -> prev = entry -> next = NULL;
+}
+
+/**	Inserisce l'elemento in testa alla lista LRU (cache_mtx acquisita)
+ */
+static void lru_push_front(file_cache_entry_t* entry) {
+	entry -> prev = NULL;
+	entry -> next = lru_head;
+	if (lru_head) lru_head -> prev = entry;
+	lru_head = entry;
+	if (lru_tail == NULL) lru_tail = entry;
+}
+
+/**	Rimuove l'elemento dalla cache rilasciando il riferimento della cache (cache_mtx acquisita)
+ */
+static void evict(file_cache_entry_t* entry) {
+	lru_unlink(entry);
+	icl_hash_delete(entries, entry -> key, NULL, NULL);
+	entry -> cached = 0;
+	cur_bytes -= entry -> len;
+	unref_entry(entry);
+}
+
+op_res_t file_cache_init(long max, int dim) {
+	if (max < 0 || dim <= 0)
+		return ILLEGAL_ARGUMENT;
+
+	max_bytes = max;
+	if (max_bytes == 0)
+		return REQUEST_OK;
+
+	entries = icl_hash_create(dim, NULL, NULL);
+	if (entries == NULL)
+		return SYSTEM_ERROR;
+
+	return REQUEST_OK;
+}
+
+void file_cache_destroy() {
+	LP_LOCK(LP_CACHE, 0, &cache_mtx);
+	while (lru_tail != NULL)
+		evict(lru_tail);
+	if (entries) icl_hash_destroy(entries, NULL, NULL);
+	entries = NULL;
+	LP_UNLOCK(LP_CACHE, 0, &cache_mtx);
+}
+
+file_cache_entry_t* file_cache_lookup(char* key) {
+	if (!key) return NULL;
+
+	file_cache_entry_t* entry = NULL;
+
+	/* CACHE DISABILITATA ==> NON ACQUISISCO LA MUTEX */
+	if (max_bytes == 0) {
+		__sync_add_and_fetch(&num_misses, 1);
+		return NULL;
+	}
+
+	LP_LOCK(LP_CACHE, 0, &cache_mtx);
+	if (entries != NULL) entry = icl_hash_find(entries, key);
+	if (entry != NULL) {
+		(entry -> refs)++;
+		lru_unlink(entry);
+		lru_push_front(entry);
+		num_hits++;
+	}
+	else num_misses++;
+	LP_UNLOCK(LP_CACHE, 0, &cache_mtx);
+
+	return entry;
+}
+
+file_cache_entry_t* file_cache_insert(char* key, char* buf, size_t len) {
+	if (!key || !buf) return NULL;
+
+	file_cache_entry_t* entry = (file_cache_entry_t*) malloc(sizeof(file_cache_entry_t));
+	if (entry == NULL)
+		return NULL;
+	entry -> key = (char*) malloc((strlen(key)+1)*sizeof(char));
+	if (entry -> key == NULL) {
+		free(entry);
+		return NULL;
+	}
+	strcpy(entry -> key, key);
+	entry -> buf = buf;
+	entry -> len = len;
+	entry -> refs = 1;
+	entry -> cached = 0;
+	entry -> prev = entry -> next = NULL;
+	if (max_bytes == 0)
+		return entry;
+
+	LP_LOCK(LP_CACHE, 0, &cache_mtx);
+	/* IL FILE VIENE INSERITO SOLO SE ENTRA NELLA CACHE E NON È GIÀ STATO INSERITO DA UN ALTRO THREAD */
+	if (entries != NULL && (long)len <= max_bytes && icl_hash_find(entries, key) == NULL) {
+		while (lru_tail != NULL && cur_bytes + (long)len > max_bytes)
+			evict(lru_tail);
+		if (icl_hash_insert(entries, entry -> key, entry) != NULL) {
+			entry -> cached = 1;
+			(entry -> refs)++;
+			cur_bytes += len;
+			lru_push_front(entry);
+		}
+	}
+	LP_UNLOCK(LP_CACHE, 0, &cache_mtx);
+
+	return entry;
+}
+
+void file_cache_release(file_cache_entry_t* entry) {
+	if (!entry) return;
+
+	/* CACHE DISABILITATA ==> L'ELEMENTO NON È CONDIVISO */
+	if (max_bytes == 0) {
+		free_entry(entry);
+		return;
+	}
+
+	LP_LOCK(LP_CACHE, 0, &cache_mtx);
+	unref_entry(entry);
+	LP_UNLOCK(LP_CACHE, 0, &cache_mtx);
+}
+
+void file_cache_invalidate(char* key) {
+	if (!key || max_bytes == 0) return;
+
+	LP_LOCK(LP_CACHE, 0, &cache_mtx);
+	file_cache_entry_t* entry = (entries != NULL) ? icl_hash_find(entries, key) : NULL;
+	if (entry != NULL) evict(entry);
+	LP_UNLOCK(LP_CACHE, 0, &cache_mtx);
+}
+
+void file_cache_get_stats(unsigned long* hits, unsigned long* misses) {
+	if (max_bytes == 0) {
+		if (hits) *hits = 0;
+		if (misses) *misses = __sync_add_and_fetch(&num_misses, 0);
+		return;
+	}
+
+	LP_LOCK(LP_CACHE, 0, &cache_mtx);
+	if (hits) *hits = num_hits;
+	if (misses) *misses = num_misses;
+	LP_UNLOCK(LP_CACHE, 0, &cache_mtx);
+}
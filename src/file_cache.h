@@ -0,0 +1,81 @@
+
+/** \file file_cache.h
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#if !defined(FILE_CACHE_H_)
+#define FILE_CACHE_H_
+
+#include <stddef.h>
+#include "op_res.h"
+
+/**   Cache LRU in memoria del contenuto dei file dello store, con dimensione massima in byte.
+ *    Le chiavi sono le chiavi dello store (vedere file_store.h): dato che il contenuto associato ad una chiave
+ *    non cambia mai, l'unica invalidazione necessaria è quella alla rimozione del file dallo store.
+ *    Gli elementi restituiti sono contati per riferimento e restano validi fino a file_cache_release
+ *    anche se nel frattempo vengono rimossi dalla cache. Tutte le funzioni (tranne init e destroy) sono thread-safe.
+ */
+typedef struct file_cache_entry {
+   char* key;                                /**<  Chiave del file nello store                          */
+   char* buf;                                /**<  Contenuto del file                                   */
+   size_t len;                               /**<  Lunghezza in byte del contenuto                      */
+   int refs;                                 /**<  Riferimenti all'elemento (compreso quello della cache) */
+   int cached;                               /**<  1 se e solo se l'elemento è nella cache               */
+   struct file_cache_entry* prev;            /**<  Elemento usato più di recente                        */
+   struct file_cache_entry* next;            /**<  Elemento usato meno di recente                       */
+} file_cache_entry_t;
+
+/**   Inizializza la cache, deve essere chiamata da un solo thread (tipicamente il thread main)
+ *
+ *    \param max_bytes: massimo numero di byte occupabili dai file nella cache (0 cache disabilitata)
+ *    \param dim:       dimensione della tabella hash
+ *    \return:          se max_bytes < 0 || dim <= 0 allora ILLEGAL_ARGUMENT
+ *                      se c'è un errore di allocazione della memoria allora SYSTEM_ERROR
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t file_cache_init(long max_bytes, int dim);
+
+/**   Dealloca la cache, deve essere chiamata da un solo thread (tipicamente il thread main)
+ */
+void file_cache_destroy();
+
+/**   Cerca il file con chiave key nella cache e se presente acquisisce un riferimento all'elemento
+ *
+ *    \param key:       chiave del file
+ *    \return:          puntatore all'elemento se il file è nella cache, NULL altrimenti
+ */
+file_cache_entry_t* file_cache_lookup(char* key);
+
+/**   Crea un elemento per il file con chiave key e lo inserisce nella cache se c'è spazio (eliminando gli
+ *    elementi usati meno di recente). L'elemento viene restituito con un riferimento acquisito
+ *    anche se non è stato inserito nella cache
+ *
+ *    \param key:       chiave del file
+ *    \param buf:       contenuto del file allocato nello heap (viene deallocato dalla cache)
+ *    \param len:       lunghezza in byte del contenuto
+ *    \return:          puntatore all'elemento, NULL in caso di errore di allocazione della memoria (buf non viene deallocato)
+ */
+file_cache_entry_t* file_cache_insert(char* key, char* buf, size_t len);
+
+/**   Rilascia un riferimento all'elemento
+ *
+ *    \param entry:     puntatore all'elemento
+ */
+void file_cache_release(file_cache_entry_t* entry);
+
+/**   Rimuove dalla cache il file con chiave key (se presente)
+ *
+ *    \param key:       chiave del file
+ */
+void file_cache_invalidate(char* key);
+
+/**   Restituisce le statistiche della cache
+ *
+ *    \param hits:      indirizzo in cui salvare il numero di richieste servite dalla cache
+ *    \param misses:    indirizzo in cui salvare il numero di richieste servite dal disco
+ */
+void file_cache_get_stats(unsigned long* hits, unsigned long* misses);
+
+#endif /* FILE_CACHE_H_ */
@@ -0,0 +1,701 @@
+
+/** \file file_store.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include "file_store.h"
+#include "icl_hash.h"
+#include "disk_io.h"
+#include "file_cache.h"
+#include "compress.h"
+#include "lock_profile.h"
+
+/**	Nome della sottodirectory (di DirName) che contiene lo store
+ */
+#define STORE_DIR ".store"
+
+/**	Nome del file (nella directory dello store) che contiene il numero di livelli con cui è organizzato lo store
+ */
+#define LAYOUT_FILE ".layout"
+
+/**	Nome del file (nella directory dello store) che contiene l'istante dell'ultimo avvio (vedere sweep_store)
+ */
+#define SWEEP_FILE ".sweep"
+
+/**	Numero di partizioni delle tabelle dei riferimenti (ognuna con la propria mutex)
+ */
+#define STORE_STRIPES 16
+
+/**	Valore iniziale dell'hash FNV-1a a 64 bit
+ */
+#define HASH_INIT 14695981039346656037ULL
+
+/**	Dimensione del buffer usato per confrontare il contenuto di un file con quello su disco
+ */
+#define CMP_CHUNK 8192
+
+/**	Suffisso della chiave dei file salvati compressi (vedere compress.h)
+ */
+#define PACKED_SUFFIX "z"
+
+/**	Partizione dello store: i file il cui hash è congruo a i modulo STORE_STRIPES appartengono alla partizione i
+ */
+typedef struct store_stripe {
+	pthread_mutex_t mtx;
+	pthread_cond_t done;			//Segnalata quando termina la scrittura di un file della partizione
+	icl_hash_t* refs;				//Chiave del file -> store_ref_t
+} store_stripe_t;
+
+/**	File presente nello store
+ */
+typedef struct store_ref {
+	int refs;						//Numero di riferimenti
+	int pending;					//1 se il file è in scrittura (la chiave è riservata ma il file non è ancora su disco)
+	int packed;						//1 se il file è salvato compresso
+	size_t raw_len;				//Lunghezza del contenuto originale (non compresso)
+} store_ref_t;
+
+static char store_dir[1024];								//Directory dello store
+static int shard_levels = 2;								//Livelli di sottodirectory dello store
+static store_stripe_t stripes[STORE_STRIPES];		//Partizioni dello store
+static int initialized = 0;
+
+static void free_key(void* key) {
+	if (key) free(key);
+}
+
+/**	Inserisce nella partizione stripe il file con chiave key, di raw_len byte e salvato compresso se packed vale 1
+ * 	(deve essere chiamata in mutua esclusione sulla partizione)
+ */
+static store_ref_t* add_ref(store_stripe_t* stripe, char* key, int refs, int pending, size_t raw_len, int packed) {
+	char* k = (char*) malloc((strlen(key)+1)*sizeof(char));
+	store_ref_t* ref = (store_ref_t*) malloc(sizeof(store_ref_t));
+	if (k) strcpy(k, key);
+	if (ref) {
+		ref -> refs = refs;
+		ref -> pending = pending;
+		ref -> packed = packed;
+		ref -> raw_len = raw_len;
+	}
+	if (!k || !ref || icl_hash_insert(stripe -> refs, k, ref) == NULL) {
+		if (k) free(k);
+		if (ref) free(ref);
+		return NULL;
+	}
+	return ref;
+}
+
+/**	Hash FNV-1a a 64 bit del contenuto del file (hash è il valore ottenuto sui byte precedenti)
+ */
+static unsigned long long hash_content(unsigned long long hash, char* buf, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char)buf[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**	Partizione a cui appartiene la chiave (le prime 16 cifre esadecimali della chiave sono l'hash del contenuto)
+ */
+static store_stripe_t* key_stripe(char* key) {
+	return stripes + (strtoull(key, NULL, 16) % STORE_STRIPES);
+}
+
+/**	Costruisce in key la chiave del file con hash e lunghezza dati (variant > 0 in caso di collisione dell'hash)
+ */
+static void store_key(char* key, unsigned long long hash, size_t len, int variant, int packed) {
+	memset(key, '\0', STORE_KEY_LENGTH);
+	if (variant == 0) snprintf(key, STORE_KEY_LENGTH, "%016llx-%lu%s", hash, (unsigned long)len, packed ? PACKED_SUFFIX : "");
+	else snprintf(key, STORE_KEY_LENGTH, "%016llx-%lu-%d%s", hash, (unsigned long)len, variant, packed ? PACKED_SUFFIX : "");
+}
+
+/**	Ricava dal nome name di un file trovato nello store (<hash>-<size>[-<variant>][z], vedere store_key)
+ * 	la lunghezza del contenuto e se è compresso, ritorna -1 se il nome non è una chiave dello store
+ */
+static int parse_key(char* name, size_t* raw_len, int* packed) {
+	unsigned long long hash;
+	unsigned long len;
+	int variant, n = 0, m = 0;
+
+	if (strlen(name) < 18 || sscanf(name, "%16llx-%lu%n", &hash, &len, &n) != 2 || n == 0 || name[16] != '-') return -1;
+	if (name[n] == '-' && (sscanf(name + n, "-%d%n", &variant, &m) != 1 || variant <= 0)) return -1;
+	n += m;
+	*packed = (strcmp(name + n, PACKED_SUFFIX) == 0);
+	if (!*packed && name[n] != '\0') return -1;
+	*raw_len = len;
+	return 0;
+}
+
+/**	Salva in raw_len e packed la lunghezza del contenuto del file con chiave key e se è salvato compresso,
+ * 	ritorna -1 se il file non è nello store (o è ancora in scrittura)
+ */
+static int ref_info(char* key, size_t* raw_len, int* packed) {
+	store_stripe_t* stripe = key_stripe(key);
+	int result = -1;
+
+	LP_LOCK(LP_STORE, stripe - stripes, &(stripe -> mtx));
+	store_ref_t* ref = icl_hash_find(stripe -> refs, key);
+	if (ref != NULL && !(ref -> pending)) {
+		*raw_len = ref -> raw_len;
+		*packed = ref -> packed;
+		result = 0;
+	}
+	LP_UNLOCK(LP_STORE, stripe - stripes, &(stripe -> mtx));
+
+	return result;
+}
+
+/**	Crea le sottodirectory dello store che conterranno il file con chiave key
+ */
+static int make_shard_dirs(char* key) {
+	char path[1100];
+	for (int level = 1; level <= shard_levels; level++) {
+		if (level == 1) snprintf(path, sizeof(path), "%s/%.2s", store_dir, key);
+		else snprintf(path, sizeof(path), "%s/%.2s/%.2s", store_dir, key, key+2);
+		if (mkdir(path, 0700) == -1 && errno != EEXIST) return -1;
+	}
+	return 0;
+}
+
+/**	Sposta nella posizione prevista da shard_levels tutti i file contenuti in dir (e nelle sue sottodirectory
+ * 	fino a profondità 2), rimuove i file temporanei lasciati da scritture interrotte e le sottodirectory svuotate
+ */
+static int migrate_dir(char* dir, int depth) {
+	char path[1200], new_path[1200];
+	struct dirent* entry;
+	struct stat st;
+	int result = 0;
+
+	DIR* d = opendir(dir);
+	if (d == NULL) return -1;
+
+	while ((entry = readdir(d)) != NULL) {
+		if (entry -> d_name[0] == '.') continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, entry -> d_name);
+		if (stat(path, &st) == -1) continue;
+
+		if (S_ISDIR(st.st_mode)) {
+			if (depth < 2 && strlen(entry -> d_name) == 2) {
+				if (migrate_dir(path, depth+1) == -1) result = -1;
+				rmdir(path);
+			}
+			continue;
+		}
+		size_t len = strlen(entry -> d_name);
+		if (len > 4 && strcmp(entry -> d_name + len - 4, ".tmp") == 0) {
+			remove(path);
+			continue;
+		}
+		if (file_store_path(entry -> d_name, new_path, sizeof(new_path)) != REQUEST_OK || strcmp(path, new_path) == 0)
+			continue;
+		if (make_shard_dirs(entry -> d_name) == -1 || rename(path, new_path) == -1) result = -1;
+	}
+	closedir(d);
+
+	return result;
+}
+
+/**	Se lo store è stato creato con un numero di livelli diverso (o è una directory piatta senza file di layout)
+ * 	riorganizza una sola volta i file esistenti e aggiorna il file di layout (first vale 1 se il file di layout non c'era)
+ */
+static int migrate_store(int* first) {
+	char path[1100];
+	int old_levels = -1;
+
+	snprintf(path, sizeof(path), "%s/%s", store_dir, LAYOUT_FILE);
+	FILE* f = fopen(path, "r");
+	if (f != NULL) {
+		if (fscanf(f, "%d", &old_levels) != 1) old_levels = -1;
+		fclose(f);
+	}
+	*first = (f == NULL);
+	if (old_levels == shard_levels) return 0;
+
+	if (migrate_dir(store_dir, 0) == -1) return -1;
+
+	f = fopen(path, "w");
+	if (f == NULL) return -1;
+	fprintf(f, "%d\n", shard_levels);
+	if (fclose(f) != 0) return -1;
+
+	return 0;
+}
+
+/**	Ritorna 1 se il file path ha esattamente il contenuto buf, 0 altrimenti
+ */
+static int same_content(char* path, char* buf, size_t len) {
+	char chunk[CMP_CHUNK];
+	struct stat st;
+	size_t off = 0, n;
+
+	if (stat(path, &st) == -1 || (size_t)st.st_size != len) return 0;
+
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) return 0;
+	while (off < len) {
+		n = fread(chunk, sizeof(char), CMP_CHUNK, f);
+		if (n == 0 || off + n > len || memcmp(chunk, buf + off, n) != 0) break;
+		off += n;
+	}
+	fclose(f);
+
+	return off == len;
+}
+
+/**	Ritorna 1 se i file path e src hanno esattamente lo stesso contenuto (di len byte), 0 altrimenti
+ */
+static int same_file(char* path, char* src, size_t len) {
+	char chunk[CMP_CHUNK], src_chunk[CMP_CHUNK];
+	struct stat st;
+	size_t off = 0, n;
+
+	if (stat(path, &st) == -1 || (size_t)st.st_size != len) return 0;
+
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) return 0;
+	FILE* g = fopen(src, "rb");
+	if (g == NULL) {
+		fclose(f);
+		return 0;
+	}
+	while (off < len) {
+		n = fread(chunk, sizeof(char), CMP_CHUNK, f);
+		if (n == 0 || off + n > len || fread(src_chunk, sizeof(char), n, g) != n || memcmp(chunk, src_chunk, n) != 0) break;
+		off += n;
+	}
+	fclose(f);
+	fclose(g);
+
+	return off == len;
+}
+
+/**	Rilascia un riferimento al file con chiave key: se era l'ultimo il file viene rimosso, a meno che keep
+ * 	non sia 1 (file trovato all'avvio senza riferimenti e solo confrontato, vedere store_put)
+ */
+static void store_release(char* key, int keep) {
+	if (!key) return;
+
+	char path[1200];
+	store_stripe_t* stripe = key_stripe(key);
+
+	LP_LOCK(LP_STORE, stripe - stripes, &(stripe -> mtx));
+	store_ref_t* ref = icl_hash_find(stripe -> refs, key);
+	if (ref != NULL && --(ref -> refs) == 0 && !keep) {
+		/* ULTIMO RIFERIMENTO ==> RIMUOVO IL FILE DALLA CACHE E DAL DISCO (SENZA ATTENDERE) */
+		file_cache_invalidate(key);
+		if (file_store_path(key, path, sizeof(path)) == REQUEST_OK) disk_io_unlink(path);
+		icl_hash_delete(stripe -> refs, key, free_key, free_key);
+	}
+	LP_UNLOCK(LP_STORE, stripe - stripes, &(stripe -> mtx));
+}
+
+/**	Ritorna 1 se il file con chiave key ha esattamente il contenuto buf oppure, se buf == NULL,
+ * 	quello del file src (di len byte), 0 altrimenti
+ */
+static int same_stored(char* key, char* buf, char* src, size_t len) {
+	char path[1200];
+	char* stored;
+	size_t n;
+	int same;
+
+	if (file_store_path(key, path, sizeof(path)) != REQUEST_OK) return 0;
+	if (!file_store_compressed(key)) return buf ? same_content(path, buf, len) : same_file(path, src, len);
+
+	/* FILE COMPRESSO ==> LO DECOMPRIMO IN MEMORIA PER CONFRONTARLO */
+	if (file_store_load(key, &stored, &n) != REQUEST_OK) return 0;
+	if (buf) same = (n == len && memcmp(stored, buf, len) == 0);
+	else same = same_content(src, stored, n);
+	free(stored);
+
+	return same;
+}
+
+/**	Salva nello store il file con hash e lunghezza dati, il cui contenuto è buf oppure (se buf == NULL) il file src,
+ * 	che viene spostato nello store o rimosso se il contenuto è già presente
+ */
+static op_res_t store_put(char* buf, char* src, size_t len, unsigned long long hash, char* key) {
+	char path[1200];
+	store_stripe_t* stripe = stripes + (hash % STORE_STRIPES);
+	op_res_t result = REQUEST_OK;
+	char* packed = NULL;		//CONTENUTO COMPRESSO
+	long packed_len = 0;		//LUNGHEZZA DEL CONTENUTO COMPRESSO (0 SE IL FILE VIENE SALVATO COSÌ COM'È)
+	char cand[2][STORE_KEY_LENGTH];	//CHIAVI GIÀ PRESENTI CON LO STESSO HASH E LA STESSA LUNGHEZZA
+	int unused[2];						//1 SE IL FILE CANDIDATO NON AVEVA RIFERIMENTI (TROVATO ALL'AVVIO, VEDERE sweep_store)
+	int ncand, found;
+
+	/* I CONTENUTI IN MEMORIA OLTRE LA SOGLIA VENGONO SALVATI COMPRESSI (LA COMPRESSIONE AVVIENE FUORI DALLA MUTUA ESCLUSIONE) */
+	if (buf && (packed_len = compress_buffer(buf, len, &packed)) == -1)
+		return SYSTEM_ERROR;
+
+	/* IN CASO DI COLLISIONE DELL'HASH (CONTENUTO DIVERSO) PROVO LE VARIANTI <hash>-<size>-<i> */
+	for (int variant = 0; ; variant++) {
+		store_ref_t* ref = NULL;
+		ncand = 0;
+		LP_LOCK(LP_STORE, stripe - stripes, &(stripe -> mtx));
+		/* LO STESSO CONTENUTO PUÒ ESSERE GIÀ SALVATO COMPRESSO O NO (SOGLIA DIVERSA, CARICAMENTO A BLOCCHI):
+			ACQUISISCO UN RIFERIMENTO AI CANDIDATI IN MODO CHE NON VENGANO RIMOSSI DURANTE IL CONFRONTO */
+		for (int packed_key = 0; packed_key < 2; packed_key++) {
+			store_key(cand[ncand], hash, len, variant, packed_key);
+			ref = icl_hash_find(stripe -> refs, cand[ncand]);
+			if (ref == NULL) continue;
+			if (ref -> pending) {
+				/* FILE ANCORA IN SCRITTURA ==> ATTENDO CHE SIA SU DISCO (O CHE LA SCRITTURA FALLISCA) E RICOMINCIO */
+				for (int i = 0; i < ncand; i++) ((store_ref_t*) icl_hash_find(stripe -> refs, cand[i])) -> refs--;
+				LP_COND_WAIT(LP_STORE, stripe - stripes, &(stripe -> done), &(stripe -> mtx));
+				ncand = 0;
+				packed_key = -1;
+				continue;
+			}
+			unused[ncand] = (ref -> refs == 0);
+			ref -> refs++;
+			ncand++;
+		}
+		if (ncand == 0) {
+			/* NUOVO FILE: RISERVO LA CHIAVE E SCRIVO IL FILE SENZA MUTEX */
+			store_key(key, hash, len, variant, packed_len > 0);
+			ref = add_ref(stripe, key, 1, 1, len, packed_len > 0);
+			LP_UNLOCK(LP_STORE, stripe - stripes, &(stripe -> mtx));
+			if (ref == NULL) {
+				result = SYSTEM_ERROR;
+				break;
+			}
+
+			/* LA SCRITTURA VIENE ACCODATA DOPO UN'EVENTUALE RIMOZIONE DELLO STESSO FILE, ACCODATA PRIMA DI RILASCIARE LA CHIAVE */
+			file_store_path(key, path, sizeof(path));
+			if (make_shard_dirs(key) == -1 || (buf ? disk_io_write(path, packed_len > 0 ? packed : buf, packed_len > 0 ? (size_t)packed_len : len)
+															  : disk_io_rename(src, path)) != REQUEST_OK) {
+				result = SYSTEM_ERROR;
+			}
+
+			LP_LOCK(LP_STORE, stripe - stripes, &(stripe -> mtx));
+			if (result == REQUEST_OK) ref -> pending = 0;
+			else icl_hash_delete(stripe -> refs, key, free_key, free_key);
+			pthread_cond_broadcast(&(stripe -> done));
+			LP_UNLOCK(LP_STORE, stripe - stripes, &(stripe -> mtx));
+			break;
+		}
+		LP_UNLOCK(LP_STORE, stripe - stripes, &(stripe -> mtx));
+
+		/* CONFRONTO IL CONTENUTO SENZA MUTEX E RILASCIO I CANDIDATI DIVERSI */
+		found = -1;
+		for (int i = 0; i < ncand; i++) {
+			if (found == -1 && same_stored(cand[i], buf, src, len)) found = i;
+			else store_release(cand[i], unused[i]);
+		}
+		if (found != -1) {
+			/* FILE GIÀ PRESENTE ==> MANTENGO IL RIFERIMENTO SENZA RISCRIVERLO */
+			memset(key, '\0', STORE_KEY_LENGTH);
+			strcpy(key, cand[found]);
+			if (!buf) unlink(src);
+			/* UN FILE TROVATO ALL'AVVIO E RIUSATO NON DEVE ESSERE RIMOSSO DAL PROSSIMO SWEEP */
+			if (unused[found] && file_store_path(key, path, sizeof(path)) == REQUEST_OK) utimensat(AT_FDCWD, path, NULL, 0);
+			break;
+		}
+	}
+	if (packed) free(packed);
+
+	return result;
+}
+
+/**	Rimuove i file dello store (in dir, fino alla profondità dei livelli di sottodirectory) modificati prima di before,
+ * 	che non sono stati usati dall'avvio precedente, e inserisce gli altri nelle tabelle dei riferimenti senza riferimenti
+ */
+static int sweep_dir(char* dir, int depth, struct timespec* before) {
+	char path[1200];
+	struct dirent* entry;
+	struct stat st;
+	int result = 0;
+
+	DIR* d = opendir(dir);
+	if (d == NULL) return -1;
+
+	while ((entry = readdir(d)) != NULL) {
+		if (entry -> d_name[0] == '.') continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, entry -> d_name);
+		if (stat(path, &st) == -1) continue;
+
+		if (S_ISDIR(st.st_mode)) {
+			if (depth < shard_levels && sweep_dir(path, depth+1, before) == -1) result = -1;
+			continue;
+		}
+		if (st.st_mtim.tv_sec < before -> tv_sec || (st.st_mtim.tv_sec == before -> tv_sec && st.st_mtim.tv_nsec < before -> tv_nsec)) {
+			remove(path);
+			continue;
+		}
+		/* LA LUNGHEZZA E LA COMPRESSIONE VENGONO RICAVATE DAL NOME UNA SOLA VOLTA, I FILE ESTRANEI VENGONO IGNORATI */
+		size_t raw_len;
+		int packed;
+		if (parse_key(entry -> d_name, &raw_len, &packed) == -1) continue;
+		if (add_ref(key_stripe(entry -> d_name), entry -> d_name, 0, 0, raw_len, packed) == NULL) result = -1;
+	}
+	closedir(d);
+
+	return result;
+}
+
+/**	I riferimenti ai file non sopravvivono al riavvio del server (gli utenti non sono persistenti): i file trovati
+ * 	all'avvio restano disponibili per un avvio (un contenuto uguale caricato di nuovo non viene riscritto) e vengono
+ * 	rimossi all'avvio successivo se nel frattempo non sono stati usati
+ */
+static int sweep_store() {
+	char path[1100];
+	struct timespec before = { 0, 0 }, now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	snprintf(path, sizeof(path), "%s/%s", store_dir, SWEEP_FILE);
+	FILE* f = fopen(path, "r");
+	if (f != NULL) {
+		if (fscanf(f, "%ld %ld", &(before.tv_sec), &(before.tv_nsec)) != 2) before.tv_sec = before.tv_nsec = 0;
+		fclose(f);
+	}
+
+	if (sweep_dir(store_dir, 0, &before) == -1) return -1;
+
+	f = fopen(path, "w");
+	if (f == NULL) return -1;
+	fprintf(f, "%ld %ld\n", (long)now.tv_sec, now.tv_nsec);
+	if (fclose(f) != 0) return -1;
+
+	return 0;
+}
+
+/**	Importa nello store i file salvati direttamente in dir_name dalle versioni precedenti del server: restano
+ * 	disponibili senza riferimenti come quelli trovati all'avvio (vedere sweep_store)
+ */
+static int import_legacy(char* dir_name) {
+	char path[1200], key[STORE_KEY_LENGTH];
+	struct dirent* entry;
+	struct stat st;
+	int result = 0;
+
+	DIR* d = opendir(dir_name);
+	if (d == NULL) return -1;
+
+	while ((entry = readdir(d)) != NULL) {
+		if (entry -> d_name[0] == '.') continue;
+		snprintf(path, sizeof(path), "%s/%s", dir_name, entry -> d_name);
+		if (stat(path, &st) == -1 || !S_ISREG(st.st_mode)) continue;
+
+		if (file_store_put_file(path, key) != REQUEST_OK) result = -1;
+		else store_release(key, 1);
+	}
+	closedir(d);
+
+	return result;
+}
+
+op_res_t file_store_init(char* dir_name, int dim, int levels) {
+	if (!dir_name || dim <= 0 || levels < 0 || levels > 2)
+		return ILLEGAL_ARGUMENT;
+
+	shard_levels = levels;
+
+	memset(store_dir, '\0', sizeof(store_dir));
+	if (snprintf(store_dir, sizeof(store_dir), "%s/%s", dir_name, STORE_DIR) >= (int)sizeof(store_dir))
+		return ILLEGAL_ARGUMENT;
+
+	if (mkdir(store_dir, 0700) == -1 && errno != EEXIST)
+		return SYSTEM_ERROR;
+
+	int first;
+	if (migrate_store(&first) == -1)
+		return SYSTEM_ERROR;
+
+	int stripe_dim = dim/STORE_STRIPES > 0 ? dim/STORE_STRIPES : 1;
+	for (int i = 0; i < STORE_STRIPES; i++) {
+		stripes[i].refs = icl_hash_create(stripe_dim, NULL, NULL);
+		if (stripes[i].refs == NULL || pthread_mutex_init(&(stripes[i].mtx), NULL) != 0) {
+			for (int j = 0; j <= i; j++) {
+				if (stripes[j].refs) icl_hash_destroy(stripes[j].refs, free_key, free_key);
+				stripes[j].refs = NULL;
+				if (j < i) {
+					pthread_mutex_destroy(&(stripes[j].mtx));
+					pthread_cond_destroy(&(stripes[j].done));
+				}
+			}
+			return SYSTEM_ERROR;
+		}
+		if (pthread_cond_init(&(stripes[i].done), NULL) != 0) {
+			pthread_mutex_destroy(&(stripes[i].mtx));
+			for (int j = 0; j <= i; j++) {
+				icl_hash_destroy(stripes[j].refs, free_key, free_key);
+				stripes[j].refs = NULL;
+				if (j < i) {
+					pthread_mutex_destroy(&(stripes[j].mtx));
+					pthread_cond_destroy(&(stripes[j].done));
+				}
+			}
+			return SYSTEM_ERROR;
+		}
+	}
+	initialized = 1;
+
+	if (sweep_store() == -1 || (first && import_legacy(dir_name) == -1)) {
+		file_store_destroy();
+		return SYSTEM_ERROR;
+	}
+
+	return REQUEST_OK;
+}
+
+void file_store_destroy() {
+	if (!initialized) return;
+
+	for (int i = 0; i < STORE_STRIPES; i++) {
+		icl_hash_destroy(stripes[i].refs, free_key, free_key);
+		stripes[i].refs = NULL;
+		pthread_mutex_destroy(&(stripes[i].mtx));
+		pthread_cond_destroy(&(stripes[i].done));
+	}
+	initialized = 0;
+}
+
+op_res_t file_store_path(char* key, char* path, size_t size) {
+	if (!key || !path || strlen(key) < 4)
+		return ILLEGAL_ARGUMENT;
+
+	int n;
+	if (shard_levels == 0) n = snprintf(path, size, "%s/%s", store_dir, key);
+	else if (shard_levels == 1) n = snprintf(path, size, "%s/%.2s/%s", store_dir, key, key);
+	else n = snprintf(path, size, "%s/%.2s/%.2s/%s", store_dir, key, key+2, key);
+	if (n >= (int)size)
+		return ILLEGAL_ARGUMENT;
+
+	return REQUEST_OK;
+}
+
+op_res_t file_store_put(char* buf, size_t len, char* key) {
+	if (!buf || !key)
+		return ILLEGAL_ARGUMENT;
+
+	return store_put(buf, NULL, len, hash_content(HASH_INIT, buf, len), key);
+}
+
+op_res_t file_store_put_file(char* src, char* key) {
+	if (!src || !key)
+		return ILLEGAL_ARGUMENT;
+
+	char chunk[CMP_CHUNK];
+	unsigned long long hash = HASH_INIT;
+	size_t len = 0, n;
+
+	/* CALCOLO L'HASH LEGGENDO IL FILE UN BLOCCO ALLA VOLTA */
+	FILE* f = fopen(src, "rb");
+	if (f == NULL)
+		return SYSTEM_ERROR;
+	while ((n = fread(chunk, sizeof(char), CMP_CHUNK, f)) > 0) {
+		hash = hash_content(hash, chunk, n);
+		len += n;
+	}
+	int err = ferror(f);
+	fclose(f);
+	if (err)
+		return SYSTEM_ERROR;
+
+	return store_put(NULL, src, len, hash, key);
+}
+
+int file_store_compressed(char* key) {
+	size_t raw_len;
+	int packed;
+	return key != NULL && ref_info(key, &raw_len, &packed) == 0 && packed;
+}
+
+op_res_t file_store_load(char* key, char** buf, size_t* len) {
+	return file_store_load_prefix(key, (size_t)-1, buf, len, NULL);
+}
+
+op_res_t file_store_load_prefix(char* key, size_t max, char** buf, size_t* len, size_t* total) {
+	if (!key || !buf || !len)
+		return ILLEGAL_ARGUMENT;
+
+	char path[1200];
+	struct stat st;
+	size_t raw_len;
+	int packed;
+
+	if (file_store_path(key, path, sizeof(path)) != REQUEST_OK)
+		return ILLEGAL_ARGUMENT;
+	if (ref_info(key, &raw_len, &packed) == -1)
+		return NOT_FOUND;
+
+	if (stat(path, &st) == -1)
+		return SYSTEM_ERROR;
+	FILE* f = fopen(path, "rb");
+	if (f == NULL)
+		return SYSTEM_ERROR;
+
+	/* I FILE NON COMPRESSI VENGONO LETTI SOLO FINO A max BYTE */
+	size_t to_read = st.st_size;
+	if (!packed && max < to_read) to_read = max;
+	char* data = (char*) malloc((to_read+1)*sizeof(char));
+	if (data == NULL) {
+		fclose(f);
+		return SYSTEM_ERROR;
+	}
+	size_t n = fread(data, sizeof(char), to_read, f);
+	if (n < to_read && ferror(f) != 0) {
+		fclose(f);
+		free(data);
+		return SYSTEM_ERROR;
+	}
+	fclose(f);
+	data[n] = '\0';
+
+	if (!packed) {
+		*buf = data;
+		*len = n;
+		if (total) *total = st.st_size;
+		return REQUEST_OK;
+	}
+
+	/* DECOMPRIMO SOLO I BYTE RICHIESTI */
+	size_t out_len = (max < raw_len) ? max : raw_len;
+	*buf = (char*) malloc((out_len+1)*sizeof(char));
+	if (*buf == NULL || (out_len == raw_len ? decompress_buffer(data, n, *buf, raw_len) : decompress_prefix(data, n, *buf, out_len)) == -1) {
+		if (*buf) free(*buf);
+		*buf = NULL;
+		free(data);
+		return SYSTEM_ERROR;
+	}
+	free(data);
+	(*buf)[out_len] = '\0';
+	*len = out_len;
+	if (total) *total = raw_len;
+
+	return REQUEST_OK;
+}
+
+op_res_t file_store_ref(char* key) {
+	if (!key)
+		return ILLEGAL_ARGUMENT;
+
+	store_stripe_t* stripe = key_stripe(key);
+	op_res_t result = REQUEST_OK;
+
+	LP_LOCK(LP_STORE, stripe - stripes, &(stripe -> mtx));
+	store_ref_t* ref = icl_hash_find(stripe -> refs, key);
+	if (ref == NULL || ref -> pending) result = NOT_FOUND;
+	else ref -> refs++;
+	LP_UNLOCK(LP_STORE, stripe - stripes, &(stripe -> mtx));
+
+	return result;
+}
+
+void file_store_release(char* key) {
+	store_release(key, 0);
+}
@@ -0,0 +1,125 @@
+
+/** \file file_store.h
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#if !defined(FILE_STORE_H_)
+#define FILE_STORE_H_
+
+#include <stddef.h>
+#include "op_res.h"
+
+/**   Lunghezza massima (compreso il terminatore) della chiave di un file nello store
+ */
+#define STORE_KEY_LENGTH 64
+
+/**   Store dei file indirizzato per contenuto
+ *    Ogni file viene salvato una sola volta in DirName/.store/xx/yy/<hash>-<size>, dove xx e yy sono i primi
+ *    quattro caratteri dell'hash (a 64 bit) del contenuto; il numero di livelli di sottodirectory (da 0 a 2)
+ *    è configurabile. Gli utenti fanno riferimento al file tramite la chiave restituita da file_store_put
+ *    (vedere name_files_rcvd in user_data.h) e il file viene rimosso dal disco quando l'ultimo riferimento
+ *    viene rilasciato. I file di almeno CompressThreshold byte inviati con file_store_put vengono salvati compressi
+ *    (vedere compress.h) e la loro chiave termina con 'z': il loro contenuto va letto con file_store_load.
+ *    La lunghezza del contenuto e la compressione di ogni file sono registrate nella tabella dei riferimenti.
+ *    Tutte le funzioni di interfaccia (tranne init e destroy) sono thread-safe.
+ */
+
+/**   Inizializza lo store, deve essere chiamata da un solo thread (tipicamente il thread main).
+ *    Se lo store esistente è organizzato con un numero di livelli diverso da levels i file vengono spostati.
+ *    I file non usati dall'avvio precedente vengono rimossi, gli altri restano disponibili senza riferimenti.
+ *    Al primo avvio con lo store i file salvati direttamente in dir_name dalle versioni precedenti vengono importati
+ *
+ *    \param dir_name:  directory in cui creare la sottodirectory dello store
+ *    \param dim:       dimensione complessiva delle tabelle dei riferimenti
+ *    \param levels:    livelli di sottodirectory (0, 1 o 2) in cui distribuire i file
+ *    \return:          se dir_name == NULL || dim <= 0 || levels < 0 || levels > 2 allora ILLEGAL_ARGUMENT
+ *                      se c'è un errore nella creazione della directory, nella migrazione dei file o di allocazione della memoria allora SYSTEM_ERROR
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t file_store_init(char* dir_name, int dim, int levels);
+
+/**   Dealloca le strutture dati dello store (i file restano su disco), deve essere chiamata da un solo thread
+ */
+void file_store_destroy();
+
+/**   Salva nello store il contenuto buf (se non già presente) e acquisisce un riferimento al file,
+ *    che deve essere rilasciato con file_store_release
+ *
+ *    \param buf:       contenuto del file
+ *    \param len:       lunghezza in byte del contenuto
+ *    \param key:       buffer di almeno STORE_KEY_LENGTH byte in cui salvare la chiave del file
+ *    \return:          se buf == NULL || key == NULL allora ILLEGAL_ARGUMENT
+ *                      se c'è un errore di scrittura su disco o di allocazione della memoria allora SYSTEM_ERROR
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t file_store_put(char* buf, size_t len, char* key);
+
+/**   Come file_store_put, ma il contenuto è quello del file src (che non viene caricato in memoria): se il
+ *    contenuto non è già presente src viene spostato nello store con una rename atomica, altrimenti viene rimosso
+ *
+ *    \param src:       path del file (deve trovarsi nello stesso filesystem dello store)
+ *    \param key:       buffer di almeno STORE_KEY_LENGTH byte in cui salvare la chiave del file
+ *    \return:          se src == NULL || key == NULL allora ILLEGAL_ARGUMENT
+ *                      se c'è un errore di lettura o scrittura su disco o di allocazione della memoria allora SYSTEM_ERROR
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t file_store_put_file(char* src, char* key);
+
+/**   Verifica se il file con chiave key è salvato compresso
+ *
+ *    \param key:       chiave del file
+ *    \return:          1 se il file è nello store ed è compresso, 0 altrimenti
+ */
+int file_store_compressed(char* key);
+
+/**   Legge l'intero contenuto del file con chiave key (decomprimendolo se necessario)
+ *
+ *    \param key:       chiave del file
+ *    \param buf:       indirizzo in cui salvare il contenuto (allocato nello heap e terminato da '\0', da deallocare con free)
+ *    \param len:       indirizzo in cui salvare la lunghezza in byte del contenuto
+ *    \return:          se uno dei parametri è NULL o la chiave non è valida allora ILLEGAL_ARGUMENT
+ *                      se il file non è nello store allora NOT_FOUND
+ *                      se c'è un errore di lettura, il file compresso è danneggiato o c'è un errore di allocazione della memoria allora SYSTEM_ERROR
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t file_store_load(char* key, char** buf, size_t* len);
+
+/**   Come file_store_load, ma legge (e decomprime) solo i primi max byte del contenuto
+ *
+ *    \param key:       chiave del file
+ *    \param max:       numero massimo di byte da leggere
+ *    \param buf:       indirizzo in cui salvare i byte letti (allocato nello heap e terminato da '\0', da deallocare con free)
+ *    \param len:       indirizzo in cui salvare il numero di byte letti
+ *    \param total:     indirizzo in cui salvare la lunghezza in byte dell'intero contenuto (può essere NULL)
+ *    \return:          come file_store_load
+ */
+op_res_t file_store_load_prefix(char* key, size_t max, char** buf, size_t* len, size_t* total);
+
+/**   Acquisisce un ulteriore riferimento al file con chiave key
+ *
+ *    \param key:       chiave del file
+ *    \return:          se key == NULL allora ILLEGAL_ARGUMENT
+ *                      se il file non è nello store allora NOT_FOUND
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t file_store_ref(char* key);
+
+/**   Rilascia un riferimento al file con chiave key, se era l'ultimo il file viene rimosso dal disco
+ *
+ *    \param key:       chiave del file
+ */
+void file_store_release(char* key);
+
+/**   Costruisce il path del file con chiave key
+ *
+ *    \param key:       chiave del file
+ *    \param path:      buffer in cui scrivere il path
+ *    \param size:      dimensione del buffer
+ *    \return:          se key == NULL || path == NULL o il buffer è troppo piccolo allora ILLEGAL_ARGUMENT
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t file_store_path(char* key, char* path, size_t size);
+
+#endif /* FILE_STORE_H_ */
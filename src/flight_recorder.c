@@ -0,0 +1,208 @@
+
+/** \file flight_recorder.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "flight_recorder.h"
+#include "latency.h"
+#include "op_res.h"
+#include "logger.h"
+
+/**	Richiesta registrata. seq è dispari mentre il thread proprietario la sta scrivendo
+ */
+typedef struct {
+	volatile unsigned long seq;
+	int op;
+	int fd;
+	int result;								//-1 se la richiesta è ancora in corso
+	unsigned int size;
+	char sender[MAX_NAME_LENGTH+1];
+	char receiver[MAX_NAME_LENGTH+1];
+	unsigned long long dequeue_ns;
+	unsigned long long start_ns;
+	unsigned long long done_ns;
+} flight_entry_t;
+
+/**	Buffer circolare di un thread, scritto solo dal thread proprietario
+ */
+typedef struct flight_ring {
+	flight_entry_t entries[FLIGHT_SLOTS];
+	volatile unsigned long count;		//Richieste registrate
+	int id;									//Identificativo del thread
+	struct flight_ring* next;
+} flight_ring_t;
+
+static const char* result_names[] = {
+	"REQUEST_OK", "ILLEGAL_ARGUMENT", "SYSTEM_ERROR", "CLIENT_ERROR", "ALREADY_INSERTED", "FOUND", "NOT_FOUND", "CONN_LIMIT_REACHED"
+};
+
+static flight_ring_t* volatile rings = NULL;				//Lista dei buffer dei thread
+static int next_id = 0;											//Identificativo del prossimo thread
+static __thread flight_ring_t* my_ring = NULL;				//Buffer del thread
+static __thread flight_entry_t* current = NULL;			//Richiesta in corso del thread
+static pthread_mutex_t dump_mtx = PTHREAD_MUTEX_INITIALIZER;	//Serializza le scritture sul file
+
+/* SCRITTURA IN BACKGROUND (flight_dump_async) */
+static pthread_mutex_t async_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_done = PTHREAD_COND_INITIALIZER;
+static int async_running = 0;									//Scrittura in background in corso
+static char* async_path = NULL;
+static char* async_reason = NULL;
+
+static flight_ring_t* register_ring() {
+	flight_ring_t* ring = (flight_ring_t*) calloc(1, sizeof(flight_ring_t));
+	if (ring == NULL) return NULL;
+	ring -> id = __sync_fetch_and_add(&next_id, 1);
+	do {
+		ring -> next = rings;
+	} while (!__sync_bool_compare_and_swap(&rings, ring -> next, ring));
+	return ring;
+}
+
+void flight_begin(int fd, unsigned long long dequeue_ns, message_t* req) {
+	if (my_ring == NULL && (my_ring = register_ring()) == NULL) return;
+
+	flight_entry_t* e = &(my_ring -> entries[my_ring -> count % FLIGHT_SLOTS]);
+	e -> seq++;
+	__sync_synchronize();
+	e -> op = req -> hdr.op;
+	e -> fd = fd;
+	e -> result = -1;
+	e -> size = req -> data.hdr.len;
+	memcpy(e -> sender, req -> hdr.sender, MAX_NAME_LENGTH+1);
+	e -> sender[MAX_NAME_LENGTH] = '\0';
+	memcpy(e -> receiver, req -> data.hdr.receiver, MAX_NAME_LENGTH+1);
+	e -> receiver[MAX_NAME_LENGTH] = '\0';
+	e -> dequeue_ns = dequeue_ns;
+	e -> start_ns = latency_now();
+	e -> done_ns = 0;
+	__sync_synchronize();
+	e -> seq++;
+	my_ring -> count++;
+	current = e;
+}
+
+void flight_end(int result) {
+	flight_entry_t* e = current;
+	if (e == NULL) return;
+
+	e -> seq++;
+	__sync_synchronize();
+	e -> result = result;
+	e -> done_ns = latency_now();
+	__sync_synchronize();
+	e -> seq++;
+	current = NULL;
+}
+
+/**	Scrive su f l'istante ns (orologio monotono) convertito in tempo reale tramite offset
+ */
+static int print_time(FILE* f, const char* name, unsigned long long ns, long long offset) {
+	if (ns == 0) return fprintf(f, " %s=-", name);
+	long long t = (long long)ns + offset;
+	return fprintf(f, " %s=%lld.%06lld", name, t / 1000000000LL, (t % 1000000000LL) / 1000);
+}
+
+int flight_dump(char* path, char* reason) {
+	struct timespec real;
+	flight_entry_t e;
+
+	if (!path || path[0] == '\0') return -1;
+
+	pthread_mutex_lock(&dump_mtx);
+	FILE* f = fopen(path, "ab");
+	if (f == NULL) {
+		pthread_mutex_unlock(&dump_mtx);
+		return -1;
+	}
+
+	/* DIFFERENZA TRA OROLOGIO REALE E MONOTONO, PER STAMPARE GLI ISTANTI REGISTRATI IN TEMPO REALE */
+	clock_gettime(CLOCK_REALTIME, &real);
+	long long offset = ((long long)real.tv_sec*1000000000LL + real.tv_nsec) - (long long)latency_now();
+
+	int err = fprintf(f, "%ld - flight recorder (%s)\n", (long)real.tv_sec, reason ? reason : "") < 0;
+	for (flight_ring_t* ring = rings; ring != NULL && !err; ring = ring -> next) {
+		unsigned long count = ring -> count;
+		unsigned long first = (count > FLIGHT_SLOTS) ? count - FLIGHT_SLOTS : 0;
+		for (unsigned long i = first; i < count && !err; i++) {
+			flight_entry_t* src = &(ring -> entries[i % FLIGHT_SLOTS]);
+			/* COPIA COERENTE: SCARTO LA RICHIESTA SE IL THREAD LA STA MODIFICANDO */
+			unsigned long seq = src -> seq;
+			if (seq & 1) continue;
+			__sync_synchronize();
+			memcpy(&e, src, sizeof(e));
+			__sync_synchronize();
+			if (src -> seq != seq) continue;
+
+			err = fprintf(f, "thread=%d op=%s fd=%d sender=%s receiver=%s size=%u", ring -> id, latency_op_name(e.op),
+				e.fd, e.sender[0] ? e.sender : "-", e.receiver[0] ? e.receiver : "-", e.size) < 0;
+			err = err || print_time(f, "dequeue", e.dequeue_ns, offset) < 0 || print_time(f, "start", e.start_ns, offset) < 0
+				|| print_time(f, "done", e.done_ns, offset) < 0;
+			if (e.result >= REQUEST_OK && e.result <= CONN_LIMIT_REACHED) err = err || fprintf(f, " result=%s\n", result_names[e.result]) < 0;
+			else err = err || fprintf(f, " result=in_progress\n") < 0;
+		}
+	}
+
+	if (fclose(f) != 0) err = 1;
+	pthread_mutex_unlock(&dump_mtx);
+	return err ? -1 : 0;
+}
+
+static void* async_func(void* arg) {
+	if (flight_dump(async_path, async_reason) == -1)
+		LOGGER(LOGGER_WARN, "Errore nella scrittura del flight recorder su %s", async_path);
+
+	pthread_mutex_lock(&async_mtx);
+	async_running = 0;
+	pthread_cond_broadcast(&async_done);
+	pthread_mutex_unlock(&async_mtx);
+	return (void*)0;
+}
+
+int flight_dump_async(char* path, char* reason) {
+	pthread_t t;
+	pthread_attr_t attr;
+
+	if (!path || path[0] == '\0') return -1;
+
+	pthread_mutex_lock(&async_mtx);
+	/* UNA SCRITTURA È GIÀ IN CORSO: NON NE AVVIO UN'ALTRA */
+	if (async_running) {
+		pthread_mutex_unlock(&async_mtx);
+		return 0;
+	}
+	async_path = path;
+	async_reason = reason;
+	int err = pthread_attr_init(&attr) != 0;
+	if (!err) {
+		err = pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) != 0 || pthread_create(&t, &attr, async_func, NULL) != 0;
+		pthread_attr_destroy(&attr);
+	}
+	if (!err) async_running = 1;
+	pthread_mutex_unlock(&async_mtx);
+	return err ? -1 : 0;
+}
+
+void flight_destroy() {
+	/* ATTENDO L'EVENTUALE SCRITTURA IN BACKGROUND, CHE LEGGE I BUFFER */
+	pthread_mutex_lock(&async_mtx);
+	while (async_running)
+		pthread_cond_wait(&async_done, &async_mtx);
+	pthread_mutex_unlock(&async_mtx);
+
+	flight_ring_t* ring = rings;
+	rings = NULL;
+	while (ring != NULL) {
+		flight_ring_t* next = ring -> next;
+		free(ring);
+		ring = next;
+	}
+}
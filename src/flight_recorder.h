@@ -0,0 +1,63 @@
+
+/** \file flight_recorder.h
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#if !defined(FLIGHT_RECORDER_H_)
+#define FLIGHT_RECORDER_H_
+
+#include "message.h"
+
+/**   Registratore delle ultime richieste gestite (sempre attivo)
+ *    Ogni thread del pool registra, in un buffer circolare privato di FLIGHT_SLOTS elementi e senza mutex, le ultime
+ *    richieste gestite: operazione, mittente, destinatario, dimensione dei dati, istanti di estrazione dalla coda,
+ *    di inizio gestione e di fine gestione, e risultato. Una richiesta ancora in corso ha risultato "in_progress".
+ *    Il contenuto dei buffer viene scritto nel file FlightFileName all'arrivo di SIGUSR2 e quando un thread del
+ *    pool termina per un errore, così da sapere cosa stavano facendo i thread durante un blocco del server.
+ */
+
+#ifndef FLIGHT_SLOTS
+#define FLIGHT_SLOTS 128
+#endif
+
+/**   Registra l'inizio della gestione della richiesta req del client fd da parte del thread chiamante
+ *
+ *    \param fd:           descrittore del client
+ *    \param dequeue_ns:   istante (latency_now) in cui il descrittore è stato estratto dalla coda
+ *    \param req:          richiesta letta
+ */
+void flight_begin(int fd, unsigned long long dequeue_ns, message_t* req);
+
+/**   Registra la fine della gestione della richiesta in corso del thread chiamante
+ *
+ *    \param result:       risultato della gestione (op_res_t)
+ */
+void flight_end(int result);
+
+/**   Scrive in append sul file path il contenuto dei buffer di tutti i thread, dalla richiesta più vecchia
+ *    alla più recente (thread-safe, le richieste che vengono modificate durante la lettura sono omesse)
+ *
+ *    \param path:         path del file
+ *    \param reason:       motivo della scrittura, riportato nell'intestazione
+ *    \return:             0 in caso di successo, -1 in caso di errore
+ */
+int flight_dump(char* path, char* reason);
+
+/**   Come flight_dump, ma la scrittura avviene in un thread separato e il chiamante non attende (usata dal listener
+ *    all'arrivo di SIGUSR2). Se una scrittura in background è già in corso non ne avvia un'altra; gli errori di
+ *    scrittura vengono riportati nel log
+ *
+ *    \param path:         path del file (deve restare valido fino al termine della scrittura)
+ *    \param reason:       motivo della scrittura, riportato nell'intestazione (come path)
+ *    \return:             0 in caso di successo, -1 se non è stato possibile avviare il thread
+ */
+int flight_dump_async(char* path, char* reason);
+
+/**   Attende l'eventuale scrittura in background e dealloca i buffer dei thread, deve essere chiamata da un solo
+ *    thread quando i thread del pool hanno terminato
+ */
+void flight_destroy();
+
+#endif /* FLIGHT_RECORDER_H_ */
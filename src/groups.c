@@ -0,0 +1,131 @@
+/** \file groups.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#include <stdlib.h>
+#include <string.h>
+#include "groups.h"
+
+/**	Numero di membri allocati inizialmente per un gruppo
+ */
+#define GROUP_INIT_CAPACITY 4
+
+/*
+	Ricerca binaria di nick nell'array ordinato dei membri
+	Ritorna la posizione di nick se presente, altrimenti -(posizione di inserimento)-1
+*/
+static int search_member(group_t* group, char* nick) {
+	int low = 0, high = group -> num_members - 1, mid, cmp;
+
+	while (low <= high) {
+		mid = (low + high)/2;
+		cmp = strncmp(group -> members[mid], nick, MAX_NAME_LENGTH);
+		if (cmp == 0) return mid;
+		if (cmp < 0) low = mid + 1;
+		else high = mid - 1;
+	}
+
+	return -low-1;
+}
+
+group_t* group_init(char* name, char* creator) {
+	if (!name || !creator)
+		return NULL;
+
+	group_t* group = (group_t*) malloc(sizeof(group_t));
+	if (!group)
+		return NULL;
+
+	group -> members = malloc(GROUP_INIT_CAPACITY*sizeof(*(group -> members)));
+	if (!(group -> members)) {
+		free(group);
+		return NULL;
+	}
+
+	memset(group -> name, '\0', MAX_NAME_LENGTH+1);
+	strncpy(group -> name, name, MAX_NAME_LENGTH);
+	group -> capacity = GROUP_INIT_CAPACITY;
+	group -> num_members = 0;
+
+	group_add_member(group, creator);
+
+	return group;
+}
+
+void group_destroy(void* group) {
+	if (!group) return;
+
+	group_t* g = group;
+	if (g -> members) free(g -> members);
+	free(g);
+}
+
+op_res_t group_add_member(group_t* group, char* nick) {
+	if (!group || !nick)
+		return ILLEGAL_ARGUMENT;
+
+	int pos = search_member(group, nick);
+	if (pos >= 0)
+		return ALREADY_INSERTED;
+	pos = -pos-1;
+
+	/* RADDOPPIO LA CAPACITÀ DELL'ARRAY SE PIENO */
+	if (group -> num_members == group -> capacity) {
+		void* tmp = realloc(group -> members, 2*(group -> capacity)*sizeof(*(group -> members)));
+		if (!tmp)
+			return SYSTEM_ERROR;
+		group -> members = tmp;
+		group -> capacity *= 2;
+	}
+
+	memmove(group -> members + pos + 1, group -> members + pos, (group -> num_members - pos)*sizeof(*(group -> members)));
+	memset(group -> members[pos], '\0', MAX_NAME_LENGTH+1);
+	strncpy(group -> members[pos], nick, MAX_NAME_LENGTH);
+	(group -> num_members)++;
+
+	return REQUEST_OK;
+}
+
+op_res_t group_remove_member(group_t* group, char* nick) {
+	if (!group || !nick)
+		return ILLEGAL_ARGUMENT;
+
+	int pos = search_member(group, nick);
+	if (pos < 0)
+		return NOT_FOUND;
+
+	memmove(group -> members + pos, group -> members + pos + 1, (group -> num_members - pos - 1)*sizeof(*(group -> members)));
+	(group -> num_members)--;
+
+	return REQUEST_OK;
+}
+
+op_res_t group_is_member(group_t* group, char* nick) {
+	if (!group || !nick)
+		return ILLEGAL_ARGUMENT;
+
+	if (search_member(group, nick) < 0)
+		return NOT_FOUND;
+
+	return FOUND;
+}
+
+op_res_t group_get_members(group_t* group, char (**members)[MAX_NAME_LENGTH+1], int* n) {
+	if (!group || !members || !n)
+		return ILLEGAL_ARGUMENT;
+
+	*n = group -> num_members;
+	*members = NULL;
+	if (*n == 0)
+		return REQUEST_OK;
+
+	*members = malloc((*n)*sizeof(**members));
+	if (!(*members))
+		return SYSTEM_ERROR;
+
+	memcpy(*members, group -> members, (*n)*sizeof(**members));
+
+	return REQUEST_OK;
+}
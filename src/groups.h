@@ -0,0 +1,81 @@
+/** \file groups.h
+      \author Giuseppe Muntoni
+      Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+      originale dell'autore
+     */
+
+#if !defined(GROUPS_H_)
+#define GROUPS_H_
+
+#include "op_res.h"
+#include "config.h"
+
+/**   Struttura dati che rappresenta un gruppo di utenti
+ *    I membri sono mantenuti in un array compatto di nickname ordinato lessicograficamente
+ *    Le funzioni di interfaccia non sono thread-safe (vedere groups_table_lock in users.h)
+ */
+typedef struct group {
+   char name[MAX_NAME_LENGTH+1];                /**<  Nome del gruppo                                    */
+   char (*members)[MAX_NAME_LENGTH+1];          /**<  Array ordinato dei nickname dei membri             */
+   int num_members;                             /**<  Numero di membri del gruppo                        */
+   int capacity;                                /**<  Numero di nickname allocati in members             */
+} group_t;
+
+/**   Inizializza un gruppo il cui unico membro è il creatore
+ *
+ *    \param name:      nome del gruppo
+ *    \param creator:   nickname del creatore del gruppo
+ *    \return:          se name == NULL || creator == NULL o c'è un errore di allocazione della memoria allora NULL
+ *                      altrimenti puntatore alla struttura dati group_t allocata
+ */
+group_t* group_init(char* name, char* creator);
+
+/**   Dealloca un gruppo
+ *
+ *    \param group:     puntatore alla struttura dati group_t
+ */
+void group_destroy(void* group);
+
+/**   Aggiunge nick ai membri del gruppo
+ *
+ *    \param group:     puntatore alla struttura dati group_t
+ *    \param nick:      nickname dell'utente da aggiungere
+ *    \return:          se group == NULL || nick == NULL allora ILLEGAL_ARGUMENT
+ *                      se nick è già membro del gruppo allora ALREADY_INSERTED
+ *                      se c'è un errore di allocazione della memoria allora SYSTEM_ERROR
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t group_add_member(group_t* group, char* nick);
+
+/**   Rimuove nick dai membri del gruppo
+ *
+ *    \param group:     puntatore alla struttura dati group_t
+ *    \param nick:      nickname dell'utente da rimuovere
+ *    \return:          se group == NULL || nick == NULL allora ILLEGAL_ARGUMENT
+ *                      se nick non è membro del gruppo allora NOT_FOUND
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t group_remove_member(group_t* group, char* nick);
+
+/**   Verifica se nick è membro del gruppo
+ *
+ *    \param group:     puntatore alla struttura dati group_t
+ *    \param nick:      nickname dell'utente
+ *    \return:          se group == NULL || nick == NULL allora ILLEGAL_ARGUMENT
+ *                      se nick è membro del gruppo allora FOUND
+ *                      altrimenti NOT_FOUND
+ */
+op_res_t group_is_member(group_t* group, char* nick);
+
+/**   Effettua una copia dei nickname dei membri del gruppo
+ *
+ *    \param group:     puntatore alla struttura dati group_t
+ *    \param members:   indirizzo in cui salvare l'array allocato dei nickname (deve essere deallocato dal chiamante)
+ *    \param n:         indirizzo in cui salvare il numero di membri
+ *    \return:          se group == NULL || members == NULL || n == NULL allora ILLEGAL_ARGUMENT
+ *                      se c'è un errore di allocazione della memoria allora SYSTEM_ERROR
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t group_get_members(group_t* group, char (**members)[MAX_NAME_LENGTH+1], int* n);
+
+#endif /* GROUPS_H_ */
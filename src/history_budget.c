@@ -0,0 +1,233 @@
+
+/** \file history_budget.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "history_budget.h"
+#include "lock_profile.h"
+#include "config.h"
+
+/**	Numero massimo di utenti candidati all'eviction estratti dalla lista LRU ad ogni passo
+ */
+#define EVICT_BATCH 8
+
+/**	Nome della sottodirectory (di DirName) che contiene le history riversate su disco
+ */
+#define SPILL_DIR ".history"
+
+static long max_bytes = 0;							//Budget in byte (0 nessun limite)
+static hist_policy_t policy = HIST_SPILL;		//Politica di eviction
+static char spill_dir[1024];						//Directory delle history riversate su disco
+static long cur_bytes = 0;							//Byte occupati dalle history in memoria (aggiornato atomicamente)
+static unsigned long num_spilled = 0;			//Messaggi riversati su disco (aggiornato atomicamente)
+static unsigned long num_dropped = 0;			//Messaggi eliminati (aggiornato atomicamente)
+static user_data_t* lru_head = NULL;			//Utente la cui history è stata usata più di recente
+static user_data_t* lru_tail = NULL;			//Utente la cui history è stata usata meno di recente
+static pthread_mutex_t budget_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/**	Rimuove user_data dalla lista LRU (budget_mtx acquisita)
+ */
+static void lru_unlink(user_data_t* user_data) {
+	if (user_data -> in_lru == FALSE) return;
+
+	if (user_data -> lru_prev) user_data -> lru_prev -> lru_next = user_data -> lru_next;
+	else lru_head = user_data -> lru_next;
+	if (user_data -> lru_next) user_data -> lru_next -> lru_prev = user_data -> lru_prev;
+	else lru_tail = user_data -> lru_prev;
+
+	user_data -> lru_prev = user_data -> lru_next = NULL;
+	user_data -> in_lru = FALSE;
+}
+
+/**	Inserisce user_data in testa alla lista LRU (budget_mtx acquisita)
+ */
+static void lru_push_front(user_data_t* user_data) {
+	user_data -> lru_prev = NULL;
+	user_data -> lru_next = lru_head;
+	if (lru_head) lru_head -> lru_prev = user_data;
+	lru_head = user_data;
+	if (lru_tail == NULL) lru_tail = user_data;
+	user_data -> in_lru = TRUE;
+}
+
+op_res_t history_budget_init(long max, hist_policy_t pol, char* dir_name) {
+	if (!dir_name || max < 0)
+		return ILLEGAL_ARGUMENT;
+
+	max_bytes = max;
+	policy = pol;
+
+	memset(spill_dir, '\0', sizeof(spill_dir));
+	if (snprintf(spill_dir, sizeof(spill_dir), "%s/%s", dir_name, SPILL_DIR) >= (int)sizeof(spill_dir))
+		return ILLEGAL_ARGUMENT;
+
+	if (max_bytes > 0 && policy == HIST_SPILL) {
+		struct stat st;
+		if (stat(spill_dir, &st) == -1 && mkdir(spill_dir, 0700) == -1)
+			return SYSTEM_ERROR;
+		/* GLI UTENTI NON SOPRAVVIVONO AL RIAVVIO DEL SERVER ==> ELIMINO LE HISTORY (E I FILE TEMPORANEI) RIMASTE SU DISCO */
+		DIR* dir = opendir(spill_dir);
+		if (dir == NULL)
+			return SYSTEM_ERROR;
+		struct dirent* entry;
+		char path[2048];
+		while ((entry = readdir(dir)) != NULL) {
+			if (entry -> d_name[0] == '.') continue;
+			if (snprintf(path, sizeof(path), "%s/%s", spill_dir, entry -> d_name) < (int)sizeof(path)) remove(path);
+		}
+		closedir(dir);
+	}
+
+	return REQUEST_OK;
+}
+
+void history_budget_destroy() {
+	LP_LOCK(LP_BUDGET, 0, &budget_mtx);
+	lru_head = lru_tail = NULL;
+	cur_bytes = 0;
+	LP_UNLOCK(LP_BUDGET, 0, &budget_mtx);
+}
+
+void history_budget_account(user_data_t* user_data, long delta) {
+	if (!user_data) return;
+
+	__sync_add_and_fetch(&cur_bytes, delta);
+	/* SENZA BUDGET LA LISTA LRU NON SERVE ==> NESSUNA MUTEX GLOBALE SUL PERCORSO DEI MESSAGGI */
+	if (max_bytes == 0) return;
+
+	LP_LOCK(LP_BUDGET, 0, &budget_mtx);
+	lru_unlink(user_data);
+	if (user_data -> hist_bytes > 0) lru_push_front(user_data);
+	LP_UNLOCK(LP_BUDGET, 0, &budget_mtx);
+}
+
+void history_budget_forget(user_data_t* user_data) {
+	if (!user_data) return;
+
+	__sync_sub_and_fetch(&cur_bytes, user_data -> hist_bytes);
+	if (max_bytes == 0) return;
+
+	LP_LOCK(LP_BUDGET, 0, &budget_mtx);
+	lru_unlink(user_data);
+	LP_UNLOCK(LP_BUDGET, 0, &budget_mtx);
+}
+
+op_res_t history_budget_path(char* nick, char* path, size_t size) {
+	if (!nick || !path)
+		return ILLEGAL_ARGUMENT;
+
+	/* IL NICK PUÒ CONTENERE CARATTERI NON VALIDI IN UN NOME DI FILE ==> LO CODIFICO IN ESADECIMALE */
+	char hex[2*MAX_NAME_LENGTH+1];
+	memset(hex, '\0', sizeof(hex));
+	for (int i = 0; nick[i] != '\0' && i < MAX_NAME_LENGTH; i++)
+		sprintf(hex + 2*i, "%02x", (unsigned char)nick[i]);
+
+	if (snprintf(path, size, "%s/%s", spill_dir, hex) >= (int)size)
+		return ILLEGAL_ARGUMENT;
+
+	return REQUEST_OK;
+}
+
+op_res_t history_budget_enforce(users_t* users) {
+	if (!users)
+		return ILLEGAL_ARGUMENT;
+
+	if (max_bytes == 0)
+		return REQUEST_OK;
+
+	char victims[EVICT_BATCH][MAX_NAME_LENGTH+1];
+	int num_victims, progress, nmsgs;
+	history_disk_t spill;
+	op_res_t result = REQUEST_OK;
+
+	do {
+		if (__sync_add_and_fetch(&cur_bytes, 0) <= max_bytes)
+			break;
+		/* ESTRAGGO I NICK DEGLI UTENTI USATI MENO DI RECENTE (LA MUTEX SUL BLOCCO LOGICO NON PUÒ ESSERE ACQUISITA CON budget_mtx) */
+		LP_LOCK(LP_BUDGET, 0, &budget_mtx);
+		num_victims = 0;
+		for (user_data_t* curr = lru_tail; curr != NULL && num_victims < EVICT_BATCH; curr = curr -> lru_prev) {
+			memset(victims[num_victims], '\0', MAX_NAME_LENGTH+1);
+			strncpy(victims[num_victims], curr -> nick, MAX_NAME_LENGTH);
+			num_victims++;
+		}
+		LP_UNLOCK(LP_BUDGET, 0, &budget_mtx);
+
+		/* RIVERSO SU DISCO (O ELIMINO) LA HISTORY DEI CANDIDATI FINCHÈ NON RIENTRO NEL BUDGET */
+		progress = 0;
+		for (int i = 0; i < num_victims; i++) {
+			nmsgs = 0;
+			users_table_lock(users, victims[i]);
+			user_data_t* user_data = get_user_data(users, victims[i]);
+			spill.n = 0;
+			if (user_data != NULL) {
+				if (policy == HIST_SPILL) {
+					if (history_spill_prepare(user_data, &spill) == SYSTEM_ERROR) result = SYSTEM_ERROR;
+				}
+				else history_drop(user_data, &nmsgs);
+			}
+			users_table_unlock(users, victims[i]);
+
+			/* LA SCRITTURA SU DISCO AVVIENE SENZA LA MUTEX SUL BLOCCO LOGICO, LO SPILL VIENE CONFERMATO SOLO SE LA HISTORY NON È CAMBIATA */
+			if (spill.n > 0) {
+				boolean_t written = (history_spill_write(&spill) == REQUEST_OK) ? TRUE : FALSE;
+				if (written == FALSE) result = SYSTEM_ERROR;
+				users_table_lock(users, victims[i]);
+				user_data_t* curr = get_user_data(users, victims[i]);
+				history_spill_commit((curr == user_data) ? curr : NULL, &spill, written, &nmsgs);
+				users_table_unlock(users, victims[i]);
+			}
+
+			if (policy == HIST_SPILL) __sync_add_and_fetch(&num_spilled, nmsgs);
+			else __sync_add_and_fetch(&num_dropped, nmsgs);
+
+			if (nmsgs > 0) progress = 1;
+			if (__sync_add_and_fetch(&cur_bytes, 0) <= max_bytes) break;
+		}
+	} while (progress && result != SYSTEM_ERROR);
+
+	return result;
+}
+
+op_res_t history_budget_restore(users_t* users, char* nick) {
+	if (!users || !nick)
+		return ILLEGAL_ARGUMENT;
+
+	if (max_bytes == 0 || policy != HIST_SPILL)
+		return REQUEST_OK;
+
+	history_disk_t restore;
+	users_table_lock(users, nick);
+	user_data_t* user_data = get_user_data(users, nick);
+	if (user_data == NULL || history_restore_prepare(user_data, &restore) != REQUEST_OK || restore.file_msgs == 0) {
+		users_table_unlock(users, nick);
+		return REQUEST_OK;
+	}
+	users_table_unlock(users, nick);
+
+	/* LA LETTURA DAL DISCO AVVIENE SENZA LA MUTEX SUL BLOCCO LOGICO, SE NEL FRATTEMPO LA HISTORY È CAMBIATA I MESSAGGI LETTI VENGONO SCARTATI */
+	if (history_restore_load(&restore) != REQUEST_OK)
+		return SYSTEM_ERROR;
+
+	users_table_lock(users, nick);
+	user_data_t* curr = get_user_data(users, nick);
+	history_restore_commit((curr == user_data) ? curr : NULL, &restore);
+	users_table_unlock(users, nick);
+
+	return REQUEST_OK;
+}
+
+void history_budget_get_stats(unsigned long* bytes, unsigned long* spilled, unsigned long* dropped) {
+	if (bytes) *bytes = __sync_add_and_fetch(&cur_bytes, 0);
+	if (spilled) *spilled = __sync_add_and_fetch(&num_spilled, 0);
+	if (dropped) *dropped = __sync_add_and_fetch(&num_dropped, 0);
+}
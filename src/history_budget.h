@@ -0,0 +1,94 @@
+
+/** \file history_budget.h
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#if !defined(HISTORY_BUDGET_H_)
+#define HISTORY_BUDGET_H_
+
+#include "op_res.h"
+#include "user_data.h"
+#include "users.h"
+
+/**   Politica adottata quando la memoria occupata dalle history supera il budget
+ */
+typedef enum hist_policy {
+   HIST_SPILL = 0,                     /**<  La history degli utenti meno attivi viene riversata su disco       */
+   HIST_DROP = 1                       /**<  La history degli utenti meno attivi viene eliminata               */
+} hist_policy_t;
+
+/**   Inizializza il budget globale di memoria per le history, deve essere chiamata da un solo thread (tipicamente il thread main)
+ *
+ *    \param max_bytes: massimo numero di byte occupabili dalle history in memoria (0 nessun limite)
+ *    \param policy:    politica da adottare quando il budget viene superato
+ *    \param dir_name:  directory in cui creare la sottodirectory per le history riversate su disco
+ *    \return:          se dir_name == NULL || max_bytes < 0 allora ILLEGAL_ARGUMENT
+ *                      se c'è un errore nella creazione della directory allora SYSTEM_ERROR
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t history_budget_init(long max_bytes, hist_policy_t policy, char* dir_name);
+
+/**   Rilascia le risorse del budget, deve essere chiamata da un solo thread (tipicamente il thread main)
+ */
+void history_budget_destroy();
+
+/**   Aggiorna la memoria occupata dalle history di delta byte e segna l'utente come usato più di recente
+ *    (la lista LRU e la relativa mutex sono usate solo se il budget è attivo)
+ *    Deve essere chiamata in mutua esclusione sul blocco logico dell'utente
+ *
+ *    \param user_data: puntatore alla struttura dati user_data_t dell'utente
+ *    \param delta:     variazione in byte della memoria occupata dalla history dell'utente
+ */
+void history_budget_account(user_data_t* user_data, long delta);
+
+/**   Rimuove l'utente dalla lista LRU delle history in memoria e ne sottrae la memoria occupata
+ *    Deve essere chiamata in mutua esclusione sul blocco logico dell'utente
+ *
+ *    \param user_data: puntatore alla struttura dati user_data_t dell'utente
+ */
+void history_budget_forget(user_data_t* user_data);
+
+/**   Costruisce il path del file su cui viene riversata la history dell'utente nick
+ *
+ *    \param nick:   nickname dell'utente
+ *    \param path:   buffer in cui scrivere il path
+ *    \param size:   dimensione del buffer
+ *    \return:       se nick == NULL || path == NULL o il buffer è troppo piccolo allora ILLEGAL_ARGUMENT
+ *                   altrimenti REQUEST_OK
+ */
+op_res_t history_budget_path(char* nick, char* path, size_t size);
+
+/**   Se la memoria occupata dalle history supera il budget riversa su disco (o elimina, secondo la politica)
+ *    la history degli utenti usati meno di recente finchè non si rientra nel budget.
+ *    Non deve essere chiamata mentre si possiede una mutex su un blocco logico di reg_users
+ *
+ *    \param users:  puntatore alla struttura dati users_t
+ *    \return:       se users == NULL allora ILLEGAL_ARGUMENT
+ *                   se c'è stato un errore di scrittura su disco allora SYSTEM_ERROR
+ *                   altrimenti REQUEST_OK
+ */
+op_res_t history_budget_enforce(users_t* users);
+
+/**   Ricarica in memoria la history dell'utente nick se è stata riversata su disco, leggendo il file
+ *    senza mantenere la mutex sul blocco logico dell'utente (da chiamare prima di history_snapshot).
+ *    Non deve essere chiamata mentre si possiede una mutex su un blocco logico di reg_users
+ *
+ *    \param users:  puntatore alla struttura dati users_t
+ *    \param nick:   nickname dell'utente
+ *    \return:       se users == NULL || nick == NULL allora ILLEGAL_ARGUMENT
+ *                   se c'è stato un errore di lettura dal disco allora SYSTEM_ERROR
+ *                   altrimenti REQUEST_OK
+ */
+op_res_t history_budget_restore(users_t* users, char* nick);
+
+/**   Restituisce le statistiche del budget
+ *
+ *    \param bytes:     indirizzo in cui salvare i byte occupati dalle history in memoria
+ *    \param spilled:   indirizzo in cui salvare il numero di messaggi riversati su disco
+ *    \param dropped:   indirizzo in cui salvare il numero di messaggi eliminati
+ */
+void history_budget_get_stats(unsigned long* bytes, unsigned long* spilled, unsigned long* dropped);
+
+#endif /* HISTORY_BUDGET_H_ */
@@ -45,8 +45,79 @@ history_msg_t* init_history_message(message_t msg, boolean_t sended) {
    strncpy((msg_copy -> data).hdr.receiver, msg.data.hdr.receiver, MAX_NAME_LENGTH);
 
    history_msg -> msg = msg_copy;
+   history_msg -> body = NULL;
 
    history_msg -> sended = sended;
+   history_msg -> seq = 0;
+   history_msg -> refs = 1;
+
+   return history_msg;
+}
+
+history_body_t* init_history_body(char* buf, unsigned int len, int nshares) {
+   if (!buf || len == 0 || nshares <= 0)
+      return NULL;
+
+   history_body_t* body = (history_body_t*) malloc(sizeof(history_body_t));
+   if (!body)
+      return NULL;
+
+   body -> buf = (char*) malloc((len+1)*sizeof(char));
+   if (!(body -> buf)) {
+      free(body);
+      return NULL;
+   }
+   memset(body -> buf, '\0', len+1);
+   memcpy(body -> buf, buf, len);
+
+   body -> len = len;
+   body -> share = (len + nshares) / nshares;
+   body -> refs = 1;
+
+   return body;
+}
+
+void release_history_body(history_body_t* body) {
+   if (!body) return;
+
+   if (__sync_sub_and_fetch(&(body -> refs), 1) > 0) return;
+
+   free(body -> buf);
+   free(body);
+}
+
+history_msg_t* init_history_message_shared(message_t msg, boolean_t sended, history_body_t* body) {
+   if (!body)
+      return NULL;
+
+   if (msg.hdr.op != TXT_MESSAGE && msg.hdr.op != FILE_MESSAGE)
+      return NULL;
+
+   history_msg_t* history_msg = (history_msg_t*) malloc(sizeof(history_msg_t));
+   if (!history_msg)
+      return NULL;
+
+   /* COPIO SOLO L'HEADER, IL CONTENUTO PUNTA AL CORPO CONDIVISO */
+   message_t* msg_copy = (message_t*) malloc(sizeof(message_t));
+   if (!msg_copy) {
+      free(history_msg);
+      return NULL;
+   }
+   memset(msg_copy, '\0', sizeof(message_t));
+
+   setHeader(&(msg_copy -> hdr), msg.hdr.op, msg.hdr.sender);
+   memset((msg_copy -> data).hdr.receiver, '\0', MAX_NAME_LENGTH+1);
+   strncpy((msg_copy -> data).hdr.receiver, msg.data.hdr.receiver, MAX_NAME_LENGTH);
+   (msg_copy -> data).hdr.len = body -> len;
+   (msg_copy -> data).buf = body -> buf;
+
+   __sync_add_and_fetch(&(body -> refs), 1);
+
+   history_msg -> msg = msg_copy;
+   history_msg -> body = body;
+   history_msg -> sended = sended;
+   history_msg -> seq = 0;
+   history_msg -> refs = 1;
 
    return history_msg;
 }
@@ -54,11 +125,38 @@ history_msg_t* init_history_message(message_t msg, boolean_t sended) {
 void free_history_message(void* history_msg) {
    if ((history_msg_t*)history_msg) {
       history_msg_t* hist_msg = history_msg;
+      if (--(hist_msg -> refs) > 0) return;
+      /* IL CONTENUTO CONDIVISO NON APPARTIENE AL MESSAGGIO */
+      if (hist_msg -> body) {
+         if (hist_msg -> msg) (hist_msg -> msg -> data).buf = NULL;
+         release_history_body(hist_msg -> body);
+      }
       if (hist_msg -> msg) freeMessage(hist_msg -> msg);
       free(hist_msg);
    }
 }
 
+op_res_t ref_history_message(history_msg_t* history_msg) {
+   if (!history_msg)
+      return ILLEGAL_ARGUMENT;
+
+   (history_msg -> refs)++;
+
+   return REQUEST_OK;
+}
+
+long history_message_size(history_msg_t* history_msg) {
+   if (!history_msg || !(history_msg -> msg))
+      return 0;
+
+   /* IL CORPO CONDIVISO È ALLOCATO UNA SOLA VOLTA: AD OGNI HISTORY VIENE ATTRIBUITA SOLO LA SUA QUOTA (FISSATA ALLA CREAZIONE, 
+      COSÌ LA MEMORIA SOTTRATTA ALL'ESTRAZIONE DEL MESSAGGIO È UGUALE A QUELLA AGGIUNTA ALL'INSERIMENTO) */
+   if (history_msg -> body)
+      return sizeof(history_msg_t) + sizeof(message_t) + (history_msg -> body) -> share;
+
+   return sizeof(history_msg_t) + sizeof(message_t) + (history_msg -> msg -> data).hdr.len + 1;
+}
+
 op_res_t set_sended(history_msg_t* history_msg, boolean_t sended) {
    if (!history_msg)
       return ILLEGAL_ARGUMENT;
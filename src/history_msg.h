@@ -18,11 +18,24 @@ typedef enum boolean {
 	TRUE = 1
 } boolean_t;
 
+/**   Corpo di un messaggio condiviso tra le history di più utenti (invio ad un gruppo)
+ *    Il contatore dei riferimenti viene aggiornato atomicamente poichè le history appartengono a blocchi logici diversi
+ */
+typedef struct history_body {
+   char* buf;                    /**<  Contenuto del messaggio                                  */
+   unsigned int len;             /**<  Lunghezza del contenuto                                  */
+   unsigned int share;           /**<  Quota del contenuto attribuita ad ogni history che lo condivide (vedi history_message_size) */
+   int refs;                     /**<  Numero di messaggi della history che condividono il corpo */
+} history_body_t;
+
 /**   Struttura dati che rappresenta un messaggio della history
  */
 typedef struct history_msg {
    message_t* msg;               /**<  Puntatore al messaggio                                   */
+   history_body_t* body;         /**<  Corpo condiviso del messaggio (NULL se msg possiede il proprio buffer)         */
    boolean_t sended;             /**<  Booleano TRUE se e solo se il messaggio è stato inviato  */ 
+   unsigned long seq;            /**<  Numero di sequenza del messaggio nella history dell'utente (0 se non inserito)  */
+   int refs;                     /**<  Numero di riferimenti al messaggio (history e snapshot in corso)               */
 } history_msg_t;
 
 
@@ -36,12 +49,56 @@ typedef struct history_msg {
  */
 history_msg_t* init_history_message(message_t msg, boolean_t sended);
 
-/**   Dealloca un messaggio della history
+/**   Inizializza il corpo condiviso di un messaggio effettuando una copia di buf
+ *
+ *    \param buf:       contenuto del messaggio
+ *    \param len:       lunghezza del contenuto
+ *    \param nshares:   numero di history che condivideranno il corpo (la memoria del contenuto viene ripartita tra queste)
+ *    \return:          se buf == NULL || len == 0 || nshares <= 0 o c'è stato un errore di allocazione della memoria allora NULL
+ *                      altrimenti puntatore alla struttura dati history_body_t con un riferimento (quello del chiamante)
+ */
+history_body_t* init_history_body(char* buf, unsigned int len, int nshares);
+
+/**   Rilascia un riferimento al corpo condiviso e lo dealloca quando non ci sono più riferimenti (thread-safe)
+ *
+ *    \param body:      puntatore alla struttura dati history_body_t
+ */
+void release_history_body(history_body_t* body);
+
+/**   Inizializza un messaggio della history che condivide il corpo body (non viene effettuata la copia del contenuto)
+ *
+ *    \param msg:       messaggio da inserire (il campo data.buf viene ignorato)
+ *    \param sended:    booleano TRUE se il messaggio è stato inviato, FALSE altrimenti
+ *    \param body:      corpo condiviso del messaggio, ne viene acquisito un riferimento
+ *    \return:          se body == NULL o c'è stato un errore di allocazione della memoria allora NULL
+ *                      se l'op del messaggio è diversa da TXT_MESSAGE e FILE_MESSAGE allora NULL (vedi message.h)
+ *                      altrimenti ritorna un puntatore alla struttura dati history_msg_t
+ */
+history_msg_t* init_history_message_shared(message_t msg, boolean_t sended, history_body_t* body);
+
+/**   Rilascia un riferimento al messaggio della history e lo dealloca quando non ci sono più riferimenti
+ *    Il chiamante deve garantire la mutua esclusione sul messaggio (mutex sul blocco logico dell'utente)
  * 
- *    \param history_msg:  puntatore alla struttura dati history_msg_t da deallocare
+ *    \param history_msg:  puntatore alla struttura dati history_msg_t da rilasciare
  */
 void free_history_message(void* history_msg);
 
+/**   Acquisisce un riferimento al messaggio della history
+ *    Il chiamante deve garantire la mutua esclusione sul messaggio (mutex sul blocco logico dell'utente)
+ * 
+ *    \param history_msg:  puntatore alla struttura dati history_msg_t
+ *    \return:             se history_msg è NULL allora ILLEGAL_ARGUMENT
+ *                         altrimenti REQUEST_OK
+ */
+op_res_t ref_history_message(history_msg_t* history_msg);
+
+/**   Restituisce la memoria occupata da un messaggio della history (strutture dati e buffer)
+ * 
+ *    \param history_msg:  puntatore alla struttura dati history_msg_t
+ *    \return:             numero di byte occupati dal messaggio, 0 se history_msg è NULL
+ */
+long history_message_size(history_msg_t* history_msg);
+
 /**   Setta il booleano sended in history_msg
  *    
  *    \param history_msg:  puntatore alla struttra dati history_msg_t
@@ -0,0 +1,186 @@
+
+/** \file latency.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include <sys/select.h>
+#include "latency.h"
+#include "ops.h"
+
+/**	Bit che individuano l'intervallo all'interno di una potenza di 2
+ */
+#define LAT_SUB_BITS 3
+#define LAT_SUB_BUCKETS (1 << LAT_SUB_BITS)
+
+/**	Esponente della massima potenza di 2 distinta (le latenze oltre 2^LAT_MAX_EXP ns finiscono nell'ultimo intervallo)
+ */
+#define LAT_MAX_EXP 44
+
+/**	Numero di intervalli di un istogramma
+ */
+#define LAT_BUCKETS ((LAT_MAX_EXP - LAT_SUB_BITS + 2) * LAT_SUB_BUCKETS)
+
+/**	Operazioni registrate (i codici da 0 a POSTTXTBATCH_OP) e latenze registrate per ogni operazione
+ */
+#define LAT_OPS (POSTTXTBATCH_OP + 1)
+#define LAT_QUEUE 0
+#define LAT_HANDLER 1
+#define LAT_SEND 2
+#define LAT_PHASES 3
+
+/**	Nomi delle latenze registrate
+ */
+static const char* phase_names[LAT_PHASES] = { "queue", "handler", "send" };
+
+/**	Nomi delle operazioni (nell'ordine dei codici di ops.h)
+ */
+static const char* op_names[LAT_OPS] = {
+	"REGISTER", "CONNECT", "POSTTXT", "POSTTXTALL", "POSTFILE", "GETFILE", "GETPREVMSGS", "USRLIST", "UNREGISTER",
+	"DISCONNECT", "CREATEGROUP", "ADDGROUP", "DELGROUP", "GETPREVMSGS_AFTER", "POSTTXTMULTI", "GETFILERANGE",
+	"UPLOADBEGIN", "UPLOADCHUNK", "UPLOADCOMMIT", "POSTTXTBATCH"
+};
+
+static unsigned long histograms[LAT_OPS][LAT_PHASES][LAT_BUCKETS];	//Numero di latenze in ogni intervallo
+static unsigned long long sums[LAT_OPS][LAT_PHASES];						//Somma delle latenze registrate
+static volatile unsigned long long enqueued_at[FD_SETSIZE];			//Istante di inserimento in codaFd di ogni descrittore
+static __thread unsigned long long begin_ns = 0;							//Inizio della richiesta in corso del thread
+static __thread unsigned long long send_ns = 0;							//Tempo di invio della richiesta in corso del thread
+
+/**	Intervallo dell'istogramma che contiene la latenza v
+ */
+static int bucket_index(unsigned long long v) {
+	if (v < LAT_SUB_BUCKETS) return v;
+	int e = 63 - __builtin_clzll(v);
+	if (e > LAT_MAX_EXP) return LAT_BUCKETS - 1;
+	return (e - LAT_SUB_BITS + 1) * LAT_SUB_BUCKETS + ((v >> (e - LAT_SUB_BITS)) & (LAT_SUB_BUCKETS - 1));
+}
+
+/**	Massima latenza contenuta nell'intervallo i
+ */
+static unsigned long long bucket_top(int i) {
+	if (i < LAT_SUB_BUCKETS) return i;
+	int e = i / LAT_SUB_BUCKETS + LAT_SUB_BITS - 1;
+	unsigned long long sub = i % LAT_SUB_BUCKETS;
+	return ((LAT_SUB_BUCKETS + sub + 1) << (e - LAT_SUB_BITS)) - 1;
+}
+
+static void record(int op, int phase, unsigned long long ns) {
+	__sync_fetch_and_add(&(histograms[op][phase][bucket_index(ns)]), 1);
+	__sync_fetch_and_add(&(sums[op][phase]), ns);
+}
+
+/**	Scrive in p i percentili 50, 90, 99 e 99.9 dell'istogramma (copiato in counts) di total latenze
+ */
+static void percentiles(unsigned long* counts, unsigned long total, unsigned long long* p) {
+	static const unsigned long permille[4] = { 500, 900, 990, 999 };
+	unsigned long cumulative = 0;
+	int i = 0;
+
+	for (int k = 0; k < 4; k++) {
+		/* RANGO DEL PERCENTILE (ARROTONDATO PER ECCESSO) */
+		unsigned long rank = (total * permille[k] + 999) / 1000;
+		if (rank == 0) rank = 1;
+		while (i < LAT_BUCKETS && cumulative + counts[i] < rank) cumulative += counts[i++];
+		p[k] = (i < LAT_BUCKETS) ? bucket_top(i) : 0;
+	}
+}
+
+unsigned long long latency_now() {
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) return 0;
+	return (unsigned long long)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+const char* latency_op_name(int op) {
+	if (op < 0 || op >= LAT_OPS) return "UNKNOWN";
+	return op_names[op];
+}
+
+void latency_enqueued(int fd) {
+	if (fd >= 0 && fd < FD_SETSIZE) enqueued_at[fd] = latency_now();
+}
+
+long long latency_queue_wait(int fd) {
+	if (fd < 0 || fd >= FD_SETSIZE || enqueued_at[fd] == 0) return -1;
+	unsigned long long now = latency_now(), then = enqueued_at[fd];
+	enqueued_at[fd] = 0;
+	return (now > then) ? (long long)(now - then) : 0;
+}
+
+void latency_begin() {
+	send_ns = 0;
+	begin_ns = latency_now();
+}
+
+void latency_add_send(unsigned long long ns) {
+	send_ns += ns;
+}
+
+void latency_end(int op, long long queue_ns) {
+	if (op < 0 || op >= LAT_OPS) return;
+
+	unsigned long long elapsed = latency_now() - begin_ns;
+	unsigned long long handler = (elapsed > send_ns) ? elapsed - send_ns : 0;
+
+	if (queue_ns >= 0) record(op, LAT_QUEUE, queue_ns);
+	record(op, LAT_HANDLER, handler);
+	record(op, LAT_SEND, send_ns);
+}
+
+int latency_print(FILE* fout) {
+	unsigned long counts[LAT_PHASES][LAT_BUCKETS];
+	unsigned long total[LAT_PHASES];
+	unsigned long long p[LAT_PHASES][4];
+
+	for (int op = 0; op < LAT_OPS; op++) {
+		/* COPIO L'ISTOGRAMMA: I PERCENTILI VENGONO CALCOLATI SU UNA COPIA COERENTE CON IL TOTALE */
+		for (int phase = 0; phase < LAT_PHASES; phase++) {
+			total[phase] = 0;
+			for (int i = 0; i < LAT_BUCKETS; i++) {
+				counts[phase][i] = __sync_add_and_fetch(&(histograms[op][phase][i]), 0);
+				total[phase] += counts[phase][i];
+			}
+			percentiles(counts[phase], total[phase], p[phase]);
+		}
+		if (total[LAT_HANDLER] == 0) continue;
+
+		if (fprintf(fout, "%ld - latency %s %lu queue %llu %llu %llu %llu handler %llu %llu %llu %llu send %llu %llu %llu %llu\n",
+			(unsigned long)time(NULL), op_names[op], total[LAT_HANDLER],
+			p[LAT_QUEUE][0], p[LAT_QUEUE][1], p[LAT_QUEUE][2], p[LAT_QUEUE][3],
+			p[LAT_HANDLER][0], p[LAT_HANDLER][1], p[LAT_HANDLER][2], p[LAT_HANDLER][3],
+			p[LAT_SEND][0], p[LAT_SEND][1], p[LAT_SEND][2], p[LAT_SEND][3]) < 0) return -1;
+	}
+
+	return 0;
+}
+
+int latency_write_metrics(FILE* fout) {
+	unsigned long count, cumulative;
+
+	if (fprintf(fout, "# TYPE chatty_latency_ns histogram\n") < 0) return -1;
+	for (int op = 0; op < LAT_OPS; op++) {
+		for (int phase = 0; phase < LAT_PHASES; phase++) {
+			cumulative = 0;
+			/* SOLO GLI INTERVALLI NON VUOTI (I CONTATORI SONO CUMULATIVI) */
+			for (int i = 0; i < LAT_BUCKETS; i++) {
+				if ((count = __sync_add_and_fetch(&(histograms[op][phase][i]), 0)) == 0) continue;
+				cumulative += count;
+				if (fprintf(fout, "chatty_latency_ns_bucket{op=\"%s\",phase=\"%s\",le=\"%llu\"} %lu\n",
+					op_names[op], phase_names[phase], bucket_top(i), cumulative) < 0) return -1;
+			}
+			if (cumulative == 0) continue;
+			if (fprintf(fout, "chatty_latency_ns_bucket{op=\"%s\",phase=\"%s\",le=\"+Inf\"} %lu\n"
+				"chatty_latency_ns_sum{op=\"%s\",phase=\"%s\"} %llu\n"
+				"chatty_latency_ns_count{op=\"%s\",phase=\"%s\"} %lu\n",
+				op_names[op], phase_names[phase], cumulative,
+				op_names[op], phase_names[phase], __sync_add_and_fetch(&(sums[op][phase]), 0),
+				op_names[op], phase_names[phase], cumulative) < 0) return -1;
+		}
+	}
+
+	return 0;
+}
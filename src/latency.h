@@ -0,0 +1,77 @@
+
+/** \file latency.h
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#if !defined(LATENCY_H_)
+#define LATENCY_H_
+
+#include <stdio.h>
+
+/**   Istogrammi delle latenze delle richieste
+ *    Per ogni operazione vengono registrate separatamente tre latenze (in nanosecondi):
+ *       queue:   attesa del descrittore in codaFd prima che un thread del pool lo estragga
+ *       handler: gestione della richiesta, escluso il tempo speso ad inviare messaggi
+ *       send:    invio della risposta e dei messaggi ai destinatari
+ *    Gli istogrammi hanno intervalli logaritmici (LAT_SUB_BUCKETS intervalli per ogni potenza di 2, errore relativo
+ *    inferiore al 12.5%) e vengono aggiornati senza mutex. Tutte le funzioni sono thread-safe.
+ */
+
+/**   Restituisce l'istante attuale (orologio monotono) in nanosecondi
+ */
+unsigned long long latency_now();
+
+/**   Restituisce il nome dell'operazione op (vedere ops.h), "UNKNOWN" se il codice non è valido
+ */
+const char* latency_op_name(int op);
+
+/**   Registra l'istante in cui il descrittore fd viene inserito in codaFd (chiamata dal thread listener)
+ *
+ *    \param fd:        descrittore del client
+ */
+void latency_enqueued(int fd);
+
+/**   Restituisce l'attesa in codaFd del descrittore fd appena estratto
+ *
+ *    \param fd:        descrittore del client
+ *    \return:          attesa in nanosecondi, -1 se l'istante di inserimento non è noto
+ */
+long long latency_queue_wait(int fd);
+
+/**   Inizia la misura della gestione di una richiesta da parte del thread chiamante
+ */
+void latency_begin();
+
+/**   Aggiunge ns al tempo di invio della richiesta in corso del thread chiamante (chiamata da chi invia i messaggi)
+ *
+ *    \param ns:        durata dell'invio in nanosecondi
+ */
+void latency_add_send(unsigned long long ns);
+
+/**   Conclude la misura iniziata da latency_begin e registra le latenze negli istogrammi dell'operazione op
+ *
+ *    \param op:        operazione richiesta (vedere ops.h)
+ *    \param queue_ns:  attesa in codaFd della richiesta (-1 se la richiesta non è passata dalla coda)
+ */
+void latency_end(int op, long long queue_ns);
+
+/**   Stampa sul file fout una riga per ogni operazione registrata almeno una volta:
+ *    <tempo> - latency <operazione> <richieste> queue <p50> <p90> <p99> <p999> handler <...> send <...>
+ *    con i percentili in nanosecondi
+ *
+ *    \param fout:      file aperto in append
+ *    \return:          0 in caso di successo, -1 in caso di errore di scrittura
+ */
+int latency_print(FILE* fout);
+
+/**   Scrive sul file fout gli istogrammi nel formato testuale di Prometheus (metrica chatty_latency_ns con
+ *    etichette op e phase, solo gli intervalli non vuoti)
+ *
+ *    \param fout:      file su cui scrivere
+ *    \return:          0 in caso di successo, -1 in caso di errore di scrittura
+ */
+int latency_write_metrics(FILE* fout);
+
+#endif /* LATENCY_H_ */
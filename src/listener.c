@@ -18,8 +18,16 @@
 #include <errno.h>
 #include "queue.h"
 #include "conn.h"
+#include "wire.h"
 #include "users.h"
-#include "stats.h"
+#include "history_budget.h"
+#include "file_cache.h"
+#include "compress.h"
+#include "latency.h"
+#include "logger.h"
+#include "lock_profile.h"
+#include "flight_recorder.h"
+#include "stats_shards.h"
 #include "parser.h"
 
 /**	Valore speciale utilizzato per far terminare i threads del pool
@@ -146,6 +154,8 @@ void* listener(void* fdsig) {
 						safeTermination();
 						return (void*)1;
 					}
+					//Il descrittore potrebbe essere stato usato da una connessione precedente in formato compatto
+					wire_set_version(fdc, WIRE_V1);
 					//Inserisco il descrittore del nuovo client nel set della select
 					FD_SET(fdc, &set);
 					if (fdc > fd_num) 
@@ -172,31 +182,56 @@ void* listener(void* fdsig) {
                   safeTermination();
                   return (void*)1;
                }
-					//Se è arrivato SIGUSR1 stampo le statistiche sul file StatFileName altrimenti termino
+					//Se è arrivato SIGUSR1 stampo le statistiche sul file StatFileName, se è arrivato SIGUSR2 scrivo le ultime
+					//richieste registrate sul file FlightFileName, altrimenti termino
                if (infosig.ssi_signo == SIGUSR1) {
-						printf("Arrivato segnale SIGUSR1\n");
+						LOGGER(LOGGER_INFO, "Arrivato segnale SIGUSR1");
 						int nreg = 0, nonline = 0;
 						//Recupero il numero di utenti registrati e connessi 
                   num_users_lock(users);
 						get_num_users_reg(users, &(nreg));
                   get_num_users_conn(users, &(nonline));
 						num_users_unlock(users);
+						//Recupero la memoria occupata dalle history
+						unsigned long hbytes = 0, hspilled = 0, hdropped = 0;
+						history_budget_get_stats(&hbytes, &hspilled, &hdropped);
+						//Recupero gli accessi alla cache dei file
+						unsigned long chits = 0, cmisses = 0;
+						file_cache_get_stats(&chits, &cmisses);
+						//Recupero le statistiche della compressione
+						unsigned long cin = 0, cout = 0, cusec = 0;
+						compress_get_stats(&cin, &cout, &cusec);
 						//Aggiorno le statistiche
-                  pthread_mutex_lock(&chattyStatsMtx);
+                  LP_LOCK(LP_STATS, 0, &chattyStatsMtx);
+						stats_shards_collect(&chattyStats);
                   chattyStats.nusers = nreg;
 						chattyStats.nonline = nonline;
-                  pthread_mutex_unlock(&chattyStatsMtx);
-						//Apro il file per stampare le statistiche
+						chattyStats.nhistbytes = hbytes;
+						chattyStats.nhistspilled = hspilled;
+						chattyStats.nhistdropped = hdropped;
+						chattyStats.nfilecachehits = chits;
+						chattyStats.nfilecachemisses = cmisses;
+						chattyStats.ncompressin = cin;
+						chattyStats.ncompressout = cout;
+						chattyStats.ncompressusec = cusec;
+                  LP_UNLOCK(LP_STATS, 0, &chattyStatsMtx);
+						//Apro il file per stampare le statistiche (il profilo delle mutex e gli istogrammi delle latenze precedono la riga delle statistiche)
 		            FILE *f = fopen(StatFileName, "ab");
-                  pthread_mutex_lock(&chattyStatsMtx);
-		            if (f == NULL || printStats(f) == -1) {
-                     pthread_mutex_unlock(&chattyStatsMtx);
+                  LP_LOCK(LP_STATS, 0, &chattyStatsMtx);
+		            if (f == NULL || lock_profile_print(f) == -1 || latency_print(f) == -1 || printStats(f) == -1) {
+                     LP_UNLOCK(LP_STATS, 0, &chattyStatsMtx);
                      safeTermination();
                      return (void*)1;
                   }
-                  pthread_mutex_unlock(&chattyStatsMtx);
+                  LP_UNLOCK(LP_STATS, 0, &chattyStatsMtx);
 		            if (f) fclose(f);
 	            }
+					else if (infosig.ssi_signo == SIGUSR2) {
+						LOGGER(LOGGER_INFO, "Arrivato segnale SIGUSR2");
+						//La scrittura avviene in background: il listener continua a servire le connessioni
+						if (flight_dump_async(FlightFileName, "SIGUSR2") == -1)
+							LOGGER(LOGGER_WARN, "Errore nell'avvio della scrittura del flight recorder su %s", FlightFileName);
+					}
                else {
 					   safeTermination();
 					   return (void*)0;
@@ -220,6 +255,7 @@ void* listener(void* fdsig) {
 						return (void*)1;
 					}
 					*data = fd;
+					latency_enqueued(fd);
 					pushQueue(codaFd, data);
 				}
 			}
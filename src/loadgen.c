@@ -0,0 +1,835 @@
+
+/** \file loadgen.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+/**   Generatore di carico multi-thread per chatty
+ *    Simula molti utenti connessi contemporaneamente (una connessione per utente, aperta con l'interfaccia di
+ *    connections.c) distribuiti tra più thread. Ogni thread esegue richieste per i propri utenti, scelti a turno,
+ *    secondo un mix di operazioni configurabile:
+ *       ciclo chiuso (-r 0, default): ogni thread ha una sola richiesta in corso, la concorrenza è il numero di thread
+ *       ciclo aperto (-r R):          le richieste arrivano R volte al secondo in totale (intervalli esponenziali)
+ *                                     e la latenza viene misurata dall'istante di arrivo previsto, così un server
+ *                                     lento non riduce il carico offerto
+ *    Al termine stampa, per ogni operazione: richieste completate, fallite, throughput e percentili della latenza.
+ *
+ *    Operazioni del mix (-m): txt (POSTTXT), all (POSTTXTALL), file (POSTFILE), get (GETFILE), prev (GETPREVMSGS),
+ *    list (USRLIST), range (GETFILERANGE, anche oltre la fine del file), upload (caricamento a blocchi completo),
+ *    begin (UPLOADBEGIN lasciato aperto, scade sul server) e batch (POSTTXTBATCH di LG_BATCH_SIZE messaggi).
+ *
+ *    Le connessioni usano il formato dei frame scelto con -w (WIRE_V1, WIRE_V2 o WIRE_V2_LZ, vedere wire.h), chiesto
+ *    al server con la registrazione (o la connessione) di ogni utente. In WIRE_V2_LZ il generatore comprime i
+ *    contenuti di almeno LG_COMPRESS_THRESHOLD byte (i messaggi e i file generati sono comprimibili). In WIRE_V2 e
+ *    WIRE_V2_LZ ogni utente può inviare -q richieste insieme senza attendere le risposte (pipelining): le risposte
+ *    devono arrivare nell'ordine delle richieste e riportarne l'id. I caricamenti a blocchi (upload e begin)
+ *    dipendono dalle risposte e vengono eseguiti dopo le altre.
+ *
+ *    Esempi (il server deve accettare almeno -u connessioni, vedere MaxConnections):
+ *       ./loadgen -l /tmp/chatty_socket -u 1000 -c 8 -d 10 -m txt=70,all=1,file=4,get=5,prev=10,list=10
+ *       ./loadgen -l /tmp/chatty_socket -u 100 -c 4 -d 10 -w v2 -q 8 -m txt=50,batch=10,range=20,upload=10,list=10
+ *       ./loadgen -l /tmp/chatty_socket -u 100 -c 4 -d 10 -w lz -s 500 -f 5000 -m txt=60,file=20,get=20
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <connections.h>
+#include <wire.h>
+#include <parser.h>
+#include <ops.h>
+
+/**	Operazioni generate
+ */
+#define LG_TXT   0
+#define LG_ALL   1
+#define LG_FILE  2
+#define LG_GET   3
+#define LG_PREV  4
+#define LG_LIST  5
+#define LG_RANGE 6
+#define LG_UPLOAD 7
+#define LG_BEGIN 8
+#define LG_BATCH 9
+#define LG_OPS   10
+
+/**	Messaggi di una richiesta POSTTXTBATCH_OP (uno su 8 ad un destinatario non registrato)
+ */
+#define LG_BATCH_SIZE 8
+
+/**	Numero massimo di richieste inviate insieme su una connessione (-q): le richieste e le risposte in sospeso
+ * 	devono stare nei buffer del socket, altrimenti client e server si bloccano a vicenda in scrittura
+ */
+#define LG_MAX_DEPTH 16
+
+/**	Soglia di compressione dei contenuti inviati in WIRE_V2_LZ (vedere CompressThreshold)
+ */
+#define LG_COMPRESS_THRESHOLD 64
+
+/**	Intervallo (millisecondi) dopo il quale un thread in attesa svuota le connessioni dei propri utenti
+ */
+#define LG_SWEEP_MS 10
+
+static const char* lg_names[LG_OPS] = { "POSTTXT", "POSTTXTALL", "POSTFILE", "GETFILE", "GETPREVMSGS", "USRLIST", "GETFILERANGE",
+													 "UPLOAD", "UPLOADBEGIN", "POSTTXTBATCH" };
+static const char* lg_keys[LG_OPS] = { "txt", "all", "file", "get", "prev", "list", "range", "upload", "begin", "batch" };
+
+/**	Latenze (nanosecondi) registrate da un thread per un'operazione
+ */
+typedef struct {
+	unsigned long long* samples;
+	size_t n, cap;
+	unsigned long errors;
+} lg_series_t;
+
+/**	Richiesta inviata in attesa di risposta
+ */
+typedef struct {
+	int op;
+	unsigned long id;				//Id della richiesta (WIRE_V2)
+	file_range_t range;			//Segmento richiesto (LG_RANGE)
+	unsigned int unknown;		//Messaggi a destinatari non registrati, un bit per messaggio (LG_BATCH)
+} lg_pending_t;
+
+/**	Stato di un thread del generatore
+ */
+typedef struct {
+	int id;
+	int nusers;						//Utenti del thread
+	int* user_idx;					//Indici globali degli utenti
+	struct pollfd* pfd;			//Connessioni degli utenti
+	unsigned long* next_id;		//Id dell'ultima richiesta inviata da ogni utente
+	unsigned int seed;
+	lg_series_t series[LG_OPS];
+	int failed;						//1 se il thread si è interrotto per un errore di connessione
+	pthread_t tid;
+} lg_thread_t;
+
+/* parametri */
+static char* sockpath = NULL;
+static int nusers = 100;
+static int nthreads = 4;
+static int duration = 10;
+static double rate = 0;
+static int think_ms = 0;
+static unsigned int msg_size = 100;
+static unsigned int file_size = 1024;
+static unsigned int seed = 1;
+static char prefix[16] = "lg";
+static int wire_format = WIRE_V1;
+static int depth = 1;
+static int weights[LG_OPS] = { 70, 1, 4, 5, 10, 10, 0, 0, 0, 0 };
+static int total_weight = 100;
+
+static char* msg_buf = NULL;		//Testo dei messaggi
+static char* file_buf = NULL;		//Contenuto dei file
+static volatile int stop = 0;
+
+static unsigned long long now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+static void nick_of(int i, char* nick) {
+	snprintf(nick, MAX_NAME_LENGTH+1, "%s%d", prefix, i);
+}
+
+static int record(lg_series_t* s, unsigned long long ns) {
+	if (s -> n == s -> cap) {
+		size_t cap = s -> cap ? 2 * s -> cap : 1024;
+		unsigned long long* tmp = realloc(s -> samples, cap * sizeof(unsigned long long));
+		if (tmp == NULL) return -1;
+		s -> samples = tmp;
+		s -> cap = cap;
+	}
+	s -> samples[s -> n++] = ns;
+	return 0;
+}
+
+/**	Legge e scarta i dati di un messaggio (o di una risposta) il cui header è già stato letto
+ */
+static int skip_data(int fd) {
+	message_data_t data;
+	data.buf = NULL;
+	int k = wire_read_data(fd, &data);
+	if (data.buf) free(data.buf);
+	return (k <= 0) ? -1 : 0;
+}
+
+/**	Legge un messaggio inviato da un altro utente (TXT_MESSAGE o FILE_MESSAGE) e lo scarta
+ */
+static int skip_message(int fd) {
+	message_hdr_t hdr;
+	if (wire_read_header(fd, &hdr) <= 0) return -1;
+	if (hdr.op != TXT_MESSAGE && hdr.op != FILE_MESSAGE) return -1;
+	return skip_data(fd);
+}
+
+/**	Svuota le connessioni degli utenti del thread (tranne skip) dai messaggi in arrivo, aspettando al più timeout_ms.
+ * 	Un utente che non legge riempirebbe il proprio socket e bloccherebbe i thread del server che gli scrivono
+ */
+static int sweep(lg_thread_t* t, int skip, int timeout_ms) {
+	if (poll(t -> pfd, t -> nusers, timeout_ms) <= 0) return 0;
+	for (int i = 0; i < t -> nusers; i++) {
+		if (i == skip || !(t -> pfd[i].revents & (POLLIN | POLLHUP))) continue;
+		if (skip_message(t -> pfd[i].fd) == -1) {
+			fprintf(stderr, "ERRORE: connessione di %s%d chiusa dal server\n", prefix, t -> user_idx[i]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**	Aspetta la risposta alla richiesta id dell'utente i del thread scartando i messaggi in arrivo,
+ * 	ritorna l'op della risposta (-1 in caso di errore o se la risposta non riporta id in WIRE_V2)
+ */
+static int wait_reply(lg_thread_t* t, int i, unsigned long id) {
+	struct pollfd p;
+	message_hdr_t hdr;
+
+	while (1) {
+		p.fd = t -> pfd[i].fd;
+		p.events = POLLIN;
+		p.revents = 0;
+		int r = poll(&p, 1, LG_SWEEP_MS);
+		if (r == -1 && errno != EINTR) return -1;
+		/* NESSUNA RISPOSTA: IL SERVER POTREBBE ESSERE BLOCCATO A SCRIVERE AD UN ALTRO UTENTE DEL THREAD */
+		if (r <= 0) {
+			if (sweep(t, i, 0) == -1) return -1;
+			continue;
+		}
+		if (wire_read_header(p.fd, &hdr) <= 0) return -1;
+		if (hdr.op == TXT_MESSAGE || hdr.op == FILE_MESSAGE) {
+			if (skip_data(p.fd) == -1) return -1;
+			continue;
+		}
+		if (wire_format != WIRE_V1 && wire_get_request_id(p.fd) != id) {
+			fprintf(stderr, "ERRORE: risposta di %s%d con id %lu invece di %lu\n", prefix, t -> user_idx[i], wire_get_request_id(p.fd), id);
+			return -1;
+		}
+		return hdr.op;
+	}
+}
+
+/**	Invia la richiesta msg dell'utente i del thread nel formato della connessione (vedere sendRequest)
+ * 	con un nuovo id, salvato in id
+ */
+static int send_request(lg_thread_t* t, int i, message_t* msg, unsigned long* id) {
+	int fd = t -> pfd[i].fd;
+	*id = ++(t -> next_id[i]);
+	wire_set_request_id(fd, *id);
+	if (wire_send_header(fd, &(msg -> hdr)) == -1 || wire_send_data(fd, &(msg -> data)) == -1) return -1;
+	return 1;
+}
+
+/**	Invia una richiesta di caricamento a blocchi (op) dell'utente i del thread con parte dati buf e legge la risposta,
+ * 	salvando in chunk quella delle richieste riuscite (se chunk != NULL); ritorna l'op della risposta (-1 in caso di errore)
+ */
+static int upload_request(lg_thread_t* t, int i, int op, char* buf, size_t len, upload_chunk_t* chunk) {
+	message_t msg;
+	char nick[MAX_NAME_LENGTH+1];
+	int fd = t -> pfd[i].fd;
+	unsigned long id;
+
+	nick_of(t -> user_idx[i], nick);
+	setHeader(&msg.hdr, op, nick);
+	setData(&msg.data, nick, buf, len);
+	if (send_request(t, i, &msg, &id) == -1) return -1;
+
+	int reply = wait_reply(t, i, id);
+	if (reply != OP_OK || chunk == NULL) return reply;
+	message_data_t data;
+	data.buf = NULL;
+	if (wire_read_data(fd, &data) <= 0 || data.buf == NULL || data.hdr.len != sizeof(upload_chunk_t)) {
+		if (data.buf) free(data.buf);
+		return -1;
+	}
+	memcpy(chunk, data.buf, sizeof(upload_chunk_t));
+	free(data.buf);
+	return reply;
+}
+
+/**	Carica a blocchi il file dell'utente i del thread (inviandolo a se stesso): apre il caricamento, invia il file
+ * 	in 3 blocchi chiedendo la dimensione ricevuta dopo il primo (come per riprendere un caricamento interrotto) e lo
+ * 	chiude. Se complete vale 0 il caricamento viene solo aperto e lasciato scadere.
+ * 	Ritorna 0 in caso di successo, 1 se il server ha risposto con un errore, -1 in caso di errore di connessione
+ */
+static int do_upload(lg_thread_t* t, int i, int complete) {
+	char nick[MAX_NAME_LENGTH+1], filename[MAX_NAME_LENGTH+8];
+	char* req = malloc(sizeof(upload_chunk_t) + file_size);
+	upload_chunk_t chunk, got;
+	int reply, result = 0;
+
+	if (req == NULL) return -1;
+	nick_of(t -> user_idx[i], nick);
+	snprintf(filename, sizeof(filename), "%s.up", nick);
+
+	reply = upload_request(t, i, UPLOADBEGIN_OP, filename, strlen(filename)+1, &got);
+	if (reply != OP_OK || got.offset != 0 || !complete) {
+		free(req);
+		return (reply == -1) ? -1 : (reply != OP_OK || got.offset != 0);
+	}
+	chunk.id = got.id;
+
+	unsigned long bounds[4] = { 0, file_size / 3, 2 * (file_size / 3), file_size };
+	for (int k = 0; k < 3 && result == 0; k++) {
+		chunk.offset = bounds[k];
+		memcpy(req, &chunk, sizeof(chunk));
+		memcpy(req + sizeof(chunk), file_buf + bounds[k], bounds[k+1] - bounds[k]);
+		reply = upload_request(t, i, UPLOADCHUNK_OP, req, sizeof(chunk) + bounds[k+1] - bounds[k], &got);
+		if (reply == -1) result = -1;
+		else if (reply != OP_OK || got.id != chunk.id || got.offset != bounds[k+1]) result = 1;
+		/* BLOCCO VUOTO: IL SERVER RISPONDE CON LA DIMENSIONE RICEVUTA */
+		if (result == 0 && k == 0) {
+			reply = upload_request(t, i, UPLOADCHUNK_OP, (char*)&chunk, sizeof(chunk), &got);
+			if (reply == -1) result = -1;
+			else if (reply != OP_OK || got.offset != bounds[1]) result = 1;
+		}
+	}
+	if (result == 0) {
+		chunk.offset = file_size;
+		reply = upload_request(t, i, UPLOADCOMMIT_OP, (char*)&chunk, sizeof(chunk), NULL);
+		if (reply == -1) result = -1;
+		else if (reply != OP_OK) result = 1;
+	}
+	free(req);
+
+	return result;
+}
+
+/**	Invia la richiesta op (non di caricamento a blocchi) dell'utente i del thread, salvandola in p,
+ * 	ritorna -1 in caso di errore di connessione, 0 altrimenti
+ */
+static int send_op(lg_thread_t* t, int i, int op, lg_pending_t* p) {
+	message_t msg;
+	char nick[MAX_NAME_LENGTH+1], receiver[MAX_NAME_LENGTH+1], filename[MAX_NAME_LENGTH+8];
+	char range_req[sizeof(file_range_t) + MAX_NAME_LENGTH+8];
+	file_range_t range;
+	char* batch_req = NULL;
+	int fd = t -> pfd[i].fd;
+
+	memset(&range, 0, sizeof(range));
+	p -> unknown = 0;
+	nick_of(t -> user_idx[i], nick);
+	nick_of(rand_r(&(t -> seed)) % nusers, receiver);
+	snprintf(filename, sizeof(filename), "%s.bin", nick);
+
+	switch (op) {
+		case LG_TXT:
+			setHeader(&msg.hdr, POSTTXT_OP, nick);
+			setData(&msg.data, receiver, msg_buf, msg_size);
+			break;
+		case LG_ALL:
+			setHeader(&msg.hdr, POSTTXTALL_OP, nick);
+			setData(&msg.data, "", msg_buf, msg_size);
+			break;
+		/* OGNI UTENTE INVIA A SE STESSO IL PROPRIO FILE, CHE POI SCARICA CON GETFILE */
+		case LG_FILE:
+			setHeader(&msg.hdr, POSTFILE_OP, nick);
+			setData(&msg.data, nick, filename, strlen(filename)+1);
+			break;
+		case LG_GET:
+			setHeader(&msg.hdr, GETFILE_OP, nick);
+			setData(&msg.data, "", filename, strlen(filename)+1);
+			break;
+		case LG_PREV:
+			setHeader(&msg.hdr, GETPREVMSGS_OP, nick);
+			setData(&msg.data, "", NULL, 0);
+			break;
+		/* SEGMENTO CASUALE DEL PROPRIO FILE (LUNGHEZZA 0 FINO ALLA FINE), UNA RICHIESTA SU 8 OLTRE LA FINE DEL FILE */
+		case LG_RANGE:
+			if (rand_r(&(t -> seed)) % 8 == 0) range.offset = file_size + 1;
+			else {
+				range.offset = rand_r(&(t -> seed)) % (file_size + 1);
+				range.length = rand_r(&(t -> seed)) % (file_size + 1);
+			}
+			memcpy(range_req, &range, sizeof(range));
+			memcpy(range_req + sizeof(range), filename, strlen(filename)+1);
+			setHeader(&msg.hdr, GETFILERANGE_OP, nick);
+			setData(&msg.data, "", range_req, sizeof(range) + strlen(filename)+1);
+			break;
+		/* LG_BATCH_SIZE MESSAGGI A DESTINATARI CASUALI (VEDERE BATCH_ENTRY_HDR_SIZE IN message.h) */
+		case LG_BATCH: {
+			unsigned int n = LG_BATCH_SIZE;
+			size_t off = sizeof(n);
+			batch_req = malloc(sizeof(n) + n * (BATCH_ENTRY_HDR_SIZE + msg_size));
+			if (batch_req == NULL) return -1;
+			memcpy(batch_req, &n, sizeof(n));
+			for (unsigned int k = 0; k < n; k++) {
+				memset(batch_req + off, '\0', MAX_NAME_LENGTH+1);
+				if (rand_r(&(t -> seed)) % 8 == 0) {
+					snprintf(batch_req + off, MAX_NAME_LENGTH+1, "%s-nessuno", prefix);
+					p -> unknown |= 1U << k;
+				}
+				else nick_of(rand_r(&(t -> seed)) % nusers, batch_req + off);
+				memcpy(batch_req + off + MAX_NAME_LENGTH+1, &msg_size, sizeof(msg_size));
+				memcpy(batch_req + off + BATCH_ENTRY_HDR_SIZE, msg_buf, msg_size);
+				off += BATCH_ENTRY_HDR_SIZE + msg_size;
+			}
+			setHeader(&msg.hdr, POSTTXTBATCH_OP, nick);
+			setData(&msg.data, "", batch_req, off);
+			break;
+		}
+		default:
+			setHeader(&msg.hdr, USRLIST_OP, nick);
+			setData(&msg.data, "", NULL, 0);
+			break;
+	}
+
+	p -> op = op;
+	p -> range = range;
+	int k = send_request(t, i, &msg, &(p -> id));
+	if (batch_req) free(batch_req);
+	if (k == -1) return -1;
+	if (op == LG_FILE) {
+		message_data_t data;
+		setData(&data, "", file_buf, file_size);
+		if (wire_send_data(fd, &data) == -1) return -1;
+	}
+
+	return 0;
+}
+
+/**	Legge la risposta completa alla richiesta p dell'utente i del thread,
+ * 	ritorna 0 in caso di successo, 1 se il server ha risposto con un errore, -1 in caso di errore di connessione
+ */
+static int read_op(lg_thread_t* t, int i, lg_pending_t* p) {
+	int fd = t -> pfd[i].fd;
+	int op = p -> op;
+	file_range_t range = p -> range;
+
+	int reply = wait_reply(t, i, p -> id);
+	if (reply == -1) return -1;
+	/* LA RICHIESTA OLTRE LA FINE DEL FILE DEVE FALLIRE SENZA CHIUDERE LA CONNESSIONE */
+	if (op == LG_RANGE && range.offset > file_size) return (reply == OP_FAIL) ? 0 : 1;
+	if (reply != OP_OK) return 1;
+
+	/* DATI DELLA RISPOSTA */
+	if (op == LG_GET || op == LG_LIST) {
+		if (skip_data(fd) == -1) return -1;
+	}
+	else if (op == LG_RANGE) {
+		/* CONTROLLO IL SEGMENTO RICEVUTO CON IL CONTENUTO DEL FILE CARICATO */
+		message_data_t data;
+		data.buf = NULL;
+		if (wire_read_data(fd, &data) <= 0 || data.buf == NULL || data.hdr.len < sizeof(file_range_t)) {
+			if (data.buf) free(data.buf);
+			return -1;
+		}
+		file_range_t got;
+		memcpy(&got, data.buf, sizeof(got));
+		unsigned long expected = (range.length == 0 || range.length > file_size - range.offset) ? file_size - range.offset : range.length;
+		int ok = got.offset == range.offset && got.length == expected && got.total == file_size &&
+					data.hdr.len == sizeof(file_range_t) + expected && memcmp(data.buf + sizeof(file_range_t), file_buf + range.offset, expected) == 0;
+		free(data.buf);
+		if (!ok) return 1;
+	}
+	else if (op == LG_BATCH) {
+		/* UN ESITO PER MESSAGGIO: OP_NICK_UNKNOWN PER I DESTINATARI NON REGISTRATI, OP_OK PER GLI ALTRI */
+		message_data_t data;
+		data.buf = NULL;
+		if (wire_read_data(fd, &data) <= 0 || data.buf == NULL || data.hdr.len != LG_BATCH_SIZE) {
+			if (data.buf) free(data.buf);
+			return -1;
+		}
+		int ok = 1;
+		for (int k = 0; k < LG_BATCH_SIZE; k++)
+			if ((unsigned char)data.buf[k] != ((p -> unknown & (1U << k)) ? OP_NICK_UNKNOWN : OP_OK)) ok = 0;
+		free(data.buf);
+		if (!ok) return 1;
+	}
+	else if (op == LG_PREV) {
+		message_data_t data;
+		data.buf = NULL;
+		if (wire_read_data(fd, &data) <= 0 || data.buf == NULL) {
+			if (data.buf) free(data.buf);
+			return -1;
+		}
+		size_t nmsgs = *(size_t*)(data.buf);
+		free(data.buf);
+		for (size_t k = 0; k < nmsgs; k++) {
+			message_hdr_t hdr;
+			if (wire_read_header(fd, &hdr) <= 0 || skip_data(fd) == -1) return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**	Esegue la richiesta op dell'utente i del thread attendendo la risposta, stessi valori di ritorno di read_op
+ */
+static int do_request(lg_thread_t* t, int i, int op) {
+	lg_pending_t p;
+	if (op == LG_UPLOAD || op == LG_BEGIN) return do_upload(t, i, op == LG_UPLOAD);
+	if (send_op(t, i, op, &p) == -1) return -1;
+	return read_op(t, i, &p);
+}
+
+/**	Sceglie un'operazione secondo il mix configurato
+ */
+static int pick_op(lg_thread_t* t) {
+	int r = rand_r(&(t -> seed)) % total_weight;
+	for (int op = 0; op < LG_OPS; op++) {
+		if (r < weights[op]) return op;
+		r -= weights[op];
+	}
+	return LG_TXT;
+}
+
+static void* lg_thread(void* arg) {
+	lg_thread_t* t = (lg_thread_t*) arg;
+	unsigned long long start = now_ns(), end = start + (unsigned long long)duration * 1000000000ULL;
+	unsigned long long next = start;
+	double mean_ns = (rate > 0) ? 1e9 * nthreads / rate : 0;	//Intervallo medio tra due arrivi del thread
+	int cur = 0;
+
+	if (t -> nusers == 0) return (void*)0;
+
+	while (!stop) {
+		unsigned long long issue = now_ns();
+		if (issue >= end) break;
+
+		/* CICLO APERTO: ASPETTO L'ARRIVO SUCCESSIVO SVUOTANDO LE CONNESSIONI */
+		if (rate > 0) {
+			if (issue < next) {
+				if (sweep(t, -1, (int)((next - issue) / 1000000)) == -1) {
+					t -> failed = 1;
+					break;
+				}
+				if (now_ns() < next) continue;
+			}
+			issue = next;
+			double u = (rand_r(&(t -> seed)) + 1.0) / ((double)RAND_MAX + 2.0);
+			next += (unsigned long long)(-log(u) * mean_ns);
+		}
+
+		/* INVIO TUTTE LE RICHIESTE DELL'UTENTE E POI LEGGO LE RISPOSTE, NELLO STESSO ORDINE,
+		 * I CARICAMENTI A BLOCCHI VENGONO ESEGUITI DOPO AVER LETTO TUTTE LE RISPOSTE */
+		lg_pending_t p[LG_MAX_DEPTH];
+		int res = 0;
+		for (int k = 0; k < depth && res != -1; k++) {
+			p[k].op = pick_op(t);
+			if (p[k].op != LG_UPLOAD && p[k].op != LG_BEGIN) res = send_op(t, cur, p[k].op, &p[k]);
+		}
+		for (int pass = 0; pass < 2; pass++) {
+			for (int k = 0; k < depth && res != -1; k++) {
+				int op = p[k].op, upload = (op == LG_UPLOAD || op == LG_BEGIN);
+				if (upload != pass) continue;
+				res = upload ? do_upload(t, cur, op == LG_UPLOAD) : read_op(t, cur, &p[k]);
+				if (res == 1) t -> series[op].errors++;
+				else if (res == 0 && record(&(t -> series[op]), now_ns() - issue) == -1) res = -1;
+			}
+		}
+		if (res == -1) {
+			fprintf(stderr, "ERRORE: connessione di %s%d interrotta\n", prefix, t -> user_idx[cur]);
+			t -> failed = 1;
+			break;
+		}
+
+		cur = (cur + 1) % t -> nusers;
+		if (rate == 0 && think_ms > 0) {
+			if (sweep(t, -1, think_ms) == -1) {
+				t -> failed = 1;
+				break;
+			}
+		}
+	}
+
+	return (void*)0;
+}
+
+/**	Chiude la connessione fd riportandola al formato WIRE_V1 (il descrittore può essere riusato)
+ */
+static void close_conn(int fd) {
+	wire_set_version(fd, WIRE_V1);
+	close(fd);
+}
+
+/**	Registra (o connette, se già registrato) l'utente i, ritorna la connessione (-1 in caso di errore).
+ * 	Il server chiude la connessione se la registrazione fallisce ==> la connessione viene riaperta per CONNECT_OP.
+ * 	La richiesta (in WIRE_V1) chiede il formato wire_format, che il server usa dalla risposta in poi
+ */
+static int login(int i) {
+	message_t msg;
+	char nick[MAX_NAME_LENGTH+1];
+	unsigned char first;
+	char* capability = (wire_format == WIRE_V2) ? WIRE_V2_CAPABILITY : (wire_format == WIRE_V2_LZ) ? WIRE_V2_LZ_CAPABILITY : NULL;
+	nick_of(i, nick);
+
+	for (int op = REGISTER_OP; op <= CONNECT_OP; op++) {
+		int fd = openConnection(sockpath, 10, 1);
+		if (fd < 0) return -1;
+		setHeader(&msg.hdr, op, nick);
+		setData(&msg.data, "", capability, capability ? strlen(capability)+1 : 0);
+		if (sendRequest(fd, &msg) == -1) {
+			close(fd);
+			return -1;
+		}
+		/* LA RISPOSTA IN WIRE_V2 INIZIA CON WIRE_V2_MAGIC */
+		if (capability) {
+			if (recv(fd, &first, 1, MSG_PEEK) != 1 || first != WIRE_V2_MAGIC) {
+				fprintf(stderr, "ERRORE: formato %s non accettato dal server\n", capability);
+				close(fd);
+				return -1;
+			}
+			wire_set_version(fd, wire_format);
+			if (wire_get_version(fd) != wire_format) {
+				fprintf(stderr, "ERRORE: descrittore %d oltre FD_SETSIZE, formato %s non utilizzabile\n", fd, capability);
+				close(fd);
+				return -1;
+			}
+		}
+		do {
+			if (wire_read_header(fd, &msg.hdr) <= 0) {
+				close_conn(fd);
+				return -1;
+			}
+			if (msg.hdr.op == TXT_MESSAGE || msg.hdr.op == FILE_MESSAGE) {
+				if (skip_data(fd) == -1) {
+					close_conn(fd);
+					return -1;
+				}
+			}
+		} while (msg.hdr.op == TXT_MESSAGE || msg.hdr.op == FILE_MESSAGE);
+		if (msg.hdr.op == OP_OK && skip_data(fd) == 0) return fd;
+		close_conn(fd);
+		if (msg.hdr.op != OP_NICK_ALREADY) return -1;
+	}
+	return -1;
+}
+
+static int cmp_ull(const void* a, const void* b) {
+	unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+	return (x > y) - (x < y);
+}
+
+/**	Stampa una riga del riepilogo per le latenze s (ordinate) di n richieste completate ed errors fallite
+ */
+static void print_line(const char* name, unsigned long long* s, size_t n, unsigned long errors, double secs) {
+	static const double q[4] = { 0.50, 0.90, 0.99, 0.999 };
+	printf("op %s count %lu errors %lu throughput %.1f", name, (unsigned long)n, errors, n / secs);
+	for (int k = 0; k < 4; k++)
+		printf(" p%g %.1f", q[k] * 100, n ? s[(size_t)(q[k] * (n - 1))] / 1000.0 : 0.0);
+	printf(" max %.1f\n", n ? s[n-1] / 1000.0 : 0.0);
+}
+
+static void report(lg_thread_t* threads, double secs) {
+	unsigned long long* all = NULL;
+	size_t nall = 0;
+	unsigned long errors_all = 0;
+
+	printf("# loadgen: %d utenti, %d thread, %s, %.1f s, latenze in microsecondi\n", nusers, nthreads,
+		(rate > 0) ? "ciclo aperto" : "ciclo chiuso", secs);
+	for (int op = 0; op < LG_OPS; op++) {
+		size_t n = 0;
+		unsigned long errors = 0;
+		for (int t = 0; t < nthreads; t++) {
+			n += threads[t].series[op].n;
+			errors += threads[t].series[op].errors;
+		}
+		if (n == 0 && errors == 0) continue;
+		unsigned long long* s = malloc((n ? n : 1) * sizeof(unsigned long long));
+		unsigned long long* tmp = realloc(all, (nall + n + 1) * sizeof(unsigned long long));
+		if (s == NULL || tmp == NULL) {
+			fprintf(stderr, "ERRORE: memoria esaurita\n");
+			if (s) free(s);
+			if (tmp) free(tmp); else free(all);
+			return;
+		}
+		all = tmp;
+		n = 0;
+		for (int t = 0; t < nthreads; t++) {
+			memcpy(s + n, threads[t].series[op].samples, threads[t].series[op].n * sizeof(unsigned long long));
+			n += threads[t].series[op].n;
+		}
+		memcpy(all + nall, s, n * sizeof(unsigned long long));
+		nall += n;
+		errors_all += errors;
+		qsort(s, n, sizeof(unsigned long long), cmp_ull);
+		print_line(lg_names[op], s, n, errors, secs);
+		free(s);
+	}
+	if (all) {
+		qsort(all, nall, sizeof(unsigned long long), cmp_ull);
+		print_line("ALL", all, nall, errors_all, secs);
+		free(all);
+	}
+}
+
+/**	Legge il mix di operazioni nel formato op=peso[,op=peso...] (le operazioni non indicate hanno peso 0)
+ */
+static int parse_mix(char* mix) {
+	int w[LG_OPS] = { 0 };
+	char* save = NULL;
+	for (char* tok = strtok_r(mix, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		char* eq = strchr(tok, '=');
+		if (!eq) return -1;
+		*eq = '\0';
+		int op;
+		for (op = 0; op < LG_OPS && strcmp(tok, lg_keys[op]) != 0; op++);
+		if (op == LG_OPS || atoi(eq + 1) < 0) return -1;
+		w[op] = atoi(eq + 1);
+	}
+	total_weight = 0;
+	for (int op = 0; op < LG_OPS; op++) {
+		weights[op] = w[op];
+		total_weight += w[op];
+	}
+	return (total_weight > 0) ? 0 : -1;
+}
+
+static void use(const char* name) {
+	fprintf(stderr,
+		"use: %s -l unix_socket_path [-u utenti] [-c thread] [-d secondi] [-r richieste/s] [-z millisecondi]\n"
+		"        [-m mix] [-s byte] [-f byte] [-p prefisso] [-S seme] [-w formato] [-q richieste]\n"
+		"  -u numero di utenti simulati, ognuno con la propria connessione (default 100)\n"
+		"  -c numero di thread, in ciclo chiuso e' il numero di richieste contemporanee (default 4)\n"
+		"  -d durata della misura in secondi (default 10)\n"
+		"  -r richieste al secondo in totale (ciclo aperto), 0 ciclo chiuso (default 0)\n"
+		"  -z pausa tra due richieste di un thread in ciclo chiuso (default 0)\n"
+		"  -m mix delle operazioni op=peso separati da ',' con op tra txt, all, file, get, prev, list, range,\n"
+		"     upload (caricamento a blocchi completo), begin (caricamento aperto e abbandonato) e\n"
+		"     batch (POSTTXTBATCH di %d messaggi) (default txt=70,all=1,file=4,get=5,prev=10,list=10)\n"
+		"  -s dimensione dei messaggi testuali (default 100)\n"
+		"  -f dimensione dei file (default 1024)\n"
+		"  -p prefisso dei nickname degli utenti (default lg)\n"
+		"  -S seme dei numeri casuali (default 1)\n"
+		"  -w formato dei frame: v1, v2 o lz (v2 con compressione) (default v1, vedere wire.h)\n"
+		"  -q richieste inviate insieme da un utente senza attendere le risposte, al piu' %d, solo con -w v2 o lz\n"
+		"     (default 1)\n", name, LG_BATCH_SIZE, LG_MAX_DEPTH);
+}
+
+int main(int argc, char* argv[]) {
+	int opt;
+
+	while ((opt = getopt(argc, argv, "l:u:c:d:r:z:m:s:f:p:S:w:q:h")) != -1) {
+		switch (opt) {
+			case 'l': sockpath = optarg; break;
+			case 'u': nusers = atoi(optarg); break;
+			case 'c': nthreads = atoi(optarg); break;
+			case 'd': duration = atoi(optarg); break;
+			case 'r': rate = atof(optarg); break;
+			case 'z': think_ms = atoi(optarg); break;
+			case 'm':
+				if (parse_mix(optarg) == -1) {
+					fprintf(stderr, "ERRORE: mix non valido\n");
+					return EXIT_FAILURE;
+				}
+				break;
+			case 's': msg_size = (unsigned int)atoi(optarg); break;
+			case 'f': file_size = (unsigned int)atoi(optarg); break;
+			case 'p': strncpy(prefix, optarg, sizeof(prefix)-1); break;
+			case 'S': seed = (unsigned int)atoi(optarg); break;
+			case 'q': depth = atoi(optarg); break;
+			case 'w':
+				if (strcmp(optarg, "v1") == 0) wire_format = WIRE_V1;
+				else if (strcmp(optarg, "v2") == 0) wire_format = WIRE_V2;
+				else if (strcmp(optarg, "lz") == 0) wire_format = WIRE_V2_LZ;
+				else {
+					fprintf(stderr, "ERRORE: formato non valido\n");
+					return EXIT_FAILURE;
+				}
+				break;
+			default: use(argv[0]); return EXIT_FAILURE;
+		}
+	}
+	if (!sockpath || nusers <= 0 || nthreads <= 0 || duration <= 0 || msg_size == 0 || file_size == 0 || rate < 0 ||
+		 depth <= 0 || depth > LG_MAX_DEPTH || (depth > 1 && wire_format == WIRE_V1)) {
+		use(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (nthreads > nusers) nthreads = nusers;
+	if (wire_format == WIRE_V2_LZ) CompressThreshold = LG_COMPRESS_THRESHOLD;
+
+	/* TESTO DEI MESSAGGI (TERMINATO DA '\0') E CONTENUTO DEI FILE */
+	msg_buf = malloc(msg_size);
+	file_buf = malloc(file_size);
+	lg_thread_t* threads = calloc(nthreads, sizeof(lg_thread_t));
+	if (!msg_buf || !file_buf || !threads) {
+		fprintf(stderr, "ERRORE: memoria esaurita\n");
+		return EXIT_FAILURE;
+	}
+	memset(msg_buf, 'x', msg_size);
+	msg_buf[msg_size-1] = '\0';
+	for (unsigned int i = 0; i < file_size; i++) file_buf[i] = (char)(i * 31);
+
+	/* CONNESSIONE DEGLI UTENTI, ASSEGNATI AI THREAD A TURNO */
+	for (int t = 0; t < nthreads; t++) {
+		threads[t].id = t;
+		threads[t].seed = seed + t;
+		threads[t].user_idx = calloc(nusers / nthreads + 1, sizeof(int));
+		threads[t].pfd = calloc(nusers / nthreads + 1, sizeof(struct pollfd));
+		threads[t].next_id = calloc(nusers / nthreads + 1, sizeof(unsigned long));
+		if (!threads[t].user_idx || !threads[t].pfd || !threads[t].next_id) {
+			fprintf(stderr, "ERRORE: memoria esaurita\n");
+			return EXIT_FAILURE;
+		}
+	}
+	for (int i = 0; i < nusers; i++) {
+		lg_thread_t* t = &(threads[i % nthreads]);
+		int fd = login(i);
+		if (fd < 0) {
+			fprintf(stderr, "ERRORE: connessione dell'utente %s%d fallita\n", prefix, i);
+			return EXIT_FAILURE;
+		}
+		t -> user_idx[t -> nusers] = i;
+		t -> pfd[t -> nusers].fd = fd;
+		t -> pfd[t -> nusers].events = POLLIN;
+		t -> nusers++;
+	}
+
+	/* OGNI UTENTE CARICA IL PROPRIO FILE, COSÌ GETFILE E GETFILERANGE HANNO SEMPRE UN FILE DA SCARICARE */
+	if (weights[LG_GET] > 0 || weights[LG_RANGE] > 0) {
+		for (int t = 0; t < nthreads; t++) {
+			for (int i = 0; i < threads[t].nusers; i++) {
+				if (do_request(&(threads[t]), i, LG_FILE) != 0) {
+					fprintf(stderr, "ERRORE: caricamento del file di %s%d fallito\n", prefix, threads[t].user_idx[i]);
+					return EXIT_FAILURE;
+				}
+			}
+		}
+	}
+	fflush(stdout);
+
+	unsigned long long start = now_ns();
+	for (int t = 0; t < nthreads; t++) {
+		if (pthread_create(&(threads[t].tid), NULL, lg_thread, &(threads[t])) != 0) {
+			fprintf(stderr, "ERRORE: creazione del thread %d\n", t);
+			stop = 1;
+			nthreads = t;
+			break;
+		}
+	}
+	for (int t = 0; t < nthreads; t++)
+		pthread_join(threads[t].tid, NULL);
+	double secs = (now_ns() - start) / 1e9;
+
+	report(threads, secs);
+
+	/* UNA CONNESSIONE INTERROTTA (ANCHE PER UNA RISPOSTA FUORI ORDINE) FA FALLIRE LA MISURA */
+	int failed = 0;
+
+	for (int t = 0; t < nthreads; t++) {
+		failed |= threads[t].failed;
+		for (int i = 0; i < threads[t].nusers; i++) close_conn(threads[t].pfd[i].fd);
+		for (int op = 0; op < LG_OPS; op++) free(threads[t].series[op].samples);
+		free(threads[t].user_idx);
+		free(threads[t].pfd);
+		free(threads[t].next_id);
+	}
+	free(threads);
+	free(msg_buf);
+	free(file_buf);
+	return failed ? EXIT_FAILURE : 0;
+}
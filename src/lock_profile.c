@@ -0,0 +1,188 @@
+
+/** \file lock_profile.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "lock_profile.h"
+
+#ifdef LOCK_PROFILE
+
+#include "latency.h"
+
+/**	Stripe distinte per famiglia (le stripe oltre LP_MAX_STRIPES condividono i contatori) e stripe stampate per famiglia
+ */
+#define LP_MAX_STRIPES 4096
+#define LP_TOP 4
+
+/**	Mutex profilate possedute contemporaneamente da un thread di cui viene misurato il tempo di possesso
+ *	(users_table_lock_all acquisisce tutte le stripe della tabella degli utenti)
+ */
+#define LP_MAX_HELD 64
+
+/**	Contatori di una stripe, aggiornati senza mutex
+ */
+typedef struct {
+	unsigned long acquisitions;
+	unsigned long contended;
+	unsigned long long wait_ns;
+	unsigned long long max_wait_ns;
+	unsigned long long hold_ns;
+} lp_stripe_t;
+
+/**	Istante di acquisizione di una mutex posseduta dal thread
+ */
+typedef struct {
+	pthread_mutex_t* mtx;
+	unsigned long long acquired_at;
+} lp_held_t;
+
+/**	Nomi delle famiglie (nell'ordine dei codici di lock_profile.h)
+ */
+static const char* family_names[LP_FAMILIES] = {
+	"users", "users_all", "fd_to_nick", "num_users", "groups", "fd", "users_list", "stats", "queue",
+	"budget", "cache", "store", "uploads", "io"
+};
+
+static lp_stripe_t stripes[LP_FAMILIES][LP_MAX_STRIPES];
+
+/* ISTANTI DI ACQUISIZIONE DEL THREAD, ASSOCIATI ALLA MUTEX E NON ALLA STRIPE: LE STRIPE OLTRE LP_MAX_STRIPES
+ * CONDIVIDONO SOLO I CONTATORI */
+static __thread lp_held_t held[LP_MAX_HELD];
+static __thread int num_held = 0;
+
+static lp_stripe_t* get_stripe(int family, int stripe) {
+	if (stripe < 0) stripe = 0;
+	return &(stripes[family][stripe % LP_MAX_STRIPES]);
+}
+
+/**	Registra l'istante di acquisizione di mtx (se il thread possiede già LP_MAX_HELD mutex il possesso non viene misurato)
+ */
+static void push_held(pthread_mutex_t* mtx) {
+	if (num_held == LP_MAX_HELD) return;
+	held[num_held].mtx = mtx;
+	held[num_held].acquired_at = latency_now();
+	num_held++;
+}
+
+/**	Rimuove mtx dalle mutex possedute dal thread, ritorna il suo istante di acquisizione o 0 se non registrato
+ */
+static unsigned long long pop_held(pthread_mutex_t* mtx) {
+	/* LE MUTEX VENGONO DI SOLITO RILASCIATE IN ORDINE INVERSO: CERCO DALL'ULTIMA */
+	for (int i = num_held - 1; i >= 0; i--) {
+		if (held[i].mtx != mtx) continue;
+		unsigned long long at = held[i].acquired_at;
+		memmove(held + i, held + i + 1, (num_held - i - 1) * sizeof(lp_held_t));
+		num_held--;
+		return at;
+	}
+	return 0;
+}
+
+/**	Aggiunge alla stripe s il tempo di possesso di mtx fino ad ora
+ */
+static void add_hold(lp_stripe_t* s, pthread_mutex_t* mtx) {
+	unsigned long long at = pop_held(mtx), now = latency_now();
+	if (at != 0 && now >= at)
+		__sync_fetch_and_add(&(s -> hold_ns), now - at);
+}
+
+/**	Aggiorna il massimo *max con v
+ */
+static void update_max(unsigned long long* max, unsigned long long v) {
+	unsigned long long old;
+	while ((old = *max) < v && !__sync_bool_compare_and_swap(max, old, v));
+}
+
+void lock_profile_lock(int family, int stripe, pthread_mutex_t* mtx) {
+	lp_stripe_t* s = get_stripe(family, stripe);
+
+	/* L'ATTESA VIENE MISURATA SOLO SE LA MUTEX È OCCUPATA */
+	if (pthread_mutex_trylock(mtx) != 0) {
+		unsigned long long start = latency_now();
+		pthread_mutex_lock(mtx);
+		unsigned long long wait = latency_now() - start;
+		__sync_fetch_and_add(&(s -> contended), 1);
+		__sync_fetch_and_add(&(s -> wait_ns), wait);
+		update_max(&(s -> max_wait_ns), wait);
+	}
+	__sync_fetch_and_add(&(s -> acquisitions), 1);
+	push_held(mtx);
+}
+
+void lock_profile_unlock(int family, int stripe, pthread_mutex_t* mtx) {
+	add_hold(get_stripe(family, stripe), mtx);
+	pthread_mutex_unlock(mtx);
+}
+
+void lock_profile_cond_wait(int family, int stripe, pthread_cond_t* cond, pthread_mutex_t* mtx) {
+	add_hold(get_stripe(family, stripe), mtx);
+	pthread_cond_wait(cond, mtx);
+	push_held(mtx);
+}
+
+int lock_profile_print(FILE* fout) {
+	lp_stripe_t copy, total;
+	int top[LP_TOP];
+	unsigned long long top_wait[LP_TOP];
+	unsigned long t = (unsigned long)time(NULL);
+
+	for (int f = 0; f < LP_FAMILIES; f++) {
+		memset(&total, 0, sizeof(total));
+		for (int i = 0; i < LP_TOP; i++) {
+			top[i] = -1;
+			top_wait[i] = 0;
+		}
+
+		for (int i = 0; i < LP_MAX_STRIPES; i++) {
+			copy.acquisitions = __sync_add_and_fetch(&(stripes[f][i].acquisitions), 0);
+			if (copy.acquisitions == 0) continue;
+			copy.contended = __sync_add_and_fetch(&(stripes[f][i].contended), 0);
+			copy.wait_ns = __sync_add_and_fetch(&(stripes[f][i].wait_ns), 0);
+			copy.max_wait_ns = __sync_add_and_fetch(&(stripes[f][i].max_wait_ns), 0);
+			copy.hold_ns = __sync_add_and_fetch(&(stripes[f][i].hold_ns), 0);
+			total.acquisitions += copy.acquisitions;
+			total.contended += copy.contended;
+			total.wait_ns += copy.wait_ns;
+			total.hold_ns += copy.hold_ns;
+			if (copy.max_wait_ns > total.max_wait_ns) total.max_wait_ns = copy.max_wait_ns;
+
+			/* INSERIMENTO ORDINATO TRA LE LP_TOP STRIPE CON ATTESA MAGGIORE */
+			if (copy.wait_ns == 0) continue;
+			for (int j = 0; j < LP_TOP; j++) {
+				if (top[j] == -1 || copy.wait_ns > top_wait[j]) {
+					memmove(top + j + 1, top + j, (LP_TOP - j - 1) * sizeof(int));
+					memmove(top_wait + j + 1, top_wait + j, (LP_TOP - j - 1) * sizeof(unsigned long long));
+					top[j] = i;
+					top_wait[j] = copy.wait_ns;
+					break;
+				}
+			}
+		}
+		if (total.acquisitions == 0) continue;
+
+		if (fprintf(fout, "%lu - lock %s %lu contended %lu wait %llu maxwait %llu hold %llu\n", t, family_names[f],
+			total.acquisitions, total.contended, total.wait_ns, total.max_wait_ns, total.hold_ns) < 0) return -1;
+		for (int j = 0; j < LP_TOP && top[j] != -1; j++) {
+			lp_stripe_t* s = &(stripes[f][top[j]]);
+			if (fprintf(fout, "%lu - lockstripe %s %d %lu contended %lu wait %llu maxwait %llu hold %llu\n", t, family_names[f], top[j],
+				s -> acquisitions, s -> contended, s -> wait_ns, s -> max_wait_ns, s -> hold_ns) < 0) return -1;
+		}
+	}
+
+	return 0;
+}
+
+#else
+
+int lock_profile_print(FILE* fout) {
+	return 0;
+}
+
+#endif /* LOCK_PROFILE */
@@ -0,0 +1,74 @@
+
+/** \file lock_profile.h
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#if !defined(LOCK_PROFILE_H_)
+#define LOCK_PROFILE_H_
+
+#include <stdio.h>
+#include <pthread.h>
+
+/**   Profilo della contesa sulle mutex (opzionale, compilando con -DLOCK_PROFILE, vedere il Makefile)
+ *    Le acquisizioni delle famiglie di mutex elencate sotto passano per le macro LP_LOCK/LP_UNLOCK, che registrano
+ *    per ogni famiglia e per ogni stripe (indice della mutex nella famiglia): numero di acquisizioni, acquisizioni
+ *    trovate occupate, tempo di attesa (solo per le acquisizioni contese) e tempo di possesso, in nanosecondi.
+ *    Senza -DLOCK_PROFILE le macro coincidono con pthread_mutex_lock/pthread_mutex_unlock e non c'è alcun costo.
+ *    I risultati vengono stampati nel file delle statistiche (SIGUSR1) prima della riga delle statistiche.
+ */
+
+/**   Famiglie di mutex profilate
+ */
+#define LP_USERS        0     //Stripe della tabella degli utenti registrati (users_table_lock, users_table_lock_block)
+#define LP_USERS_ALL    1     //Stripe della tabella degli utenti acquisite tutte insieme (users_table_lock_all)
+#define LP_FD_TO_NICK   2     //Stripe della tabella descrittore -> nickname
+#define LP_NUM_USERS    3     //Contatori degli utenti (mtx_num_users)
+#define LP_GROUPS       4     //Creazione dei gruppi (mtx_groups)
+#define LP_FD           5     //Scritture sui descrittori dei client (fd_mtx)
+#define LP_USERS_LIST   6     //Stringa degli utenti connessi
+#define LP_STATS        7     //Statistiche del server (chattyStatsMtx)
+#define LP_QUEUE        8     //Coda dei descrittori (qlock)
+#define LP_BUDGET       9     //Budget di memoria delle history (budget_mtx)
+#define LP_CACHE        10    //Cache dei file (cache_mtx)
+#define LP_STORE        11    //Stripe dello store dei file
+#define LP_UPLOADS      12    //Tabella dei caricamenti a blocchi (uploads_mtx)
+#define LP_IO           13    //Coda dello stadio di I/O su disco (io_mtx)
+#define LP_FAMILIES     14
+
+#ifdef LOCK_PROFILE
+#define LP_LOCK(family, stripe, mtx)         lock_profile_lock((family), (stripe), (mtx))
+#define LP_UNLOCK(family, stripe, mtx)       lock_profile_unlock((family), (stripe), (mtx))
+#define LP_COND_WAIT(family, stripe, cond, mtx) lock_profile_cond_wait((family), (stripe), (cond), (mtx))
+#else
+#define LP_LOCK(family, stripe, mtx)         pthread_mutex_lock(mtx)
+#define LP_UNLOCK(family, stripe, mtx)       pthread_mutex_unlock(mtx)
+#define LP_COND_WAIT(family, stripe, cond, mtx) pthread_cond_wait((cond), (mtx))
+#endif
+
+/**   Acquisisce la mutex mtx (stripe stripe della famiglia family) registrando l'eventuale attesa (usare LP_LOCK)
+ */
+void lock_profile_lock(int family, int stripe, pthread_mutex_t* mtx);
+
+/**   Rilascia la mutex mtx registrando il tempo di possesso (usare LP_UNLOCK)
+ */
+void lock_profile_unlock(int family, int stripe, pthread_mutex_t* mtx);
+
+/**   Attende la condizione cond rilasciando mtx: l'attesa della condizione non viene contata come tempo di
+ *    possesso nè come contesa (usare LP_COND_WAIT)
+ */
+void lock_profile_cond_wait(int family, int stripe, pthread_cond_t* cond, pthread_mutex_t* mtx);
+
+/**   Stampa sul file fout una riga per ogni famiglia acquisita almeno una volta:
+ *    <tempo> - lock <famiglia> <acquisizioni> contended <contese> wait <ns> maxwait <ns> hold <ns>
+ *    seguita da una riga per ognuna delle (al più LP_TOP) stripe con attesa totale maggiore:
+ *    <tempo> - lockstripe <famiglia> <stripe> <acquisizioni> contended <contese> wait <ns> maxwait <ns> hold <ns>
+ *    Senza -DLOCK_PROFILE non stampa nulla.
+ *
+ *    \param fout:      file aperto in append
+ *    \return:          0 in caso di successo, -1 in caso di errore di scrittura
+ */
+int lock_profile_print(FILE* fout);
+
+#endif /* LOCK_PROFILE_H_ */
@@ -0,0 +1,171 @@
+
+/** \file logger.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <time.h>
+#include "logger.h"
+
+/**	Righe del buffer circolare di ogni thread e lunghezza massima di una riga (le righe più lunghe vengono troncate)
+ */
+#define LOGGER_RING_SLOTS 256
+#define LOGGER_LINE_MAX 256
+
+/**	Intervallo (millisecondi) tra due raccolte del thread del log
+ */
+#define LOGGER_FLUSH_MS 20
+
+/**	Buffer circolare di un thread: head viene incrementato solo dal thread proprietario, tail solo dal thread del log
+ */
+typedef struct log_ring {
+	char lines[LOGGER_RING_SLOTS][LOGGER_LINE_MAX];
+	volatile unsigned long head;			//Righe scritte
+	volatile unsigned long tail;			//Righe raccolte
+	volatile unsigned long dropped;		//Righe scartate perchè il buffer era pieno
+	unsigned long reported;				//Righe scartate già segnalate nel log
+	int id;									//Identificativo del thread
+	struct log_ring* next;
+} log_ring_t;
+
+int logger_level = LOGGER_INFO;
+
+static const char* level_names[] = { "error", "warn", "info", "debug" };
+static log_ring_t* volatile rings = NULL;			//Lista dei buffer dei thread
+static int next_id = 0;									//Identificativo del prossimo thread
+static __thread log_ring_t* my_ring = NULL;			//Buffer del thread
+static volatile int running = 0;
+static volatile int stop = 0;
+static pthread_t logger_thread;
+
+/**	Scrive in line l'intestazione e il messaggio della riga, terminata da '\n'
+ */
+static void format_line(char* line, int id, int level, const char* fmt, va_list ap) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	int n = snprintf(line, LOGGER_LINE_MAX, "ts=%ld.%06ld level=%s thread=%d ", (long)ts.tv_sec, ts.tv_nsec/1000, level_names[level], id);
+	if (n < 0 || n >= LOGGER_LINE_MAX - 1) n = 0;
+	vsnprintf(line + n, LOGGER_LINE_MAX - n, fmt, ap);
+	size_t len = strlen(line);
+	if (len == LOGGER_LINE_MAX - 1) len--;
+	if (len == 0 || line[len-1] != '\n') {
+		line[len] = '\n';
+		line[len+1] = '\0';
+	}
+}
+
+/**	Crea il buffer del thread chiamante e lo inserisce nella lista, ritorna NULL in caso di errore di allocazione
+ */
+static log_ring_t* register_ring() {
+	log_ring_t* ring = (log_ring_t*) calloc(1, sizeof(log_ring_t));
+	if (ring == NULL) return NULL;
+	ring -> id = __sync_fetch_and_add(&next_id, 1);
+	/* INSERIMENTO IN TESTA SENZA MUTEX */
+	do {
+		ring -> next = rings;
+	} while (!__sync_bool_compare_and_swap(&rings, ring -> next, ring));
+	return ring;
+}
+
+/**	Scrive su stdout le righe di tutti i buffer, ritorna il numero di righe scritte
+ */
+static int drain() {
+	int n = 0;
+	for (log_ring_t* ring = rings; ring != NULL; ring = ring -> next) {
+		unsigned long tail = ring -> tail, head = ring -> head;
+		__sync_synchronize();
+		for (; tail != head; tail++, n++)
+			fputs(ring -> lines[tail % LOGGER_RING_SLOTS], stdout);
+		/* IL PRODUTTORE PUÒ RIUSARE LE RIGHE SOLO DOPO CHE SONO STATE SCRITTE */
+		__sync_synchronize();
+		ring -> tail = tail;
+		unsigned long dropped = ring -> dropped;
+		if (dropped != ring -> reported) {
+			struct timespec ts;
+			clock_gettime(CLOCK_REALTIME, &ts);
+			fprintf(stdout, "ts=%ld.%06ld level=warn thread=%d %lu righe del log perse\n", (long)ts.tv_sec, ts.tv_nsec/1000, ring -> id, dropped - ring -> reported);
+			ring -> reported = dropped;
+		}
+	}
+	if (n > 0) fflush(stdout);
+	return n;
+}
+
+static void* logger_func(void* arg) {
+	struct timespec ts;
+	ts.tv_sec = 0;
+	ts.tv_nsec = LOGGER_FLUSH_MS * 1000000L;
+
+	while (!stop) {
+		drain();
+		nanosleep(&ts, NULL);
+	}
+	drain();
+
+	return (void*)0;
+}
+
+int logger_init(int level) {
+	logger_level = level;
+	stop = 0;
+	if (pthread_create(&logger_thread, NULL, logger_func, NULL) != 0)
+		return -1;
+	running = 1;
+	return 0;
+}
+
+void logger_destroy() {
+	if (!running) return;
+
+	stop = 1;
+	pthread_join(logger_thread, NULL);
+	running = 0;
+
+	log_ring_t* ring = rings;
+	rings = NULL;
+	while (ring != NULL) {
+		log_ring_t* next = ring -> next;
+		free(ring);
+		ring = next;
+	}
+	/* IL BUFFER DEL THREAD CHIAMANTE NON ESISTE PIÙ */
+	my_ring = NULL;
+}
+
+void logger_write(int level, const char* fmt, ...) {
+	va_list ap;
+	char line[LOGGER_LINE_MAX];
+
+	if (level < LOGGER_ERROR || level > LOGGER_DEBUG) return;
+
+	if (running && my_ring == NULL) my_ring = register_ring();
+
+	/* THREAD DEL LOG NON ATTIVO (O BUFFER NON ALLOCATO) ==> SCRIVO DIRETTAMENTE */
+	if (!running || my_ring == NULL) {
+		va_start(ap, fmt);
+		format_line(line, -1, level, fmt, ap);
+		va_end(ap);
+		fputs(line, stdout);
+		fflush(stdout);
+		return;
+	}
+
+	unsigned long head = my_ring -> head;
+	if (head - my_ring -> tail >= LOGGER_RING_SLOTS) {
+		my_ring -> dropped++;
+		return;
+	}
+	va_start(ap, fmt);
+	format_line(my_ring -> lines[head % LOGGER_RING_SLOTS], my_ring -> id, level, fmt, ap);
+	va_end(ap);
+	/* LA RIGA DEVE ESSERE COMPLETA PRIMA CHE IL THREAD DEL LOG VEDA IL NUOVO head */
+	__sync_synchronize();
+	my_ring -> head = head + 1;
+}
@@ -0,0 +1,59 @@
+
+/** \file logger.h
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#if !defined(LOGGER_H_)
+#define LOGGER_H_
+
+/**   Log asincrono a livelli
+ *    Ogni thread scrive le proprie righe, senza mutex, in un buffer circolare privato; un thread dedicato
+ *    le raccoglie periodicamente e le scrive sullo standard output nel formato
+ *       ts=<secondi>.<microsecondi> level=<livello> thread=<id> <messaggio>
+ *    Se il buffer di un thread è pieno la riga viene scartata (il numero di righe perse viene scritto nel log).
+ *    Le righe con livello superiore a quello configurato (LogLevel, di default LOGGER_INFO) costano solo un
+ *    confronto; quelle con livello superiore a LOGGER_MAX_LEVEL vengono eliminate a tempo di compilazione
+ *    (ad esempio -DLOGGER_MAX_LEVEL=2 elimina i messaggi di debug, scritti per ogni richiesta gestita).
+ */
+
+#define LOGGER_ERROR 0
+#define LOGGER_WARN  1
+#define LOGGER_INFO  2
+#define LOGGER_DEBUG 3
+
+#ifndef LOGGER_MAX_LEVEL
+#define LOGGER_MAX_LEVEL LOGGER_DEBUG
+#endif
+
+/**   Livello massimo delle righe scritte (configurabile a tempo di esecuzione)
+ */
+extern int logger_level;
+
+/**   Scrive una riga di livello level con formato e argomenti come printf (il '\n' finale è facoltativo)
+ */
+#define LOGGER(level, ...)                                                  \
+   do {                                                                     \
+      if ((level) <= LOGGER_MAX_LEVEL && (level) <= logger_level)          \
+         logger_write((level), __VA_ARGS__);                                \
+   } while (0)
+
+/**   Avvia il thread che scrive il log, deve essere chiamata da un solo thread (tipicamente il thread main).
+ *    Prima dell'avvio e dopo la terminazione le righe vengono scritte direttamente dal chiamante
+ *
+ *    \param level:     livello massimo delle righe scritte
+ *    \return:          0 in caso di successo, -1 se non è stato possibile creare il thread
+ */
+int logger_init(int level);
+
+/**   Scrive le righe rimaste, termina il thread del log e dealloca i buffer, deve essere chiamata da un solo
+ *    thread quando gli altri thread hanno terminato
+ */
+void logger_destroy();
+
+/**   Scrive una riga nel buffer del thread chiamante (usare la macro LOGGER)
+ */
+void logger_write(int level, const char* fmt, ...);
+
+#endif /* LOGGER_H_ */
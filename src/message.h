@@ -68,6 +68,81 @@ typedef struct {
     message_data_t data;
 } message_t;
 
+/**
+ *  @struct history_cursor
+ *  @brief parte dati della richiesta GETPREVMSGS_AFTER_OP
+ *
+ *  @var after_seq vengono restituiti i messaggi con numero di sequenza maggiore di after_seq
+ *  @var max_msgs numero massimo di messaggi restituiti (0 nessun limite)
+ */
+typedef struct {
+    unsigned long after_seq;
+    unsigned long max_msgs;
+} history_cursor_t;
+
+/**
+ *  @struct history_page
+ *  @brief parte dati della risposta OP_OK a GETPREVMSGS_AFTER_OP,
+ *         seguita da nmsgs messaggi (i numeri di sequenza sono consecutivi a partire da first_seq)
+ *
+ *  @var nmsgs numero di messaggi che seguono la risposta
+ *  @var first_seq numero di sequenza del primo messaggio inviato
+ *  @var last_seq numero di sequenza dell'ultimo messaggio inviato (cursore per la richiesta successiva)
+ *  @var latest_seq numero di sequenza dell'ultimo messaggio presente nella history
+ */
+typedef struct {
+    unsigned long nmsgs;
+    unsigned long first_seq;
+    unsigned long last_seq;
+    unsigned long latest_seq;
+} history_page_t;
+
+/**
+ *  @brief parte dati della richiesta POSTTXTMULTI_OP:
+ *         [numero di destinatari n (unsigned int)][n nickname di MAX_NAME_LENGTH+1 byte][testo del messaggio]
+ *         la risposta OP_OK contiene una bitmap di MULTI_STATUS_SIZE(n) byte, il bit i (bit i%8 del byte i/8)
+ *         vale 1 se e solo se il destinatario i e' registrato (messaggio consegnato o inserito nella history)
+ */
+#define MULTI_HDR_SIZE(n)     (sizeof(unsigned int) + (n)*(MAX_NAME_LENGTH+1))
+#define MULTI_STATUS_SIZE(n)  (((n)+7)/8)
+
+/**
+ *  @brief parte dati della richiesta POSTTXTBATCH_OP: [numero di messaggi n (unsigned int)] seguito da n elementi
+ *         [destinatario di MAX_NAME_LENGTH+1 byte][lunghezza len del testo (unsigned int)][testo di len byte terminato da '\0']
+ *         la risposta OP_OK contiene n byte, il byte i e' l'esito del messaggio i (OP_OK, OP_NICK_UNKNOWN o OP_MSG_TOOLONG,
+ *         OP_FAIL se il messaggio ad un gruppo non e' stato consegnato per un errore del server)
+ */
+#define BATCH_ENTRY_HDR_SIZE  (MAX_NAME_LENGTH+1 + sizeof(unsigned int))
+
+/**
+ *  @struct file_range
+ *  @brief parte dati della richiesta GETFILERANGE_OP (seguita dal nome del file terminato da '\0')
+ *         e della risposta OP_OK (seguita dai length byte del file a partire da offset)
+ *
+ *  @var offset posizione del primo byte del segmento
+ *  @var length lunghezza del segmento (nella richiesta 0 indica fino alla fine del file)
+ *  @var total dimensione totale del file (significativo solo nella risposta)
+ */
+typedef struct {
+    unsigned long offset;
+    unsigned long length;
+    unsigned long total;
+} file_range_t;
+
+/**
+ *  @struct upload_chunk
+ *  @brief parte dati delle richieste UPLOADCHUNK_OP (seguita dai byte del blocco) e UPLOADCOMMIT_OP
+ *         e delle risposte alle richieste UPLOADBEGIN_OP e UPLOADCHUNK_OP
+ *
+ *  @var id identificativo del caricamento
+ *  @var offset posizione del blocco (UPLOADCHUNK_OP), dimensione totale del file (UPLOADCOMMIT_OP)
+ *              o numero di byte ricevuti dal server (risposte)
+ */
+typedef struct {
+    unsigned long id;
+    unsigned long offset;
+} upload_chunk_t;
+
 /* ------ funzioni di utilità ------- */
 
 /**
@@ -0,0 +1,415 @@
+
+/** \file microbench.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+/**   Microbenchmark delle strutture dati del server (make bench)
+ *    Misura, per ogni numero di thread richiesto:
+ *       icl_hash:      insert, find e delete di -n chiavi (una tabella per thread, come le stripe di users)
+ *       bqueue:        push, iterazione e pop di -n elementi (una coda per thread, come le history)
+ *       queue:         push e pop di -n elementi per thread sulla coda dei descrittori condivisa
+ *                      (metà dei thread inseriscono e metà estraggono)
+ *       users_list:    insert e remove di -k nickname per thread nella lista condivisa che contiene già
+ *                      10000, 50000 e 100000 utenti (-u)
+ *       history_msg:   init_history_message e free_history_message di -n messaggi per thread
+ *    I risultati vengono stampati sullo standard output in formato CSV, una riga per fase:
+ *       benchmark,phase,threads,param,ops,seconds,ns_per_op,ops_per_sec
+ *    dove ns_per_op è il tempo reale diviso per le operazioni di tutti i thread.
+ *    Con -b file i risultati vengono confrontati con un CSV precedente: le fasi più lente di oltre -r per cento
+ *    vengono segnalate sullo standard error e il programma termina con codice 2.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <pthread.h>
+#include "icl_hash.h"
+#include "boundedqueue.h"
+#include "queue.h"
+#include "users_list.h"
+#include "history_msg.h"
+#include "message.h"
+#include "ops.h"
+
+#define MB_MAX_THREADS 64
+#define MB_MAX_RESULTS 256
+#define MB_HASH_BUCKETS 1024
+
+/**	Risultato di una fase
+ */
+typedef struct {
+	char benchmark[16];
+	char phase[16];
+	int threads;
+	long param;
+	unsigned long ops;
+	double seconds;
+} mb_result_t;
+
+/**	Esecuzione di un benchmark: i thread si sincronizzano con il thread main sulla barriera all'inizio e alla fine
+ * 	di ogni fase e registrano gli istanti in cui iniziano e finiscono la fase; la durata della fase va dal primo
+ * 	inizio all'ultima fine
+ */
+typedef struct {
+	int nthreads;
+	long param;
+	pthread_barrier_t barrier;
+	void* shared;
+	double begin[MB_MAX_THREADS];
+	double end[MB_MAX_THREADS];
+} mb_run_t;
+
+typedef struct {
+	mb_run_t* run;
+	int id;
+} mb_arg_t;
+
+/* parametri */
+static long iterations = 100000;
+static long churn = 1000;
+static int thread_counts[MB_MAX_THREADS];
+static int nthread_counts = 0;
+static long list_sizes[8];
+static int nlist_sizes = 0;
+
+static mb_result_t results[MB_MAX_RESULTS];
+static int nresults = 0;
+
+Queue_t* mb_queue = NULL;		//Coda dei descrittori (una sola per processo, la mutex di queue.c è globale)
+
+static double now_sec() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void phase_begin(mb_arg_t* a) {
+	pthread_barrier_wait(&(a -> run -> barrier));
+	a -> run -> begin[a -> id] = now_sec();
+}
+
+static void phase_end(mb_arg_t* a) {
+	a -> run -> end[a -> id] = now_sec();
+	pthread_barrier_wait(&(a -> run -> barrier));
+}
+
+static char* make_key(const char* prefix, int id, long i) {
+	char* key = malloc(MAX_NAME_LENGTH+1);
+	if (key) snprintf(key, MAX_NAME_LENGTH+1, "%s%d_%ld", prefix, id, i);
+	return key;
+}
+
+/* ------------------- icl_hash ------------------- */
+
+static void* icl_worker(void* arg) {
+	mb_arg_t* a = (mb_arg_t*) arg;
+	icl_hash_t* ht = icl_hash_create(MB_HASH_BUCKETS, NULL, NULL);
+	char** keys = malloc(iterations * sizeof(char*));
+	for (long i = 0; i < iterations && keys; i++) keys[i] = make_key("k", a -> id, i);
+	int value = 1;
+
+	phase_begin(a);
+	for (long i = 0; i < iterations && ht && keys; i++) icl_hash_insert(ht, keys[i], &value);
+	phase_end(a);
+	phase_begin(a);
+	for (long i = 0; i < iterations && ht && keys; i++) icl_hash_find(ht, keys[i]);
+	phase_end(a);
+	phase_begin(a);
+	for (long i = 0; i < iterations && ht && keys; i++) icl_hash_delete(ht, keys[i], NULL, NULL);
+	phase_end(a);
+
+	if (ht) icl_hash_destroy(ht, NULL, NULL);
+	for (long i = 0; i < iterations && keys; i++) free(keys[i]);
+	free(keys);
+	return NULL;
+}
+
+/* ------------------- BQueue_t ------------------- */
+
+static void* bqueue_worker(void* arg) {
+	mb_arg_t* a = (mb_arg_t*) arg;
+	BQueue_t* q = initBQueue(iterations);
+	int value = 1;
+
+	phase_begin(a);
+	for (long i = 0; i < iterations && q; i++) pushBQueue(q, &value);
+	phase_end(a);
+	phase_begin(a);
+	BQueue_iterator_t* it = q ? BQueue_iterator_init(q) : NULL;
+	if (it) {
+		/* L'ITERATORE È CIRCOLARE: SCORRO ESATTAMENTE GLI ELEMENTI PRESENTI */
+		for (size_t i = 0, len = getBQueueLen(q); i < len; i++) BQueue_iterator_next(it);
+		BQueue_iterator_destroy(it);
+	}
+	phase_end(a);
+	phase_begin(a);
+	for (long i = 0; i < iterations && q; i++) popBQueue(q);
+	phase_end(a);
+
+	if (q) destroyBQueue(q, NULL);
+	return NULL;
+}
+
+/* ------------------- Queue_t ------------------- */
+
+static void* queue_worker(void* arg) {
+	mb_arg_t* a = (mb_arg_t*) arg;
+	int n = a -> run -> nthreads;
+	int value = 1;
+
+	phase_begin(a);
+	if (n == 1) {
+		for (long i = 0; i < iterations; i++) pushQueue(mb_queue, &value);
+		for (long i = 0; i < iterations; i++) popQueue(mb_queue);
+	}
+	/* CON UN NUMERO DISPARI DI THREAD L'ULTIMO NON PARTECIPA */
+	else if (a -> id < (n / 2) * 2) {
+		if (a -> id % 2 == 0)
+			for (long i = 0; i < iterations; i++) pushQueue(mb_queue, &value);
+		else
+			for (long i = 0; i < iterations; i++) popQueue(mb_queue);
+	}
+	phase_end(a);
+	return NULL;
+}
+
+/* ------------------- users_list_t ------------------- */
+
+static void* users_list_worker(void* arg) {
+	mb_arg_t* a = (mb_arg_t*) arg;
+	users_list_t* list = (users_list_t*) a -> run -> shared;
+	int n = a -> run -> nthreads;
+	char nick[MAX_NAME_LENGTH+1];
+
+	phase_begin(a);
+	for (long i = 0; i < churn; i++) {
+		snprintf(nick, sizeof(nick), "n%d_%ld", a -> id, i);
+		users_list_lock(list);
+		users_list_insert(list, nick);
+		users_list_unlock(list);
+	}
+	phase_end(a);
+	phase_begin(a);
+	/* OGNI THREAD RIMUOVE UTENTI PRESENTI FIN DALL'INIZIO, DISTRIBUITI SU TUTTA LA LISTA */
+	for (long i = 0; i < churn; i++) {
+		long u = ((i * n + a -> id) * 7919) % a -> run -> param;
+		snprintf(nick, sizeof(nick), "u%ld", u);
+		users_list_lock(list);
+		users_list_remove(list, nick);
+		users_list_unlock(list);
+	}
+	phase_end(a);
+	return NULL;
+}
+
+/* ------------------- history_msg_t ------------------- */
+
+static void* history_worker(void* arg) {
+	mb_arg_t* a = (mb_arg_t*) arg;
+	history_msg_t** msgs = malloc(iterations * sizeof(history_msg_t*));
+	char text[100];
+	message_t msg;
+
+	memset(text, 'x', sizeof(text));
+	text[sizeof(text)-1] = '\0';
+	setHeader(&(msg.hdr), TXT_MESSAGE, "mittente");
+	setData(&(msg.data), "destinatario", text, sizeof(text));
+
+	phase_begin(a);
+	for (long i = 0; i < iterations && msgs; i++) msgs[i] = init_history_message(msg, FALSE);
+	phase_end(a);
+	phase_begin(a);
+	for (long i = 0; i < iterations && msgs; i++) free_history_message(msgs[i]);
+	phase_end(a);
+
+	free(msgs);
+	return NULL;
+}
+
+/**	Esegue il benchmark name con nthreads thread che eseguono worker, stampando una riga per ognuna delle nphases
+ * 	fasi; ops è il numero di operazioni di una fase eseguite da tutti i thread
+ */
+static int run_benchmark(const char* name, const char** phases, int nphases, void* (*worker)(void*), int nthreads,
+	long param, void* shared, unsigned long ops) {
+	pthread_t tids[MB_MAX_THREADS];
+	mb_arg_t args[MB_MAX_THREADS];
+	mb_run_t run;
+
+	run.nthreads = nthreads;
+	run.param = param;
+	run.shared = shared;
+	if (pthread_barrier_init(&(run.barrier), NULL, nthreads + 1) != 0) return -1;
+	for (int i = 0; i < nthreads; i++) {
+		args[i].run = &run;
+		args[i].id = i;
+		if (pthread_create(tids + i, NULL, worker, args + i) != 0) {
+			fprintf(stderr, "ERRORE: creazione thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (int p = 0; p < nphases; p++) {
+		pthread_barrier_wait(&(run.barrier));
+		pthread_barrier_wait(&(run.barrier));
+		double first = run.begin[0], last = run.end[0];
+		for (int i = 1; i < nthreads; i++) {
+			if (run.begin[i] < first) first = run.begin[i];
+			if (run.end[i] > last) last = run.end[i];
+		}
+		if (nresults < MB_MAX_RESULTS) {
+			mb_result_t* r = results + nresults++;
+			strncpy(r -> benchmark, name, sizeof(r -> benchmark)-1);
+			strncpy(r -> phase, phases[p], sizeof(r -> phase)-1);
+			r -> threads = nthreads;
+			r -> param = param;
+			r -> ops = ops;
+			r -> seconds = last - first;
+			printf("%s,%s,%d,%ld,%lu,%.6f,%.1f,%.0f\n", r -> benchmark, r -> phase, r -> threads, r -> param, r -> ops,
+				r -> seconds, r -> seconds * 1e9 / r -> ops, r -> ops / r -> seconds);
+			fflush(stdout);
+		}
+	}
+
+	for (int i = 0; i < nthreads; i++) pthread_join(tids[i], NULL);
+	pthread_barrier_destroy(&(run.barrier));
+	return 0;
+}
+
+/**	Confronta i risultati con quelli del CSV baseline, ritorna il numero di fasi più lente di oltre tolerance per cento
+ */
+static int compare(const char* baseline, double tolerance) {
+	FILE* f = fopen(baseline, "r");
+	char line[256], bench[16], phase[16];
+	int threads, regressions = 0;
+	long param;
+	unsigned long ops;
+	double seconds, ns;
+
+	if (f == NULL) {
+		perror("baseline");
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%15[^,],%15[^,],%d,%ld,%lu,%lf,%lf", bench, phase, &threads, &param, &ops, &seconds, &ns) != 7) continue;
+		for (int i = 0; i < nresults; i++) {
+			mb_result_t* r = results + i;
+			if (strcmp(r -> benchmark, bench) || strcmp(r -> phase, phase) || r -> threads != threads || r -> param != param) continue;
+			double cur = r -> seconds * 1e9 / r -> ops;
+			if (cur > ns * (1 + tolerance / 100)) {
+				fprintf(stderr, "REGRESSIONE %s,%s,%d,%ld: %.1f ns/op (baseline %.1f, +%.0f%%)\n", bench, phase, threads, param,
+					cur, ns, (cur / ns - 1) * 100);
+				regressions++;
+			}
+		}
+	}
+	fclose(f);
+	return regressions;
+}
+
+/**	Legge una lista di interi positivi separati da ','
+ */
+static int parse_list(char* s, long* out, int max) {
+	int n = 0;
+	char* save = NULL;
+	for (char* tok = strtok_r(s, ",", &save); tok && n < max; tok = strtok_r(NULL, ",", &save)) {
+		long v = strtol(tok, NULL, 10);
+		if (v <= 0) return -1;
+		out[n++] = v;
+	}
+	return n;
+}
+
+static void use(const char* name) {
+	fprintf(stderr,
+		"use: %s [-t thread] [-n iterazioni] [-u utenti] [-k operazioni] [-b baseline.csv] [-r tolleranza]\n"
+		"  -t numeri di thread separati da ',' (default 1,2,4,8)\n"
+		"  -n operazioni per thread di icl_hash, bqueue, queue e history_msg (default 100000)\n"
+		"  -u utenti già presenti nella lista degli utenti connessi, separati da ',' (default 10000,50000,100000)\n"
+		"  -k insert e remove per thread nella lista degli utenti connessi (default 1000)\n"
+		"  -b CSV di un'esecuzione precedente con cui confrontare i risultati\n"
+		"  -r rallentamento massimo tollerato in per cento (default 20)\n", name);
+}
+
+int main(int argc, char* argv[]) {
+	char* baseline = NULL;
+	double tolerance = 20;
+	long tmp[MB_MAX_THREADS];
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:n:u:k:b:r:h")) != -1) {
+		switch (opt) {
+			case 't':
+				if ((nthread_counts = parse_list(optarg, tmp, MB_MAX_THREADS)) <= 0) { use(argv[0]); return EXIT_FAILURE; }
+				for (int i = 0; i < nthread_counts; i++)
+					thread_counts[i] = (tmp[i] > MB_MAX_THREADS) ? MB_MAX_THREADS : (int)tmp[i];
+				break;
+			case 'n': iterations = strtol(optarg, NULL, 10); break;
+			case 'u':
+				if ((nlist_sizes = parse_list(optarg, list_sizes, 8)) <= 0) { use(argv[0]); return EXIT_FAILURE; }
+				break;
+			case 'k': churn = strtol(optarg, NULL, 10); break;
+			case 'b': baseline = optarg; break;
+			case 'r': tolerance = strtod(optarg, NULL); break;
+			default: use(argv[0]); return EXIT_FAILURE;
+		}
+	}
+	if (iterations <= 0 || churn <= 0 || tolerance < 0) {
+		use(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (nthread_counts == 0) {
+		int def[] = { 1, 2, 4, 8 };
+		for (nthread_counts = 0; nthread_counts < 4; nthread_counts++) thread_counts[nthread_counts] = def[nthread_counts];
+	}
+	if (nlist_sizes == 0) {
+		list_sizes[0] = 10000; list_sizes[1] = 50000; list_sizes[2] = 100000;
+		nlist_sizes = 3;
+	}
+
+	if ((mb_queue = initQueue()) == NULL) {
+		fprintf(stderr, "ERRORE: inizializzazione coda\n");
+		return EXIT_FAILURE;
+	}
+
+	static const char* icl_phases[] = { "insert", "find", "delete" };
+	static const char* bqueue_phases[] = { "push", "iterate", "pop" };
+	static const char* queue_phases[] = { "pushpop" };
+	static const char* list_phases[] = { "insert", "remove" };
+	static const char* history_phases[] = { "init", "free" };
+
+	printf("benchmark,phase,threads,param,ops,seconds,ns_per_op,ops_per_sec\n");
+	for (int i = 0; i < nthread_counts; i++) {
+		int n = thread_counts[i];
+		run_benchmark("icl_hash", icl_phases, 3, icl_worker, n, MB_HASH_BUCKETS, NULL, iterations * n);
+		run_benchmark("bqueue", bqueue_phases, 3, bqueue_worker, n, iterations, NULL, iterations * n);
+		run_benchmark("queue", queue_phases, 1, queue_worker, n, 0, NULL, iterations * ((n == 1) ? 2 : (n / 2) * 2));
+		for (int s = 0; s < nlist_sizes; s++) {
+			users_list_t* list = users_list_init(list_sizes[s]);
+			char nick[MAX_NAME_LENGTH+1];
+			for (long u = 0; list && u < list_sizes[s]; u++) {
+				snprintf(nick, sizeof(nick), "u%ld", u);
+				users_list_insert(list, nick);
+			}
+			if (list == NULL) {
+				fprintf(stderr, "ERRORE: inizializzazione lista utenti\n");
+				return EXIT_FAILURE;
+			}
+			run_benchmark("users_list", list_phases, 2, users_list_worker, n, list_sizes[s], list, churn * n);
+			users_list_destroy(list);
+		}
+		run_benchmark("history_msg", history_phases, 2, history_worker, n, 100, NULL, iterations * n);
+	}
+
+	deleteQueue(mb_queue, NULL);
+
+	if (baseline) {
+		int regressions = compare(baseline, tolerance);
+		if (regressions != 0) return 2;
+	}
+	return 0;
+}
@@ -5,18 +5,29 @@
        originale dell'autore  
      */  
 
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include "operations.h"
 #include "connections.h"
 #include "stats.h"
+#include "stats_shards.h"
+#include "latency.h"
+#include "logger.h"
+#include "lock_profile.h"
 #include "boundedqueue.h"
 #include "message.h"
 #include "users.h"
 #include "users_list.h"
+#include "history_budget.h"
+#include "file_store.h"
+#include "file_cache.h"
+#include "uploads.h"
+#include "wire.h"
 #include "conn.h"
 #include "parser.h"
 
@@ -38,43 +49,34 @@
 #define DIM_FILE_TABLE 32
 #endif
 
-extern struct statistics chattyStats;		//Struttura dati che mantiene le statistiche (definita in stats.h)
-extern pthread_mutex_t chattyStatsMtx;		//Mutex sulle statistiche
 extern users_t* users;							//Struttura dati per la gestione degli utenti
 extern users_list_t* users_list;				//Struttura deti per la gestione della stringa degli utenti connessi
 extern pthread_mutex_t* fd_mtx;				//Array di mutex sui descrittori
-extern pthread_mutex_t dir_mtx;				//Mutex per la gestione della directory dei file
 
 /* 
-	Funzione thread_safe che effettua l'aggiornamento delle statistiche 
+	Funzione thread_safe che effettua l'aggiornamento delle statistiche (senza mutex, vedere stats_shards.h)
 */
 static void update_stats(long nusers, long nonline, long ndeliv, long nnotdeliv, long nfiledeliv, long nfilenotdeliv, long nerr) {
 
-	pthread_mutex_lock(&chattyStatsMtx);
-	chattyStats.nusers += nusers;
-	chattyStats.nonline += nonline;
-	chattyStats.ndelivered += ndeliv;
-	chattyStats.nnotdelivered += nnotdeliv;
-	chattyStats.nfiledelivered += nfiledeliv;
-	chattyStats.nfilenotdelivered += nfilenotdeliv;
-	chattyStats.nerrors += nerr;
-	pthread_mutex_unlock(&chattyStatsMtx);
+	stats_shards_add(nusers, nonline, ndeliv, nnotdeliv, nfiledeliv, nfilenotdeliv, nerr);
 
 }
 
 /*
-	Funzione thread_safe che invia messaggio ad un client
+	Funzione thread_safe che invia messaggio ad un client, sulle connessioni WIRE_V2_LZ con il contenuto
+	compresso in anticipo packed (se != NULL, vedere wire_pack)
 	Ritorna -1 in caso di errore di scrittura, 0 in caso di successo
 */
-static int send_reply(int user_id, int fd, message_hdr_t *hdr, message_data_t *data) {
+static int send_reply_packed(int user_id, int fd, message_hdr_t *hdr, message_data_t *data, wire_packed_t* packed) {
 	int result = 0;		//VALORE DI RITORNO DELLA FUNZIONE
+	unsigned long long start = latency_now();	//INIZIO DELL'INVIO (COMPRESA L'ATTESA DELLA MUTEX)
 	
 	/*	SE user_id != -1 ALLORA ACQUISICO LA MUTEX SUL DESCRITTORE ALTRIMENTI NO */
-	if (user_id !=-1) pthread_mutex_lock(&(fd_mtx[user_id%MaxConnections]));
+	if (user_id !=-1) LP_LOCK(LP_FD, user_id%MaxConnections, &(fd_mtx[user_id%MaxConnections]));
 
 	/* INVIO L'HEADER SE != NULL, IGNORO EPIPE ED EBADF */
 	if (hdr != NULL) {
-		if (sendHeader(fd, hdr) == -1) {
+		if (wire_send_header(fd, hdr) == -1) {
 			if (errno == EPIPE || errno == EBADF) ;
 			else result = -1;
 		}
@@ -82,18 +84,28 @@ static int send_reply(int user_id, int fd, message_hdr_t *hdr, message_data_t *d
 
 	/* INVIO I DATI DATI SE != NULL, IGNORO EPIPE ED EBADF */
 	if (data != NULL && result != -1) {
-		if (sendData(fd, data) == -1) {
+		if (wire_send_data_packed(fd, data, packed) == -1) {
 			if (errno == EPIPE || errno == EBADF) ;
 			else result = -1;
 		}
 	}
 
 	/* RILASCIO LA MUTEX SE E SOLO SE PRIMA ERA STATA ACQUISITA */
-	if (user_id != -1) pthread_mutex_unlock(&(fd_mtx[user_id%MaxConnections]));
+	if (user_id != -1) LP_UNLOCK(LP_FD, user_id%MaxConnections, &(fd_mtx[user_id%MaxConnections]));
+
+	latency_add_send(latency_now() - start);
 	
 	return result;
 }
 
+/*
+	Funzione thread_safe che invia messaggio ad un client
+	Ritorna -1 in caso di errore di scrittura, 0 in caso di successo
+*/
+static int send_reply(int user_id, int fd, message_hdr_t *hdr, message_data_t *data) {
+	return send_reply_packed(user_id, fd, hdr, data, NULL);
+}
+
 op_res_t register_op(unsigned int fd, message_t msg) {
 	op_res_t result = REQUEST_OK;		//VALORE DI RITORNO DELLA FUNZIONE
 	op_res_t func_res;					//RISULTATO DELLE FUNZIONI CHIAMATE
@@ -122,6 +134,10 @@ op_res_t register_op(unsigned int fd, message_t msg) {
 	}
 	/* FINE CONTROLLO PARAMETRI */
 
+	/* SE IL CLIENT LO CHIEDE LA RISPOSTA E TUTTI I FRAME SUCCESSIVI SULLA CONNESSIONE SONO IN FORMATO COMPATTO
+	 * (SOLO DOPO IL CONTROLLO DEI PARAMETRI: UNA RICHIESTA NON VALIDA NON MODIFICA IL FORMATO DELLA CONNESSIONE) */
+	wire_negotiate(fd, &msg);
+
 	/* VERIFICO DI NON AVER RAGGIUNTO IL NUMERO MASSIMO DI CONNESSIONI */
 	num_users_lock(users);
 	func_res = testAndInc_num_users_conn(users);
@@ -170,7 +186,11 @@ op_res_t register_op(unsigned int fd, message_t msg) {
 	
 	/* INSERISCO I DATI DELL'UTENTE IN USERS */ 
 	users_table_lock(users, msg.hdr.sender);
-	func_res = users_table_insert(users, nick, user_data);
+	/* IL NICKNAME NON PUÒ COINCIDERE CON IL NOME DI UN GRUPPO */
+	groups_table_lock(users);
+	if (get_group(users, msg.hdr.sender) != NULL) func_res = ALREADY_INSERTED;
+	else func_res = users_table_insert(users, nick, user_data);
+	groups_table_unlock(users);
 	users_table_unlock(users, msg.hdr.sender);
 
 	/* CONTROLLO ERRORI INSERIMENTO */
@@ -252,7 +272,7 @@ op_res_t register_op(unsigned int fd, message_t msg) {
 	inc_num_users_reg(users);
 	num_users_unlock(users);
 
-	printf("Registrazione di %s terminata\n", msg.hdr.sender);
+	LOGGER(LOGGER_DEBUG, "Registrazione di %s terminata", msg.hdr.sender);
 
 	return result;
 
@@ -270,9 +290,9 @@ op_res_t register_op(unsigned int fd, message_t msg) {
 				/* ACQUISISCO LA MUTEX SUL BLOCCO LOGICO DELLA TABELLA HASH */
 				users_table_lock(users, msg.hdr.sender);
 				/* ACQUISISCO LA MUTEX SUL DESCRITTORE POICHÈ NON È CONSENTITA LA CLOSE MENTRE SONO IN CORSO DELLE WRITE SUL DESCRITTORE STESSO */
-				pthread_mutex_lock(&(fd_mtx[user_id%MaxConnections]));
+				LP_LOCK(LP_FD, user_id%MaxConnections, &(fd_mtx[user_id%MaxConnections]));
 				func_res = users_table_delete(users, msg.hdr.sender);
-				pthread_mutex_unlock(&(fd_mtx[user_id%MaxConnections]));
+				LP_UNLOCK(LP_FD, user_id%MaxConnections, &(fd_mtx[user_id%MaxConnections]));
 				users_table_unlock(users, msg.hdr.sender);
 			}
 			else {
@@ -344,6 +364,10 @@ op_res_t connect_op(unsigned int fd, message_t msg) {
 	}
 	/* FINE CONTROLLO PARAMETRI */
 
+	/* SE IL CLIENT LO CHIEDE LA RISPOSTA E TUTTI I FRAME SUCCESSIVI SULLA CONNESSIONE SONO IN FORMATO COMPATTO
+	 * (SOLO DOPO IL CONTROLLO DEI PARAMETRI: UNA RICHIESTA NON VALIDA NON MODIFICA IL FORMATO DELLA CONNESSIONE) */
+	wire_negotiate(fd, &msg);
+
 	/* VERIFICO DI NON AVER RAGGIUNTO IL NUMERO MASSIMO DI CONNESSIONI */
 	num_users_lock(users);
 	func_res = testAndInc_num_users_conn(users);
@@ -380,9 +404,9 @@ op_res_t connect_op(unsigned int fd, message_t msg) {
 		goto error_connect;
 	}
 	/* SETTO IL DESCRITTORE */
-	pthread_mutex_lock(fd_mtx + (user_id % MaxConnections));
+	LP_LOCK(LP_FD, user_id % MaxConnections, fd_mtx + (user_id % MaxConnections));
 	set_fd(user_data, fd);
-	pthread_mutex_unlock(fd_mtx + (user_id % MaxConnections));
+	LP_UNLOCK(LP_FD, user_id % MaxConnections, fd_mtx + (user_id % MaxConnections));
 	users_table_unlock(users, msg.hdr.sender);
 
 	connected = 1;
@@ -450,7 +474,7 @@ op_res_t connect_op(unsigned int fd, message_t msg) {
 	}
 	users_list_unlock(users_list);
 
-	printf("Connessione di %s avvenuta con successo\n", msg.hdr.sender);
+	LOGGER(LOGGER_DEBUG, "Connessione di %s avvenuta con successo", msg.hdr.sender);
 
 	return result;
 
@@ -462,9 +486,9 @@ op_res_t connect_op(unsigned int fd, message_t msg) {
 		else {
 			if (connected) {
 				users_table_lock(users, msg.hdr.sender);
-				pthread_mutex_lock(fd_mtx + (user_id % MaxConnections));
+				LP_LOCK(LP_FD, user_id % MaxConnections, fd_mtx + (user_id % MaxConnections));
 				set_fd(user_data, -1);
-				pthread_mutex_unlock(fd_mtx + (user_id % MaxConnections));
+				LP_UNLOCK(LP_FD, user_id % MaxConnections, fd_mtx + (user_id % MaxConnections));
 				users_table_unlock(users, msg.hdr.sender);
 			}
 			else {
@@ -497,6 +521,159 @@ op_res_t connect_op(unsigned int fd, message_t msg) {
 	}
 }
 
+/*
+	Se name è il nome di un gruppo ritorna FOUND e, se sender è membro del gruppo, salva in members una copia
+	(da deallocare) dei nickname dei membri e in is_member 1; se sender non è membro is_member vale 0.
+	Ritorna NOT_FOUND se name non è il nome di un gruppo, SYSTEM_ERROR in caso di errore di allocazione della memoria
+*/
+static op_res_t lookup_group(char* name, char* sender, char (**members)[MAX_NAME_LENGTH+1], int* num_members, int* is_member) {
+	op_res_t result = FOUND;
+
+	*members = NULL;
+	*num_members = 0;
+	*is_member = 0;
+
+	groups_table_lock(users);
+	group_t* group = get_group(users, name);
+	if (group == NULL) result = NOT_FOUND;
+	else if (group_is_member(group, sender) == FOUND) {
+		*is_member = 1;
+		if (group_get_members(group, members, num_members) == SYSTEM_ERROR) result = SYSTEM_ERROR;
+	}
+	groups_table_unlock(users);
+
+	return result;
+}
+
+/*
+	Elemento usato per raggruppare i destinatari per blocco logico di reg_users
+*/
+typedef struct fanout_entry {
+	int block;			//BLOCCO LOGICO DI REG_USERS DEL DESTINATARIO
+	int index;			//POSIZIONE DEL DESTINATARIO NELLA LISTA ORIGINALE
+	char* nick;			//NICKNAME DEL DESTINATARIO
+} fanout_entry_t;
+
+static int cmp_fanout_entry(const void* a, const void* b) {
+	const fanout_entry_t* e1 = a;
+	const fanout_entry_t* e2 = b;
+	if (e1 -> block != e2 -> block) return e1 -> block - e2 -> block;
+	return strncmp(e1 -> nick, e2 -> nick, MAX_NAME_LENGTH);
+}
+
+/*
+	Invia message_to_send a tutti i destinatari connessi della lista recipients e lo inserisce nella history di ognuno.
+	Il contenuto del messaggio viene allocato una sola volta e condiviso tra le history (history_body_t definita in history_msg.h);
+	i destinatari vengono ordinati per blocco logico di reg_users in modo da acquisire ogni mutex una sola volta per tutti 
+	i destinatari del blocco (i destinatari ripetuti ricevono il messaggio una sola volta).
+	Se file_key != NULL il contenuto del messaggio è il nome di un file salvato nello store con chiave file_key:
+	il nome (reso unico tra i file ricevuti dal destinatario) viene inserito tra i file ricevuti da ogni destinatario.
+	Se status != NULL il bit i di status viene settato se e solo se il destinatario i è registrato.
+	Il campo receiver del messaggio ricevuto è quello di message_to_send (es. il nome del gruppo) o, se vuoto, il nick del destinatario.
+	Ritorna -1 in caso di errore di allocazione della memoria, 0 altrimenti
+*/
+static int fanout_message(message_t* message_to_send, char (*recipients)[MAX_NAME_LENGTH+1], int num_recipients, char* file_key, unsigned char* status, int* num_sended, int* num_not_sended) {
+	fanout_entry_t* entries;			//DESTINATARI ORDINATI PER BLOCCO LOGICO
+	history_body_t* body;				//CONTENUTO CONDIVISO DEL MESSAGGIO
+	history_msg_t* history_msg;		//MESSAGGIO DA INSERIRE NELLA HISTORY
+	message_t message;					//MESSAGGIO INVIATO AL DESTINATARIO
+	wire_packed_t packed;				//CONTENUTO COMPRESSO UNA SOLA VOLTA PER TUTTI I DESTINATARI
+	char file_name[1024];				//NOME DEL FILE PER IL DESTINATARIO
+	op_res_t func_res;					//RISULTATO DELLE CHIAMATE DI FUNZIONE
+	user_data_t* user_data;				//DATI E INFO DEL DESTINATARIO
+	boolean_t sended;						//TRUE SE E SOLO SE IL MESSAGGIO È STATO INVIATO AL DESTINATARIO
+	int user_id, fd_receiver, block, i, j;
+	int result = 0;
+
+	*num_sended = 0;
+	*num_not_sended = 0;
+	if (num_recipients == 0) return 0;
+
+	entries = (fanout_entry_t*) malloc(num_recipients*sizeof(fanout_entry_t));
+	if (entries == NULL) return -1;
+	for (i = 0; i < num_recipients; i++) {
+		entries[i].nick = recipients[i];
+		entries[i].index = i;
+		entries[i].block = users_table_block(users, recipients[i]);
+	}
+	qsort(entries, num_recipients, sizeof(fanout_entry_t), cmp_fanout_entry);
+
+	/* LA MEMORIA DEL CONTENUTO VIENE RIPARTITA TRA I DESTINATARI DISTINTI (I RIPETUTI SONO ADIACENTI DOPO L'ORDINAMENTO) */
+	int num_distinct = 0;
+	for (i = 0; i < num_recipients; i++) {
+		if (i == 0 || entries[i].block != entries[i-1].block || strncmp(entries[i-1].nick, entries[i].nick, MAX_NAME_LENGTH) != 0) num_distinct++;
+	}
+	body = init_history_body(message_to_send -> data.buf, message_to_send -> data.hdr.len, num_distinct);
+	if (body == NULL) {
+		free(entries);
+		return -1;
+	}
+	/* IL CONTENUTO VIENE COMPRESSO (PER LE CONNESSIONI CHE LO CHIEDONO) PRIMA DI ACQUISIRE LE MUTEX */
+	wire_pack(&(message_to_send -> data), &packed);
+
+	for (i = 0; i < num_recipients && result != -1; i = j) {
+		block = entries[i].block;
+		users_table_lock_block(users, block);
+		for (j = i; j < num_recipients && entries[j].block == block; j++) {
+			if (result == -1) continue;
+			/* IL DESTINATARIO POTREBBE NON ESSERE REGISTRATO O ESSERSI DEREGISTRATO NEL FRATTEMPO */
+			user_data = get_user_data(users, entries[j].nick);
+			if (user_data == NULL) continue;
+			if (status != NULL) status[entries[j].index/8] |= (unsigned char)(1 << (entries[j].index%8));
+			/* DESTINATARIO RIPETUTO ==> IL MESSAGGIO È GIÀ STATO CONSEGNATO */
+			if (j > i && strncmp(entries[j-1].nick, entries[j].nick, MAX_NAME_LENGTH) == 0) continue;
+			get_id(user_data, &user_id);
+
+			/* IL DESTINATARIO DEL MESSAGGIO È IL GRUPPO SE INDICATO, ALTRIMENTI L'UTENTE STESSO */
+			message = *message_to_send;
+			if (message_to_send -> data.hdr.receiver[0] == '\0') {
+				memset(message.data.hdr.receiver, '\0', MAX_NAME_LENGTH+1);
+				strncpy(message.data.hdr.receiver, entries[j].nick, MAX_NAME_LENGTH);
+			}
+			/* IL NOME DEL FILE DEVE ESSERE UNICO TRA I FILE RICEVUTI DAL DESTINATARIO ==> IL MESSAGGIO PUÒ DIFFERIRE */
+			if (file_key != NULL) {
+				func_res = unique_file_name(user_data, message_to_send -> data.buf, file_name, sizeof(file_name));
+				if (func_res == REQUEST_OK) func_res = insert_file_name(user_data, file_name, file_key);
+				if (func_res == SYSTEM_ERROR) result = -1;
+				if (func_res != REQUEST_OK) {
+					(*num_not_sended)++;
+					continue;
+				}
+				if (strcmp(file_name, message_to_send -> data.buf) != 0)
+					setData(&message.data, message.data.hdr.receiver, file_name, strlen(file_name)+1);
+			}
+
+			/* INVIO IL MESSAGGIO SE E SOLO SE IL DESTINATARIO È CONNESSO */
+			LP_LOCK(LP_FD, user_id % MaxConnections, fd_mtx + (user_id % MaxConnections));
+			fd_receiver = -1;
+			get_fd(user_data, &fd_receiver);
+			sended = FALSE;
+			if (fd_receiver != -1 && send_reply_packed(-1, fd_receiver, &(message.hdr), &(message.data), &packed) != -1)
+				sended = TRUE;
+			LP_UNLOCK(LP_FD, user_id % MaxConnections, fd_mtx + (user_id % MaxConnections));
+
+			if (sended == TRUE) (*num_sended)++;
+			else (*num_not_sended)++;
+
+			/* INSERISCO NELLA HISTORY DEL DESTINATARIO UN MESSAGGIO CHE CONDIVIDE IL CONTENUTO (SE NON È STATO RINOMINATO) */
+			if (message.data.buf == message_to_send -> data.buf) history_msg = init_history_message_shared(message, sended, body);
+			else history_msg = init_history_message(message, sended);
+			if (history_msg == NULL) {
+				result = -1;
+				continue;
+			}
+			insert_message(user_data, history_msg);
+		}
+		users_table_unlock_block(users, block);
+	}
+
+	free(entries);
+	release_history_body(body);
+	wire_packed_free(&packed);
+
+	return result;
+}
+
 op_res_t posttxt_op(unsigned int fd, message_t msg) {
 	op_res_t result = REQUEST_OK;						//RISULTATO DELL'OPERAZIONE
 	message_hdr_t header_reply;						//HEADER MESSAGGIO RISPOSTA
@@ -507,6 +684,10 @@ op_res_t posttxt_op(unsigned int fd, message_t msg) {
 	user_data_t* user_data_receiver = NULL;		//DATI E INFO DEL RECEIVER
 	int user_id_sender = -1;							//ID DEL SENDER
 	int user_id_receiver = -1;							//ID DEL RECEIVER
+	op_res_t func_res;									//RISULTATO DELLE CHIAMATE DI FUNZIONE
+	char (*members)[MAX_NAME_LENGTH+1] = NULL;	//MEMBRI DEL GRUPPO DESTINATARIO
+	int num_members = 0;									//NUMERO DI MEMBRI DEL GRUPPO DESTINATARIO
+	int is_member = 0;									//UGUALE A 1 SE E SOLO SE IL MITTENTE È MEMBRO DEL GRUPPO DESTINATARIO
 
 	/* INIZIO CONTROLLO PARAMETRI */
 	if (fd < 0) return ILLEGAL_ARGUMENT;
@@ -561,6 +742,55 @@ op_res_t posttxt_op(unsigned int fd, message_t msg) {
 	}
 	users_table_unlock(users, msg.hdr.sender);
 
+	/* SE IL DESTINATARIO È UN GRUPPO INVIO IL MESSAGGIO A TUTTI I SUOI MEMBRI */
+	func_res = lookup_group(msg.data.hdr.receiver, msg.hdr.sender, &members, &num_members, &is_member);
+	if (func_res == SYSTEM_ERROR) {
+		setHeader(&header_reply, OP_FAIL, "");
+		send_reply(user_id_sender, fd, &header_reply, NULL);
+		update_stats(0,0,0,0,0,0,1);
+		return SYSTEM_ERROR;
+	}
+	if (func_res == FOUND) {
+		/* SOLO I MEMBRI DEL GRUPPO POSSONO INVIARE MESSAGGI AL GRUPPO */
+		if (!is_member) {
+			setHeader(&header_reply, OP_NICK_UNKNOWN, "");
+			if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+			else result = CLIENT_ERROR;
+			update_stats(0,0,0,0,0,0,1);
+			return result;
+		}
+
+		setHeader(&message_to_send.hdr, TXT_MESSAGE, msg.hdr.sender);
+		setData(&message_to_send.data, msg.data.hdr.receiver, msg.data.buf, strlen(msg.data.buf)+1);
+
+		int num_sended, num_not_sended;
+		int fanout_res = fanout_message(&message_to_send, members, num_members, NULL, NULL, &num_sended, &num_not_sended);
+		if (members) free(members);
+		if (fanout_res == -1) {
+			setHeader(&header_reply, OP_FAIL, "");
+			send_reply(user_id_sender, fd, &header_reply, NULL);
+			update_stats(0,0,0,0,0,0,1);
+			return SYSTEM_ERROR;
+		}
+
+		/* VERIFICO IL BUDGET DI MEMORIA DELLE HISTORY */
+		history_budget_enforce(users);
+
+		/* INVIO IL MESSAGGIO DI RISPOSTA AL MITTENTE */
+		setHeader(&header_reply, OP_OK, "");
+		if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) {
+			update_stats(0,0,0,0,0,0,1);
+			return SYSTEM_ERROR;
+		}
+
+		/* AGGIORNAMENTO STATISTICHE */
+		update_stats(0,0,num_sended,num_not_sended,0,0,0);
+
+		LOGGER(LOGGER_DEBUG, "Messaggio inviato da %s al gruppo %s con successo", msg.hdr.sender, msg.data.hdr.receiver);
+
+		return result;
+	}
+
 	users_table_lock(users, msg.data.hdr.receiver);
 	/* CONTROLLO SE IL DESTINATARIO È REGISTRATO */
 	user_data_receiver = get_user_data(users, msg.data.hdr.receiver);
@@ -579,15 +809,20 @@ op_res_t posttxt_op(unsigned int fd, message_t msg) {
 	setHeader(&message_to_send.hdr, TXT_MESSAGE, msg.hdr.sender);
 	setData(&message_to_send.data, msg.data.hdr.receiver, msg.data.buf, strlen(msg.data.buf)+1);
 
+	/* IL CONTENUTO VIENE COMPRESSO (SE LA CONNESSIONE LO CHIEDE) PRIMA DI ACQUISIRE LA MUTEX SUL DESCRITTORE */
+	wire_packed_t packed;
+	wire_pack(&message_to_send.data, &packed);
+
 	/* INVIO IL MESSAGGIO SE E SOLO SE IL DESTINATARIO È CONNESSO */
-	pthread_mutex_lock(fd_mtx + (user_id_receiver % MaxConnections));
+	LP_LOCK(LP_FD, user_id_receiver % MaxConnections, fd_mtx + (user_id_receiver % MaxConnections));
 	int fd_receiver = -1;
 	get_fd(user_data_receiver, &fd_receiver);
 	/* SE IL DESTINATARIO SI È DEREGISTRATO O SI È DISCONNESSO ALLORA fd_receiver = -1 */
 	if (fd_receiver != -1) {
 		/* PASSO PARAMETRO USER_ID = -1 PERCHÈ LA MUTUA ESCLUSIONE SUL DESCRITTORE È STATA GIÀ ACQUISITA */
-		if (send_reply(-1, fd_receiver, &message_to_send.hdr, &message_to_send.data) == -1) {
-			pthread_mutex_unlock(fd_mtx + (user_id_receiver % MaxConnections));
+		if (send_reply_packed(-1, fd_receiver, &message_to_send.hdr, &message_to_send.data, &packed) == -1) {
+			LP_UNLOCK(LP_FD, user_id_receiver % MaxConnections, fd_mtx + (user_id_receiver % MaxConnections));
+			wire_packed_free(&packed);
 			update_stats(0,0,0,0,0,0,1);
 			return SYSTEM_ERROR;
 		}
@@ -596,7 +831,8 @@ op_res_t posttxt_op(unsigned int fd, message_t msg) {
 	else {
 		sended = FALSE;
 	}
-	pthread_mutex_unlock(fd_mtx + (user_id_receiver % MaxConnections));
+	LP_UNLOCK(LP_FD, user_id_receiver % MaxConnections, fd_mtx + (user_id_receiver % MaxConnections));
+	wire_packed_free(&packed);
 
 
 	/* INIZIALIZZO IL MESSAGGIO DA INSERIRE NELLA HISTORY */
@@ -623,6 +859,9 @@ op_res_t posttxt_op(unsigned int fd, message_t msg) {
 	insert_message(user_data_receiver, history_msg);
 	users_table_unlock(users, msg.data.hdr.receiver);
 
+	/* VERIFICO IL BUDGET DI MEMORIA DELLE HISTORY */
+	history_budget_enforce(users);
+
 	/* INVIO IL MESSAGGIO DI RISPOSTA AL MITTENTE */
 	setHeader(&header_reply, OP_OK, "");
 	if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) {
@@ -634,7 +873,7 @@ op_res_t posttxt_op(unsigned int fd, message_t msg) {
 	if (sended == TRUE) update_stats(0,0,1,0,0,0,0);
 	else if (sended == FALSE) update_stats(0,0,0,1,0,0,0);
 
-	printf("Messaggio [%s] inviato da %s a %s con successo\n", msg.data.buf, msg.hdr.sender, msg.data.hdr.receiver);
+	LOGGER(LOGGER_DEBUG, "Messaggio inviato da %s a %s con successo", msg.hdr.sender, msg.data.hdr.receiver);
 
 	return result;
 }
@@ -710,14 +949,16 @@ op_res_t posttxtall_op(unsigned int fd, message_t msg) {
 	func_res = users_table_iterate(iterator, &iterator_element);
 	while(func_res != NOT_FOUND) {
 		if (strcmp(msg.hdr.sender, iterator_element.nick) != 0) {	//non invio il messaggio all'utente che ha effettuato la richiesta
+			memset(message_to_sent.data.hdr.receiver, '\0', MAX_NAME_LENGTH+1);
+			strncpy(message_to_sent.data.hdr.receiver, iterator_element.nick, MAX_NAME_LENGTH);
 			get_id(iterator_element.user_data, &user_id_receiver);
 			users_table_unlock_all(users);
 			fd_receiver = -1;
-			pthread_mutex_lock(fd_mtx + (user_id_receiver % MaxConnections));
+			LP_LOCK(LP_FD, user_id_receiver % MaxConnections, fd_mtx + (user_id_receiver % MaxConnections));
 			get_fd(iterator_element.user_data, &fd_receiver);
 			if (fd_receiver != -1) {
 				if (send_reply(-1, fd_receiver, &message_to_sent.hdr, &message_to_sent.data) == -1) {
-					pthread_mutex_unlock(fd_mtx + (user_id_receiver % MaxConnections));
+					LP_UNLOCK(LP_FD, user_id_receiver % MaxConnections, fd_mtx + (user_id_receiver % MaxConnections));
 					setHeader(&header_reply, OP_FAIL, "");
 					send_reply(user_id_sender, fd, &header_reply, NULL);
 					update_stats(0,0,0,0,0,0,1);
@@ -730,7 +971,7 @@ op_res_t posttxtall_op(unsigned int fd, message_t msg) {
 				sended = FALSE;
 				num_messages_not_sended++;
 			}
-			pthread_mutex_unlock(fd_mtx + (user_id_receiver % MaxConnections));
+			LP_UNLOCK(LP_FD, user_id_receiver % MaxConnections, fd_mtx + (user_id_receiver % MaxConnections));
 
 			history_msg = init_history_message(message_to_sent, sended);
 			if (history_msg == NULL) {
@@ -755,6 +996,9 @@ op_res_t posttxtall_op(unsigned int fd, message_t msg) {
 
 	users_table_iterator_close(&iterator);
 
+	/* VERIFICO IL BUDGET DI MEMORIA DELLE HISTORY */
+	history_budget_enforce(users);
+
 	/* INVIO IL MESSAGGIO DI RISPOSTA AL MITTENTE */
 	setHeader(&header_reply, OP_OK, "");
 	if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) { 
@@ -765,24 +1009,369 @@ op_res_t posttxtall_op(unsigned int fd, message_t msg) {
 	/* AGGIORNAMENTO STATISTICHE */
 	update_stats(0, 0, num_messages_sended, num_messages_not_sended, 0, 0, 0);
 	
-	printf("Messaggio [%s] inviato a tutti con successo\n", msg.data.buf);
+	LOGGER(LOGGER_DEBUG, "Messaggio inviato da %s a tutti con successo", msg.hdr.sender);
 
 	return result;
 }
 
-op_res_t postfile_op(unsigned int fd, message_t msg, message_data_t file_content) {
+op_res_t posttxtmulti_op(unsigned int fd, message_t msg) {
+	op_res_t result = REQUEST_OK;						//RISULTATO DELL'OPERAZIONE
+	message_hdr_t header_reply;						//HEADER DELLA RISPOSTA
+	message_data_t data_reply;							//DATI DELLA RISPOSTA (BITMAP DEGLI ESITI)
+	message_t message_to_send;							//MESSAGGIO DA INVIARE
+	user_data_t* user_data_sender;					//DATI E INFO DEL SENDER
+	char (*recipients)[MAX_NAME_LENGTH+1];			//NICKNAME DEI DESTINATARI
+	unsigned char* status = NULL;						//BITMAP DEGLI ESITI PER DESTINATARIO
+	unsigned int num_recipients = 0;					//NUMERO DI DESTINATARI
+	char* text;												//TESTO DEL MESSAGGIO
+	int user_id_sender = -1;							//ID DEL SENDER
+	int num_sended, num_not_sended;					//NUMERO DI MESSAGGI INVIATI E NON INVIATI
+
+	/* INIZIO CONTROLLO PARAMETRI */
+	if (fd < 0) return ILLEGAL_ARGUMENT;
+
+	if (msg.hdr.sender[0] == '\0' || strlen(msg.hdr.sender) > MAX_NAME_LENGTH) {
+		setHeader(&header_reply, OP_FAIL, "");
+		if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+
+	/* LA PARTE DATI DEVE CONTENERE ALMENO UN DESTINATARIO E UN TESTO TERMINATO DA '\0' */
+	if (msg.data.buf != NULL && msg.data.hdr.len > sizeof(unsigned int))
+		memcpy(&num_recipients, msg.data.buf, sizeof(unsigned int));
+	if (num_recipients == 0 || num_recipients > (msg.data.hdr.len - sizeof(unsigned int))/(MAX_NAME_LENGTH+1) 
+		 || msg.data.hdr.len <= MULTI_HDR_SIZE(num_recipients) || msg.data.buf[msg.data.hdr.len-1] != '\0') {
+		setHeader(&header_reply, OP_FAIL, "");
+		if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+	recipients = (char (*)[MAX_NAME_LENGTH+1]) (msg.data.buf + sizeof(unsigned int));
+	/* I NICKNAME DEVONO ESSERE TERMINATI DA '\0' */
+	for (unsigned int i = 0; i < num_recipients; i++) {
+		if (memchr(recipients[i], '\0', MAX_NAME_LENGTH+1) == NULL) {
+			setHeader(&header_reply, OP_FAIL, "");
+			if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+			else result = CLIENT_ERROR;
+			update_stats(0,0,0,0,0,0,1);
+			return result;
+		}
+	}
+	text = msg.data.buf + MULTI_HDR_SIZE(num_recipients);
+
+	if (strlen(text) > MaxMsgSize) {
+		setHeader(&header_reply, OP_MSG_TOOLONG, "");
+		if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+	/* FINE CONTROLLO PARAMETRI */
+
+	users_table_lock(users, msg.hdr.sender);
+	/* CONTROLLO SE IL MITTENTE È REGISTRATO */
+	user_data_sender = get_user_data(users, msg.hdr.sender);
+	if (user_data_sender == NULL) {
+		users_table_unlock(users, msg.hdr.sender);
+		setHeader(&header_reply, OP_NICK_UNKNOWN, "");
+		if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+	/* RECUPERO L'ID DEL MITTENTE */
+	get_id(user_data_sender, &user_id_sender);
+	/* CONTROLLO SE IL MITTENTE È CONNESSO */
+	int current_fd;
+	get_fd(user_data_sender, &current_fd);
+	if (current_fd == -1) {
+		users_table_unlock(users, msg.hdr.sender);
+		setHeader(&header_reply, OP_FAIL, "");
+		if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+	users_table_unlock(users, msg.hdr.sender);
+
+	status = (unsigned char*) malloc(MULTI_STATUS_SIZE(num_recipients)*sizeof(unsigned char));
+	if (status == NULL) {
+		setHeader(&header_reply, OP_FAIL, "");
+		send_reply(user_id_sender, fd, &header_reply, NULL);
+		update_stats(0,0,0,0,0,0,1);
+		return SYSTEM_ERROR;
+	}
+	memset(status, 0, MULTI_STATUS_SIZE(num_recipients));
+
+	/* RISOLVO I DESTINATARI E INVIO IL MESSAGGIO CON UN'UNICA PASSATA SULLA TABELLA DEGLI UTENTI */
+	setHeader(&message_to_send.hdr, TXT_MESSAGE, msg.hdr.sender);
+	setData(&message_to_send.data, "", text, strlen(text)+1);
+	if (fanout_message(&message_to_send, recipients, num_recipients, NULL, status, &num_sended, &num_not_sended) == -1) {
+		free(status);
+		setHeader(&header_reply, OP_FAIL, "");
+		send_reply(user_id_sender, fd, &header_reply, NULL);
+		update_stats(0,0,0,0,0,0,1);
+		return SYSTEM_ERROR;
+	}
+
+	/* VERIFICO IL BUDGET DI MEMORIA DELLE HISTORY */
+	history_budget_enforce(users);
+
+	/* INVIO AL MITTENTE LA BITMAP DEGLI ESITI */
+	setHeader(&header_reply, OP_OK, "");
+	setData(&data_reply, "", (char*)status, MULTI_STATUS_SIZE(num_recipients));
+	if (send_reply(user_id_sender, fd, &header_reply, &data_reply) == -1) {
+		free(status);
+		update_stats(0,0,0,0,0,0,1);
+		return SYSTEM_ERROR;
+	}
+	free(status);
+
+	/* AGGIORNAMENTO STATISTICHE */
+	update_stats(0,0,num_sended,num_not_sended,0,0,0);
+
+	LOGGER(LOGGER_DEBUG, "Messaggio inviato da %s a %u destinatari con successo", msg.hdr.sender, num_recipients);
+
+	return result;
+}
+
+/*
+	Elemento di una richiesta POSTTXTBATCH_OP
+*/
+typedef struct batch_entry {
+	int block;			//BLOCCO LOGICO DI REG_USERS DEL DESTINATARIO
+	int index;			//POSIZIONE DEL MESSAGGIO NELLA RICHIESTA
+	char* nick;			//DESTINATARIO
+	char* text;			//TESTO DEL MESSAGGIO
+	unsigned int len;	//LUNGHEZZA DEL TESTO (COMPRESO IL '\0')
+	history_msg_t* history_msg;					//MESSAGGIO DELLA HISTORY PREALLOCATO (DESTINATARIO UTENTE)
+	char (*members)[MAX_NAME_LENGTH+1];			//MEMBRI DEL GRUPPO DESTINATARIO (SE IL MITTENTE NE È MEMBRO)
+	int num_members;
+	wire_packed_t packed;							//TESTO COMPRESSO IN ANTICIPO (DESTINATARIO UTENTE)
+} batch_entry_t;
+
+static op_res_t check_sender(unsigned int fd, message_t msg, int* user_id);
+
+/* A PARITÀ DI BLOCCO L'ORDINE DELLA RICHIESTA VIENE MANTENUTO (I MESSAGGI ALLO STESSO DESTINATARIO ARRIVANO IN ORDINE) */
+static int cmp_batch_entry(const void* a, const void* b) {
+	const batch_entry_t* e1 = a;
+	const batch_entry_t* e2 = b;
+	if (e1 -> block != e2 -> block) return e1 -> block - e2 -> block;
+	return e1 -> index - e2 -> index;
+}
+
+/*
+	Consegna il messaggio entry al destinatario (mutua esclusione sul blocco logico del destinatario acquisita):
+	lo invia se il destinatario è connesso e inserisce nella sua history il messaggio preallocato
+*/
+static void deliver_batch_entry(char* sender, user_data_t* user_data, batch_entry_t* entry, int* num_sended, int* num_not_sended) {
+	message_t message;					//MESSAGGIO DA INVIARE
+	boolean_t sended = FALSE;			//TRUE SE E SOLO SE IL MESSAGGIO È STATO INVIATO AL DESTINATARIO
+	int user_id, fd_receiver = -1;
+
+	setHeader(&message.hdr, TXT_MESSAGE, sender);
+	setData(&message.data, entry -> nick, entry -> text, entry -> len);
+	get_id(user_data, &user_id);
+
+	LP_LOCK(LP_FD, user_id % MaxConnections, fd_mtx + (user_id % MaxConnections));
+	get_fd(user_data, &fd_receiver);
+	if (fd_receiver != -1 && send_reply_packed(-1, fd_receiver, &(message.hdr), &(message.data), &(entry -> packed)) != -1)
+		sended = TRUE;
+	LP_UNLOCK(LP_FD, user_id % MaxConnections, fd_mtx + (user_id % MaxConnections));
+
+	if (sended == TRUE) (*num_sended)++;
+	else (*num_not_sended)++;
+
+	set_sended(entry -> history_msg, sended);
+	insert_message(user_data, entry -> history_msg);
+	entry -> history_msg = NULL;
+}
+
+/*
+	Dealloca i messaggi preallocati e i membri dei gruppi di num_entries elementi di POSTTXTBATCH_OP
+*/
+static void free_batch_entries(batch_entry_t* entries, unsigned int num_entries) {
+	for (unsigned int i = 0; i < num_entries; i++) {
+		if (entries[i].history_msg) free_history_message(entries[i].history_msg);
+		if (entries[i].members) free(entries[i].members);
+		wire_packed_free(&(entries[i].packed));
+	}
+	free(entries);
+}
+
+op_res_t posttxtbatch_op(unsigned int fd, message_t msg) {
+	op_res_t result = REQUEST_OK;						//RISULTATO DELL'OPERAZIONE
+	op_res_t func_res;									//RISULTATO DELLE CHIAMATE DI FUNZIONE
+	message_hdr_t header_reply;						//HEADER DELLA RISPOSTA
+	message_data_t data_reply;							//DATI DELLA RISPOSTA (ESITI DEI MESSAGGI)
+	message_t message_to_send;							//MESSAGGIO DA INVIARE
+	batch_entry_t* entries = NULL;					//MESSAGGI ORDINATI PER BLOCCO LOGICO DEL DESTINATARIO
+	unsigned char* status = NULL;						//ESITO DI OGNI MESSAGGIO
+	unsigned int num_entries = 0;						//NUMERO DI MESSAGGI
+	user_data_t* user_data;								//DATI E INFO DEL DESTINATARIO
+	int user_id_sender = -1;							//ID DEL SENDER
+	int num_sended = 0, num_not_sended = 0;		//NUMERO DI MESSAGGI INVIATI E NON INVIATI
+	int sended, not_sended;								//MESSAGGI INVIATI E NON INVIATI AD UN GRUPPO
+	int is_member, block;
+	unsigned int i, j;
+	size_t off;
+	int err = 0;
+
+	/* INIZIO CONTROLLO PARAMETRI */
+	if (fd < 0) return ILLEGAL_ARGUMENT;
+
+	if ((result = check_sender(fd, msg, &user_id_sender)) != REQUEST_OK) return result;
+
+	if (msg.data.buf != NULL && msg.data.hdr.len > sizeof(unsigned int))
+		memcpy(&num_entries, msg.data.buf, sizeof(unsigned int));
+	if (num_entries == 0 || num_entries > (msg.data.hdr.len - sizeof(unsigned int))/BATCH_ENTRY_HDR_SIZE) err = 1;
+	else {
+		entries = (batch_entry_t*) calloc(num_entries, sizeof(batch_entry_t));
+		status = (unsigned char*) malloc(num_entries*sizeof(unsigned char));
+		if (entries == NULL || status == NULL) {
+			if (entries) free(entries);
+			if (status) free(status);
+			setHeader(&header_reply, OP_FAIL, "");
+			send_reply(user_id_sender, fd, &header_reply, NULL);
+			update_stats(0,0,0,0,0,0,1);
+			return SYSTEM_ERROR;
+		}
+	}
+	/* OGNI DESTINATARIO E OGNI TESTO DEVONO ESSERE TERMINATI DA '\0' E CONTENUTI NELLA PARTE DATI */
+	off = sizeof(unsigned int);
+	for (i = 0; i < num_entries && !err; i++) {
+		if (msg.data.hdr.len - off < BATCH_ENTRY_HDR_SIZE) {
+			err = 1;
+			break;
+		}
+		entries[i].index = i;
+		entries[i].nick = msg.data.buf + off;
+		memcpy(&(entries[i].len), msg.data.buf + off + MAX_NAME_LENGTH+1, sizeof(unsigned int));
+		entries[i].text = msg.data.buf + off + BATCH_ENTRY_HDR_SIZE;
+		off += BATCH_ENTRY_HDR_SIZE;
+		if (memchr(entries[i].nick, '\0', MAX_NAME_LENGTH+1) == NULL || entries[i].len == 0 || entries[i].len > msg.data.hdr.len - off
+			 || entries[i].text[entries[i].len-1] != '\0') {
+			err = 1;
+			break;
+		}
+		off += entries[i].len;
+		entries[i].block = users_table_block(users, entries[i].nick);
+		status[i] = (entries[i].len > MaxMsgSize) ? OP_MSG_TOOLONG : OP_NICK_UNKNOWN;
+	}
+	if (err) {
+		if (entries) free(entries);
+		if (status) free(status);
+		setHeader(&header_reply, OP_FAIL, "");
+		if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+	/* FINE CONTROLLO PARAMETRI */
+
+	/* PRIMA DI CONSEGNARE QUALSIASI MESSAGGIO RISOLVO I GRUPPI DESTINATARI E PREALLOCO I MESSAGGI DELLE HISTORY DEGLI
+	 * UTENTI (I NOMI DEI GRUPPI NON COINCIDONO CON QUELLI DEGLI UTENTI): UN ERRORE DI ALLOCAZIONE NON LASCIA LA RICHIESTA
+	 * CONSEGNATA IN PARTE */
+	for (i = 0; i < num_entries && !err; i++) {
+		if (status[i] == OP_MSG_TOOLONG) continue;
+		is_member = 0;
+		func_res = lookup_group(entries[i].nick, msg.hdr.sender, &(entries[i].members), &(entries[i].num_members), &is_member);
+		if (func_res == SYSTEM_ERROR) err = 1;
+		else if (func_res == NOT_FOUND) {
+			setHeader(&message_to_send.hdr, TXT_MESSAGE, msg.hdr.sender);
+			setData(&message_to_send.data, entries[i].nick, entries[i].text, entries[i].len);
+			if ((entries[i].history_msg = init_history_message(message_to_send, FALSE)) == NULL) err = 1;
+			else wire_pack(&message_to_send.data, &(entries[i].packed));
+		}
+	}
+	if (err) {
+		free_batch_entries(entries, num_entries);
+		free(status);
+		setHeader(&header_reply, OP_FAIL, "");
+		send_reply(user_id_sender, fd, &header_reply, NULL);
+		update_stats(0,0,0,0,0,0,1);
+		return SYSTEM_ERROR;
+	}
+
+	/* CONSEGNO I MESSAGGI AGLI UTENTI ACQUISENDO LA MUTEX DI OGNI BLOCCO LOGICO UNA SOLA VOLTA */
+	qsort(entries, num_entries, sizeof(batch_entry_t), cmp_batch_entry);
+	for (i = 0; i < num_entries; i = j) {
+		block = entries[i].block;
+		users_table_lock_block(users, block);
+		for (j = i; j < num_entries && entries[j].block == block; j++) {
+			if (entries[j].history_msg == NULL) continue;
+			user_data = get_user_data(users, entries[j].nick);
+			if (user_data == NULL) continue;
+			deliver_batch_entry(msg.hdr.sender, user_data, entries + j, &num_sended, &num_not_sended);
+			status[entries[j].index] = OP_OK;
+		}
+		users_table_unlock_block(users, block);
+	}
+
+	/* CONSEGNO I MESSAGGI AI GRUPPI, DOPO UN ERRORE DI ALLOCAZIONE I MESSAGGI NON CONSEGNATI HANNO ESITO OP_FAIL */
+	for (i = 0; i < num_entries; i++) {
+		if (entries[i].members == NULL) continue;
+		if (err) {
+			status[entries[i].index] = OP_FAIL;
+			continue;
+		}
+		setHeader(&message_to_send.hdr, TXT_MESSAGE, msg.hdr.sender);
+		setData(&message_to_send.data, entries[i].nick, entries[i].text, entries[i].len);
+		if (fanout_message(&message_to_send, entries[i].members, entries[i].num_members, NULL, NULL, &sended, &not_sended) == -1) {
+			status[entries[i].index] = OP_FAIL;
+			err = 1;
+		}
+		else {
+			status[entries[i].index] = OP_OK;
+			num_sended += sended;
+			num_not_sended += not_sended;
+		}
+	}
+	free_batch_entries(entries, num_entries);
+
+	/* VERIFICO IL BUDGET DI MEMORIA DELLE HISTORY */
+	history_budget_enforce(users);
+
+	/* INVIO AL MITTENTE IL VETTORE DEGLI ESITI (ANCHE DOPO UN ERRORE: I MESSAGGI CONSEGNATI HANNO ESITO OP_OK) */
+	setHeader(&header_reply, OP_OK, "");
+	setData(&data_reply, "", (char*)status, num_entries);
+	if (send_reply(user_id_sender, fd, &header_reply, &data_reply) == -1) err = 1;
+	free(status);
+
+	/* AGGIORNAMENTO STATISTICHE */
+	update_stats(0,0,num_sended,num_not_sended,0,0,0);
+	if (err) {
+		update_stats(0,0,0,0,0,0,1);
+		return SYSTEM_ERROR;
+	}
+
+	LOGGER(LOGGER_DEBUG, "%u messaggi inviati da %s con una sola richiesta", num_entries, msg.hdr.sender);
+
+	return result;
+}
+
+/*
+	Invia un file ad un utente o ad un gruppo. Il contenuto è file_content oppure (se file_content == NULL)
+	il file parziale part_path di un caricamento a blocchi, che viene spostato nello store
+*/
+static op_res_t post_file(unsigned int fd, message_t msg, message_data_t* file_content, char* part_path) {
    op_res_t result = REQUEST_OK;			//RISULTATO DELL'OPERAZIONE
    message_hdr_t header_reply;			//HEADER DELLA RISPOSTA
    message_t message_to_send;				//MESSAGGIO DA INVIARE
    user_data_t* user_data_sender;		//INFO E DATI DEL SENDER
    user_data_t* user_data_receiver;		//INFO E DATI DEL RECEIVER
-   history_msg_t* history_msg;			//MESSAGGIO DA INSERIRE NELLA HISTORY
-   char file_path[2048];					//PATH DEL FILE		
-   char file_name[1024];					//NOME DEL FILE
-   FILE* file = NULL;						//PUNTATORE ALLA STRUTTURA DATI FILE DEL FILE file_name
+   char file_key[STORE_KEY_LENGTH];		//CHIAVE DEL FILE NELLO STORE
+   char receiver[MAX_NAME_LENGTH+1];	//DESTINATARIO (SE NON È UN GRUPPO)
+   unsigned char status[1];				//BIT SETTATO SE IL DESTINATARIO È REGISTRATO
+   int num_sended, num_not_sended;		//NUMERO DI DESTINATARI A CUI LA NOTIFICA È STATA/NON È STATA INVIATA
    int user_id_sender = -1;				//ID DEL SENDER
-   int user_id_receiver = -1;				//ID DEL RECEIVER
-   boolean_t sended = FALSE;				//TRUE SE E SOLO SE IL MESSAGGIO È STATO INVIATO
+   op_res_t func_res, func_res_put;		//RISULTATO DELLE CHIAMATE DI FUNZIONE
+   char (*members)[MAX_NAME_LENGTH+1] = NULL;	//MEMBRI DEL GRUPPO DESTINATARIO
+   int num_members = 0;						//NUMERO DI MEMBRI DEL GRUPPO DESTINATARIO
+   int is_member = 0;						//UGUALE A 1 SE E SOLO SE IL MITTENTE È MEMBRO DEL GRUPPO DESTINATARIO
 
    /* INIZIO CONTROLLO PARAMETRI */
 	if (fd < 0) return ILLEGAL_ARGUMENT;
@@ -803,7 +1392,7 @@ op_res_t postfile_op(unsigned int fd, message_t msg, message_data_t file_content
 		return result;
 	}
 
-   if (!file_content.buf) {
+   if (file_content != NULL && !file_content -> buf) {
       setHeader(&header_reply, OP_FAIL, "");
 		if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
 		else result = CLIENT_ERROR;
@@ -811,7 +1400,7 @@ op_res_t postfile_op(unsigned int fd, message_t msg, message_data_t file_content
 		return result;
    }
 
-   if (file_content.hdr.len > (MaxFileSize*1000)) {
+   if (file_content != NULL && file_content -> hdr.len > (MaxFileSize*1000)) {
       setHeader(&header_reply, OP_MSG_TOOLONG, "");
 		if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
 		else result = CLIENT_ERROR;
@@ -846,175 +1435,421 @@ op_res_t postfile_op(unsigned int fd, message_t msg, message_data_t file_content
 	}
 	users_table_unlock(users, msg.hdr.sender);
 
-   users_table_lock(users, msg.data.hdr.receiver);
-   /* CONTROLLO CHE IL DESTINATARIO SIA REGISTRATO */
-   user_data_receiver = get_user_data(users, msg.data.hdr.receiver);
-   if (user_data_receiver == NULL) {
-      users_table_unlock(users, msg.data.hdr.receiver);
+   /* SE IL DESTINATARIO È UN GRUPPO IL FILE VIENE INVIATO A TUTTI I SUOI MEMBRI */
+   func_res = lookup_group(msg.data.hdr.receiver, msg.hdr.sender, &members, &num_members, &is_member);
+   if (func_res == SYSTEM_ERROR) {
+      setHeader(&header_reply, OP_FAIL, "");
+      send_reply(user_id_sender, fd, &header_reply, NULL);
+      update_stats(0,0,0,0,0,0,1);
+      return SYSTEM_ERROR;
+   }
+   /* SOLO I MEMBRI DEL GRUPPO POSSONO INVIARE FILE AL GRUPPO */
+   if (func_res == FOUND && !is_member) {
       setHeader(&header_reply, OP_NICK_UNKNOWN, "");
       if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
       else result = CLIENT_ERROR;
       update_stats(0,0,0,0,0,0,1);
-		return result;
+      return result;
    }
-   /* RECUPERO L'ID DEL DESTINATARIO */
-   get_id(user_data_receiver, &user_id_receiver);
-   users_table_unlock(users, msg.data.hdr.receiver);
-
-   /* PREPARO IL PATH DEL FILE */
-   memset(file_path, '\0', 1024);
-   strncpy(file_path, DirName, strlen(DirName));
-   strncat(file_path, "/", 1);
-   strncat(file_path, msg.data.buf, strlen(msg.data.buf));
-
-   char suffix[16];
-   memset(suffix, '\0', 16);
-   int i, open_error = 0;
-   pthread_mutex_lock(&dir_mtx);
-   struct stat st;
-   for (i = 1; i <= 128; i++) {
-      if (stat(file_path, &st) != -1) {
-         sprintf(suffix, "(%d)", i);
-         memset(file_path, '\0', 1024);
-         strncpy(file_path, DirName, strlen(DirName));
-         strncat(file_path, "/", 1);
-         strncat(file_path, msg.data.buf, strlen(msg.data.buf));
-         strncat(file_path, suffix, strlen(suffix));
-      }
-      else {
-         errno = 0;
-         file = fopen(file_path, "wb");
-         if (file == NULL && errno != ENOENT) open_error = 1;
-         break;
+
+   if (func_res == NOT_FOUND) {
+      users_table_lock(users, msg.data.hdr.receiver);
+      /* CONTROLLO CHE IL DESTINATARIO SIA REGISTRATO */
+      user_data_receiver = get_user_data(users, msg.data.hdr.receiver);
+      if (user_data_receiver == NULL) {
+         users_table_unlock(users, msg.data.hdr.receiver);
+         setHeader(&header_reply, OP_NICK_UNKNOWN, "");
+         if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+         else result = CLIENT_ERROR;
+         update_stats(0,0,0,0,0,0,1);
+         return result;
       }
+      users_table_unlock(users, msg.data.hdr.receiver);
    }
-   pthread_mutex_unlock(&dir_mtx);
 
-   memset(file_name, '\0', 1024);
-   strncpy(file_name, msg.data.buf, msg.data.hdr.len);
-   strncat(file_name, suffix, strlen(suffix));
-
-   if (open_error) {
+   /* SALVO IL FILE NELLO STORE (SE UN FILE CON LO STESSO CONTENUTO È GIÀ PRESENTE NON VIENE RISCRITTO) */
+   if (file_content != NULL) func_res_put = file_store_put(file_content -> buf, file_content -> hdr.len, file_key);
+   else func_res_put = file_store_put_file(part_path, file_key);
+   if (func_res_put != REQUEST_OK) {
+      if (members) free(members);
       setHeader(&header_reply, OP_FAIL, "");
       send_reply(user_id_sender, fd, &header_reply, NULL);
       update_stats(0,0,0,0,0,0,1);
 		return SYSTEM_ERROR;
    }
 
-   //se non c'è stato errore nell'apertura ma file è comunque null allora ci sono più di 128 file con lo stesso nome ==> fallisco
-   if (file == NULL) {
-      setHeader(&header_reply, OP_FAIL, "");
-      if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
-      else result = CLIENT_ERROR;
-      update_stats(0,0,0,0,0,0,1);
-		return result;
+   /* SE IL DESTINATARIO NON È UN GRUPPO L'UNICO DESTINATARIO È IL RECEIVER */
+   if (func_res == NOT_FOUND) {
+      members = &receiver;
+      num_members = 1;
+      memset(receiver, '\0', MAX_NAME_LENGTH+1);
+      strncpy(receiver, msg.data.hdr.receiver, MAX_NAME_LENGTH);
    }
 
-   if (fwrite(file_content.buf, sizeof(char), file_content.hdr.len, file) < file_content.hdr.len) {
-      fclose(file);
-      remove(file_path);
+   setHeader(&message_to_send.hdr, FILE_MESSAGE, msg.hdr.sender);
+   setData(&message_to_send.data, msg.data.hdr.receiver, msg.data.buf, strlen(msg.data.buf)+1); 
+
+   /* INVIO LA NOTIFICA AI DESTINATARI, OGNUNO DEI QUALI ACQUISISCE UN RIFERIMENTO AL FILE NELLO STORE */
+   memset(status, 0, sizeof(status));
+   int fanout_res = fanout_message(&message_to_send, members, num_members, file_key, status, &num_sended, &num_not_sended);
+   if (func_res == FOUND) free(members);
+   /* RILASCIO IL RIFERIMENTO ACQUISITO DA file_store_put (SE NESSUN DESTINATARIO HA RICEVUTO IL FILE VIENE RIMOSSO) */
+   file_store_release(file_key);
+   if (fanout_res == -1) {
       setHeader(&header_reply, OP_FAIL, "");
       send_reply(user_id_sender, fd, &header_reply, NULL);
       update_stats(0,0,0,0,0,0,1);
-		return SYSTEM_ERROR;
+      return SYSTEM_ERROR;
    }
 
-   fclose(file);
-   
-   setHeader(&message_to_send.hdr, FILE_MESSAGE, msg.hdr.sender);
-   setData(&message_to_send.data, msg.data.hdr.receiver, file_name, strlen(file_name)+1); 
+   /* IL DESTINATARIO POTREBBE ESSERSI DEREGISTRATO NEL FRATTEMPO */
+   if (func_res == NOT_FOUND && status[0] == 0) {
+		setHeader(&header_reply, OP_NICK_UNKNOWN, "");
+		if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+      return result;
+   }
 
-   /* INVIO IL MESSAGGIO SE E SOLO SE IL DESTINATARIO È CONNESSO */
-	pthread_mutex_lock(fd_mtx + (user_id_receiver % MaxConnections));
-	int fd_receiver = -1;
-	get_fd(user_data_receiver, &fd_receiver);
-	/* SE IL DESTINATARIO SI È DEREGISTRATO O SI È DISCONNESSO ALLORA fd_receiver = -1 */
-	if (fd_receiver != -1) {
-		if (send_reply(-1, fd_receiver, &message_to_send.hdr, &message_to_send.data) == -1) {
-         pthread_mutex_unlock(fd_mtx + (user_id_receiver % MaxConnections));
-         remove(file_path);
-         update_stats(0,0,0,0,0,0,1);
-		   return SYSTEM_ERROR;
+   /* VERIFICO IL BUDGET DI MEMORIA DELLE HISTORY */
+   history_budget_enforce(users);
+
+   /* INVIO IL MESSAGGIO DI RISPOSTA AL MITTENTE */
+	setHeader(&header_reply, OP_OK, "");
+	if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) {
+      update_stats(0,0,0,0,0,0,1);
+      return SYSTEM_ERROR;
+   }
+
+	/* AGGIORNAMENTO STATISTICHE */
+	update_stats(0,0,0,0,num_sended,num_not_sended,0);
+
+	if (func_res == FOUND) LOGGER(LOGGER_DEBUG, "File [%s] postato da %s per il gruppo %s con successo", msg.data.buf, msg.hdr.sender, msg.data.hdr.receiver);
+	else LOGGER(LOGGER_DEBUG, "File [%s] postato da %s per %s con successo", msg.data.buf, msg.hdr.sender, msg.data.hdr.receiver);
+
+	return result;
+}
+
+op_res_t postfile_op(unsigned int fd, message_t msg, message_data_t file_content) {
+   return post_file(fd, msg, &file_content, NULL);
+}
+
+/*
+	Verifica che il mittente della richiesta sia registrato e connesso e ne salva l'id in user_id.
+	In caso contrario invia la risposta di errore al client e ritorna CLIENT_ERROR (o SYSTEM_ERROR se l'invio fallisce)
+*/
+static op_res_t check_sender(unsigned int fd, message_t msg, int* user_id) {
+   message_hdr_t header_reply;		//HEADER DELLA RISPOSTA
+   user_data_t* user_data;				//INFO E DATI DELL'UTENTE
+   int current_fd;						//DESCRITTORE DELL'UTENTE
+   op_t op_reply = OP_OK;				//CODICE DELL'EVENTUALE RISPOSTA DI ERRORE
+
+   *user_id = -1;
+   if (msg.hdr.sender[0] == '\0' || strlen(msg.hdr.sender) > MAX_NAME_LENGTH) op_reply = OP_FAIL;
+   else {
+      users_table_lock(users, msg.hdr.sender);
+      user_data = get_user_data(users, msg.hdr.sender);
+      if (user_data == NULL) op_reply = OP_NICK_UNKNOWN;
+      else {
+         get_id(user_data, user_id);
+         get_fd(user_data, &current_fd);
+         if (current_fd == -1) op_reply = OP_FAIL;
       }
-		else sended = TRUE;
-	}
-	else {
-		sended = FALSE;
-	}
-	pthread_mutex_unlock(fd_mtx + (user_id_receiver % MaxConnections));
+      users_table_unlock(users, msg.hdr.sender);
+   }
+   if (op_reply == OP_OK) return REQUEST_OK;
 
-   /* INIZIALIZZO IL MESSAGGIO DA INSERIRE NELLA HISTORY */
-	history_msg = init_history_message(message_to_send, sended);
-   if (history_msg == NULL) {
-      remove(file_path);
+   setHeader(&header_reply, op_reply, "");
+   update_stats(0,0,0,0,0,0,1);
+   if (send_reply(*user_id, fd, &header_reply, NULL) == -1) return SYSTEM_ERROR;
+   return CLIENT_ERROR;
+}
+
+/*
+	Invia al client la risposta op con il caricamento id e la dimensione ricevuta size
+*/
+static int send_upload_reply(int user_id, unsigned int fd, op_t op, unsigned long id, unsigned long size) {
+   message_hdr_t header_reply;
+   message_data_t data_reply;
+   upload_chunk_t chunk;
+
+   chunk.id = id;
+   chunk.offset = size;
+   setHeader(&header_reply, op, "");
+   setData(&data_reply, "", (char*)&chunk, sizeof(upload_chunk_t));
+
+   return send_reply(user_id, fd, &header_reply, &data_reply);
+}
+
+op_res_t uploadbegin_op(unsigned int fd, message_t msg) {
+   op_res_t result = REQUEST_OK;			//RISULTATO DELL'OPERAZIONE
+   message_hdr_t header_reply;			//HEADER DELLA RISPOSTA
+   int user_id = -1;							//ID DEL MITTENTE
+   unsigned long id;							//IDENTIFICATIVO DEL CARICAMENTO
+   char (*members)[MAX_NAME_LENGTH+1] = NULL;	//MEMBRI DEL GRUPPO DESTINATARIO
+   int num_members = 0;						//NUMERO DI MEMBRI DEL GRUPPO DESTINATARIO
+   int is_member = 0;						//UGUALE A 1 SE E SOLO SE IL MITTENTE È MEMBRO DEL GRUPPO DESTINATARIO
+
+   /* INIZIO CONTROLLO PARAMETRI */
+   if (fd < 0) return ILLEGAL_ARGUMENT;
+
+   if ((result = check_sender(fd, msg, &user_id)) != REQUEST_OK) return result;
+
+   if (strlen(msg.data.hdr.receiver) > MAX_NAME_LENGTH || !msg.data.buf || msg.data.hdr.len == 0 || msg.data.buf[msg.data.hdr.len-1] != '\0') {
       setHeader(&header_reply, OP_FAIL, "");
-      send_reply(user_id_sender, fd, &header_reply, NULL);
+      if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+      else result = CLIENT_ERROR;
       update_stats(0,0,0,0,0,0,1);
-		return SYSTEM_ERROR;
+      return result;
+   }
+   /* FINE CONTROLLO PARAMETRI */
+
+   /* IL DESTINATARIO DEVE ESISTERE GIÀ ALL'APERTURA (VIENE COMUNQUE VERIFICATO DI NUOVO ALLA CHIUSURA) */
+   op_res_t func_res = lookup_group(msg.data.hdr.receiver, msg.hdr.sender, &members, &num_members, &is_member);
+   if (members) free(members);
+   if (func_res == NOT_FOUND) {
+      users_table_lock(users, msg.data.hdr.receiver);
+      if (get_user_data(users, msg.data.hdr.receiver) == NULL) func_res = CLIENT_ERROR;
+      users_table_unlock(users, msg.data.hdr.receiver);
+   }
+   else if (func_res == FOUND && !is_member) func_res = CLIENT_ERROR;
+   if (func_res == SYSTEM_ERROR || func_res == CLIENT_ERROR) {
+      setHeader(&header_reply, (func_res == SYSTEM_ERROR) ? OP_FAIL : OP_NICK_UNKNOWN, "");
+      if (send_reply(user_id, fd, &header_reply, NULL) == -1 || func_res == SYSTEM_ERROR) result = SYSTEM_ERROR;
+      else result = CLIENT_ERROR;
+      update_stats(0,0,0,0,0,0,1);
+      return result;
    }
 
-   /* ALLOCO IL NOME DEL FILE */
-   char* str = (char*) malloc((strlen(file_name)+1)*sizeof(char));
-   if (str == NULL) {
-      remove(file_path);
+   func_res = upload_begin(msg.hdr.sender, msg.data.hdr.receiver, msg.data.buf, &id);
+   if (func_res != REQUEST_OK) {
+      /* TROPPI CARICAMENTI APERTI ==> LA CONNESSIONE RESTA APERTA, IL CLIENT PUÒ COMPLETARNE O ATTENDERNE LA SCADENZA */
       setHeader(&header_reply, OP_FAIL, "");
-		send_reply(user_id_sender, fd, &header_reply, NULL);
-		update_stats(0,0,0,0,0,0,1);
+      update_stats(0,0,0,0,0,0,1);
+      if (send_reply(user_id, fd, &header_reply, NULL) == -1 || func_res != CLIENT_ERROR) return SYSTEM_ERROR;
+      return REQUEST_OK;
+   }
+
+   if (send_upload_reply(user_id, fd, OP_OK, id, 0) == -1) {
+      update_stats(0,0,0,0,0,0,1);
       return SYSTEM_ERROR;
    }
-   memset(str, '\0', strlen(file_name)+1);
-   strncpy(str, file_name, strlen(file_name));
 
-	/* INSERISCO IL MESSAGGIO NELLA HISTORY DEL DESTINATARIO */
-	users_table_lock(users, msg.data.hdr.receiver);
-	/* user_data_receiver POTREBBE ESSERE DIVENTATO NULL SE IL DESTINATARIO SI È DEREGISTRATO */
-	if (user_data_receiver == NULL) {
-		users_table_unlock(users, msg.data.hdr.receiver);
-      remove(file_path);
-		free_history_message(history_msg);
-      free(str);
-		setHeader(&header_reply, OP_NICK_UNKNOWN, "");
-		if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
-		else result = CLIENT_ERROR;
-		update_stats(0,0,0,0,0,0,1);
+   LOGGER(LOGGER_DEBUG, "Caricamento %lu del file [%s] aperto da %s", id, msg.data.buf, msg.hdr.sender);
+
+   return result;
+}
+
+op_res_t uploadchunk_op(unsigned int fd, message_t msg) {
+   op_res_t result = REQUEST_OK;			//RISULTATO DELL'OPERAZIONE
+   message_hdr_t header_reply;			//HEADER DELLA RISPOSTA
+   int user_id = -1;							//ID DEL MITTENTE
+   upload_chunk_t chunk;					//CARICAMENTO E POSIZIONE DEL BLOCCO
+   size_t len;									//LUNGHEZZA DEL BLOCCO
+   unsigned long size = 0;					//DIMENSIONE RICEVUTA
+
+   /* INIZIO CONTROLLO PARAMETRI */
+   if (fd < 0) return ILLEGAL_ARGUMENT;
+
+   if ((result = check_sender(fd, msg, &user_id)) != REQUEST_OK) return result;
+
+   if (!msg.data.buf || msg.data.hdr.len < sizeof(upload_chunk_t)) {
+      setHeader(&header_reply, OP_FAIL, "");
+      if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+      else result = CLIENT_ERROR;
+      update_stats(0,0,0,0,0,0,1);
       return result;
-	}
-	insert_message(user_data_receiver, history_msg);
-   if (insert_file_name(user_data_receiver, str) == SYSTEM_ERROR) {
-      users_table_unlock(users, msg.data.hdr.receiver);
-      remove(file_path);
-      free(str);
-		setHeader(&header_reply, OP_FAIL, "");
-		send_reply(user_id_sender, fd, &header_reply, NULL);
+   }
+   memcpy(&chunk, msg.data.buf, sizeof(upload_chunk_t));
+   len = msg.data.hdr.len - sizeof(upload_chunk_t);
+
+   if (chunk.offset + len > (unsigned long)(MaxFileSize*1000)) {
+      setHeader(&header_reply, OP_MSG_TOOLONG, "");
+      if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+      else result = CLIENT_ERROR;
       update_stats(0,0,0,0,0,0,1);
-		return SYSTEM_ERROR;
+      return result;
    }
-	users_table_unlock(users, msg.data.hdr.receiver);
+   /* FINE CONTROLLO PARAMETRI */
 
-   /* INVIO IL MESSAGGIO DI RISPOSTA AL MITTENTE */
-	setHeader(&header_reply, OP_OK, "");
-	if (send_reply(user_id_sender, fd, &header_reply, NULL) == -1) {
+   op_res_t func_res = upload_append(chunk.id, msg.hdr.sender, chunk.offset, msg.data.buf + sizeof(upload_chunk_t), len, &size);
+   if (func_res == NOT_FOUND) {
+      setHeader(&header_reply, OP_FAIL, "");
+      if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+      else result = CLIENT_ERROR;
+      update_stats(0,0,0,0,0,0,1);
+      return result;
+   }
+   /* POSIZIONE ERRATA: IL CLIENT RICEVE LA DIMENSIONE RICEVUTA E PUÒ RIPRENDERE DA LÌ */
+   if (func_res == CLIENT_ERROR) {
+      update_stats(0,0,0,0,0,0,1);
+      if (send_upload_reply(user_id, fd, OP_FAIL, chunk.id, size) == -1) return SYSTEM_ERROR;
+      return REQUEST_OK;
+   }
+   if (func_res != REQUEST_OK) {
+      send_upload_reply(user_id, fd, OP_FAIL, chunk.id, size);
       update_stats(0,0,0,0,0,0,1);
       return SYSTEM_ERROR;
    }
 
-	/* AGGIORNAMENTO STATISTICHE */
-	if (sended == TRUE) update_stats(0,0,0,0,1,0,0);
-	else if (sended == FALSE) update_stats(0,0,0,0,0,1,0);
+   if (send_upload_reply(user_id, fd, OP_OK, chunk.id, size) == -1) {
+      update_stats(0,0,0,0,0,0,1);
+      return SYSTEM_ERROR;
+   }
 
-	printf("File [%s] postato da %s per %s con successo\n", msg.data.buf, msg.hdr.sender, msg.data.hdr.receiver);
+   return result;
+}
 
-	return result;
+op_res_t uploadcommit_op(unsigned int fd, message_t msg) {
+   op_res_t result = REQUEST_OK;			//RISULTATO DELL'OPERAZIONE
+   message_hdr_t header_reply;			//HEADER DELLA RISPOSTA
+   message_t file_msg;						//RICHIESTA DI INVIO DEL FILE CARICATO
+   int user_id = -1;							//ID DEL MITTENTE
+   upload_chunk_t chunk;					//CARICAMENTO E DIMENSIONE TOTALE DEL FILE
+   char receiver[MAX_NAME_LENGTH+1];	//DESTINATARIO DEL FILE
+   char* name = NULL;						//NOME DEL FILE
+   char part_path[1200];					//PATH DEL FILE PARZIALE
+
+   /* INIZIO CONTROLLO PARAMETRI */
+   if (fd < 0) return ILLEGAL_ARGUMENT;
+
+   if ((result = check_sender(fd, msg, &user_id)) != REQUEST_OK) return result;
+
+   if (!msg.data.buf || msg.data.hdr.len != sizeof(upload_chunk_t)) {
+      setHeader(&header_reply, OP_FAIL, "");
+      if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+      else result = CLIENT_ERROR;
+      update_stats(0,0,0,0,0,0,1);
+      return result;
+   }
+   memcpy(&chunk, msg.data.buf, sizeof(upload_chunk_t));
+   /* FINE CONTROLLO PARAMETRI */
+
+   op_res_t func_res = upload_commit(chunk.id, msg.hdr.sender, chunk.offset, receiver, &name, part_path, sizeof(part_path));
+   if (func_res != REQUEST_OK) {
+      /* DIMENSIONE ERRATA: IL CARICAMENTO RESTA APERTO E PUÒ ESSERE COMPLETATO */
+      setHeader(&header_reply, OP_FAIL, "");
+      update_stats(0,0,0,0,0,0,1);
+      if (send_reply(user_id, fd, &header_reply, NULL) == -1) return SYSTEM_ERROR;
+      return (func_res == CLIENT_ERROR) ? REQUEST_OK : CLIENT_ERROR;
+   }
+
+   /* IL FILE CARICATO VIENE INVIATO COME CON POSTFILE_OP, SPOSTANDO IL FILE PARZIALE NELLO STORE */
+   memset(&file_msg, 0, sizeof(message_t));
+   setHeader(&file_msg.hdr, POSTFILE_OP, msg.hdr.sender);
+   setData(&file_msg.data, receiver, name, strlen(name)+1);
+   result = post_file(fd, file_msg, NULL, part_path);
+
+   /* SE L'INVIO È FALLITO PRIMA DELLO SPOSTAMENTO IL FILE PARZIALE È ANCORA PRESENTE */
+   unlink(part_path);
+   free(name);
+
+   return result;
 }
 
-op_res_t getfile_op(unsigned int fd, message_t msg) {
+/*
+	Restituisce (con un riferimento acquisito, da rilasciare con file_cache_release) il contenuto del file
+	con chiave file_key: se il file non è nella cache viene letto dallo store e inserito nella cache.
+	Ritorna NULL in caso di errore di lettura o di allocazione della memoria
+*/
+static file_cache_entry_t* load_stored_file(char* file_key) {
+	char* buf;
+	size_t n;
+
+	file_cache_entry_t* entry = file_cache_lookup(file_key);
+	if (entry != NULL) return entry;
+
+	if (file_store_load(file_key, &buf, &n) != REQUEST_OK) return NULL;
+
+	entry = file_cache_insert(file_key, buf, n);
+	if (entry == NULL) free(buf);
+
+	return entry;
+}
+
+/*
+	Legge dal file con chiave file_key il segmento richiesto da range e costruisce il buffer della risposta
+	(file_range_t seguita dai byte del segmento). Se il file è nella cache il segmento viene copiato dalla cache,
+	altrimenti viene letto con una lettura posizionale senza caricare l'intero file. Dei file compressi viene
+	decompresso solo il contenuto fino alla fine del segmento (se è l'intero file viene inserito nella cache).
+	Ritorna 0 in caso di successo, 1 se range -> offset supera la dimensione del file, -1 in caso di errore
+*/
+static int read_file_range(char* file_key, file_range_t* range, char** reply, size_t* reply_len) {
+	char file_path[1200];
+	struct stat st;
+	int fd_file = -1;
+	char* prefix = NULL;		//CONTENUTO DECOMPRESSO FINO ALLA FINE DEL SEGMENTO
+	size_t prefix_len, total;
+
+	file_cache_entry_t* entry = file_cache_lookup(file_key);
+	if (entry != NULL) range -> total = entry -> len;
+	else if (file_store_compressed(file_key)) {
+		size_t end = (range -> length == 0 || range -> length > (size_t)-1 - range -> offset) ? (size_t)-1 : range -> offset + range -> length;
+		if (file_store_load_prefix(file_key, end, &prefix, &prefix_len, &total) != REQUEST_OK) return -1;
+		range -> total = total;
+		/* CONTENUTO DECOMPRESSO PER INTERO ==> LO INSERISCO NELLA CACHE PER LE RICHIESTE SUCCESSIVE */
+		if (prefix_len == total && (entry = file_cache_insert(file_key, prefix, prefix_len)) != NULL) prefix = NULL;
+	}
+	else {
+		if (file_store_path(file_key, file_path, sizeof(file_path)) != REQUEST_OK) return -1;
+		if ((fd_file = open(file_path, O_RDONLY)) == -1) return -1;
+		if (fstat(fd_file, &st) == -1) {
+			close(fd_file);
+			return -1;
+		}
+		range -> total = st.st_size;
+	}
+
+	int result = 0;
+	if (range -> offset > range -> total) result = 1;
+	else {
+		/* LUNGHEZZA 0 O OLTRE LA FINE DEL FILE ==> FINO ALLA FINE DEL FILE */
+		if (range -> length == 0 || range -> length > range -> total - range -> offset)
+			range -> length = range -> total - range -> offset;
+
+		*reply_len = sizeof(file_range_t) + range -> length;
+		*reply = (char*) malloc(*reply_len);
+		if (*reply == NULL) result = -1;
+	}
+
+	if (result == 0 && entry != NULL) memcpy(*reply + sizeof(file_range_t), entry -> buf + range -> offset, range -> length);
+	else if (result == 0 && prefix != NULL) memcpy(*reply + sizeof(file_range_t), prefix + range -> offset, range -> length);
+	else if (result == 0) {
+		size_t done = 0;
+		ssize_t n;
+		while (done < range -> length) {
+			n = pread(fd_file, *reply + sizeof(file_range_t) + done, range -> length - done, range -> offset + done);
+			if (n <= 0) {
+				result = -1;
+				break;
+			}
+			done += n;
+		}
+	}
+	if (entry) file_cache_release(entry);
+	if (prefix) free(prefix);
+	if (fd_file != -1) close(fd_file);
+
+	if (result == -1 && *reply) {
+		free(*reply);
+		*reply = NULL;
+	}
+	if (result != 0) return result;
+	memcpy(*reply, range, sizeof(file_range_t));
+
+	return 0;
+}
+
+/*
+	Invia all'utente il file file_name (se range == NULL l'intero file, altrimenti il segmento richiesto)
+*/
+static op_res_t send_stored_file(unsigned int fd, message_t msg, char* file_name, file_range_t* range) {
    op_res_t result = REQUEST_OK;		//RISULTATO OPERAZIONE
    message_hdr_t header_reply;		//HEADER DELLA RISPOSTA
    message_data_t data_reply;			//DATI DELLA RISPOSTA
    user_data_t* user_data;				//INFO E DATI DELL'UTENTE
    int user_id = -1;						//ID DELL'UTENTE
-   char* buf = NULL;						//CONTENUTO FILE
-   char file_path[1024];				//PATH DEL FILE
+   char file_key[STORE_KEY_LENGTH];	//CHIAVE DEL FILE NELLO STORE
 
    /* INIZIO CONTROLLO PARAMETRI */
    if (fd < 0) return ILLEGAL_ARGUMENT;
@@ -1052,8 +1887,8 @@ op_res_t getfile_op(unsigned int fd, message_t msg) {
 		update_stats(0,0,0,0,0,0,1);
       return result;
 	}
-   /* VERIFICO CHE IL FILE SIA DESTINATO ALL'UTENTE */
-   if (search_file_name(user_data, msg.data.buf) == NOT_FOUND) {
+   /* VERIFICO CHE IL FILE SIA DESTINATO ALL'UTENTE E RECUPERO LA SUA CHIAVE NELLO STORE */
+   if (get_file_key(user_data, file_name, file_key) != REQUEST_OK) {
       users_table_unlock(users, msg.hdr.sender);
       setHeader(&header_reply, OP_FAIL, "");
       if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
@@ -1062,91 +1897,110 @@ op_res_t getfile_op(unsigned int fd, message_t msg) {
       return result;
    }
 	users_table_unlock(users, msg.hdr.sender);
-	
-   /* PREPARO IL PATH DEL FILE */
-   memset(file_path, '\0', 1024);
-   strncpy(file_path, DirName, strlen(DirName));
-   strncat(file_path, "/", 1);
-   strncat(file_path, msg.data.buf, msg.data.hdr.len);
-   
-	//MUTEX QUI PROBABILMENTE NON NECESSARIA
-   pthread_mutex_lock(&dir_mtx);
-   FILE* file = fopen(file_path, "rb");
-   pthread_mutex_unlock(&dir_mtx);
 
-   if (file == NULL) {
-      setHeader(&header_reply, OP_FAIL, "");
-      send_reply(user_id, fd, &header_reply, NULL);
-      update_stats(0,0,0,0,0,0,1);
-      return SYSTEM_ERROR;
-   }
-	
-   if (fseek(file, SEEK_END, 0) == -1) {
-      fclose(file);
-      setHeader(&header_reply, OP_FAIL, "");
-      send_reply(user_id, fd, &header_reply, NULL);
-      update_stats(0,0,0,0,0,0,1);
-      return SYSTEM_ERROR;
-   }
-	
-   long file_size = ftell(file);
-   
-   rewind(file);
-   
-   buf = (char*) malloc((file_size+1)*sizeof(char));
-   if (!buf) {
-      fclose(file);
-      setHeader(&header_reply, OP_FAIL, "");
-      send_reply(user_id, fd, &header_reply, NULL);
-      update_stats(0,0,0,0,0,0,1);
-      return SYSTEM_ERROR;
-   }
-   memset(buf, '\0', file_size + 1);
+   if (range != NULL) {
+      /* LEGGO SOLO IL SEGMENTO RICHIESTO */
+      char* reply = NULL;
+      size_t reply_len = 0;
+      int res = read_file_range(file_key, range, &reply, &reply_len);
+      if (res != 0) {
+         /* SEGMENTO OLTRE LA FINE DEL FILE ==> LA CONNESSIONE RESTA APERTA, ERRORE DI LETTURA ==> CHIUDO LA CONNESSIONE */
+         setHeader(&header_reply, OP_FAIL, "");
+         if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+         else if (res == -1) result = CLIENT_ERROR;
+         update_stats(0,0,0,0,0,0,1);
+         return result;
+      }
 
-   int n = fread(buf, sizeof(char), file_size, file);
+      setHeader(&header_reply, OP_OK, "");
+      setData(&data_reply, "", reply, reply_len);
+      res = send_reply(user_id, fd, &header_reply, &data_reply);
+      free(reply);
+      if (res == -1) {
+         update_stats(0,0,0,0,0,0,1);
+         return SYSTEM_ERROR;
+      }
+
+      LOGGER(LOGGER_DEBUG, "Segmento [%lu, %lu) del file inviato a %s con successo", range -> offset, range -> offset + range -> length, msg.hdr.sender);
 
-   if (n < file_size && ferror(file) != 0) {
-      fclose(file);
-      free(buf);
+      return result;
+   }
+	
+   /* RECUPERO IL CONTENUTO DEL FILE DALLA CACHE O DAL DISCO */
+   file_cache_entry_t* entry = load_stored_file(file_key);
+   if (entry == NULL) {
       setHeader(&header_reply, OP_FAIL, "");
       send_reply(user_id, fd, &header_reply, NULL);
       update_stats(0,0,0,0,0,0,1);
       return SYSTEM_ERROR;
    }
 
-   fclose(file);
-
    setHeader(&header_reply, OP_OK, "");
-   setData(&data_reply, "", buf, strlen(buf)+1);
+   setData(&data_reply, "", entry -> buf, entry -> len);
    if (send_reply(user_id, fd, &header_reply, &data_reply) == -1) {
-      free(buf);
+      file_cache_release(entry);
       update_stats(0,0,0,0,0,0,1);
       return SYSTEM_ERROR;   
    }
 
-   free(buf);
+   file_cache_release(entry);
 
-   printf("File inviato a %s con successo\n", msg.hdr.sender);
+   LOGGER(LOGGER_DEBUG, "File inviato a %s con successo", msg.hdr.sender);
 
    return result;
 }
 
-op_res_t getprevmsgs_op(unsigned int fd, message_t msg) {
+op_res_t getfile_op(unsigned int fd, message_t msg) {
+   return send_stored_file(fd, msg, msg.data.buf, NULL);
+}
+
+op_res_t getfilerange_op(unsigned int fd, message_t msg) {
+   message_hdr_t header_reply;		//HEADER DELLA RISPOSTA
+   file_range_t range;					//SEGMENTO RICHIESTO DAL CLIENT
+
+   /* INIZIO CONTROLLO PARAMETRI */
+   if (fd < 0) return ILLEGAL_ARGUMENT;
+
+   /* IL NOME DEL FILE SEGUE IL SEGMENTO E DEVE ESSERE TERMINATO DA '\0' */
+   if (msg.data.buf == NULL || msg.data.hdr.len <= sizeof(file_range_t) || msg.data.buf[msg.data.hdr.len-1] != '\0') {
+      setHeader(&header_reply, OP_FAIL, "");
+      update_stats(0,0,0,0,0,0,1);
+      if (send_reply(-1, fd, &header_reply, NULL) == -1) return SYSTEM_ERROR;
+      return CLIENT_ERROR;
+   }
+   /* FINE CONTROLLO PARAMETRI */
+
+   memcpy(&range, msg.data.buf, sizeof(file_range_t));
+   range.total = 0;
+
+   return send_stored_file(fd, msg, msg.data.buf + sizeof(file_range_t), &range);
+}
+
+/*
+	Invia all'utente i messaggi della history con numero di sequenza maggiore di after_seq (al più max_msgs, 0 nessun limite).
+	La mutex sul blocco logico dell'utente viene acquisita solo per effettuare lo snapshot dei riferimenti ai messaggi 
+	e per aggiornarne lo stato alla fine dell'invio, non durante l'invio stesso.
+	Se paged == 0 la risposta contiene il numero di messaggi (size_t), altrimenti una struttura history_page_t
+*/
+static op_res_t send_history(unsigned int fd, message_t msg, unsigned long after_seq, size_t max_msgs, int paged) {
 	op_res_t result = REQUEST_OK;		//RISULTATO OPERAZIONE
 	op_res_t func_res;					//RISULTATO CHIAMATE DI FUNZIONE
 	message_hdr_t header_reply;		//HEADER DELLA RISPOSTA
 	message_data_t data_reply;			//DATI DELLA RISPOSTA
 	user_data_t* user_data;				//INFO E DATI DELL'UTENTE
-	history_msg_t* history_msg;		//MESSAGGIO DELLA HISTORY
+	history_msg_t** snapshot = NULL;	//RIFERIMENTI AI MESSAGGI DELLA HISTORY DA INVIARE
+	size_t n = 0;							//NUMERO DI MESSAGGI DELLO SNAPSHOT
+	size_t num_hist_msgs;				//NUMERO DI MESSAGGI INVIATI NELLA RISPOSTA (VERSIONE NON PAGINATA)
+	history_page_t page;					//INTESTAZIONE DELLA RISPOSTA (VERSIONE PAGINATA)
+	unsigned long latest_seq = 0;		//NUMERO DI SEQUENZA DELL'ULTIMO MESSAGGIO NELLA HISTORY
 	int user_id = -1;						//ID DELL'UTENTE
-	size_t* num_hist_msgs;				//NUMERO DI MESSAGGI NELLA HISTORY DELL'UTENTE
 	int num_messages_sended = 0;		//NUMERO DI MESSAGGI INVIATI
 	int num_files_sended = 0;			//NUMERO DI FILES INVIATI
 
 	/* INIZIO CONTROLLO PARAMETRI */
 	if (fd < 0) return ILLEGAL_ARGUMENT;
 
-	if (!msg.hdr.sender || strlen(msg.hdr.sender) > MAX_NAME_LENGTH) {
+	if (msg.hdr.sender[0] == '\0' || strlen(msg.hdr.sender) > MAX_NAME_LENGTH) {
 		setHeader(&header_reply, OP_FAIL, "");
 		if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
 		else result = CLIENT_ERROR;
@@ -1155,6 +2009,9 @@ op_res_t getprevmsgs_op(unsigned int fd, message_t msg) {
 	}
 	/* FINE CONTROLLO PARAMETRI */
 
+	/* SE LA HISTORY È SU DISCO LA RICARICO SENZA MANTENERE LA MUTEX SUL BLOCCO LOGICO DURANTE LA LETTURA */
+	history_budget_restore(users, msg.hdr.sender);
+
 	users_table_lock(users, msg.hdr.sender);
 	/* CONTROLLO SE L'UTENTE È REGISTRATO */
 	user_data = get_user_data(users, msg.hdr.sender);
@@ -1179,71 +2036,96 @@ op_res_t getprevmsgs_op(unsigned int fd, message_t msg) {
 		update_stats(0,0,0,0,0,0,1);
       return result;
 	}
-	int n;
-	get_num_hist_msgs(user_data, &n);
+	/* EFFETTUO LO SNAPSHOT DEI RIFERIMENTI AI MESSAGGI DA INVIARE */
+	func_res = history_snapshot(user_data, after_seq, max_msgs, &snapshot, &n);
+	get_last_seq(user_data, &latest_seq);
 	users_table_unlock(users, msg.hdr.sender);
 
-	/* APRO UN ITERATORE PER LA HISTORY */
-	history_iterator_t iterator;
-	func_res = history_iterator_open(user_data, &iterator);
 	if (func_res == SYSTEM_ERROR) {
 		setHeader(&header_reply, OP_FAIL, "");
 		send_reply(user_id, fd, &header_reply, NULL);
 		update_stats(0,0,0,0,0,0,1);
       return SYSTEM_ERROR;
 	}
-	
-	num_hist_msgs = (size_t*) malloc(sizeof(size_t));
-   if (num_hist_msgs == NULL) {
-      setHeader(&header_reply, OP_FAIL, "");
-		send_reply(user_id, fd, &header_reply, NULL);
-		update_stats(0,0,0,0,0,0,1);
-      return SYSTEM_ERROR;
-   }
-	*num_hist_msgs = n;
-	/* INVIO IL NUMERO DI MESSGGI NELLA HISTORY */
+
+	/* INVIO IL NUMERO DI MESSAGGI (O L'INTESTAZIONE DELLA PAGINA) */
 	setHeader(&header_reply, OP_OK, "");
-	setData(&data_reply, "", (char*)num_hist_msgs, sizeof(size_t*));
-	if (send_reply(user_id, fd, &header_reply, &data_reply) == -1) {
-      free(num_hist_msgs);
-		update_stats(0,0,0,0,0,0,1);
-      return SYSTEM_ERROR;
-   }
+	if (paged) {
+		page.nmsgs = n;
+		page.first_seq = (n > 0) ? snapshot[0] -> seq : 0;
+		page.last_seq = (n > 0) ? snapshot[n-1] -> seq : after_seq;
+		page.latest_seq = latest_seq;
+		setData(&data_reply, "", (char*)&page, sizeof(history_page_t));
+	}
+	else {
+		num_hist_msgs = n;
+		setData(&data_reply, "", (char*)&num_hist_msgs, sizeof(size_t));
+	}
+	if (send_reply(user_id, fd, &header_reply, &data_reply) == -1) 
+		result = SYSTEM_ERROR;
 
-	/* INVIO I MESSAGGI */
+	/* INVIO I MESSAGGI SENZA MANTENERE LA MUTEX SUL BLOCCO LOGICO DELL'UTENTE */
+	size_t num_sent = 0;
+	for (size_t i = 0; i < n && result != SYSTEM_ERROR; i++) {
+		if (send_reply(user_id, fd, &(snapshot[i] -> msg -> hdr), &(snapshot[i] -> msg -> data)) == -1) {
+			result = SYSTEM_ERROR;
+			break;
+		}
+		num_sent++;
+	}
+
+	/* AGGIORNO LO STATO DEI MESSAGGI INVIATI E RILASCIO I RIFERIMENTI */
    boolean_t sended;
 	users_table_lock(users, msg.hdr.sender);
-	for (size_t i = 0; i < (*num_hist_msgs); i++) {
-		history_msg = history_iterate(iterator);
-		if (history_msg == NULL) break;
-		if (send_reply(user_id, fd, &(history_msg -> msg -> hdr), &(history_msg -> msg -> data)) == -1) {
-			users_table_unlock(users, msg.hdr.sender);
-			history_iterator_close(iterator);
-         free(num_hist_msgs);
-		   update_stats(0,0,0,0,0,0,1);
-         return SYSTEM_ERROR;
-		}
-		get_sended(history_msg, &sended);
+	for (size_t i = 0; i < num_sent; i++) {
+		get_sended(snapshot[i], &sended);
 		if (sended == FALSE) {
-			set_sended(history_msg, TRUE);
-			if ((history_msg -> msg -> hdr).op == TXT_MESSAGE) num_messages_sended++;
-			else if ((history_msg -> msg -> hdr).op == FILE_MESSAGE) num_files_sended++;
+			set_sended(snapshot[i], TRUE);
+			if ((snapshot[i] -> msg -> hdr).op == TXT_MESSAGE) num_messages_sended++;
+			else if ((snapshot[i] -> msg -> hdr).op == FILE_MESSAGE) num_files_sended++;
 		}
 	}
+	history_snapshot_release(user_data, snapshot, n);
 	users_table_unlock(users, msg.hdr.sender);
 
-	history_iterator_close(iterator);
+	/* LO SNAPSHOT PUÒ AVER RICARICATO LA HISTORY DAL DISCO ==> VERIFICO IL BUDGET DI MEMORIA */
+	history_budget_enforce(users);
 
 	/* AGGIORNAMENTO STATISTICHE */
-	update_stats(0, 0, num_messages_sended, (-num_messages_sended), num_files_sended, (-num_files_sended), 0);
+	update_stats(0, 0, num_messages_sended, (-num_messages_sended), num_files_sended, (-num_files_sended), (result == SYSTEM_ERROR) ? 1 : 0);
 
-	free(num_hist_msgs);	
-	
-	printf("Messaggi della history di %s inviati con successo\n", msg.hdr.sender);
+	if (result == SYSTEM_ERROR)
+		return result;
+
+	LOGGER(LOGGER_DEBUG, "Messaggi della history di %s inviati con successo", msg.hdr.sender);
 
 	return result;
 }
 
+op_res_t getprevmsgs_op(unsigned int fd, message_t msg) {
+	return send_history(fd, msg, 0, 0, 0);
+}
+
+op_res_t getprevmsgs_after_op(unsigned int fd, message_t msg) {
+	message_hdr_t header_reply;		//HEADER DELLA RISPOSTA
+	history_cursor_t cursor;			//CURSORE RICHIESTO DAL CLIENT
+
+	/* INIZIO CONTROLLO PARAMETRI */
+	if (fd < 0) return ILLEGAL_ARGUMENT;
+
+	if (msg.data.buf == NULL || msg.data.hdr.len != sizeof(history_cursor_t)) {
+		setHeader(&header_reply, OP_FAIL, "");
+		update_stats(0,0,0,0,0,0,1);
+		if (send_reply(-1, fd, &header_reply, NULL) == -1) return SYSTEM_ERROR;
+		return CLIENT_ERROR;
+	}
+	/* FINE CONTROLLO PARAMETRI */
+
+	memcpy(&cursor, msg.data.buf, sizeof(history_cursor_t));
+
+	return send_history(fd, msg, cursor.after_seq, cursor.max_msgs, 1);
+}
+
 op_res_t usrlist_op(unsigned int fd, message_t msg) {
 	op_res_t result = REQUEST_OK;		//RISULTATO DELL'OPERAZIONE
 	message_hdr_t header_reply;		//HEADER DELLA RISPOSTA
@@ -1301,7 +2183,7 @@ op_res_t usrlist_op(unsigned int fd, message_t msg) {
 	}
 	users_list_unlock(users_list);
 
-   printf("Lista degli utenti connessi inviata a %s con successo\n", msg.hdr.sender);
+   LOGGER(LOGGER_DEBUG, "Lista degli utenti connessi inviata a %s con successo", msg.hdr.sender);
 
 	return result;
 }
@@ -1376,12 +2258,18 @@ op_res_t unregister_op(unsigned int fd, message_t msg) {
 
 	/* ELIMINO I FILE DESTINATI ALL'UTENTE ED ELIMINO L'UTENTE DALLA TABELLA DEGLI UTENTI */
 	users_table_lock(users, msg.hdr.sender);
-   remove_all_file(user_data, DirName);
-	pthread_mutex_lock(fd_mtx + (user_id % MaxConnections));
+   remove_all_file(user_data);
+   uploads_cancel_owner(msg.hdr.sender);
+	LP_LOCK(LP_FD, user_id % MaxConnections, fd_mtx + (user_id % MaxConnections));
 	users_table_delete(users, msg.hdr.sender);
-	pthread_mutex_unlock(fd_mtx + (user_id % MaxConnections));
+	LP_UNLOCK(LP_FD, user_id % MaxConnections, fd_mtx + (user_id % MaxConnections));
 	users_table_unlock(users, msg.hdr.sender);
 
+	/* ELIMINO L'UTENTE DAI GRUPPI DI CUI È MEMBRO */
+	groups_table_lock(users);
+	groups_remove_member_all(users, msg.hdr.sender);
+	groups_table_unlock(users);
+
 	/* ELIMINO L'ASSOCIAZIONE DESCRITTORE NICK */
 	fd_to_nick_table_lock(users, fd);
 	fd_to_nick_delete(users, fd);
@@ -1404,7 +2292,7 @@ op_res_t unregister_op(unsigned int fd, message_t msg) {
 	dec_num_users_conn(users);
 	num_users_unlock(users);
 
-   printf("%s deregistrato con successo\n", msg.hdr.sender);
+   LOGGER(LOGGER_DEBUG, "%s deregistrato con successo", msg.hdr.sender);
 
 	return result;
 }
@@ -1435,9 +2323,9 @@ op_res_t disconnect_op(unsigned int fd) {
 		user_data = get_user_data(users, nick);
 		if (user_data) {
 			get_id(user_data, &id);
-			pthread_mutex_lock(&(fd_mtx[id%MaxConnections]));
+			LP_LOCK(LP_FD, id%MaxConnections, &(fd_mtx[id%MaxConnections]));
 			set_fd(user_data, -1);
-			pthread_mutex_unlock(&(fd_mtx[id%MaxConnections]));
+			LP_UNLOCK(LP_FD, id%MaxConnections, &(fd_mtx[id%MaxConnections]));
 		}
 		else close(fd);
 		users_table_unlock(users, nick);
@@ -1453,7 +2341,218 @@ op_res_t disconnect_op(unsigned int fd) {
 	   num_users_unlock(users);
 	}
 
-   printf("Disconnessione di %s avvenuta con successo\n", nick);
+   LOGGER(LOGGER_DEBUG, "Disconnessione di %s avvenuta con successo", nick);
 
 	return REQUEST_OK;
 }
+
+op_res_t creategroup_op(unsigned int fd, message_t msg) {
+	op_res_t result = REQUEST_OK;		//RISULTATO DELL'OPERAZIONE
+	op_res_t func_res = REQUEST_OK;	//RISULTATO DELLE CHIAMATE DI FUNZIONE
+	message_hdr_t header_reply;		//HEADER DELLA RISPOSTA
+	user_data_t* user_data;				//INFO E DATI DELL'UTENTE
+	group_t* group = NULL;				//GRUPPO DA CREARE
+	char* name = NULL;					//NOME DEL GRUPPO (CHIAVE DELLA TABELLA DEI GRUPPI)
+	int user_id = -1;						//ID DELL'UTENTE
+
+	/* INIZIO CONTROLLO PARAMETRI */
+	if (fd < 0) return ILLEGAL_ARGUMENT;
+
+	if (msg.hdr.sender[0] == '\0' || strlen(msg.hdr.sender) > MAX_NAME_LENGTH) {
+		setHeader(&header_reply, OP_FAIL, "");
+		if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+
+	if (msg.data.hdr.receiver[0] == '\0' || strlen(msg.data.hdr.receiver) > MAX_NAME_LENGTH) {
+		setHeader(&header_reply, OP_FAIL, "");
+		if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+	/* FINE CONTROLLO PARAMETRI */
+
+	users_table_lock(users, msg.hdr.sender);
+	/* CONTROLLO SE L'UTENTE È REGISTRATO */
+	user_data = get_user_data(users, msg.hdr.sender);
+	if (user_data == NULL) {
+		users_table_unlock(users, msg.hdr.sender);
+		setHeader(&header_reply, OP_NICK_UNKNOWN, "");
+		if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+	/* RECUPERO L'ID DELL'UTENTE */
+	get_id(user_data, &user_id);
+	/* CONTROLLO SE L'UTENTE È CONNESSO */
+	int current_fd;
+	get_fd(user_data, &current_fd);
+	users_table_unlock(users, msg.hdr.sender);
+	if (current_fd == -1) {
+		setHeader(&header_reply, OP_FAIL, "");
+		if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+
+	/* INIZIALIZZO IL GRUPPO, IL CREATORE È IL PRIMO MEMBRO */
+	group = group_init(msg.data.hdr.receiver, msg.hdr.sender);
+	name = (char*) malloc((strlen(msg.data.hdr.receiver)+1)*sizeof(char));
+	if (group == NULL || name == NULL) {
+		if (group) group_destroy(group);
+		if (name) free(name);
+		setHeader(&header_reply, OP_FAIL, "");
+		send_reply(user_id, fd, &header_reply, NULL);
+		update_stats(0,0,0,0,0,0,1);
+		return SYSTEM_ERROR;
+	}
+	memset(name, '\0', strlen(msg.data.hdr.receiver)+1);
+	strncpy(name, msg.data.hdr.receiver, strlen(msg.data.hdr.receiver));
+
+	/* INSERISCO IL GRUPPO: IL NOME NON PUÒ COINCIDERE CON QUELLO DI UN UTENTE O DI UN ALTRO GRUPPO */
+	users_table_lock(users, msg.data.hdr.receiver);
+	groups_table_lock(users);
+	if (get_user_data(users, msg.data.hdr.receiver) != NULL) func_res = ALREADY_INSERTED;
+	else func_res = groups_table_insert(users, name, group);
+	groups_table_unlock(users);
+	users_table_unlock(users, msg.data.hdr.receiver);
+
+	if (func_res != REQUEST_OK) {
+		group_destroy(group);
+		free(name);
+		if (func_res == ALREADY_INSERTED) {
+			setHeader(&header_reply, OP_NICK_ALREADY, "");
+			if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+			else result = CLIENT_ERROR;
+		}
+		else {
+			setHeader(&header_reply, OP_FAIL, "");
+			send_reply(user_id, fd, &header_reply, NULL);
+			result = SYSTEM_ERROR;
+		}
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+
+	/* INVIO MESSAGGIO DI RISPOSTA */
+	setHeader(&header_reply, OP_OK, "");
+	if (send_reply(user_id, fd, &header_reply, NULL) == -1) {
+		update_stats(0,0,0,0,0,0,1);
+		return SYSTEM_ERROR;
+	}
+
+	LOGGER(LOGGER_DEBUG, "Gruppo %s creato da %s con successo", msg.data.hdr.receiver, msg.hdr.sender);
+
+	return result;
+}
+
+/*
+	Aggiunge (add == 1) o rimuove (add == 0) il mittente della richiesta dai membri del gruppo msg.data.hdr.receiver.
+	Il gruppo viene cancellato quando l'ultimo membro lo abbandona
+*/
+static op_res_t update_group_membership(unsigned int fd, message_t msg, int add) {
+	op_res_t result = REQUEST_OK;		//RISULTATO DELL'OPERAZIONE
+	op_res_t func_res;					//RISULTATO DELLE CHIAMATE DI FUNZIONE
+	message_hdr_t header_reply;		//HEADER DELLA RISPOSTA
+	user_data_t* user_data;				//INFO E DATI DELL'UTENTE
+	group_t* group;						//GRUPPO DA AGGIORNARE
+	int user_id = -1;						//ID DELL'UTENTE
+
+	/* INIZIO CONTROLLO PARAMETRI */
+	if (fd < 0) return ILLEGAL_ARGUMENT;
+
+	if (msg.hdr.sender[0] == '\0' || strlen(msg.hdr.sender) > MAX_NAME_LENGTH) {
+		setHeader(&header_reply, OP_FAIL, "");
+		if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+
+	if (msg.data.hdr.receiver[0] == '\0' || strlen(msg.data.hdr.receiver) > MAX_NAME_LENGTH) {
+		setHeader(&header_reply, OP_FAIL, "");
+		if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+	/* FINE CONTROLLO PARAMETRI */
+
+	users_table_lock(users, msg.hdr.sender);
+	/* CONTROLLO SE L'UTENTE È REGISTRATO */
+	user_data = get_user_data(users, msg.hdr.sender);
+	if (user_data == NULL) {
+		users_table_unlock(users, msg.hdr.sender);
+		setHeader(&header_reply, OP_NICK_UNKNOWN, "");
+		if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+	/* RECUPERO L'ID DELL'UTENTE */
+	get_id(user_data, &user_id);
+	/* CONTROLLO SE L'UTENTE È CONNESSO */
+	int current_fd;
+	get_fd(user_data, &current_fd);
+	users_table_unlock(users, msg.hdr.sender);
+	if (current_fd == -1) {
+		setHeader(&header_reply, OP_FAIL, "");
+		if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+		else result = CLIENT_ERROR;
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+
+	groups_table_lock(users);
+	/* CONTROLLO CHE IL GRUPPO ESISTA */
+	group = get_group(users, msg.data.hdr.receiver);
+	if (group == NULL) func_res = NOT_FOUND;
+	else if (add) func_res = group_add_member(group, msg.hdr.sender);
+	else {
+		func_res = group_remove_member(group, msg.hdr.sender);
+		if (func_res == REQUEST_OK && group -> num_members == 0)
+			groups_table_delete(users, msg.data.hdr.receiver);
+	}
+	groups_table_unlock(users);
+
+	if (func_res != REQUEST_OK) {
+		if (func_res == SYSTEM_ERROR) {
+			setHeader(&header_reply, OP_FAIL, "");
+			send_reply(user_id, fd, &header_reply, NULL);
+			result = SYSTEM_ERROR;
+		}
+		else {
+			/* ALREADY_INSERTED SE L'UTENTE È GIÀ MEMBRO, NOT_FOUND SE IL GRUPPO NON ESISTE O L'UTENTE NON NE È MEMBRO */
+			setHeader(&header_reply, (func_res == ALREADY_INSERTED) ? OP_NICK_ALREADY : OP_NICK_UNKNOWN, "");
+			if (send_reply(user_id, fd, &header_reply, NULL) == -1) result = SYSTEM_ERROR;
+			else result = CLIENT_ERROR;
+		}
+		update_stats(0,0,0,0,0,0,1);
+		return result;
+	}
+
+	/* INVIO MESSAGGIO DI RISPOSTA */
+	setHeader(&header_reply, OP_OK, "");
+	if (send_reply(user_id, fd, &header_reply, NULL) == -1) {
+		update_stats(0,0,0,0,0,0,1);
+		return SYSTEM_ERROR;
+	}
+
+	if (add) LOGGER(LOGGER_DEBUG, "%s aggiunto al gruppo %s con successo", msg.hdr.sender, msg.data.hdr.receiver);
+	else LOGGER(LOGGER_DEBUG, "%s rimosso dal gruppo %s con successo", msg.hdr.sender, msg.data.hdr.receiver);
+
+	return result;
+}
+
+op_res_t addgroup_op(unsigned int fd, message_t msg) {
+	return update_group_membership(fd, msg, 1);
+}
+
+op_res_t delgroup_op(unsigned int fd, message_t msg) {
+	return update_group_membership(fd, msg, 0);
+}
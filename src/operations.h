@@ -51,6 +51,17 @@ op_res_t posttxt_op(unsigned int fd, message_t msg);
  */ 
 op_res_t posttxtall_op(unsigned int fd, message_t msg);
 
+/** Invia un messaggio ad una lista di utenti registrati alla chat con un'unica richiesta
+ *  (vedere POSTTXTMULTI_OP in ops.h e MULTI_HDR_SIZE in message.h per il formato della parte dati)
+ * 
+ *  \param fd:  descrittore del client
+ *  \param msg: richiesta del client
+ *  \return:    se l'operazione ha avuto successo allora REQUEST_OK
+ *              se l'operazione ha fallito causa richiesta malformata dal client allora CLIENT_ERROR
+ *              se l'operazione ha fallito durante la gestione della memoria dinamica o in qualche chiamata di sistema allora SYSTEM_ERROR
+ */ 
+op_res_t posttxtmulti_op(unsigned int fd, message_t msg);
+
 /** Salva un file nella directory DirName e lo notifica, se connesso, al client ricevente
  * 
  *  \param fd:              descrittore del client
@@ -72,6 +83,70 @@ op_res_t postfile_op(unsigned int fd, message_t msg, message_data_t file_content
  */
 op_res_t getfile_op(unsigned int fd, message_t msg);
 
+/** Invia un segmento di un file (per riprendere download interrotti o scaricare file grandi a pezzi).
+ *  La parte dati della richiesta contiene un file_range_t (offset e lunghezza, 0 indica fino alla fine del file)
+ *  seguito dal nome del file; la risposta contiene un file_range_t (offset, lunghezza effettiva e dimensione totale)
+ *  seguito dai byte del segmento. Se offset supera la dimensione del file la richiesta fallisce con OP_FAIL
+ *  senza chiudere la connessione
+ * 
+ *  \param fd:  descrittore del client
+ *  \param msg: richiesta del client
+ *  \return:    se l'operazione ha avuto successo (o offset supera la dimensione del file) allora REQUEST_OK
+ *              se l'operazione ha fallito causa richiesta malformata dal client o errore di lettura del file allora CLIENT_ERROR
+ *              se l'operazione ha fallito nell'invio della risposta allora SYSTEM_ERROR
+ */
+op_res_t getfilerange_op(unsigned int fd, message_t msg);
+
+/** Invia più messaggi testuali, ognuno al proprio destinatario (nickname o gruppo), con una sola richiesta.
+ *  I messaggi vengono consegnati raggruppati per blocco logico della tabella degli utenti (mantenendo l'ordine
+ *  dei messaggi allo stesso destinatario) e la risposta contiene l'esito di ogni messaggio (vedere message.h).
+ *  La richiesta viene validata e la memoria per le history degli utenti allocata prima di consegnare qualsiasi messaggio;
+ *  se la consegna ad un gruppo fallisce la risposta OP_OK riporta comunque gli esiti dei messaggi già consegnati
+ * 
+ *  \param fd:  descrittore del client
+ *  \param msg: richiesta del client
+ *  \return:    se l'operazione ha avuto successo allora REQUEST_OK
+ *              se l'operazione ha fallito causa richiesta malformata dal client allora CLIENT_ERROR
+ *              se l'operazione ha fallito durante la gestione della memoria dinamica o in qualche chiamata di sistema allora SYSTEM_ERROR
+ */
+op_res_t posttxtbatch_op(unsigned int fd, message_t msg);
+
+/** Apre un caricamento a blocchi di un file. Il destinatario (nickname o gruppo) è il receiver della richiesta
+ *  e la parte dati contiene il nome del file; la risposta contiene un upload_chunk_t con l'identificativo del caricamento.
+ *  Se l'utente ha già MaxUploadsPerUser caricamenti aperti la richiesta fallisce con OP_FAIL senza chiudere la connessione
+ * 
+ *  \param fd:  descrittore del client
+ *  \param msg: richiesta del client
+ *  \return:    se l'operazione ha avuto successo (o l'utente ha troppi caricamenti aperti) allora REQUEST_OK
+ *              se l'operazione ha fallito causa richiesta malformata dal client allora CLIENT_ERROR
+ *              se l'operazione ha fallito durante la gestione della memoria dinamica o in qualche chiamata di sistema allora SYSTEM_ERROR
+ */
+op_res_t uploadbegin_op(unsigned int fd, message_t msg);
+
+/** Scrive un blocco di un caricamento. La parte dati contiene un upload_chunk_t (identificativo e posizione del blocco,
+ *  che deve coincidere con il numero di byte già ricevuti) seguito dai byte del blocco; la risposta contiene il numero
+ *  di byte ricevuti. Un blocco vuoto serve a conoscere il numero di byte ricevuti per riprendere un caricamento interrotto.
+ *  Se la posizione è errata la risposta è OP_FAIL (con il numero di byte ricevuti) ma il client resta connesso
+ * 
+ *  \param fd:  descrittore del client
+ *  \param msg: richiesta del client
+ *  \return:    se l'operazione ha avuto successo allora REQUEST_OK
+ *              se l'operazione ha fallito causa richiesta malformata dal client allora CLIENT_ERROR
+ *              se l'operazione ha fallito durante la gestione della memoria dinamica o in qualche chiamata di sistema allora SYSTEM_ERROR
+ */
+op_res_t uploadchunk_op(unsigned int fd, message_t msg);
+
+/** Chiude un caricamento e invia il file al destinatario come POSTFILE_OP. La parte dati contiene un upload_chunk_t
+ *  con l'identificativo del caricamento e la dimensione totale del file, che deve coincidere con quella ricevuta
+ * 
+ *  \param fd:  descrittore del client
+ *  \param msg: richiesta del client
+ *  \return:    se l'operazione ha avuto successo allora REQUEST_OK
+ *              se l'operazione ha fallito causa richiesta malformata dal client allora CLIENT_ERROR
+ *              se l'operazione ha fallito durante la gestione della memoria dinamica o in qualche chiamata di sistema allora SYSTEM_ERROR
+ */
+op_res_t uploadcommit_op(unsigned int fd, message_t msg);
+
 /** Invia tutti i messaggi salvati nella history dell'utente
  * 
  *  \param fd:  descrittore del client
@@ -82,6 +157,17 @@ op_res_t getfile_op(unsigned int fd, message_t msg);
  */
 op_res_t getprevmsgs_op(unsigned int fd, message_t msg);
 
+/** Invia i messaggi della history dell'utente successivi al numero di sequenza indicato nella richiesta
+ *  (la parte dati della richiesta contiene una struttura history_cursor_t definita in message.h)
+ * 
+ *  \param fd:  descrittore del client
+ *  \param msg: richiesta del client
+ *  \return:    se l'operazione ha avuto successo allora REQUEST_OK
+ *              se l'operazione ha fallito causa richiesta malformata dal client allora CLIENT_ERROR
+ *              se l'operazione ha fallito durante la gestione della memoria dinamica o in qualche chiamata di sistema allora SYSTEM_ERROR
+ */
+op_res_t getprevmsgs_after_op(unsigned int fd, message_t msg);
+
 /** Invia la lista degli utenti connessi
  * 
  *  \param fd:  descrittore del client
@@ -111,4 +197,35 @@ op_res_t unregister_op(unsigned int fd, message_t msg);
  */
 op_res_t disconnect_op(unsigned int fd);
 
+/** Crea un gruppo il cui nome è il destinatario della richiesta, il richiedente diventa il primo membro del gruppo
+ *  (il nome del gruppo non può coincidere con il nickname di un utente o con il nome di un altro gruppo)
+ * 
+ *  \param fd:  descrittore del client
+ *  \param msg: richiesta del client
+ *  \return:    se l'operazione ha avuto successo allora REQUEST_OK
+ *              se l'operazione ha fallito causa richiesta malformata dal client allora CLIENT_ERROR
+ *              se l'operazione ha fallito durante la gestione della memoria dinamica o in qualche chiamata di sistema allora SYSTEM_ERROR
+ */
+op_res_t creategroup_op(unsigned int fd, message_t msg);
+
+/** Aggiunge il richiedente ai membri del gruppo destinatario della richiesta
+ * 
+ *  \param fd:  descrittore del client
+ *  \param msg: richiesta del client
+ *  \return:    se l'operazione ha avuto successo allora REQUEST_OK
+ *              se l'operazione ha fallito causa richiesta malformata dal client allora CLIENT_ERROR
+ *              se l'operazione ha fallito durante la gestione della memoria dinamica o in qualche chiamata di sistema allora SYSTEM_ERROR
+ */
+op_res_t addgroup_op(unsigned int fd, message_t msg);
+
+/** Rimuove il richiedente dai membri del gruppo destinatario della richiesta, il gruppo viene cancellato se rimane senza membri
+ * 
+ *  \param fd:  descrittore del client
+ *  \param msg: richiesta del client
+ *  \return:    se l'operazione ha avuto successo allora REQUEST_OK
+ *              se l'operazione ha fallito causa richiesta malformata dal client allora CLIENT_ERROR
+ *              se l'operazione ha fallito durante la gestione della memoria dinamica o in qualche chiamata di sistema allora SYSTEM_ERROR
+ */
+op_res_t delgroup_op(unsigned int fd, message_t msg);
+
 #endif /* OPERATIONS_H_ */
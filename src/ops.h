@@ -43,6 +43,13 @@ typedef enum {
     /* 
      * aggiungere qui eltre operazioni che si vogliono implementare 
      */
+    GETPREVMSGS_AFTER_OP = 13,  /// richiesta di recupero dei messaggi della history successivi ad un numero di sequenza
+    POSTTXTMULTI_OP  = 14,  /// richiesta di invio di un messaggio testuale ad una lista di nickname
+    GETFILERANGE_OP  = 15,  /// richiesta di recupero di un segmento di un file
+    UPLOADBEGIN_OP   = 16,  /// richiesta di apertura di un caricamento a blocchi di un file
+    UPLOADCHUNK_OP   = 17,  /// richiesta di scrittura di un blocco di un caricamento
+    UPLOADCOMMIT_OP  = 18,  /// richiesta di chiusura di un caricamento e di invio del file
+    POSTTXTBATCH_OP  = 19,  /// richiesta di invio di più messaggi testuali (ognuno con il proprio destinatario)
 
     /* ------------------------------------------ */
     /*    messaggi inviati dal server             */
@@ -16,7 +16,20 @@
 char UnixPath[UNIX_PATH_MAX];
 char DirName[256];
 char StatFileName[256];
+char AdminPath[UNIX_PATH_MAX];	//Socket di amministrazione (opzionale, stringa vuota se non configurato)
+char FlightFileName[256];		//File delle richieste registrate dal flight recorder (opzionale, stringa vuota se non configurato)
 long MaxConnections, ThreadsInPool, MaxMsgSize, MaxFileSize, MaxHistMsgs;
+/* parametri opzionali del file di configurazione */
+long MaxHistMemory;			//Memoria massima occupata dalle history (kilobytes, 0 nessun limite)
+long HistOverflowPolicy;	//0 se le history in eccesso vengono riversate su disco (spill), 1 se vengono eliminate (drop)
+long FileShardLevels;		//Livelli di sottodirectory (da 256 ciascuno) in cui sono distribuiti i file (0, 1 o 2)
+long FsyncPolicy;				//0 se i file non vengono sincronizzati su disco (none), 1 se vengono sincronizzati a gruppi (batch)
+long DurabilityAck;			//0 se un upload è completato quando il file è scritto (written), 1 quando è sincronizzato (synced)
+long FileCacheSize;			//Memoria massima occupata dalla cache dei file (kilobytes, 0 cache disabilitata)
+long CompressThreshold;		//Dimensione minima (byte) dei messaggi e dei file compressi (0 compressione disabilitata)
+long MaxUploadsPerUser;		//Caricamenti a blocchi aperti contemporaneamente da un utente (0 nessun limite)
+long UploadIdleTimeout;		//Secondi di inattività dopo i quali un caricamento a blocchi viene annullato (0 mai)
+long LogLevel;					//Livello massimo delle righe di log: 0 error, 1 warn, 2 info, 3 debug
 
 /**	Elimina spazi, tab e newline da una stringa e rende tutti i caratteri minuscoli
  */
@@ -46,8 +59,12 @@ int parse_config_file (char* path_file) {
 	memset(UnixPath, '\0', UNIX_PATH_MAX);
 	memset(DirName, '\0', 256);
 	memset(StatFileName, '\0', 256);
+	memset(AdminPath, '\0', UNIX_PATH_MAX);
+	memset(FlightFileName, '\0', 256);
 	//Inizializzo tutti i valori a -1
 	MaxConnections = -1; ThreadsInPool = -1; MaxMsgSize = -1; MaxFileSize = -1; MaxHistMsgs = -1;
+	MaxHistMemory = -1; HistOverflowPolicy = -1; FileShardLevels = -1; FsyncPolicy = -1; DurabilityAck = -1; FileCacheSize = -1; CompressThreshold = -1; LogLevel = -1;
+	MaxUploadsPerUser = -1; UploadIdleTimeout = -1;
 
 	//Apro il file di configurazione
 	FILE *conf = fopen(path_file, "rb");
@@ -73,6 +90,14 @@ int parse_config_file (char* path_file) {
 			token += strlen("statfilename=");
 			strncpy(StatFileName, token, strlen(token));
 		}
+		else if (AdminPath[0] == '\0' && ((token = strstr(normal_str, "adminpath=")) != NULL || (token = strstr(normal_str, "adminpath:")) != NULL)) {
+			token += strlen("adminpath=");
+			strncpy(AdminPath, token, UNIX_PATH_MAX-1);
+		}
+		else if (FlightFileName[0] == '\0' && ((token = strstr(normal_str, "flightfilename=")) != NULL || (token = strstr(normal_str, "flightfilename:")) != NULL)) {
+			token += strlen("flightfilename=");
+			strncpy(FlightFileName, token, 255);
+		}
 		else if (MaxConnections == -1 && ((token = strstr(normal_str, "maxconnections=")) != NULL || (token = strstr(normal_str, "maxconnections:")) != NULL)) {
 			token += strlen("maxconnections=");
 			MaxConnections = strtol(token, NULL, 10);
@@ -93,6 +118,49 @@ int parse_config_file (char* path_file) {
 			token += strlen("maxhistmsgs=");
 			MaxHistMsgs = strtol(token, NULL, 10);
 		}
+		else if (MaxHistMemory == -1 && ((token = strstr(normal_str, "maxhistmemory=")) != NULL || (token = strstr(normal_str, "maxhistmemory:")) != NULL)) {
+			token += strlen("maxhistmemory=");
+			MaxHistMemory = strtol(token, NULL, 10);
+		}
+		else if (HistOverflowPolicy == -1 && ((token = strstr(normal_str, "histoverflowpolicy=")) != NULL || (token = strstr(normal_str, "histoverflowpolicy:")) != NULL)) {
+			token += strlen("histoverflowpolicy=");
+			HistOverflowPolicy = (strncmp(token, "drop", strlen("drop")) == 0) ? 1 : 0;
+		}
+		else if (FileShardLevels == -1 && ((token = strstr(normal_str, "fileshardlevels=")) != NULL || (token = strstr(normal_str, "fileshardlevels:")) != NULL)) {
+			token += strlen("fileshardlevels=");
+			FileShardLevels = strtol(token, NULL, 10);
+		}
+		else if (FsyncPolicy == -1 && ((token = strstr(normal_str, "fsyncpolicy=")) != NULL || (token = strstr(normal_str, "fsyncpolicy:")) != NULL)) {
+			token += strlen("fsyncpolicy=");
+			FsyncPolicy = (strncmp(token, "batch", strlen("batch")) == 0) ? 1 : 0;
+		}
+		else if (DurabilityAck == -1 && ((token = strstr(normal_str, "durabilityack=")) != NULL || (token = strstr(normal_str, "durabilityack:")) != NULL)) {
+			token += strlen("durabilityack=");
+			DurabilityAck = (strncmp(token, "synced", strlen("synced")) == 0) ? 1 : 0;
+		}
+		else if (FileCacheSize == -1 && ((token = strstr(normal_str, "filecachesize=")) != NULL || (token = strstr(normal_str, "filecachesize:")) != NULL)) {
+			token += strlen("filecachesize=");
+			FileCacheSize = strtol(token, NULL, 10);
+		}
+		else if (CompressThreshold == -1 && ((token = strstr(normal_str, "compressthreshold=")) != NULL || (token = strstr(normal_str, "compressthreshold:")) != NULL)) {
+			token += strlen("compressthreshold=");
+			CompressThreshold = strtol(token, NULL, 10);
+		}
+		else if (MaxUploadsPerUser == -1 && ((token = strstr(normal_str, "maxuploadsperuser=")) != NULL || (token = strstr(normal_str, "maxuploadsperuser:")) != NULL)) {
+			token += strlen("maxuploadsperuser=");
+			MaxUploadsPerUser = strtol(token, NULL, 10);
+		}
+		else if (UploadIdleTimeout == -1 && ((token = strstr(normal_str, "uploadidletimeout=")) != NULL || (token = strstr(normal_str, "uploadidletimeout:")) != NULL)) {
+			token += strlen("uploadidletimeout=");
+			UploadIdleTimeout = strtol(token, NULL, 10);
+		}
+		else if (LogLevel == -1 && ((token = strstr(normal_str, "loglevel=")) != NULL || (token = strstr(normal_str, "loglevel:")) != NULL)) {
+			token += strlen("loglevel=");
+			if (strncmp(token, "error", strlen("error")) == 0) LogLevel = 0;
+			else if (strncmp(token, "warn", strlen("warn")) == 0) LogLevel = 1;
+			else if (strncmp(token, "debug", strlen("debug")) == 0) LogLevel = 3;
+			else LogLevel = 2;
+		}
 
 		memset(buf, '\0', N);
 		memset(normal_str, '\0', N);
@@ -106,5 +174,17 @@ int parse_config_file (char* path_file) {
 	if (MaxConnections == -1 || ThreadsInPool == -1 || MaxMsgSize == -1 || MaxFileSize == -1 || MaxHistMsgs == -1)
 		return -1;
 
+	//Valori di default dei parametri opzionali
+	if (MaxHistMemory < 0) MaxHistMemory = 0;
+	if (HistOverflowPolicy == -1) HistOverflowPolicy = 0;
+	if (FileShardLevels < 0 || FileShardLevels > 2) FileShardLevels = 2;
+	if (FsyncPolicy == -1) FsyncPolicy = 0;
+	if (DurabilityAck == -1) DurabilityAck = 0;
+	if (FileCacheSize < 0) FileCacheSize = 0;
+	if (CompressThreshold < 0) CompressThreshold = 0;
+	if (LogLevel == -1) LogLevel = 2;
+	if (MaxUploadsPerUser < 0) MaxUploadsPerUser = 4;
+	if (UploadIdleTimeout < 0) UploadIdleTimeout = 600;
+
 	return 0;
 } 
\ No newline at end of file
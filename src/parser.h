@@ -12,7 +12,12 @@
 extern char UnixPath[UNIX_PATH_MAX];
 extern char DirName[256];
 extern char StatFileName[256];
+extern char AdminPath[UNIX_PATH_MAX];
+extern char FlightFileName[256];
 extern long MaxConnections, ThreadsInPool, MaxMsgSize, MaxFileSize, MaxHistMsgs;
+/* parametri opzionali */
+extern long MaxHistMemory, HistOverflowPolicy, FileShardLevels, FsyncPolicy, DurabilityAck, FileCacheSize, CompressThreshold, LogLevel;
+extern long MaxUploadsPerUser, UploadIdleTimeout;
 
 /** Effettua il parsing del file di configurazione
  * 
@@ -5,10 +5,12 @@
        originale dell'autore  
      */  
 
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <poll.h>
 #include "conn.h"
 #include "queue.h"
 #include "message.h"
@@ -16,6 +18,10 @@
 #include "parser.h"
 #include "operations.h"
 #include "connections.h"
+#include "wire.h"
+#include "latency.h"
+#include "logger.h"
+#include "flight_recorder.h"
 
 /**	Valore speciale che indica che un thread del pool deve terminare
  */
@@ -23,22 +29,48 @@
 #define POOL_TERM (void*)-1
 #endif
 
+/**	Numero massimo di richieste di una connessione gestite di seguito da un thread senza ripassare dal listener
+ */
+#ifndef MAX_PIPELINED_REQUESTS
+#define MAX_PIPELINED_REQUESTS 32
+#endif
+
 extern Queue_t *codaFd;										//Coda dei descrittori condivisa con il thread listener
 extern int fdpipe[2];										//Pipe per la comunicazione dei descrittori dei client per i quali ho finito di gestire la richiesta
 extern int countActiveThreads;							//Numero di threads del pool attualmente attivi
 extern pthread_mutex_t mtx_countActiveThreads;		//Mutex su countActiveThreads
 
-/**	Decrementa di uno il numero di threads del pool attivi (thread_safe)
+/**	Decrementa di uno il numero di threads del pool attivi (thread_safe), chiamata quando un thread termina per un errore:
+ * 	scrive prima le ultime richieste registrate dal flight recorder
  */
 static void update_countActiveThreads() {
+	if (FlightFileName[0] != '\0') flight_dump(FlightFileName, "terminazione anomala di un thread del pool");
 	pthread_mutex_lock(&mtx_countActiveThreads);
 	countActiveThreads--;
 	pthread_mutex_unlock(&mtx_countActiveThreads);
 }
 
-/**	Notifica al thread listener, tramite la pipe, il descrittore del client per il quale ha concluso la gestione della richiesta 
+/**	Ritorna 1 se sulla connessione fd ci sono già dati da leggere (senza bloccarsi), 0 altrimenti
+ */
+static int request_pending(int fd) {
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	return poll(&pfd, 1, 0) == 1 && (pfd.revents & (POLLIN | POLLHUP));
+}
+
+/**	Conclusa la gestione di una richiesta: se il client ha già inviato la richiesta successiva (e non ne sono state
+ * 	gestite di seguito più di MAX_PIPELINED_REQUESTS) la salva in next_fd per gestirla subito, mantenendo l'ordine
+ * 	delle richieste della connessione; altrimenti notifica il descrittore al thread listener tramite la pipe
  */
-static int communicate_request_completed(int fd) {
+static int communicate_request_completed(int fd, int* next_fd, int* num_pipelined) {
+	if (*num_pipelined < MAX_PIPELINED_REQUESTS && request_pending(fd)) {
+		(*num_pipelined)++;
+		*next_fd = fd;
+		return 0;
+	}
+	*num_pipelined = 0;
 	if (writen(fdpipe[1], &fd, sizeof(int)) == -1) {
 		disconnect_op(fd);
 		return -1;
@@ -51,23 +83,38 @@ void* pool_func() {
 	int fd;					//Descrittore del client che ha effettuato la richiesta
 	int read_res;			//Risultato lettura richiesta	
 	op_res_t op_res;		//Risultato gestione operazione
+	int next_fd = -1;		//Descrittore con una richiesta già arrivata da gestire subito (-1 se nessuno)
+	int num_pipelined = 0;	//Richieste della stessa connessione gestite di seguito
+	long long queue_ns;		//Attesa in coda della richiesta (-1 se non è passata dalla coda)
+	unsigned long long dequeue_ns;	//Istante di estrazione del descrittore (o di inizio della richiesta successiva)
 	void *data;		
 
 	request.data.buf  = NULL;
 	
 	while(1) {
-		//Estraggo il descrittore dalla coda
-		data = popQueue(codaFd);
-		
-		//Verifico se devo terminare
-		if (data == POOL_TERM)
-		   break;
+		//Se il client ha già inviato un'altra richiesta la gestisco subito, altrimenti estraggo il descrittore dalla coda
+		if (next_fd != -1) {
+			fd = next_fd;
+			next_fd = -1;
+			queue_ns = -1;
+			dequeue_ns = latency_now();
+		}
+		else {
+			data = popQueue(codaFd);
+			
+			//Verifico se devo terminare
+			if (data == POOL_TERM)
+			   break;
 
-		fd = *(int*)data;
-		free(data);
+			fd = *(int*)data;
+			free(data);
+			num_pipelined = 0;
+			queue_ns = latency_queue_wait(fd);
+			dequeue_ns = latency_now();
+		}
 		
 		//Leggo la richiesta
-		read_res = readMsg(fd, &request);
+		read_res = wire_read_msg(fd, &request);
 		//Controlle esito
 		if (read_res == -1) {
 		   close(fd);
@@ -76,23 +123,25 @@ void* pool_func() {
 		}
 		else if (read_res == 0) {
 			if (disconnect_op(fd) == SYSTEM_ERROR) {
-				printf("Errore di sistema nella disconessione\n");
+				LOGGER(LOGGER_ERROR, "Errore di sistema nella disconessione");
 				update_countActiveThreads();
 				return (void*)1;
 			}
 		}
 		else if (read_res > 0) {
+			latency_begin();
+			flight_begin(fd, dequeue_ns, &request);
 			switch(request.hdr.op) {
 				case REGISTER_OP: {
 					op_res = register_op(fd, request);
 					if (op_res == REQUEST_OK) {
-						if (communicate_request_completed(fd) == -1) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
 							update_countActiveThreads();
 							return (void*)1;
 						}
 					}
 					else if (op_res == SYSTEM_ERROR) {
-						printf("Errore di sistema nella registrazione\n");
+						LOGGER(LOGGER_ERROR, "Errore di sistema nella registrazione");
 						update_countActiveThreads();
 						return (void*)1;
 					}
@@ -101,13 +150,13 @@ void* pool_func() {
 				case CONNECT_OP: {
 					op_res = connect_op(fd, request);
 				   if (op_res == REQUEST_OK) {
-						if (communicate_request_completed(fd) == -1) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
 							update_countActiveThreads();
 							return (void*)1;
 						}
 					}
 					else if (op_res == SYSTEM_ERROR) {
-						printf("Errore di sistema nella connessione\n");
+						LOGGER(LOGGER_ERROR, "Errore di sistema nella connessione");
 						update_countActiveThreads();
 						return (void*)1;
 					}
@@ -116,13 +165,13 @@ void* pool_func() {
 				case POSTTXT_OP: {
 					op_res = posttxt_op(fd, request);
 					if (op_res == REQUEST_OK) {
-						if (communicate_request_completed(fd) == -1) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
 							update_countActiveThreads();
 							return (void*)1;
 						}
 					}
 					else if (op_res == SYSTEM_ERROR) {
-						printf("Errore di sistema nell'invio di un messaggio\n");
+						LOGGER(LOGGER_ERROR, "Errore di sistema nell'invio di un messaggio");
 						disconnect_op(fd);
 						update_countActiveThreads();
 						return (void*)1;
@@ -135,13 +184,32 @@ void* pool_func() {
 				case POSTTXTALL_OP: {
 					op_res = posttxtall_op(fd, request);
 					if (op_res == REQUEST_OK) {
-						if (communicate_request_completed(fd) == -1) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
+							update_countActiveThreads();
+							return (void*)1;
+						}
+					}
+					else if (op_res == SYSTEM_ERROR) {
+						LOGGER(LOGGER_ERROR, "Errore di sistema nell'invio di un messaggio a tutti");
+						disconnect_op(fd);
+						update_countActiveThreads();
+						return (void*)1;
+					}
+					else if (op_res == CLIENT_ERROR) {
+						disconnect_op(fd);
+					}
+					break;
+				}
+				case POSTTXTMULTI_OP: {
+					op_res = posttxtmulti_op(fd, request);
+					if (op_res == REQUEST_OK) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
 							update_countActiveThreads();
 							return (void*)1;
 						}
 					}
 					else if (op_res == SYSTEM_ERROR) {
-						printf("Errore di sistema nell'invio di un messaggio a tutti\n");
+						LOGGER(LOGGER_ERROR, "Errore di sistema nell'invio del messaggio a piu' destinatari");
 						disconnect_op(fd);
 						update_countActiveThreads();
 						return (void*)1;
@@ -154,8 +222,10 @@ void* pool_func() {
 				case POSTFILE_OP: {
                //Leggo il contenuto del file
                message_data_t file_content;
-               if (readData(fd, &file_content) == -1) {
+               file_content.buf = NULL;
+               if (wire_read_data(fd, &file_content) == -1) {
                   if (errno == EPIPE) {
+                     op_res = CLIENT_ERROR;
                      disconnect_op(fd);
                   }
                   else {
@@ -167,13 +237,13 @@ void* pool_func() {
                else {
                   op_res = postfile_op(fd, request, file_content);
                   if (op_res == REQUEST_OK) {
-                     if (communicate_request_completed(fd) == -1) {
+                     if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
                         update_countActiveThreads();
                         return (void*)1;
                      }
                   }
                   else if (op_res == SYSTEM_ERROR) {
-							printf("Errore di sistema nell'invio di un file da %s a %s\n", request.hdr.sender, request.data.hdr.receiver);
+							LOGGER(LOGGER_ERROR, "Errore di sistema nell'invio di un file da %s a %s", request.hdr.sender, request.data.hdr.receiver);
 							disconnect_op(fd);
                      update_countActiveThreads();
                      return (void*)1;
@@ -188,13 +258,108 @@ void* pool_func() {
 				case GETFILE_OP: {
 					op_res = getfile_op(fd, request);
 					if (op_res == REQUEST_OK) {
-						if (communicate_request_completed(fd) == -1) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
+							update_countActiveThreads();
+							return (void*)1;
+						}
+					}
+					else if (op_res == SYSTEM_ERROR) {
+						LOGGER(LOGGER_ERROR, "Errore di sistema nel download di un file");
+						disconnect_op(fd);
+						update_countActiveThreads();
+						return (void*)1;
+					}
+               else if (op_res == CLIENT_ERROR) {
+						disconnect_op(fd);
+					}
+               break;
+				}
+				case GETFILERANGE_OP: {
+					op_res = getfilerange_op(fd, request);
+					if (op_res == REQUEST_OK) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
+							update_countActiveThreads();
+							return (void*)1;
+						}
+					}
+					else if (op_res == SYSTEM_ERROR) {
+						LOGGER(LOGGER_ERROR, "Errore di sistema nel download di un segmento di un file");
+						disconnect_op(fd);
+						update_countActiveThreads();
+						return (void*)1;
+					}
+               else if (op_res == CLIENT_ERROR) {
+						disconnect_op(fd);
+					}
+               break;
+				}
+				case POSTTXTBATCH_OP: {
+					op_res = posttxtbatch_op(fd, request);
+					if (op_res == REQUEST_OK) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
+							update_countActiveThreads();
+							return (void*)1;
+						}
+					}
+					else if (op_res == SYSTEM_ERROR) {
+						LOGGER(LOGGER_ERROR, "Errore di sistema nell'invio di un gruppo di messaggi");
+						disconnect_op(fd);
+						update_countActiveThreads();
+						return (void*)1;
+					}
+               else if (op_res == CLIENT_ERROR) {
+						disconnect_op(fd);
+					}
+               break;
+				}
+				case UPLOADBEGIN_OP: {
+					op_res = uploadbegin_op(fd, request);
+					if (op_res == REQUEST_OK) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
+							update_countActiveThreads();
+							return (void*)1;
+						}
+					}
+					else if (op_res == SYSTEM_ERROR) {
+						LOGGER(LOGGER_ERROR, "Errore di sistema nell'apertura di un caricamento");
+						disconnect_op(fd);
+						update_countActiveThreads();
+						return (void*)1;
+					}
+               else if (op_res == CLIENT_ERROR) {
+						disconnect_op(fd);
+					}
+               break;
+				}
+				case UPLOADCHUNK_OP: {
+					op_res = uploadchunk_op(fd, request);
+					if (op_res == REQUEST_OK) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
+							update_countActiveThreads();
+							return (void*)1;
+						}
+					}
+					else if (op_res == SYSTEM_ERROR) {
+						LOGGER(LOGGER_ERROR, "Errore di sistema nella scrittura di un blocco di un caricamento");
+						disconnect_op(fd);
+						update_countActiveThreads();
+						return (void*)1;
+					}
+               else if (op_res == CLIENT_ERROR) {
+						disconnect_op(fd);
+					}
+               break;
+				}
+				case UPLOADCOMMIT_OP: {
+					op_res = uploadcommit_op(fd, request);
+					if (op_res == REQUEST_OK) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
 							update_countActiveThreads();
 							return (void*)1;
 						}
 					}
 					else if (op_res == SYSTEM_ERROR) {
-						printf("Errore di sistema nel download di un file\n");
+						LOGGER(LOGGER_ERROR, "Errore di sistema nella chiusura di un caricamento");
 						disconnect_op(fd);
 						update_countActiveThreads();
 						return (void*)1;
@@ -207,13 +372,32 @@ void* pool_func() {
 				case GETPREVMSGS_OP: {
 					op_res = getprevmsgs_op(fd, request);
 					if (op_res == REQUEST_OK) {
-						if (communicate_request_completed(fd) == -1) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
 							update_countActiveThreads();
 							return (void*)1;
 						}
 					}
 					else if (op_res == SYSTEM_ERROR) {
-						printf("Errore di sistema nell'invio dei messaggi della history\n");
+						LOGGER(LOGGER_ERROR, "Errore di sistema nell'invio dei messaggi della history");
+						disconnect_op(fd);
+						update_countActiveThreads();
+						return (void*)1;
+					}
+               else if (op_res == CLIENT_ERROR) {
+						disconnect_op(fd);
+					}
+				   break;
+				}
+				case GETPREVMSGS_AFTER_OP: {
+					op_res = getprevmsgs_after_op(fd, request);
+					if (op_res == REQUEST_OK) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
+							update_countActiveThreads();
+							return (void*)1;
+						}
+					}
+					else if (op_res == SYSTEM_ERROR) {
+						LOGGER(LOGGER_ERROR, "Errore di sistema nell'invio dei messaggi della history");
 						disconnect_op(fd);
 						update_countActiveThreads();
 						return (void*)1;
@@ -226,13 +410,13 @@ void* pool_func() {
 				case USRLIST_OP: {
 					op_res = usrlist_op(fd, request);
 					if (op_res == REQUEST_OK) {
-						if (communicate_request_completed(fd) == -1) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
 							update_countActiveThreads();
 							return (void*)1;
 						}
 					}
 					else if (op_res == SYSTEM_ERROR) {
-							printf("Errore di sistema nell'invio della lista degli utenti connessi\n");
+							LOGGER(LOGGER_ERROR, "Errore di sistema nell'invio della lista degli utenti connessi");
 							disconnect_op(fd);
 							update_countActiveThreads();
 							return (void*)1;
@@ -245,18 +429,78 @@ void* pool_func() {
 				case UNREGISTER_OP: {
 					op_res = unregister_op(fd, request);
 					if (op_res == SYSTEM_ERROR){
-						printf("Errore di sistema nella deregistrazione\n");
+						LOGGER(LOGGER_ERROR, "Errore di sistema nella deregistrazione");
+						disconnect_op(fd);
+						update_countActiveThreads();
+						return (void*)1;
+					}
+					break;
+				}
+				case CREATEGROUP_OP: {
+					op_res = creategroup_op(fd, request);
+					if (op_res == REQUEST_OK) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
+							update_countActiveThreads();
+							return (void*)1;
+						}
+					}
+					else if (op_res == SYSTEM_ERROR) {
+						LOGGER(LOGGER_ERROR, "Errore di sistema nella creazione del gruppo");
+						disconnect_op(fd);
+						update_countActiveThreads();
+						return (void*)1;
+					}
+					else if (op_res == CLIENT_ERROR) {
+						disconnect_op(fd);
+					}
+					break;
+				}
+				case ADDGROUP_OP: {
+					op_res = addgroup_op(fd, request);
+					if (op_res == REQUEST_OK) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
+							update_countActiveThreads();
+							return (void*)1;
+						}
+					}
+					else if (op_res == SYSTEM_ERROR) {
+						LOGGER(LOGGER_ERROR, "Errore di sistema nella aggiunta al gruppo");
+						disconnect_op(fd);
+						update_countActiveThreads();
+						return (void*)1;
+					}
+					else if (op_res == CLIENT_ERROR) {
+						disconnect_op(fd);
+					}
+					break;
+				}
+				case DELGROUP_OP: {
+					op_res = delgroup_op(fd, request);
+					if (op_res == REQUEST_OK) {
+						if (communicate_request_completed(fd, &next_fd, &num_pipelined) == -1) {
+							update_countActiveThreads();
+							return (void*)1;
+						}
+					}
+					else if (op_res == SYSTEM_ERROR) {
+						LOGGER(LOGGER_ERROR, "Errore di sistema nella rimozione dal gruppo");
 						disconnect_op(fd);
 						update_countActiveThreads();
 						return (void*)1;
 					}
+					else if (op_res == CLIENT_ERROR) {
+						disconnect_op(fd);
+					}
 					break;
 				}
 				default: {
+					op_res = CLIENT_ERROR;
 					disconnect_op(fd);
 					break;
 				}
 			}
+			latency_end(request.hdr.op, queue_ns);
+			flight_end(op_res);
 		}
 		if (request.data.buf) {
 			free(request.data.buf);
@@ -2,6 +2,7 @@
 #include <assert.h>
 #include <pthread.h>
 #include <queue.h>
+#include <lock_profile.h>
 
 /**
  * @file queue.c
@@ -18,12 +19,12 @@ static pthread_cond_t  qcond = PTHREAD_COND_INITIALIZER;
 static Node_t *allocNode()         { return malloc(sizeof(Node_t));  }
 static Queue_t *allocQueue()       { return malloc(sizeof(Queue_t)); }
 static void freeNode(Node_t *node) { free((void*)node); }
-static void LockQueue()            { pthread_mutex_lock(&qlock);   }
-static void UnlockQueue()          { pthread_mutex_unlock(&qlock); }
-static void UnlockQueueAndWait()   { pthread_cond_wait(&qcond, &qlock); }
+static void LockQueue()            { LP_LOCK(LP_QUEUE, 0, &qlock);   }
+static void UnlockQueue()          { LP_UNLOCK(LP_QUEUE, 0, &qlock); }
+static void UnlockQueueAndWait()   { LP_COND_WAIT(LP_QUEUE, 0, &qcond, &qlock); }
 static void UnlockQueueAndSignal() {
     pthread_cond_signal(&qcond);
-    pthread_mutex_unlock(&qlock);
+    LP_UNLOCK(LP_QUEUE, 0, &qlock);
 }
 
 /* ------------------- interfaccia della coda ------------------ */
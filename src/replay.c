@@ -0,0 +1,858 @@
+
+/** \file replay.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+/**   Benchmark end-to-end riproducibile basato su una traccia di carico
+ *    Una traccia è una sequenza di richieste (istante, utente, operazione, destinatario, dimensione) ordinate per
+ *    istante. Lo strumento ha due modalità:
+ *       generazione (-g): scrive su file (-o) una traccia deterministica (a parità di parametri e di seme):
+ *          stress:  riproduce la forma del traffico di teststress.sh (-n giri di 10 client con le stesse sequenze
+ *                   di operazioni, dimensioni e pause, i connect falliti di utenti sconosciuti e lo scambio di file
+ *                   tra utente1 e utente2)
+ *          synth:   -u utenti che si registrano all'inizio e -n richieste con arrivi esponenziali a -r richieste
+ *                   al secondo, operazioni scelte secondo il mix -m (come loadgen)
+ *       riproduzione (-l): esegue la traccia (-i) su un server chatty già avviato, ogni richiesta all'istante
+ *          registrato (ciclo aperto: la latenza viene misurata dall'istante previsto, così un server lento non
+ *          riduce il carico offerto). Ogni utente ha la propria connessione e gli utenti sono distribuiti tra -c
+ *          thread; le richieste di un utente sono eseguite nell'ordine della traccia.
+ *          Al termine stampa messaggi al secondo, MB di file al secondo e percentili della latenza per operazione.
+ *    Il risultato di una traccia dipende dallo stato del server: va riprodotta su un server appena avviato
+ *    (vedere il target replaybench del Makefile).
+ *
+ *    Formato del file: "CHTR", versione (1 byte), numero di utenti e numero di richieste, seguiti dalle richieste.
+ *    Ogni richiesta è codificata come: distanza in microsecondi dalla precedente, utente, operazione (1 byte, codice
+ *    di ops.h), destinatario + 1 (0 se assente o se la richiesta è per tutti) e dimensione in byte del messaggio o del
+ *    file; tutti i campi tranne l'operazione sono interi senza segno in formato varint (7 bit per byte, little endian).
+ *    GETFILE scarica il file che il destinatario ha inviato all'utente con POSTFILE (il nome del file è ricavato
+ *    da mittente e dimensione).
+ *
+ *    Esempio: ./replay -g synth -u 200 -n 50000 -r 2000 -o synth.trace && ./replay -l /tmp/chatty_socket -i synth.trace
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <connections.h>
+#include <ops.h>
+
+#define RP_MAGIC "CHTR"
+#define RP_VERSION 1
+
+/**	Operazioni della traccia (indici delle statistiche)
+ */
+#define RP_REGISTER   0
+#define RP_CONNECT    1
+#define RP_TXT        2
+#define RP_ALL        3
+#define RP_FILE       4
+#define RP_GET        5
+#define RP_PREV       6
+#define RP_LIST       7
+#define RP_DISCONNECT 8
+#define RP_OPS        9
+
+/**	Intervallo (millisecondi) dopo il quale un thread in attesa svuota le connessioni dei propri utenti
+ */
+#define RP_SWEEP_MS 10
+
+static const int rp_codes[RP_OPS] = { REGISTER_OP, CONNECT_OP, POSTTXT_OP, POSTTXTALL_OP, POSTFILE_OP, GETFILE_OP,
+	GETPREVMSGS_OP, USRLIST_OP, DISCONNECT_OP };
+static const char* rp_names[RP_OPS] = { "REGISTER", "CONNECT", "POSTTXT", "POSTTXTALL", "POSTFILE", "GETFILE",
+	"GETPREVMSGS", "USRLIST", "DISCONNECT" };
+static const char* rp_keys[RP_OPS] = { NULL, NULL, "txt", "all", "file", "get", "prev", "list", NULL };
+
+/**	Richiesta della traccia
+ */
+typedef struct {
+	unsigned long long off_us;		//Istante in microsecondi dall'inizio della traccia
+	unsigned int user;
+	int op;								//Indice RP_*
+	int receiver;						//-1 se assente
+	unsigned int size;
+	unsigned int seq;					//Ordine di generazione, per un ordinamento stabile
+} rp_record_t;
+
+typedef struct {
+	rp_record_t* records;
+	size_t n, cap;
+	unsigned int nusers;
+} rp_trace_t;
+
+/**	Latenze (nanosecondi) registrate da un thread per un'operazione
+ */
+typedef struct {
+	unsigned long long* samples;
+	size_t n, cap;
+	unsigned long errors;
+	unsigned long long bytes;		//Byte di testo o di file trasferiti dalle richieste completate
+} rp_series_t;
+
+/**	Stato di un thread della riproduzione
+ */
+typedef struct {
+	int id;
+	size_t* idx;						//Richieste del thread, in ordine
+	size_t nidx;
+	int nusers;							//Utenti del thread (l'utente u è in posizione u / nthreads)
+	struct pollfd* pfd;				//Connessioni degli utenti (fd -1 se non connesso)
+	char* msg_buf;						//Testo dei messaggi
+	rp_series_t series[RP_OPS];
+	unsigned long long max_lag;		//Ritardo massimo di invio rispetto alla traccia
+	pthread_t tid;
+} rp_thread_t;
+
+/* parametri */
+static char* sockpath = NULL;
+static int nthreads = 16;
+static double speed = 1.0;
+static char prefix[16] = "rp";
+
+static rp_trace_t trace;
+static char* file_buf = NULL;			//Contenuto dei file
+static unsigned long long start = 0;	//Istante di inizio della riproduzione
+
+static unsigned long long now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+static void nick_of(int i, char* nick) {
+	snprintf(nick, MAX_NAME_LENGTH+1, "%s%d", prefix, i);
+}
+
+/**	Nome del file inviato dall'utente sender di dimensione size
+ */
+static void filename_of(int sender, unsigned int size, char* name, size_t len) {
+	snprintf(name, len, "%s%d_%u.bin", prefix, sender, size);
+}
+
+/* ------------------------------------------------------------------------------------------------------------ */
+/*                                                  TRACCIA                                                     */
+/* ------------------------------------------------------------------------------------------------------------ */
+
+static int add_record(rp_trace_t* t, unsigned long long off_us, unsigned int user, int op, int receiver, unsigned int size) {
+	if (t -> n == t -> cap) {
+		size_t cap = t -> cap ? 2 * t -> cap : 1024;
+		rp_record_t* tmp = realloc(t -> records, cap * sizeof(rp_record_t));
+		if (tmp == NULL) return -1;
+		t -> records = tmp;
+		t -> cap = cap;
+	}
+	rp_record_t* r = &(t -> records[t -> n]);
+	r -> off_us = off_us;
+	r -> user = user;
+	r -> op = op;
+	r -> receiver = receiver;
+	r -> size = size;
+	r -> seq = (unsigned int)t -> n++;
+	if (user >= t -> nusers) t -> nusers = user + 1;
+	if (receiver >= 0 && (unsigned int)receiver >= t -> nusers) t -> nusers = receiver + 1;
+	return 0;
+}
+
+static int cmp_record(const void* a, const void* b) {
+	const rp_record_t* x = a;
+	const rp_record_t* y = b;
+	if (x -> off_us != y -> off_us) return (x -> off_us > y -> off_us) - (x -> off_us < y -> off_us);
+	return (x -> seq > y -> seq) - (x -> seq < y -> seq);
+}
+
+static int put_varint(FILE* f, unsigned long long v) {
+	do {
+		unsigned char b = v & 0x7f;
+		v >>= 7;
+		if (v) b |= 0x80;
+		if (fputc(b, f) == EOF) return -1;
+	} while (v);
+	return 0;
+}
+
+static int get_varint(FILE* f, unsigned long long* v) {
+	int c, shift = 0;
+	*v = 0;
+	do {
+		if ((c = fgetc(f)) == EOF || shift > 63) return -1;
+		*v |= (unsigned long long)(c & 0x7f) << shift;
+		shift += 7;
+	} while (c & 0x80);
+	return 0;
+}
+
+static int write_trace(rp_trace_t* t, char* path) {
+	FILE* f = fopen(path, "wb");
+	if (f == NULL) return -1;
+
+	qsort(t -> records, t -> n, sizeof(rp_record_t), cmp_record);
+	int err = fwrite(RP_MAGIC, 1, 4, f) != 4 || fputc(RP_VERSION, f) == EOF;
+	err = err || put_varint(f, t -> nusers) == -1 || put_varint(f, t -> n) == -1;
+	unsigned long long prev = 0;
+	for (size_t i = 0; i < t -> n && !err; i++) {
+		rp_record_t* r = &(t -> records[i]);
+		err = put_varint(f, r -> off_us - prev) == -1 || put_varint(f, r -> user) == -1
+			|| fputc(rp_codes[r -> op], f) == EOF || put_varint(f, (unsigned long long)(r -> receiver + 1)) == -1
+			|| put_varint(f, r -> size) == -1;
+		prev = r -> off_us;
+	}
+	if (fclose(f) != 0) err = 1;
+	return err ? -1 : 0;
+}
+
+static int read_trace(rp_trace_t* t, char* path) {
+	char magic[4];
+	unsigned long long nusers, n, delta, user, receiver, size, off = 0;
+
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) return -1;
+	if (fread(magic, 1, 4, f) != 4 || memcmp(magic, RP_MAGIC, 4) != 0 || fgetc(f) != RP_VERSION
+		|| get_varint(f, &nusers) == -1 || get_varint(f, &n) == -1) {
+		fclose(f);
+		return -1;
+	}
+	for (unsigned long long i = 0; i < n; i++) {
+		int code, op;
+		if (get_varint(f, &delta) == -1 || get_varint(f, &user) == -1 || (code = fgetc(f)) == EOF
+			|| get_varint(f, &receiver) == -1 || get_varint(f, &size) == -1) break;
+		for (op = 0; op < RP_OPS && rp_codes[op] != code; op++);
+		off += delta;
+		if (op == RP_OPS || user >= nusers || receiver > nusers || size > 0xffffffffULL
+			|| add_record(t, off, (unsigned int)user, op, (int)receiver - 1, (unsigned int)size) == -1) break;
+	}
+	fclose(f);
+	if (t -> n != n) return -1;
+	t -> nusers = (unsigned int)nusers;
+	return 0;
+}
+
+/* ------------------------------------------------------------------------------------------------------------ */
+/*                                                GENERAZIONE                                                   */
+/* ------------------------------------------------------------------------------------------------------------ */
+
+/**	Utenti della traccia stress: i 10 utenti di teststress.sh, utente1, utente2 e i 5 utenti sconosciuti
+ */
+enum { PIPPO, PLUTO, MINNI, TOPOLINO, PAPERINO, QUI, QUO, QUA, ZIO, CLARABELLA, UTENTE1, UTENTE2, UNKNOWN };
+
+/**	Dimensioni dei file inviati da teststress.sh (client, chatty, libchatty.a, chatty.o, DATA/chatty.conf1)
+ */
+#define SZ_CLIENT 48000
+#define SZ_CHATTY 320000
+#define SZ_LIB    590000
+#define SZ_OBJ    40000
+#define SZ_CONF   4000
+
+/**	Operazione di un client di teststress.sh (RP_OPS: attesa di messaggi, -R)
+ */
+typedef struct {
+	int op;
+	int receiver;
+	unsigned int size;
+} rp_step_t;
+
+#define TXT(to, n) { RP_TXT, to, n }
+#define ALL(n)     { RP_ALL, -1, n }
+#define FILE_(to, n) { RP_FILE, to, n }
+#define PREV       { RP_PREV, -1, 0 }
+#define LIST       { RP_LIST, -1, 0 }
+#define RECV       { RP_OPS, -1, 0 }
+#define END        { -1, -1, 0 }
+
+typedef struct {
+	int user;
+	unsigned int pause_ms;			//Pausa tra due operazioni (-t)
+	rp_step_t steps[16];
+} rp_client_t;
+
+static const rp_client_t stress_clients[] = {
+	{ TOPOLINO, 200, { TXT(MINNI, 28), TXT(PLUTO, 18), ALL(18), TXT(PAPERINO, 22), FILE_(MINNI, SZ_CLIENT),
+		FILE_(QUA, SZ_CHATTY), PREV, RECV, END } },
+	{ PAPERINO, 600, { RECV, TXT(MINNI, 28), TXT(PLUTO, 18), ALL(18), TXT(TOPOLINO, 22), FILE_(PLUTO, SZ_LIB), PREV, END } },
+	{ PLUTO, 300, { RECV, TXT(MINNI, 28), TXT(PLUTO, 18), ALL(18), TXT(TOPOLINO, 22), FILE_(MINNI, SZ_LIB), PREV, END } },
+	{ QUI, 300, { TXT(PLUTO, 28), ALL(18), ALL(18), ALL(22), ALL(22), ALL(18), ALL(17), ALL(14), ALL(23), ALL(19), PREV, END } },
+	{ QUO, 500, { LIST, PREV, TXT(PLUTO, 28), ALL(18), ALL(18), ALL(22), ALL(22), ALL(18), ALL(17), ALL(14), ALL(23),
+		ALL(19), END } },
+	{ PIPPO, 500, { LIST, FILE_(QUA, SZ_OBJ), FILE_(QUA, SZ_CLIENT), FILE_(QUA, SZ_LIB), PREV, END } },
+	{ QUA, 200, { RECV, FILE_(PIPPO, SZ_CONF), TXT(PIPPO, 27), ALL(19), ALL(18), ALL(22), ALL(22), ALL(18), ALL(17),
+		ALL(14), ALL(23), ALL(19), END } },
+	{ MINNI, 100, { TXT(QUA, 28), TXT(PLUTO, 18), ALL(18), TXT(TOPOLINO, 22), FILE_(PLUTO, SZ_LIB), PREV, END } },
+	{ ZIO, 300, { TXT(CLARABELLA, 51), ALL(19), ALL(18), TXT(TOPOLINO, 22), PREV, END } },
+	{ CLARABELLA, 100, { ALL(30), RECV, FILE_(MINNI, SZ_CHATTY), ALL(18), ALL(22), ALL(22), ALL(18), ALL(17), ALL(14),
+		ALL(23), ALL(19), PREV, END } }
+};
+
+/**	Traccia con la forma del traffico di teststress.sh, ripetuto per rounds giri
+ */
+static int gen_stress(rp_trace_t* t, int rounds) {
+	int nclients = sizeof(stress_clients) / sizeof(stress_clients[0]);
+	unsigned long long round_start = 0;
+	int err = 0;
+
+	/* REGISTRAZIONE CONTEMPORANEA DEI 10 UTENTI (client -c, che chiude subito la connessione) */
+	for (int u = PIPPO; u <= CLARABELLA; u++) {
+		err = err || add_record(t, 0, u, RP_REGISTER, -1, 0) == -1;
+		err = err || add_record(t, 1000, u, RP_DISCONNECT, -1, 0) == -1;
+	}
+	round_start = 100000;
+
+	for (int r = 0; r < rounds && !err; r++) {
+		unsigned long long round_len = 0;
+
+		/* CLIENT CONTEMPORANEI: CONNECT, UN'OPERAZIONE OGNI pause_ms E CHIUSURA DELLA CONNESSIONE */
+		for (int c = 0; c < nclients && !err; c++) {
+			const rp_client_t* cl = &(stress_clients[c]);
+			unsigned long long at = round_start;
+			err = add_record(t, at, cl -> user, RP_CONNECT, -1, 0) == -1;
+			for (int s = 0; cl -> steps[s].op != -1 && !err; s++) {
+				if (cl -> steps[s].op != RP_OPS)
+					err = add_record(t, at, cl -> user, cl -> steps[s].op, cl -> steps[s].receiver, cl -> steps[s].size) == -1;
+				at += cl -> pause_ms * 1000ULL;
+			}
+			err = err || add_record(t, at, cl -> user, RP_DISCONNECT, -1, 0) == -1;
+			if (at - round_start > round_len) round_len = at - round_start;
+		}
+
+		/* CLIENT SEQUENZIALI: 5 UTENTI SCONOSCIUTI (CONNECT FALLITO), POI utente1 E utente2 */
+		unsigned long long at = round_start + 1000;
+		for (int k = 0; k < 5 && !err; k++, at += 5000)
+			err = add_record(t, at, UNKNOWN + k, RP_CONNECT, -1, 0) == -1;
+		for (int u = UTENTE1; u <= UTENTE2 && !err; u++, at += 5000) {
+			err = add_record(t, at, u, RP_REGISTER, -1, 0) == -1;
+			err = err || add_record(t, at + 1000, u, RP_DISCONNECT, -1, 0) == -1;
+		}
+		err = err || add_record(t, at, UTENTE1, RP_CONNECT, -1, 0) == -1;
+		err = err || add_record(t, at + 1000, UTENTE1, RP_TXT, UTENTE2, 14) == -1;
+		err = err || add_record(t, at + 2000, UTENTE1, RP_PREV, -1, 0) == -1;
+		err = err || add_record(t, at + 3000, UTENTE1, RP_DISCONNECT, -1, 0) == -1;
+		at += 5000;
+		err = err || add_record(t, at, UTENTE2, RP_CONNECT, -1, 0) == -1;
+		err = err || add_record(t, at + 1000, UTENTE2, RP_PREV, -1, 0) == -1;
+		err = err || add_record(t, at + 2000, UTENTE2, RP_TXT, UTENTE1, 9) == -1;
+		err = err || add_record(t, at + 3000, UTENTE2, RP_DISCONNECT, -1, 0) == -1;
+
+		round_start += round_len + 50000;
+	}
+
+	return err ? -1 : 0;
+}
+
+/**	Traccia sintetica: nusers utenti registrati all'inizio e, dopo un secondo (così tutti i destinatari sono
+ * 	registrati), n richieste con arrivi esponenziali a rate richieste al secondo. GETFILE scarica l'ultimo file ricevuto dall'utente; un utente che non ha ancora ricevuto file ne invia uno
+ */
+static int gen_synth(rp_trace_t* t, int nusers, long n, double rate, int* weights, unsigned int msg_size,
+	unsigned int file_size, unsigned int seed) {
+	int total = 0, err = 0;
+	double now = 1e6;
+
+	for (int op = 0; op < RP_OPS; op++) total += weights[op];
+	int* last_file = malloc(nusers * sizeof(int));		//Mittente dell'ultimo file ricevuto da ogni utente
+	if (last_file == NULL) return -1;
+	for (int u = 0; u < nusers; u++) {
+		last_file[u] = -1;
+		err = err || add_record(t, 0, u, RP_REGISTER, -1, 0) == -1;
+	}
+
+	for (long i = 0; i < n && !err; i++) {
+		double x = (rand_r(&seed) + 1.0) / ((double)RAND_MAX + 2.0);
+		now += -log(x) * 1e6 / rate;
+		int user = rand_r(&seed) % nusers;
+		int receiver = rand_r(&seed) % nusers;
+		int w = rand_r(&seed) % total, op;
+		for (op = 0; op < RP_OPS && w >= weights[op]; op++) w -= weights[op];
+
+		if (op == RP_GET && last_file[user] == -1) op = RP_FILE;
+		switch (op) {
+			case RP_TXT:
+				err = add_record(t, (unsigned long long)now, user, op, receiver, msg_size) == -1;
+				break;
+			case RP_ALL:
+				err = add_record(t, (unsigned long long)now, user, op, -1, msg_size) == -1;
+				break;
+			case RP_FILE:
+				err = add_record(t, (unsigned long long)now, user, op, receiver, file_size) == -1;
+				last_file[receiver] = user;
+				break;
+			case RP_GET:
+				err = add_record(t, (unsigned long long)now, user, op, last_file[user], file_size) == -1;
+				break;
+			default:
+				err = add_record(t, (unsigned long long)now, user, op, -1, 0) == -1;
+				break;
+		}
+	}
+
+	free(last_file);
+	t -> nusers = nusers;
+	return err ? -1 : 0;
+}
+
+/* ------------------------------------------------------------------------------------------------------------ */
+/*                                               RIPRODUZIONE                                                   */
+/* ------------------------------------------------------------------------------------------------------------ */
+
+static int record(rp_series_t* s, unsigned long long ns) {
+	if (s -> n == s -> cap) {
+		size_t cap = s -> cap ? 2 * s -> cap : 1024;
+		unsigned long long* tmp = realloc(s -> samples, cap * sizeof(unsigned long long));
+		if (tmp == NULL) return -1;
+		s -> samples = tmp;
+		s -> cap = cap;
+	}
+	s -> samples[s -> n++] = ns;
+	return 0;
+}
+
+/**	Legge e scarta i dati di un messaggio (o di una risposta) il cui header è già stato letto
+ */
+static int skip_data(int fd) {
+	message_data_t data;
+	data.buf = NULL;
+	int k = readData(fd, &data);
+	if (data.buf) free(data.buf);
+	return (k <= 0) ? -1 : 0;
+}
+
+/**	Chiude la connessione dell'utente in posizione i del thread
+ */
+static void drop(rp_thread_t* t, int i) {
+	if (t -> pfd[i].fd < 0) return;
+	close(t -> pfd[i].fd);
+	t -> pfd[i].fd = -1;
+}
+
+/**	Svuota le connessioni degli utenti del thread (tranne skip) dai messaggi in arrivo, aspettando al più timeout_ms.
+ * 	Un utente che non legge riempirebbe il proprio socket e bloccherebbe i thread del server che gli scrivono.
+ * 	Le connessioni chiuse dal server vengono chiuse anche qui
+ */
+static int sweep(rp_thread_t* t, int skip, int timeout_ms) {
+	message_hdr_t hdr;
+	int r = poll(t -> pfd, t -> nusers, timeout_ms);
+	if (r == -1 && errno != EINTR) return -1;
+	if (r <= 0) return 0;
+	for (int i = 0; i < t -> nusers; i++) {
+		if (i == skip || t -> pfd[i].fd < 0 || !(t -> pfd[i].revents & (POLLIN | POLLHUP))) continue;
+		if (readHeader(t -> pfd[i].fd, &hdr) <= 0 || (hdr.op != TXT_MESSAGE && hdr.op != FILE_MESSAGE)
+			|| skip_data(t -> pfd[i].fd) == -1) drop(t, i);
+	}
+	return 0;
+}
+
+/**	Aspetta la risposta alla richiesta dell'utente i del thread scartando i messaggi in arrivo,
+ * 	ritorna l'op della risposta (-1 in caso di errore)
+ */
+static int wait_reply(rp_thread_t* t, int i) {
+	struct pollfd p;
+	message_hdr_t hdr;
+
+	while (1) {
+		p.fd = t -> pfd[i].fd;
+		p.events = POLLIN;
+		p.revents = 0;
+		int r = poll(&p, 1, RP_SWEEP_MS);
+		if (r == -1 && errno != EINTR) return -1;
+		/* NESSUNA RISPOSTA: IL SERVER POTREBBE ESSERE BLOCCATO A SCRIVERE AD UN ALTRO UTENTE DEL THREAD */
+		if (r <= 0) {
+			if (sweep(t, i, 0) == -1) return -1;
+			continue;
+		}
+		if (readHeader(p.fd, &hdr) <= 0) return -1;
+		if (hdr.op == TXT_MESSAGE || hdr.op == FILE_MESSAGE) {
+			if (skip_data(p.fd) == -1) return -1;
+			continue;
+		}
+		return hdr.op;
+	}
+}
+
+/**	Esegue la richiesta r dell'utente in posizione i del thread e legge la risposta completa,
+ * 	ritorna 0 in caso di successo, 1 se la richiesta è fallita (risposta di errore o connessione chiusa)
+ */
+static int do_request(rp_thread_t* t, int i, rp_record_t* r) {
+	message_t msg;
+	char nick[MAX_NAME_LENGTH+1], receiver[MAX_NAME_LENGTH+1], filename[MAX_NAME_LENGTH+16];
+
+	nick_of(r -> user, nick);
+	receiver[0] = '\0';
+	if (r -> receiver >= 0) nick_of(r -> receiver, receiver);
+
+	/* REGISTER E CONNECT APRONO UNA NUOVA CONNESSIONE */
+	if (r -> op == RP_REGISTER || r -> op == RP_CONNECT) {
+		drop(t, i);
+		if ((t -> pfd[i].fd = openConnection(sockpath, 10, 1)) < 0) return 1;
+	}
+	if (t -> pfd[i].fd < 0) return 1;
+	int fd = t -> pfd[i].fd;
+
+	setHeader(&msg.hdr, rp_codes[r -> op], nick);
+	switch (r -> op) {
+		case RP_TXT:
+		case RP_ALL:
+			t -> msg_buf[r -> size - 1] = '\0';
+			setData(&msg.data, receiver, t -> msg_buf, r -> size);
+			break;
+		case RP_FILE:
+			filename_of(r -> user, r -> size, filename, sizeof(filename));
+			setData(&msg.data, receiver, filename, strlen(filename)+1);
+			break;
+		case RP_GET:
+			filename_of(r -> receiver, r -> size, filename, sizeof(filename));
+			setData(&msg.data, "", filename, strlen(filename)+1);
+			break;
+		default:
+			setData(&msg.data, "", NULL, 0);
+			break;
+	}
+
+	int res = sendRequest(fd, &msg);
+	if (r -> op == RP_TXT || r -> op == RP_ALL) t -> msg_buf[r -> size - 1] = 'x';
+	if (res != -1 && r -> op == RP_FILE) {
+		message_data_t data;
+		setData(&data, "", file_buf, r -> size);
+		res = sendData(fd, &data);
+	}
+	int reply = (res == -1) ? -1 : wait_reply(t, i);
+	if (reply == -1) {
+		drop(t, i);
+		return 1;
+	}
+	if (reply != OP_OK) {
+		/* IL SERVER CHIUDE LA CONNESSIONE DI UN REGISTER O CONNECT FALLITO */
+		if (r -> op == RP_REGISTER || r -> op == RP_CONNECT) drop(t, i);
+		return 1;
+	}
+
+	/* DATI DELLA RISPOSTA */
+	if (r -> op == RP_REGISTER || r -> op == RP_CONNECT || r -> op == RP_GET || r -> op == RP_LIST) {
+		if (skip_data(fd) == -1) {
+			drop(t, i);
+			return 1;
+		}
+	}
+	else if (r -> op == RP_PREV) {
+		message_data_t data;
+		data.buf = NULL;
+		if (readData(fd, &data) <= 0 || data.buf == NULL) {
+			if (data.buf) free(data.buf);
+			drop(t, i);
+			return 1;
+		}
+		size_t nmsgs = *(size_t*)(data.buf);
+		free(data.buf);
+		for (size_t k = 0; k < nmsgs; k++) {
+			message_hdr_t hdr;
+			if (readHeader(fd, &hdr) <= 0 || skip_data(fd) == -1) {
+				drop(t, i);
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void* rp_thread(void* arg) {
+	rp_thread_t* t = (rp_thread_t*) arg;
+
+	for (size_t k = 0; k < t -> nidx; k++) {
+		rp_record_t* r = &(trace.records[t -> idx[k]]);
+		unsigned long long sched = start + (unsigned long long)(r -> off_us * 1000.0 / speed);
+
+		/* ASPETTO L'ISTANTE DELLA RICHIESTA SVUOTANDO LE CONNESSIONI */
+		unsigned long long now;
+		while ((now = now_ns()) < sched) {
+			if (sweep(t, -1, (int)((sched - now + 999999) / 1000000)) == -1) return (void*)0;
+		}
+		if (now - sched > t -> max_lag) t -> max_lag = now - sched;
+
+		/* DISCONNECT CHIUDE LA CONNESSIONE SENZA RICHIESTE (COME client) */
+		if (r -> op == RP_DISCONNECT) {
+			drop(t, r -> user / nthreads);
+			continue;
+		}
+		rp_series_t* s = &(t -> series[r -> op]);
+		if (do_request(t, r -> user / nthreads, r) != 0) s -> errors++;
+		else {
+			if (record(s, now_ns() - sched) == -1) return (void*)0;
+			s -> bytes += r -> size;
+		}
+	}
+
+	return (void*)0;
+}
+
+static int cmp_ull(const void* a, const void* b) {
+	unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+	return (x > y) - (x < y);
+}
+
+/**	Stampa una riga del riepilogo per le latenze s (ordinate) di n richieste completate ed errors fallite
+ */
+static void print_line(const char* name, unsigned long long* s, size_t n, unsigned long errors, double secs) {
+	static const double q[4] = { 0.50, 0.90, 0.99, 0.999 };
+	printf("op %s count %lu errors %lu throughput %.1f", name, (unsigned long)n, errors, n / secs);
+	for (int k = 0; k < 4; k++)
+		printf(" p%g %.1f", q[k] * 100, n ? s[(size_t)(q[k] * (n - 1))] / 1000.0 : 0.0);
+	printf(" max %.1f\n", n ? s[n-1] / 1000.0 : 0.0);
+}
+
+static void report(rp_thread_t* threads, char* path, double secs) {
+	unsigned long long* all = NULL;
+	size_t nall = 0;
+	unsigned long errors_all = 0, msgs = 0;
+	unsigned long long file_bytes = 0, max_lag = 0;
+
+	printf("# replay: %s, %lu richieste, %u utenti, %d thread, traccia %.1f s, velocita' %g, %.1f s, latenze in microsecondi\n",
+		path, (unsigned long)trace.n, trace.nusers, nthreads, trace.n ? trace.records[trace.n-1].off_us / 1e6 : 0.0, speed, secs);
+	for (int t = 0; t < nthreads; t++)
+		if (threads[t].max_lag > max_lag) max_lag = threads[t].max_lag;
+	for (int op = 0; op < RP_OPS; op++) {
+		size_t n = 0;
+		unsigned long errors = 0;
+		for (int t = 0; t < nthreads; t++) {
+			n += threads[t].series[op].n;
+			errors += threads[t].series[op].errors;
+			if (op == RP_TXT || op == RP_ALL) msgs += threads[t].series[op].n;
+			if (op == RP_FILE || op == RP_GET) file_bytes += threads[t].series[op].bytes;
+		}
+		if (n == 0 && errors == 0) continue;
+		unsigned long long* s = malloc((n ? n : 1) * sizeof(unsigned long long));
+		unsigned long long* tmp = realloc(all, (nall + n + 1) * sizeof(unsigned long long));
+		if (s == NULL || tmp == NULL) {
+			fprintf(stderr, "ERRORE: memoria esaurita\n");
+			if (s) free(s);
+			if (tmp) free(tmp); else free(all);
+			return;
+		}
+		all = tmp;
+		n = 0;
+		for (int t = 0; t < nthreads; t++) {
+			memcpy(s + n, threads[t].series[op].samples, threads[t].series[op].n * sizeof(unsigned long long));
+			n += threads[t].series[op].n;
+		}
+		memcpy(all + nall, s, n * sizeof(unsigned long long));
+		nall += n;
+		errors_all += errors;
+		qsort(s, n, sizeof(unsigned long long), cmp_ull);
+		print_line(rp_names[op], s, n, errors, secs);
+		free(s);
+	}
+	if (all) {
+		qsort(all, nall, sizeof(unsigned long long), cmp_ull);
+		print_line("ALL", all, nall, errors_all, secs);
+		free(all);
+	}
+	printf("messages %lu msgs/s %.1f filebytes %llu MB/s %.3f maxlag %.1f\n", msgs, msgs / secs, file_bytes,
+		file_bytes / 1e6 / secs, max_lag / 1000.0);
+}
+
+static int replay(char* path) {
+	unsigned int max_msg = 1, max_file = 1;
+
+	if (nthreads > (int)trace.nusers) nthreads = trace.nusers;
+	if (nthreads <= 0) nthreads = 1;
+	for (size_t k = 0; k < trace.n; k++) {
+		rp_record_t* r = &(trace.records[k]);
+		if ((r -> op == RP_TXT || r -> op == RP_ALL) && r -> size == 0) r -> size = 1;
+		if ((r -> op == RP_TXT || r -> op == RP_ALL) && r -> size > max_msg) max_msg = r -> size;
+		if (r -> op == RP_FILE && r -> size > max_file) max_file = r -> size;
+	}
+
+	/* CONTENUTO DEI FILE E RICHIESTE DI OGNI THREAD (L'UTENTE u È ASSEGNATO AL THREAD u % nthreads) */
+	file_buf = malloc(max_file);
+	rp_thread_t* threads = calloc(nthreads, sizeof(rp_thread_t));
+	if (!file_buf || !threads) {
+		fprintf(stderr, "ERRORE: memoria esaurita\n");
+		return -1;
+	}
+	for (unsigned int i = 0; i < max_file; i++) file_buf[i] = (char)(i * 31);
+	for (size_t k = 0; k < trace.n; k++) threads[trace.records[k].user % nthreads].nidx++;
+	for (int t = 0; t < nthreads; t++) {
+		threads[t].id = t;
+		threads[t].nusers = (trace.nusers - t + nthreads - 1) / nthreads;
+		threads[t].idx = malloc((threads[t].nidx ? threads[t].nidx : 1) * sizeof(size_t));
+		threads[t].pfd = malloc((threads[t].nusers ? threads[t].nusers : 1) * sizeof(struct pollfd));
+		threads[t].msg_buf = malloc(max_msg);
+		if (!threads[t].idx || !threads[t].pfd || !threads[t].msg_buf) {
+			fprintf(stderr, "ERRORE: memoria esaurita\n");
+			return -1;
+		}
+		for (int i = 0; i < threads[t].nusers; i++) {
+			threads[t].pfd[i].fd = -1;
+			threads[t].pfd[i].events = POLLIN;
+		}
+		memset(threads[t].msg_buf, 'x', max_msg);
+		threads[t].nidx = 0;
+	}
+	for (size_t k = 0; k < trace.n; k++) {
+		rp_thread_t* t = &(threads[trace.records[k].user % nthreads]);
+		t -> idx[t -> nidx++] = k;
+	}
+
+	/* I THREAD PARTONO INSIEME, LA TRACCIA INIZIA 100 MILLISECONDI DOPO */
+	fflush(stdout);
+	start = now_ns() + 100000000ULL;
+	int created = 0;
+	for (; created < nthreads; created++) {
+		if (pthread_create(&(threads[created].tid), NULL, rp_thread, &(threads[created])) != 0) {
+			fprintf(stderr, "ERRORE: creazione del thread %d\n", created);
+			break;
+		}
+	}
+	for (int t = 0; t < created; t++)
+		pthread_join(threads[t].tid, NULL);
+	double secs = (now_ns() - start) / 1e9;
+
+	if (created == nthreads) report(threads, path, secs);
+
+	for (int t = 0; t < nthreads; t++) {
+		for (int i = 0; i < threads[t].nusers; i++) drop(&(threads[t]), i);
+		for (int op = 0; op < RP_OPS; op++) free(threads[t].series[op].samples);
+		free(threads[t].idx);
+		free(threads[t].pfd);
+		free(threads[t].msg_buf);
+	}
+	free(threads);
+	free(file_buf);
+	return (created == nthreads) ? 0 : -1;
+}
+
+/**	Stampa la traccia in formato testuale: istante (microsecondi), utente, operazione, destinatario, dimensione
+ */
+static void print_trace() {
+	printf("# %u utenti, %lu richieste\n", trace.nusers, (unsigned long)trace.n);
+	for (size_t k = 0; k < trace.n; k++) {
+		rp_record_t* r = &(trace.records[k]);
+		printf("%llu %u %s %d %u\n", r -> off_us, r -> user, rp_names[r -> op], r -> receiver, r -> size);
+	}
+}
+
+/**	Legge il mix di operazioni nel formato op=peso[,op=peso...] (le operazioni non indicate hanno peso 0)
+ */
+static int parse_mix(char* mix, int* weights) {
+	int total = 0;
+	char* save = NULL;
+	memset(weights, 0, RP_OPS * sizeof(int));
+	for (char* tok = strtok_r(mix, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		char* eq = strchr(tok, '=');
+		if (!eq) return -1;
+		*eq = '\0';
+		int op;
+		for (op = 0; op < RP_OPS && (rp_keys[op] == NULL || strcmp(tok, rp_keys[op]) != 0); op++);
+		if (op == RP_OPS || atoi(eq + 1) < 0) return -1;
+		weights[op] = atoi(eq + 1);
+	}
+	for (int op = 0; op < RP_OPS; op++) total += weights[op];
+	return (total > 0) ? 0 : -1;
+}
+
+static void use(const char* name) {
+	fprintf(stderr,
+		"use: %s -g stress|synth -o traccia [-n numero] [-u utenti] [-r richieste/s] [-m mix] [-s byte] [-f byte] [-S seme]\n"
+		"     %s -l unix_socket_path -i traccia [-c thread] [-x velocita'] [-p prefisso]\n"
+		"     %s -i traccia -P\n"
+		"  -g genera una traccia: stress (forma di teststress.sh) o synth (sintetica)\n"
+		"  -o file su cui scrivere la traccia generata\n"
+		"  -n giri di teststress.sh (stress, default 16) o numero di richieste (synth, default 100000)\n"
+		"  -u numero di utenti (synth, default 100)\n"
+		"  -r richieste al secondo (synth, default 1000)\n"
+		"  -m mix delle operazioni op=peso separati da ',' con op tra txt, all, file, get, prev, list\n"
+		"     (synth, default txt=70,all=1,file=4,get=5,prev=10,list=10)\n"
+		"  -s dimensione dei messaggi testuali (synth, default 100)\n"
+		"  -f dimensione dei file (synth, default 1024)\n"
+		"  -S seme dei numeri casuali (synth, default 1)\n"
+		"  -i traccia da riprodurre\n"
+		"  -c numero di thread della riproduzione (default 16)\n"
+		"  -x fattore di velocita' della riproduzione, 2 dimezza gli intervalli tra le richieste (default 1)\n"
+		"  -p prefisso dei nickname degli utenti (default rp)\n"
+		"  -P stampa la traccia in formato testuale\n", name, name, name);
+}
+
+int main(int argc, char* argv[]) {
+	char *gen = NULL, *out = NULL, *in = NULL;
+	long n = -1;
+	int nusers = 100, print = 0, opt;
+	double rate = 1000;
+	unsigned int msg_size = 100, file_size = 1024, seed = 1;
+	int weights[RP_OPS] = { 0, 0, 70, 1, 4, 5, 10, 10, 0 };
+
+	while ((opt = getopt(argc, argv, "g:o:n:u:r:m:s:f:S:l:i:c:x:p:Ph")) != -1) {
+		switch (opt) {
+			case 'g': gen = optarg; break;
+			case 'o': out = optarg; break;
+			case 'n': n = atol(optarg); break;
+			case 'u': nusers = atoi(optarg); break;
+			case 'r': rate = atof(optarg); break;
+			case 'm':
+				if (parse_mix(optarg, weights) == -1) {
+					fprintf(stderr, "ERRORE: mix non valido\n");
+					return EXIT_FAILURE;
+				}
+				break;
+			case 's': msg_size = (unsigned int)atoi(optarg); break;
+			case 'f': file_size = (unsigned int)atoi(optarg); break;
+			case 'S': seed = (unsigned int)atoi(optarg); break;
+			case 'l': sockpath = optarg; break;
+			case 'i': in = optarg; break;
+			case 'c': nthreads = atoi(optarg); break;
+			case 'x': speed = atof(optarg); break;
+			case 'p': strncpy(prefix, optarg, sizeof(prefix)-1); break;
+			case 'P': print = 1; break;
+			default: use(argv[0]); return EXIT_FAILURE;
+		}
+	}
+
+	/* GENERAZIONE */
+	if (gen) {
+		int res;
+		if (!out) {
+			use(argv[0]);
+			return EXIT_FAILURE;
+		}
+		if (strcmp(gen, "stress") == 0) res = gen_stress(&trace, (n < 0) ? 16 : (int)n);
+		else if (strcmp(gen, "synth") == 0) {
+			if (nusers <= 0 || rate <= 0 || msg_size == 0 || file_size == 0) {
+				use(argv[0]);
+				return EXIT_FAILURE;
+			}
+			res = gen_synth(&trace, nusers, (n < 0) ? 100000 : n, rate, weights, msg_size, file_size, seed);
+		}
+		else {
+			use(argv[0]);
+			return EXIT_FAILURE;
+		}
+		if (res == -1 || write_trace(&trace, out) == -1) {
+			fprintf(stderr, "ERRORE: scrittura della traccia %s\n", out);
+			free(trace.records);
+			return EXIT_FAILURE;
+		}
+		printf("# traccia %s: %u utenti, %lu richieste, %.1f s\n", out, trace.nusers, (unsigned long)trace.n,
+			trace.n ? trace.records[trace.n-1].off_us / 1e6 : 0.0);
+		free(trace.records);
+		return 0;
+	}
+
+	/* RIPRODUZIONE O STAMPA */
+	if (!in || (!print && (!sockpath || nthreads <= 0 || speed <= 0))) {
+		use(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (read_trace(&trace, in) == -1) {
+		fprintf(stderr, "ERRORE: traccia %s non valida\n", in);
+		free(trace.records);
+		return EXIT_FAILURE;
+	}
+	int res = 0;
+	if (print) print_trace();
+	else res = replay(in);
+	free(trace.records);
+	return (res == 0) ? 0 : EXIT_FAILURE;
+}
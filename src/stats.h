@@ -19,6 +19,14 @@ struct statistics {
     unsigned long nfiledelivered;               // n. di file consegnati
     unsigned long nfilenotdelivered;            // n. di file non ancora consegnati
     unsigned long nerrors;                      // n. di messaggi di errore
+    unsigned long nhistbytes;                   // n. di byte occupati dalle history in memoria
+    unsigned long nhistspilled;                 // n. di messaggi delle history riversati su disco
+    unsigned long nhistdropped;                 // n. di messaggi delle history eliminati per il budget di memoria
+    unsigned long nfilecachehits;               // n. di file scaricati serviti dalla cache
+    unsigned long nfilecachemisses;             // n. di file scaricati letti dal disco
+    unsigned long ncompressin;                  // n. di byte sottoposti a compressione
+    unsigned long ncompressout;                 // n. di byte risultanti dalla compressione
+    unsigned long ncompressusec;                // tempo di CPU (microsecondi) speso a comprimere e decomprimere
 };
 
 /* aggiungere qui altre funzioni di utilita' per le statistiche */
@@ -35,7 +43,7 @@ struct statistics {
 static inline int printStats(FILE *fout) {
     extern struct statistics chattyStats;
 
-    if (fprintf(fout, "%ld - %ld %ld %ld %ld %ld %ld %ld\n",
+    if (fprintf(fout, "%ld - %ld %ld %ld %ld %ld %ld %ld %ld %ld %ld %ld %ld %ld %ld %ld\n",
 		(unsigned long)time(NULL),
 		chattyStats.nusers, 
 		chattyStats.nonline,
@@ -43,7 +51,15 @@ static inline int printStats(FILE *fout) {
 		chattyStats.nnotdelivered,
 		chattyStats.nfiledelivered,
 		chattyStats.nfilenotdelivered,
-		chattyStats.nerrors
+		chattyStats.nerrors,
+		chattyStats.nhistbytes,
+		chattyStats.nhistspilled,
+		chattyStats.nhistdropped,
+		chattyStats.nfilecachehits,
+		chattyStats.nfilecachemisses,
+		chattyStats.ncompressin,
+		chattyStats.ncompressout,
+		chattyStats.ncompressusec
 		) < 0) return -1;
     fflush(fout);
     return 0;
@@ -0,0 +1,65 @@
+
+/** \file stats_shards.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#include "stats_shards.h"
+
+/**	Numero di partizioni dei contatori
+ */
+#define STATS_SHARDS 64
+
+/**	Dimensione di una linea di cache
+ */
+#define CACHE_LINE 64
+
+/**	Partizione dei contatori, occupa esattamente una linea di cache
+ */
+typedef union stats_shard {
+	struct {
+		unsigned long nusers;
+		unsigned long nonline;
+		unsigned long ndelivered;
+		unsigned long nnotdelivered;
+		unsigned long nfiledelivered;
+		unsigned long nfilenotdelivered;
+		unsigned long nerrors;
+	} c;
+	char pad[CACHE_LINE];
+} stats_shard_t;
+
+static stats_shard_t shards[STATS_SHARDS] __attribute__((aligned(CACHE_LINE)));
+static unsigned int next_shard = 0;				//Partizione del prossimo thread che aggiorna i contatori
+static __thread stats_shard_t* my_shard = NULL;	//Partizione del thread
+
+void stats_shards_add(long nusers, long nonline, long ndeliv, long nnotdeliv, long nfiledeliv, long nfilenotdeliv, long nerr) {
+	/* AL PRIMO AGGIORNAMENTO IL THREAD SCEGLIE LA PROPRIA PARTIZIONE */
+	if (my_shard == NULL)
+		my_shard = shards + (__sync_fetch_and_add(&next_shard, 1) % STATS_SHARDS);
+
+	if (nusers) __sync_fetch_and_add(&(my_shard -> c.nusers), nusers);
+	if (nonline) __sync_fetch_and_add(&(my_shard -> c.nonline), nonline);
+	if (ndeliv) __sync_fetch_and_add(&(my_shard -> c.ndelivered), ndeliv);
+	if (nnotdeliv) __sync_fetch_and_add(&(my_shard -> c.nnotdelivered), nnotdeliv);
+	if (nfiledeliv) __sync_fetch_and_add(&(my_shard -> c.nfiledelivered), nfiledeliv);
+	if (nfilenotdeliv) __sync_fetch_and_add(&(my_shard -> c.nfilenotdelivered), nfilenotdeliv);
+	if (nerr) __sync_fetch_and_add(&(my_shard -> c.nerrors), nerr);
+}
+
+void stats_shards_collect(struct statistics* stats) {
+	if (!stats) return;
+
+	stats -> nusers = stats -> nonline = stats -> ndelivered = stats -> nnotdelivered = 0;
+	stats -> nfiledelivered = stats -> nfilenotdelivered = stats -> nerrors = 0;
+	for (int i = 0; i < STATS_SHARDS; i++) {
+		stats -> nusers += __sync_add_and_fetch(&(shards[i].c.nusers), 0);
+		stats -> nonline += __sync_add_and_fetch(&(shards[i].c.nonline), 0);
+		stats -> ndelivered += __sync_add_and_fetch(&(shards[i].c.ndelivered), 0);
+		stats -> nnotdelivered += __sync_add_and_fetch(&(shards[i].c.nnotdelivered), 0);
+		stats -> nfiledelivered += __sync_add_and_fetch(&(shards[i].c.nfiledelivered), 0);
+		stats -> nfilenotdelivered += __sync_add_and_fetch(&(shards[i].c.nfilenotdelivered), 0);
+		stats -> nerrors += __sync_add_and_fetch(&(shards[i].c.nerrors), 0);
+	}
+}
@@ -0,0 +1,31 @@
+
+/** \file stats_shards.h
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#if !defined(STATS_SHARDS_H_)
+#define STATS_SHARDS_H_
+
+#include "stats.h"
+
+/**   Contatori delle statistiche aggiornati dalle operazioni
+ *    Ogni thread aggiorna (senza mutex) la propria partizione dei contatori, allineata ad una linea di cache per non
+ *    condividerla con gli altri thread; le partizioni vengono sommate solo quando le statistiche vengono lette.
+ *    Se i thread sono più delle partizioni alcuni thread condividono la stessa partizione: gli aggiornamenti
+ *    sono comunque atomici.
+ */
+
+/**   Somma i valori passati ai contatori della partizione del thread chiamante (thread-safe, senza mutex)
+ */
+void stats_shards_add(long nusers, long nonline, long ndeliv, long nnotdeliv, long nfiledeliv, long nfilenotdeliv, long nerr);
+
+/**   Scrive in stats la somma delle partizioni dei contatori aggiornati con stats_shards_add
+ *    (gli altri campi di stats non vengono modificati)
+ *
+ *    \param stats:     statistiche da aggiornare
+ */
+void stats_shards_collect(struct statistics* stats);
+
+#endif /* STATS_SHARDS_H_ */
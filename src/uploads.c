@@ -0,0 +1,372 @@
+
+/** \file uploads.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "uploads.h"
+#include "icl_hash.h"
+#include "lock_profile.h"
+
+/**	Nome della sottodirectory (di DirName) che contiene i file parziali
+ */
+#define UPLOADS_DIR ".uploads"
+
+/**	Intervallo minimo (secondi) tra due ricerche dei caricamenti inattivi (se il timeout non è più breve)
+ */
+#define SWEEP_INTERVAL 10
+
+/**	Caricamento in corso
+ */
+typedef struct upload {
+	char key[24];									//Identificativo del caricamento (come stringa, chiave della tabella)
+	char owner[MAX_NAME_LENGTH+1];			//Utente che carica il file
+	char receiver[MAX_NAME_LENGTH+1];		//Destinatario del file
+	char* name;										//Nome del file
+	unsigned long size;							//Byte ricevuti
+	int busy;										//1 se un thread sta scrivendo un blocco
+	int cancelled;									//1 se il caricamento va annullato al termine della scrittura in corso
+	time_t last;									//Istante dell'ultima operazione sul caricamento
+	struct upload* prev;							//Caricamento precedente dello stesso utente
+	struct upload* next;							//Caricamento successivo dello stesso utente
+} upload_t;
+
+/**	Caricamenti aperti da un utente
+ */
+typedef struct owner {
+	int count;										//Numero di caricamenti aperti
+	upload_t* head;								//Lista dei caricamenti
+} owner_t;
+
+static char uploads_dir[1024];							//Directory dei file parziali
+static icl_hash_t* uploads = NULL;						//Identificativo -> caricamento
+static icl_hash_t* owners = NULL;						//Nickname -> caricamenti dell'utente
+static unsigned long next_id = 1;						//Identificativo del prossimo caricamento
+static int max_per_owner = 0;								//Caricamenti aperti contemporaneamente da un utente (0 nessun limite)
+static int idle_timeout = 0;								//Secondi di inattività dopo i quali un caricamento viene annullato (0 mai)
+static time_t last_sweep = 0;								//Istante dell'ultima ricerca dei caricamenti inattivi
+static pthread_mutex_t uploads_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static void free_upload(void* data) {
+	upload_t* upload = (upload_t*) data;
+	if (upload == NULL) return;
+	if (upload -> name) free(upload -> name);
+	free(upload);
+}
+
+static void free_key(void* key) {
+	if (key) free(key);
+}
+
+/**	Path del file parziale del caricamento
+ */
+static void part_path(char* key, char* path, size_t size) {
+	snprintf(path, size, "%s/%s.part", uploads_dir, key);
+}
+
+/**	Cerca il caricamento id dell'utente owner che non sia in uso (uploads_mtx acquisita)
+ */
+static upload_t* find_upload(unsigned long id, char* owner) {
+	char key[24];
+	snprintf(key, sizeof(key), "%lu", id);
+	upload_t* upload = icl_hash_find(uploads, key);
+	if (upload == NULL || upload -> busy || strcmp(upload -> owner, owner) != 0) return NULL;
+	return upload;
+}
+
+/**	Rimuove il caricamento dalla tabella e dalla lista del suo utente; se unlink_part vale 1 rimuove anche
+ * 	il file parziale (uploads_mtx acquisita)
+ */
+static void remove_upload(upload_t* upload, int unlink_part) {
+	char path[1200];
+
+	owner_t* owner = icl_hash_find(owners, upload -> owner);
+	if (owner != NULL) {
+		if (upload -> prev) upload -> prev -> next = upload -> next;
+		else owner -> head = upload -> next;
+		if (upload -> next) upload -> next -> prev = upload -> prev;
+		if (--(owner -> count) == 0) icl_hash_delete(owners, upload -> owner, free_key, free);
+	}
+	if (unlink_part) {
+		part_path(upload -> key, path, sizeof(path));
+		unlink(path);
+	}
+	icl_hash_delete(uploads, upload -> key, NULL, free_upload);
+}
+
+/**	Annulla i caricamenti inattivi da almeno idle_timeout secondi, al più una volta ogni SWEEP_INTERVAL secondi
+ * 	(uploads_mtx acquisita)
+ */
+static void sweep_idle(time_t now) {
+	icl_entry_t* entry;
+	int n = 0;
+
+	if (idle_timeout == 0 || now - last_sweep < (idle_timeout < SWEEP_INTERVAL ? idle_timeout : SWEEP_INTERVAL) || uploads -> nentries == 0) return;
+	last_sweep = now;
+
+	/* LA TABELLA NON PUÒ ESSERE MODIFICATA DURANTE L'ITERAZIONE: RACCOLGO PRIMA I CARICAMENTI SCADUTI */
+	upload_t** expired = (upload_t**) malloc(uploads -> nentries * sizeof(upload_t*));
+	icl_iterator_t* it = icl_iterator_create(uploads);
+	while (expired != NULL && it != NULL && (entry = icl_hash_iterate(it)) != NULL) {
+		upload_t* upload = (upload_t*) entry -> data;
+		if (!upload -> busy && now - upload -> last >= idle_timeout) expired[n++] = upload;
+	}
+	if (it) icl_iterator_destroy(it);
+
+	for (int i = 0; i < n; i++) remove_upload(expired[i], 1);
+	if (expired) free(expired);
+}
+
+op_res_t uploads_init(char* dir_name, int dim, int max_uploads, int timeout) {
+	if (!dir_name || dim <= 0 || max_uploads < 0 || timeout < 0)
+		return ILLEGAL_ARGUMENT;
+
+	char path[1300];
+	struct dirent* entry;
+
+	memset(uploads_dir, '\0', sizeof(uploads_dir));
+	if (snprintf(uploads_dir, sizeof(uploads_dir), "%s/%s", dir_name, UPLOADS_DIR) >= (int)sizeof(uploads_dir))
+		return ILLEGAL_ARGUMENT;
+
+	if (mkdir(uploads_dir, 0700) == -1 && errno != EEXIST)
+		return SYSTEM_ERROR;
+
+	/* GLI IDENTIFICATIVI NON SOPRAVVIVONO AL RIAVVIO ==> I FILE PARZIALI PRECEDENTI NON SONO PIÙ RIPRENDIBILI */
+	DIR* d = opendir(uploads_dir);
+	if (d == NULL)
+		return SYSTEM_ERROR;
+	while ((entry = readdir(d)) != NULL) {
+		if (entry -> d_name[0] == '.') continue;
+		snprintf(path, sizeof(path), "%s/%s", uploads_dir, entry -> d_name);
+		unlink(path);
+	}
+	closedir(d);
+
+	uploads = icl_hash_create(dim, NULL, NULL);
+	owners = icl_hash_create(dim, NULL, NULL);
+	if (uploads == NULL || owners == NULL) {
+		if (uploads) icl_hash_destroy(uploads, NULL, NULL);
+		if (owners) icl_hash_destroy(owners, NULL, NULL);
+		uploads = owners = NULL;
+		return SYSTEM_ERROR;
+	}
+	max_per_owner = max_uploads;
+	idle_timeout = timeout;
+	last_sweep = time(NULL);
+
+	return REQUEST_OK;
+}
+
+void uploads_destroy() {
+	char path[1200];
+	icl_entry_t* entry;
+
+	if (uploads == NULL) return;
+
+	icl_iterator_t* it = icl_iterator_create(uploads);
+	while (it != NULL && (entry = icl_hash_iterate(it)) != NULL) {
+		part_path(((upload_t*) entry -> data) -> key, path, sizeof(path));
+		unlink(path);
+	}
+	if (it) icl_iterator_destroy(it);
+
+	icl_hash_destroy(uploads, NULL, free_upload);
+	icl_hash_destroy(owners, free_key, free);
+	uploads = owners = NULL;
+}
+
+op_res_t upload_begin(char* owner, char* receiver, char* name, unsigned long* id) {
+	if (!owner || !receiver || !name || !id)
+		return ILLEGAL_ARGUMENT;
+
+	char path[1200];
+	upload_t* upload = (upload_t*) malloc(sizeof(upload_t));
+	if (upload == NULL)
+		return SYSTEM_ERROR;
+	memset(upload, 0, sizeof(upload_t));
+	strncpy(upload -> owner, owner, MAX_NAME_LENGTH);
+	strncpy(upload -> receiver, receiver, MAX_NAME_LENGTH);
+	upload -> name = (char*) malloc((strlen(name)+1)*sizeof(char));
+	if (upload -> name == NULL) {
+		free(upload);
+		return SYSTEM_ERROR;
+	}
+	strcpy(upload -> name, name);
+
+	time_t now = time(NULL);
+	LP_LOCK(LP_UPLOADS, 0, &uploads_mtx);
+	sweep_idle(now);
+	/* L'UTENTE HA GIÀ IL NUMERO MASSIMO DI CARICAMENTI APERTI */
+	owner_t* own = icl_hash_find(owners, owner);
+	if (max_per_owner > 0 && own != NULL && own -> count >= max_per_owner) {
+		LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+		free_upload(upload);
+		return CLIENT_ERROR;
+	}
+	*id = next_id++;
+	snprintf(upload -> key, sizeof(upload -> key), "%lu", *id);
+	LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+
+	/* IL FILE PARZIALE VIENE CREATO SUBITO (VUOTO) SENZA MUTUA ESCLUSIONE */
+	part_path(upload -> key, path, sizeof(path));
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd == -1) {
+		free_upload(upload);
+		return SYSTEM_ERROR;
+	}
+	close(fd);
+	upload -> last = now;
+
+	LP_LOCK(LP_UPLOADS, 0, &uploads_mtx);
+	/* IL LIMITE VIENE CONTROLLATO DI NUOVO: UN ALTRO CARICAMENTO DELLO STESSO UTENTE PUÒ ESSERE STATO APERTO NEL FRATTEMPO */
+	own = icl_hash_find(owners, owner);
+	if (own == NULL) {
+		char* k = (char*) malloc((strlen(upload -> owner)+1)*sizeof(char));
+		own = (owner_t*) malloc(sizeof(owner_t));
+		if (k) strcpy(k, upload -> owner);
+		if (own) memset(own, 0, sizeof(owner_t));
+		if (!k || !own || icl_hash_insert(owners, k, own) == NULL) {
+			LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+			if (k) free(k);
+			if (own) free(own);
+			unlink(path);
+			free_upload(upload);
+			return SYSTEM_ERROR;
+		}
+	}
+	else if (max_per_owner > 0 && own -> count >= max_per_owner) {
+		LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+		unlink(path);
+		free_upload(upload);
+		return CLIENT_ERROR;
+	}
+	if (icl_hash_insert(uploads, upload -> key, upload) == NULL) {
+		if (own -> count == 0) icl_hash_delete(owners, upload -> owner, free_key, free);
+		LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+		unlink(path);
+		free_upload(upload);
+		return SYSTEM_ERROR;
+	}
+	upload -> next = own -> head;
+	if (own -> head) own -> head -> prev = upload;
+	own -> head = upload;
+	own -> count++;
+	LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+
+	return REQUEST_OK;
+}
+
+op_res_t upload_append(unsigned long id, char* owner, unsigned long offset, char* buf, size_t len, unsigned long* size) {
+	if (!owner || !size || (!buf && len > 0))
+		return ILLEGAL_ARGUMENT;
+
+	char path[1200];
+	op_res_t result = REQUEST_OK;
+	time_t now = time(NULL);
+
+	LP_LOCK(LP_UPLOADS, 0, &uploads_mtx);
+	sweep_idle(now);
+	upload_t* upload = find_upload(id, owner);
+	if (upload == NULL) {
+		LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+		return NOT_FOUND;
+	}
+	upload -> last = now;
+	*size = upload -> size;
+	if (len == 0) {
+		LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+		return REQUEST_OK;
+	}
+	if (offset != upload -> size) {
+		LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+		return CLIENT_ERROR;
+	}
+	/* LA SCRITTURA AVVIENE SENZA MUTUA ESCLUSIONE SULLA TABELLA: IL CARICAMENTO VIENE SEGNATO IN USO */
+	upload -> busy = 1;
+	LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+
+	part_path(upload -> key, path, sizeof(path));
+	int fd = open(path, O_WRONLY);
+	size_t written = 0;
+	ssize_t n;
+	if (fd == -1) result = SYSTEM_ERROR;
+	while (result == REQUEST_OK && written < len) {
+		if ((n = pwrite(fd, buf + written, len - written, offset + written)) == -1) result = SYSTEM_ERROR;
+		else written += n;
+	}
+	/* IN CASO DI ERRORE IL FILE PARZIALE TORNA ALLA DIMENSIONE PRECEDENTE, IL CLIENT PUÒ RIPROVARE */
+	if (fd != -1) {
+		if (result != REQUEST_OK && ftruncate(fd, offset) == -1) result = SYSTEM_ERROR;
+		close(fd);
+	}
+
+	LP_LOCK(LP_UPLOADS, 0, &uploads_mtx);
+	if (upload -> cancelled) {
+		/* IL CARICAMENTO È STATO ANNULLATO DURANTE LA SCRITTURA (DEREGISTRAZIONE DEL PROPRIETARIO) */
+		remove_upload(upload, 1);
+		LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+		return NOT_FOUND;
+	}
+	if (result == REQUEST_OK) upload -> size += len;
+	*size = upload -> size;
+	upload -> busy = 0;
+	upload -> last = time(NULL);
+	LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+
+	return result;
+}
+
+op_res_t upload_commit(unsigned long id, char* owner, unsigned long size, char* receiver, char** name, char* path, size_t path_size) {
+	if (!owner || !receiver || !name || !path)
+		return ILLEGAL_ARGUMENT;
+
+	LP_LOCK(LP_UPLOADS, 0, &uploads_mtx);
+	sweep_idle(time(NULL));
+	upload_t* upload = find_upload(id, owner);
+	if (upload == NULL) {
+		LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+		return NOT_FOUND;
+	}
+	if (size != upload -> size) {
+		LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+		return CLIENT_ERROR;
+	}
+	memset(receiver, '\0', MAX_NAME_LENGTH+1);
+	strncpy(receiver, upload -> receiver, MAX_NAME_LENGTH);
+	part_path(upload -> key, path, path_size);
+	/* IL NOME PASSA AL CHIAMANTE */
+	*name = upload -> name;
+	upload -> name = NULL;
+	remove_upload(upload, 0);
+	LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+
+	return REQUEST_OK;
+}
+
+void uploads_cancel_owner(char* owner) {
+	if (!owner) return;
+
+	LP_LOCK(LP_UPLOADS, 0, &uploads_mtx);
+	owner_t* own = icl_hash_find(owners, owner);
+	upload_t* upload = (own != NULL) ? own -> head : NULL;
+	while (upload != NULL) {
+		upload_t* next = upload -> next;
+		/* UN CARICAMENTO IN USO VIENE RIMOSSO DAL THREAD CHE STA SCRIVENDO IL BLOCCO */
+		if (upload -> busy) upload -> cancelled = 1;
+		else remove_upload(upload, 1);
+		upload = next;
+	}
+	LP_UNLOCK(LP_UPLOADS, 0, &uploads_mtx);
+}
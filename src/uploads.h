@@ -0,0 +1,95 @@
+
+/** \file uploads.h
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#if !defined(UPLOADS_H_)
+#define UPLOADS_H_
+
+#include <stddef.h>
+#include "op_res.h"
+#include "config.h"
+
+/**   Caricamenti a blocchi dei file
+ *    Un caricamento viene aperto da upload_begin, che restituisce il suo identificativo, riceve i blocchi in ordine
+ *    (ognuno con la posizione a cui va scritto) in un file parziale DirName/.uploads/<id>.part e viene chiuso da
+ *    upload_commit, dopo il quale il file parziale può essere spostato nello store. In memoria resta solo il blocco
+ *    in corso di scrittura. I caricamenti sopravvivono alla disconnessione del proprietario, che può riprenderli
+ *    chiedendo la dimensione già ricevuta, ma vengono annullati se restano inattivi troppo a lungo; ogni utente può
+ *    avere un numero limitato di caricamenti aperti. Tutte le funzioni (tranne init e destroy) sono thread-safe.
+ */
+
+/**   Inizializza la tabella dei caricamenti e rimuove i file parziali rimasti da un'esecuzione precedente,
+ *    deve essere chiamata da un solo thread (tipicamente il thread main)
+ *
+ *    \param dir_name:     directory in cui creare la sottodirectory dei file parziali
+ *    \param dim:          dimensione della tabella hash
+ *    \param max_uploads:  numero massimo di caricamenti aperti contemporaneamente da un utente (0 nessun limite)
+ *    \param timeout:      secondi di inattività dopo i quali un caricamento viene annullato (0 mai)
+ *    \return:             se dir_name == NULL || dim <= 0 || max_uploads < 0 || timeout < 0 allora ILLEGAL_ARGUMENT
+ *                         se c'è un errore nella creazione della directory o di allocazione della memoria allora SYSTEM_ERROR
+ *                         altrimenti REQUEST_OK
+ */
+op_res_t uploads_init(char* dir_name, int dim, int max_uploads, int timeout);
+
+/**   Annulla tutti i caricamenti in corso e dealloca la tabella, deve essere chiamata da un solo thread
+ */
+void uploads_destroy();
+
+/**   Apre un nuovo caricamento
+ *
+ *    \param owner:     nickname dell'utente che carica il file
+ *    \param receiver:  destinatario del file (nickname o gruppo)
+ *    \param name:      nome del file
+ *    \param id:        indirizzo in cui salvare l'identificativo del caricamento
+ *    \return:          se uno dei parametri è NULL allora ILLEGAL_ARGUMENT
+ *                      se l'utente ha già il numero massimo di caricamenti aperti allora CLIENT_ERROR
+ *                      se c'è un errore nella creazione del file parziale o di allocazione della memoria allora SYSTEM_ERROR
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t upload_begin(char* owner, char* receiver, char* name, unsigned long* id);
+
+/**   Scrive un blocco del caricamento id nella posizione offset, che deve coincidere con la dimensione già ricevuta.
+ *    Un blocco vuoto non modifica il caricamento e serve a conoscerne la dimensione (per riprenderlo)
+ *
+ *    \param id:        identificativo del caricamento
+ *    \param owner:     nickname dell'utente che carica il file
+ *    \param offset:    posizione del blocco nel file
+ *    \param buf:       contenuto del blocco
+ *    \param len:       lunghezza in byte del blocco
+ *    \param size:      indirizzo in cui salvare la dimensione ricevuta (dopo la scrittura del blocco)
+ *    \return:          se owner == NULL || size == NULL || (buf == NULL && len > 0) allora ILLEGAL_ARGUMENT
+ *                      se il caricamento non esiste, appartiene ad un altro utente o è in uso allora NOT_FOUND
+ *                      se offset è diverso dalla dimensione ricevuta allora CLIENT_ERROR
+ *                      se c'è un errore di scrittura su disco allora SYSTEM_ERROR
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t upload_append(unsigned long id, char* owner, unsigned long offset, char* buf, size_t len, unsigned long* size);
+
+/**   Chiude il caricamento id, che viene rimosso dalla tabella. Il file parziale resta su disco: il chiamante
+ *    deve spostarlo (ad esempio con file_store_put_file) o rimuoverlo
+ *
+ *    \param id:        identificativo del caricamento
+ *    \param owner:     nickname dell'utente che carica il file
+ *    \param size:      dimensione totale del file dichiarata dal client
+ *    \param receiver:  buffer di almeno MAX_NAME_LENGTH+1 byte in cui salvare il destinatario
+ *    \param name:      indirizzo in cui salvare il nome del file (allocato nello heap, da deallocare con free)
+ *    \param path:      buffer in cui salvare il path del file parziale
+ *    \param path_size: dimensione del buffer path
+ *    \return:          se uno dei parametri è NULL allora ILLEGAL_ARGUMENT
+ *                      se il caricamento non esiste, appartiene ad un altro utente o è in uso allora NOT_FOUND
+ *                      se size è diversa dalla dimensione ricevuta allora CLIENT_ERROR (il caricamento resta aperto)
+ *                      altrimenti REQUEST_OK
+ */
+op_res_t upload_commit(unsigned long id, char* owner, unsigned long size, char* receiver, char** name, char* path, size_t path_size);
+
+/**   Annulla tutti i caricamenti dell'utente owner rimuovendo i file parziali (tipicamente alla deregistrazione).
+ *    I caricamenti in uso vengono annullati al termine della scrittura del blocco in corso
+ *
+ *    \param owner:     nickname dell'utente
+ */
+void uploads_cancel_owner(char* owner);
+
+#endif /* UPLOADS_H_ */
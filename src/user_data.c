@@ -5,10 +5,15 @@
        originale dell'autore  
      */  
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <limits.h>
+#include <pthread.h>
 #include "user_data.h"
+#include "history_budget.h"
+#include "file_store.h"
 
 #define BITS_IN_int     ( sizeof(int) * CHAR_BIT )
 #define THREE_QUARTERS  ((int) ((BITS_IN_int * 3) / 4))
@@ -35,6 +40,102 @@ static void free_key(void* key) {
    if (key) free(key);
 }
 
+/**   Record di un messaggio della history riversata su disco (seguito da len byte del buffer)
+ */
+typedef struct spill_record {
+   op_t op;
+   char sender[MAX_NAME_LENGTH+1];
+   char receiver[MAX_NAME_LENGTH+1];
+   boolean_t sended;
+   unsigned long seq;
+   unsigned int len;
+} spill_record_t;
+
+/**   Numero progressivo usato per i nomi dei file temporanei degli spill
+ */
+static unsigned long tmp_counter = 0;
+
+/**   Scrive il messaggio hist_msg nel file f, ritorna -1 in caso di errore 0 altrimenti
+ */
+static int write_spill_record(FILE* f, history_msg_t* hist_msg) {
+   spill_record_t record;
+   memset(&record, '\0', sizeof(spill_record_t));
+   record.op = (hist_msg -> msg -> hdr).op;
+   strncpy(record.sender, (hist_msg -> msg -> hdr).sender, MAX_NAME_LENGTH);
+   strncpy(record.receiver, (hist_msg -> msg -> data).hdr.receiver, MAX_NAME_LENGTH);
+   record.sended = hist_msg -> sended;
+   record.seq = hist_msg -> seq;
+   record.len = (hist_msg -> msg -> data).hdr.len;
+
+   if (fwrite(&record, sizeof(spill_record_t), 1, f) != 1) return -1;
+   if (fwrite((hist_msg -> msg -> data).buf, sizeof(char), record.len, f) != record.len) return -1;
+
+   return 0;
+}
+
+/**   Legge il prossimo record dal file f, se buf == NULL il contenuto del messaggio viene saltato altrimenti viene allocato
+ *    Ritorna -1 se il file è terminato (o troncato), -2 in caso di errore di allocazione della memoria, 0 altrimenti
+ */
+static int read_spill_record(FILE* f, spill_record_t* record, char** buf) {
+   if (fread(record, sizeof(spill_record_t), 1, f) != 1) return -1;
+   if (buf == NULL) return (fseek(f, record -> len, SEEK_CUR) == 0) ? 0 : -1;
+
+   *buf = (char*) malloc((record -> len + 1)*sizeof(char));
+   if (*buf == NULL) return -2;
+   memset(*buf, '\0', record -> len + 1);
+   if (fread(*buf, sizeof(char), record -> len, f) != record -> len) {
+      free(*buf);
+      *buf = NULL;
+      return -1;
+   }
+
+   return 0;
+}
+
+/**   Estrae e rilascia il messaggio meno recente della history in memoria aggiornando la memoria occupata
+ */
+static void pop_history(user_data_t* user_data) {
+   history_msg_t* hist_msg = popBQueue(user_data -> history);
+   long size = history_message_size(hist_msg);
+   user_data -> hist_bytes -= size;
+   history_budget_account(user_data, -size);
+   free_history_message(hist_msg);
+}
+
+/**   Inserisce il messaggio in coda alla history in memoria eliminando il meno recente se la history è piena
+ */
+static void push_history(user_data_t* user_data, history_msg_t* msg) {
+   if (pushBQueue(user_data -> history, msg) == -1) {
+      pop_history(user_data);
+      pushBQueue(user_data -> history, msg);
+   } 
+   else {
+      (user_data -> num_hist_msgs)++;
+   }
+   long size = history_message_size(msg);
+   user_data -> hist_bytes += size;
+   history_budget_account(user_data, size);
+}
+
+/**   Ricarica in memoria la history riversata su disco in mutua esclusione sul blocco logico dell'utente
+ *    Succede solo se la history è stata riversata di nuovo dopo history_budget_restore (vedi history_snapshot)
+ */
+static op_res_t restore_history(user_data_t* user_data) {
+   history_disk_t restore;
+
+   if (user_data -> hist_spilled == FALSE)
+      return REQUEST_OK;
+
+   if (history_restore_prepare(user_data, &restore) != REQUEST_OK)
+      return SYSTEM_ERROR;
+   if (history_restore_load(&restore) != REQUEST_OK)
+      return SYSTEM_ERROR;
+   if (history_restore_commit(user_data, &restore) == FALSE)
+      return SYSTEM_ERROR;
+
+   return REQUEST_OK;
+}
+
 user_data_t* user_data_init(char* nick, int fd, int history_dim, int name_files_table_dim) {
    if (!nick || fd < 0 || history_dim <= 0 || name_files_table_dim <= 0) 
    	return NULL;
@@ -56,9 +157,27 @@ user_data_t* user_data_init(char* nick, int fd, int history_dim, int name_files_
       return NULL;
    }
 
+   user_data -> next_suffix = icl_hash_create(name_files_table_dim, NULL, NULL);
+   if (!(user_data -> next_suffix)) {
+      icl_hash_destroy(user_data -> name_files_rcvd, NULL, NULL);
+      destroyBQueue(user_data -> history, NULL);
+      free(user_data);
+      return NULL;
+   }
+
+   memset(user_data -> nick, '\0', MAX_NAME_LENGTH+1);
+   strncpy(user_data -> nick, nick, MAX_NAME_LENGTH);
    user_data -> fd = fd;
    user_data -> id = hash_pjw(nick);
    user_data -> num_hist_msgs = 0;
+   user_data -> next_seq = 1;
+   user_data -> hist_bytes = 0;
+   user_data -> hist_spilled = FALSE;
+   user_data -> hist_file_msgs = 0;
+   user_data -> hist_gen = 0;
+   user_data -> hist_readers = 0;
+   user_data -> lru_prev = user_data -> lru_next = NULL;
+   user_data -> in_lru = FALSE;
 
    return user_data;
 }
@@ -66,8 +185,14 @@ user_data_t* user_data_init(char* nick, int fd, int history_dim, int name_files_
 void user_data_destroy(void* user_data) {
    if ((user_data_t*)user_data) {
       user_data_t* data = (user_data_t*)user_data;
+      history_budget_forget(data);
+      if (data -> hist_spilled == TRUE) {
+         char path[2048];
+         if (history_budget_path(data -> nick, path, sizeof(path)) == REQUEST_OK) remove(path);
+      }
       if (data -> history) destroyBQueue(data -> history, free_history_message);
-      if (data -> name_files_rcvd) icl_hash_destroy(data -> name_files_rcvd, free_key, NULL);
+      if (data -> name_files_rcvd) icl_hash_destroy(data -> name_files_rcvd, free_key, free_key);
+      if (data -> next_suffix) icl_hash_destroy(data -> next_suffix, free_key, free_key);
       if (data -> fd != -1) close(data -> fd);
       free(data);
    }
@@ -119,14 +244,10 @@ op_res_t insert_message(user_data_t* user_data, history_msg_t* msg) {
    if (!msg) 
       return ILLEGAL_ARGUMENT;
 
-   if (pushBQueue(user_data -> history, msg) == -1) {
-      history_msg_t* hist_msg = popBQueue(user_data -> history);
-      free_history_message(hist_msg);
-      pushBQueue(user_data -> history, msg);
-   } 
-   else {
-      (user_data -> num_hist_msgs)++;
-   }
+   msg -> seq = (user_data -> next_seq)++;
+
+   /* ANCHE SE LA HISTORY È SU DISCO IL MESSAGGIO VIENE INSERITO IN MEMORIA: I MESSAGGI SU DISCO SONO PIÙ VECCHI */
+   push_history(user_data, msg);
 
    return REQUEST_OK;
 }
@@ -152,18 +273,405 @@ history_msg_t* history_iterate(history_iterator_t iterator) {
    return BQueue_iterator_next(iterator);
 }
 
-op_res_t insert_file_name(user_data_t* user_data, char* file_name) {
+op_res_t get_last_seq(user_data_t* user_data, unsigned long* seq) {
+   if (!user_data || !seq)
+      return ILLEGAL_ARGUMENT;
+
+   *seq = (user_data -> next_seq) - 1;
+
+   return REQUEST_OK;
+}
+
+op_res_t history_snapshot(user_data_t* user_data, unsigned long after_seq, size_t max_msgs, history_msg_t*** snapshot, size_t* n) {
+   if (!user_data || !(user_data -> history) || !snapshot || !n)
+      return ILLEGAL_ARGUMENT;
+
+   *snapshot = NULL;
+   *n = 0;
+
+   if (restore_history(user_data) == SYSTEM_ERROR)
+      return SYSTEM_ERROR;
+   /* SEGNO LA HISTORY COME USATA DI RECENTE */
+   history_budget_account(user_data, 0);
+
+   size_t len = getBQueueLen(user_data -> history);
+   if (len == 0)
+      return REQUEST_OK;
+
+   history_msg_t** array = (history_msg_t**) malloc(len*sizeof(history_msg_t*));
+   if (!array)
+      return SYSTEM_ERROR;
+
+   BQueue_iterator_t* it = BQueue_iterator_init(user_data -> history);
+   if (!it) {
+      free(array);
+      return SYSTEM_ERROR;
+   }
+
+   size_t count = 0;
+   for (size_t i = 0; i < len; i++) {
+      history_msg_t* hist_msg = BQueue_iterator_next(it);
+      if (hist_msg == NULL || hist_msg -> seq <= after_seq) continue;
+      if (max_msgs != 0 && count == max_msgs) break;
+      ref_history_message(hist_msg);
+      array[count++] = hist_msg;
+   }
+   BQueue_iterator_destroy(it);
+
+   if (count == 0) {
+      free(array);
+      return REQUEST_OK;
+   }
+
+   *snapshot = array;
+   *n = count;
+   (user_data -> hist_readers)++;
+
+   return REQUEST_OK;
+}
+
+void history_snapshot_release(user_data_t* user_data, history_msg_t** snapshot, size_t n) {
+   if (!snapshot) return;
+
+   for (size_t i = 0; i < n; i++)
+      free_history_message(snapshot[i]);
+   free(snapshot);
+
+   if (user_data) (user_data -> hist_readers)--;
+}
+
+op_res_t history_spill_prepare(user_data_t* user_data, history_disk_t* spill) {
+   if (!user_data || !(user_data -> history) || !spill)
+      return ILLEGAL_ARGUMENT;
+
+   spill -> msgs = NULL;
+   spill -> n = 0;
+
+   size_t len = getBQueueLen(user_data -> history);
+   if (len == 0 || user_data -> hist_readers > 0)
+      return REQUEST_OK;
+
+   if (history_budget_path(user_data -> nick, spill -> path, sizeof(spill -> path)) != REQUEST_OK)
+      return SYSTEM_ERROR;
+   /* IL NICK È CODIFICATO IN ESADECIMALE ==> IL NOME DEL FILE TEMPORANEO NON PUÒ COINCIDERE CON QUELLO DI UN ALTRO UTENTE */
+   if (snprintf(spill -> tmp, sizeof(spill -> tmp), "%s.%lu", spill -> path, __sync_fetch_and_add(&tmp_counter, 1)) >= (int)sizeof(spill -> tmp))
+      return SYSTEM_ERROR;
+
+   history_msg_t** msgs = (history_msg_t**) malloc(len*sizeof(history_msg_t*));
+   if (!msgs)
+      return SYSTEM_ERROR;
+   BQueue_iterator_t* it = BQueue_iterator_init(user_data -> history);
+   if (!it) {
+      free(msgs);
+      return SYSTEM_ERROR;
+   }
+   for (size_t i = 0; i < len; i++) {
+      msgs[i] = BQueue_iterator_next(it);
+      ref_history_message(msgs[i]);
+   }
+   BQueue_iterator_destroy(it);
+
+   spill -> msgs = msgs;
+   spill -> n = len;
+   spill -> max = (user_data -> history) -> qsize;
+   spill -> file_msgs = (user_data -> hist_spilled == TRUE) ? user_data -> hist_file_msgs : 0;
+   spill -> gen = user_data -> hist_gen;
+
+   /* IL FILE CONTIENE AL PIÙ max MESSAGGI: DI QUELLI GIÀ SU DISCO SI MANTENGONO SOLO I PIÙ RECENTI */
+   size_t keep = (len >= spill -> max) ? 0 : spill -> max - len;
+   if (keep > spill -> file_msgs) keep = spill -> file_msgs;
+   spill -> skip = spill -> file_msgs - keep;
+
+   return REQUEST_OK;
+}
+
+op_res_t history_spill_write(history_disk_t* spill) {
+   if (!spill)
+      return ILLEGAL_ARGUMENT;
+
+   FILE* f = fopen(spill -> tmp, "wb");
+   if (f == NULL)
+      return SYSTEM_ERROR;
+
+   int error = 0;
+   /* COPIO I MESSAGGI GIÀ SU DISCO CHE RESTANO NELLA HISTORY */
+   if (spill -> file_msgs > spill -> skip) {
+      spill_record_t record;
+      char* buf;
+      FILE* old = fopen(spill -> path, "rb");
+      if (old == NULL) error = 1;
+      for (size_t i = 0; i < spill -> file_msgs && !error; i++) {
+         if (i < spill -> skip) {
+            if (read_spill_record(old, &record, NULL) != 0) error = 1;
+            continue;
+         }
+         if (read_spill_record(old, &record, &buf) != 0) error = 1;
+         else {
+            if (fwrite(&record, sizeof(spill_record_t), 1, f) != 1 || fwrite(buf, sizeof(char), record.len, f) != record.len) error = 1;
+            free(buf);
+         }
+      }
+      if (old) fclose(old);
+   }
+   for (size_t i = 0; i < spill -> n && !error; i++) {
+      if (write_spill_record(f, spill -> msgs[i]) == -1) error = 1;
+   }
+
+   if (fclose(f) != 0 || error) {
+      remove(spill -> tmp);
+      return SYSTEM_ERROR;
+   }
+
+   return REQUEST_OK;
+}
+
+void history_spill_commit(user_data_t* user_data, history_disk_t* spill, boolean_t written, int* nmsgs) {
+   if (nmsgs) *nmsgs = 0;
+   if (!spill || spill -> n == 0)
+      return;
+
+   boolean_t valid = (user_data != NULL && written == TRUE && user_data -> hist_gen == spill -> gen && user_data -> hist_readers == 0) ? TRUE : FALSE;
+   /* I MESSAGGI RIVERSATI DEVONO ESSERE ANCORA I PIÙ VECCHI IN MEMORIA (NESSUNO È STATO ELIMINATO PER FAR SPAZIO AI NUOVI) */
+   if (valid == TRUE) {
+      BQueue_iterator_t* it = BQueue_iterator_init(user_data -> history);
+      if (!it || getBQueueLen(user_data -> history) < spill -> n) valid = FALSE;
+      for (size_t i = 0; i < spill -> n && valid == TRUE; i++) {
+         if (BQueue_iterator_next(it) != spill -> msgs[i]) valid = FALSE;
+      }
+      if (it) BQueue_iterator_destroy(it);
+   }
+   if (valid == TRUE && rename(spill -> tmp, spill -> path) == -1) valid = FALSE;
+
+   if (valid == TRUE) {
+      for (size_t i = 0; i < spill -> n; i++)
+         pop_history(user_data);
+      user_data -> num_hist_msgs = getBQueueLen(user_data -> history);
+      user_data -> hist_file_msgs = (spill -> file_msgs - spill -> skip) + spill -> n;
+      user_data -> hist_spilled = TRUE;
+      (user_data -> hist_gen)++;
+      if (nmsgs) *nmsgs = spill -> n;
+   }
+   else if (written == TRUE) remove(spill -> tmp);
+
+   for (size_t i = 0; i < spill -> n; i++)
+      free_history_message(spill -> msgs[i]);
+   free(spill -> msgs);
+   spill -> msgs = NULL;
+   spill -> n = 0;
+}
+
+op_res_t history_restore_prepare(user_data_t* user_data, history_disk_t* restore) {
+   if (!user_data || !(user_data -> history) || !restore)
+      return ILLEGAL_ARGUMENT;
+
+   restore -> msgs = NULL;
+   restore -> n = 0;
+   restore -> file_msgs = 0;
+
+   if (user_data -> hist_spilled == FALSE)
+      return REQUEST_OK;
+
+   if (history_budget_path(user_data -> nick, restore -> path, sizeof(restore -> path)) != REQUEST_OK)
+      return SYSTEM_ERROR;
+
+   restore -> max = (user_data -> history) -> qsize;
+   restore -> file_msgs = user_data -> hist_file_msgs;
+   restore -> gen = user_data -> hist_gen;
+
+   /* I MESSAGGI IN MEMORIA SONO PIÙ RECENTI: DI QUELLI SU DISCO SI LEGGONO SOLO GLI ULTIMI CHE ENTRANO NELLA HISTORY */
+   size_t len = getBQueueLen(user_data -> history);
+   size_t keep = (len >= restore -> max) ? 0 : restore -> max - len;
+   if (keep > restore -> file_msgs) keep = restore -> file_msgs;
+   restore -> skip = restore -> file_msgs - keep;
+
+   return REQUEST_OK;
+}
+
+op_res_t history_restore_load(history_disk_t* restore) {
+   if (!restore)
+      return ILLEGAL_ARGUMENT;
+
+   restore -> msgs = NULL;
+   restore -> n = 0;
+   if (restore -> file_msgs <= restore -> skip)
+      return REQUEST_OK;
+
+   FILE* f = fopen(restore -> path, "rb");
+   if (f == NULL)
+      return SYSTEM_ERROR;
+
+   restore -> msgs = (history_msg_t**) malloc((restore -> file_msgs - restore -> skip)*sizeof(history_msg_t*));
+   if (!(restore -> msgs)) {
+      fclose(f);
+      return SYSTEM_ERROR;
+   }
+
+   spill_record_t record;
+   message_t msg;
+   char* buf;
+   int res = 0, error = 0;
+   for (size_t i = 0; i < restore -> file_msgs && res == 0; i++) {
+      /* SE IL FILE È TRONCATO MANTENGO I MESSAGGI LETTI FINO A QUEL PUNTO */
+      res = read_spill_record(f, &record, (i < restore -> skip) ? NULL : &buf);
+      if (res == -2) error = 1;
+      if (res != 0 || i < restore -> skip) continue;
+
+      setHeader(&msg.hdr, record.op, record.sender);
+      setData(&msg.data, record.receiver, buf, record.len);
+      history_msg_t* hist_msg = init_history_message(msg, record.sended);
+      free(buf);
+      if (!hist_msg) {
+         error = 1;
+         break;
+      }
+      hist_msg -> seq = record.seq;
+      restore -> msgs[(restore -> n)++] = hist_msg;
+   }
+   fclose(f);
+
+   if (error) {
+      for (size_t i = 0; i < restore -> n; i++)
+         free_history_message(restore -> msgs[i]);
+      free(restore -> msgs);
+      restore -> msgs = NULL;
+      restore -> n = 0;
+      return SYSTEM_ERROR;
+   }
+
+   return REQUEST_OK;
+}
+
+boolean_t history_restore_commit(user_data_t* user_data, history_disk_t* restore) {
+   if (!restore)
+      return FALSE;
+
+   boolean_t valid = (user_data != NULL && user_data -> hist_spilled == TRUE && user_data -> hist_gen == restore -> gen) ? TRUE : FALSE;
+   if (valid == TRUE) {
+      /* DALLA PREPARE POSSONO ESSERE ARRIVATI NUOVI MESSAGGI: DI QUELLI LETTI SI INSERISCONO SOLO GLI ULTIMI CHE ENTRANO */
+      size_t len = getBQueueLen(user_data -> history);
+      size_t first = (restore -> n + len > restore -> max) ? restore -> n + len - restore -> max : 0;
+      if (first > restore -> n) first = restore -> n;
+
+      /* I MESSAGGI IN MEMORIA SONO PIÙ RECENTI DI QUELLI LETTI: LI ESTRAGGO E LI REINSERISCO IN CODA */
+      history_msg_t** newer = NULL;
+      if (len > 0 && (newer = (history_msg_t**) malloc(len*sizeof(history_msg_t*))) == NULL) valid = FALSE;
+      if (valid == TRUE) {
+         long size = 0;
+         for (size_t i = 0; i < len; i++)
+            newer[i] = popBQueue(user_data -> history);
+         for (size_t i = first; i < restore -> n; i++) {
+            pushBQueue(user_data -> history, restore -> msgs[i]);
+            size += history_message_size(restore -> msgs[i]);
+            restore -> msgs[i] = NULL;
+         }
+         for (size_t i = 0; i < len; i++)
+            pushBQueue(user_data -> history, newer[i]);
+         if (newer) free(newer);
+
+         user_data -> num_hist_msgs = getBQueueLen(user_data -> history);
+         user_data -> hist_bytes += size;
+         history_budget_account(user_data, size);
+         remove(restore -> path);
+         user_data -> hist_spilled = FALSE;
+         user_data -> hist_file_msgs = 0;
+         (user_data -> hist_gen)++;
+      }
+   }
+
+   for (size_t i = 0; i < restore -> n; i++) {
+      if (restore -> msgs[i]) free_history_message(restore -> msgs[i]);
+   }
+   if (restore -> msgs) free(restore -> msgs);
+   restore -> msgs = NULL;
+   restore -> n = 0;
+
+   return valid;
+}
+
+op_res_t history_drop(user_data_t* user_data, int* nmsgs) {
+   if (!user_data || !(user_data -> history) || !nmsgs)
+      return ILLEGAL_ARGUMENT;
+
+   *nmsgs = 0;
+
+   size_t len = getBQueueLen(user_data -> history);
+   if (len == 0 || user_data -> hist_readers > 0)
+      return REQUEST_OK;
+
+   for (size_t i = 0; i < len; i++)
+      pop_history(user_data);
+   user_data -> num_hist_msgs = 0;
+   *nmsgs = len;
+
+   return REQUEST_OK;
+}
+
+op_res_t unique_file_name(user_data_t* user_data, char* file_name, char* unique, size_t size) {
+   if (!user_data || !(user_data -> name_files_rcvd) || !(user_data -> next_suffix) || !file_name || !unique)
+      return ILLEGAL_ARGUMENT;
+
+   if (snprintf(unique, size, "%s", file_name) >= (int)size)
+      return ILLEGAL_ARGUMENT;
+
+   /* PRIMO FILE CON QUESTO NOME ==> NESSUN SUFFISSO */
+   int* next = icl_hash_find(user_data -> next_suffix, file_name);
+   if (next == NULL && icl_hash_find(user_data -> name_files_rcvd, unique) == NULL)
+      return REQUEST_OK;
+
+   if (next == NULL) {
+      char* name = (char*) malloc((strlen(file_name)+1)*sizeof(char));
+      next = (int*) malloc(sizeof(int));
+      if (name) strcpy(name, file_name);
+      if (next) *next = 1;
+      if (!name || !next || icl_hash_insert(user_data -> next_suffix, name, next) == NULL) {
+         if (name) free(name);
+         if (next) free(next);
+         return SYSTEM_ERROR;
+      }
+   }
+
+   /* PARTO DAL PROSSIMO SUFFISSO LIBERO: SI SALTANO SOLO I NOMI CON SUFFISSO RICEVUTI COME TALI (ES. "a(1)") */
+   do {
+      if (snprintf(unique, size, "%s(%d)", file_name, *next) >= (int)size)
+         return ILLEGAL_ARGUMENT;
+      (*next)++;
+   } while (icl_hash_find(user_data -> name_files_rcvd, unique) != NULL);
+
+   return REQUEST_OK;
+}
+
+op_res_t insert_file_name(user_data_t* user_data, char* file_name, char* file_key) {
    if (!user_data || !(user_data -> name_files_rcvd)) 
       return ILLEGAL_ARGUMENT;
 
-   if (!file_name) 
+   if (!file_name || !file_key) 
       return ILLEGAL_ARGUMENT;
 
    if (icl_hash_find(user_data -> name_files_rcvd, file_name) != NULL)
       return ALREADY_INSERTED;
 
-   if (icl_hash_insert(user_data -> name_files_rcvd, file_name, file_name) == NULL)
+   char* name = (char*) malloc((strlen(file_name)+1)*sizeof(char));
+   char* key = (char*) malloc((strlen(file_key)+1)*sizeof(char));
+   if (!name || !key) {
+      if (name) free(name);
+      if (key) free(key);
       return SYSTEM_ERROR;
+   }
+   strcpy(name, file_name);
+   strcpy(key, file_key);
+
+   /* IL NOME FA RIFERIMENTO AL FILE NELLO STORE FINCHÈ L'UTENTE NON SI DEREGISTRA */
+   if (file_store_ref(key) != REQUEST_OK) {
+      free(name);
+      free(key);
+      return SYSTEM_ERROR;
+   }
+   if (icl_hash_insert(user_data -> name_files_rcvd, name, key) == NULL) {
+      file_store_release(key);
+      free(name);
+      free(key);
+      return SYSTEM_ERROR;
+   }
 
    return REQUEST_OK;
 }
@@ -181,8 +689,22 @@ op_res_t search_file_name(user_data_t* user_data, char* file_name) {
    return FOUND;
 }
 
-op_res_t remove_all_file(user_data_t* user_data, char* dir_name) {
-   if (!user_data || !(user_data -> name_files_rcvd) || !dir_name)
+op_res_t get_file_key(user_data_t* user_data, char* file_name, char* file_key) {
+   if (!user_data || !(user_data -> name_files_rcvd) || !file_name || !file_key)
+      return ILLEGAL_ARGUMENT;
+
+   char* key = icl_hash_find(user_data -> name_files_rcvd, file_name);
+   if (key == NULL)
+      return NOT_FOUND;
+
+   memset(file_key, '\0', STORE_KEY_LENGTH);
+   strncpy(file_key, key, STORE_KEY_LENGTH-1);
+
+   return REQUEST_OK;
+}
+
+op_res_t remove_all_file(user_data_t* user_data) {
+   if (!user_data || !(user_data -> name_files_rcvd))
       return ILLEGAL_ARGUMENT;
 
    icl_iterator_t* iterator = icl_iterator_create(user_data -> name_files_rcvd);
@@ -190,18 +712,12 @@ op_res_t remove_all_file(user_data_t* user_data, char* dir_name) {
       return SYSTEM_ERROR;
 
    icl_entry_t* entry;
-   char* file_name;
-   char file_path[2048];
    while((entry = icl_hash_iterate(iterator)) != NULL) {
-      file_name = entry -> data;
-      memset(file_path, '\0', 2048);
-      strncpy(file_path, dir_name, strlen(dir_name));
-      strncat(file_path, "/", 1);
-      strncat(file_path, file_name, strlen(file_name));
-      remove(file_path);
+      /* IL FILE POTREBBE ESSERE DESTINATO ANCHE AD ALTRI UTENTI: VIENE RIMOSSO SOLO CON L'ULTIMO RIFERIMENTO */
+      file_store_release(entry -> data);
    }
 
    icl_iterator_destroy(iterator);
 
    return REQUEST_OK;
-}
\ No newline at end of file
+}
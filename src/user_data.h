@@ -12,19 +12,46 @@
 #include "icl_hash.h"
 #include "history_msg.h"
 #include "op_res.h"
+#include "config.h"
 
 /**   Struttura dati contenente informazioni associate ad un utente
  */
 typedef struct user_data {
+   char nick[MAX_NAME_LENGTH+1];	/**<	Nickname dell'utente																*/
    BQueue_t* history;				/**<	Coda contenente gli ultimi messaggi inviati all'utente		*/
-   icl_hash_t* name_files_rcvd;	/**<	Tabella hash contenente i nomi dei file inviati all'utente	*/	
+   icl_hash_t* name_files_rcvd;	/**<	Tabella hash nome del file inviato all'utente -> chiave nello store	*/	
+   icl_hash_t* next_suffix;		/**<	Tabella hash nome del file -> prossimo suffisso (i) da usare per quel nome	*/
    int num_hist_msgs;				/**<	Dimensione della history												*/
+   unsigned long next_seq;			/**<	Numero di sequenza da assegnare al prossimo messaggio della history	*/
+   long hist_bytes;					/**<	Memoria occupata dai messaggi della history in memoria					*/
+   boolean_t hist_spilled;			/**<	TRUE se e solo se la history è stata riversata su disco					*/
+   int hist_file_msgs;				/**<	Numero di messaggi della history riversati su disco (più vecchi di quelli in memoria)	*/
+   unsigned long hist_gen;			/**<	Incrementato ad ogni spill o restore della history (vedi history_spill_commit)	*/
+   int hist_readers;					/**<	Numero di snapshot della history in corso (history non riversabile)	*/
+   struct user_data* lru_prev;	/**<	Utente usato più di recente nella lista LRU (vedi history_budget.h)	*/
+   struct user_data* lru_next;	/**<	Utente usato meno di recente nella lista LRU (vedi history_budget.h)	*/
+   boolean_t in_lru;					/**<	TRUE se e solo se l'utente è nella lista LRU									*/
    int fd;								/**<	Descrittore dell'utente se è connesso, -1 altrimenti			*/
    int id;								/**<	Id immutabile associato all'utente (non univoco)				*/
 } user_data_t;
 
 typedef BQueue_iterator_t* history_iterator_t;	//Iteratore history
 
+/**   Stato di uno spill (o di un restore) della history in corso
+ *    Lo spill e il restore sono divisi in tre fasi: prepare e commit in mutua esclusione sul blocco logico dell'utente,
+ *    write (load) senza mutex, in modo da non effettuare I/O su disco mantenendo la mutex sul blocco logico
+ */
+typedef struct history_disk {
+   char path[2048];					/**<	File della history riversata su disco									*/
+   char tmp[2048];					/**<	File temporaneo su cui viene scritta la nuova history (spill)		*/
+   history_msg_t** msgs;			/**<	Messaggi da riversare (spill) o letti dal disco (restore)			*/
+   size_t n;							/**<	Numero di messaggi in msgs													*/
+   size_t max;							/**<	Numero massimo di messaggi della history									*/
+   size_t skip;						/**<	Messaggi più vecchi del file da scartare (spill)						*/
+   size_t file_msgs;					/**<	Messaggi presenti nel file al momento della prepare					*/
+   unsigned long gen;				/**<	Valore di hist_gen al momento della prepare								*/
+} history_disk_t;
+
 /* FUNZIONI DI INTERFACCIA */
 
 /**	Inizializza la struttura dati user_data_t
@@ -80,8 +107,10 @@ op_res_t get_id(user_data_t* user_data, int* id);
  */
 op_res_t get_num_hist_msgs(user_data_t* user_data, int* num_hist_msgs);
 
-/**	Inserisce un messaggio nella history dell'utente
+/**	Inserisce un messaggio nella history dell'utente assegnandogli il prossimo numero di sequenza
  * 	Se la history è piena per far spazio al nuovo messaggio verrà eliminato il messaggio inserito meno di recente
+ * 	Se la history è stata riversata su disco il messaggio viene inserito in memoria senza ricaricare la history
+ * 	(i messaggi su disco sono più vecchi di quelli in memoria)
  * 
  * 	\param user_data:	puntatore alla struttura dati user_data_t
  * 	\param msg: 		puntatore al messaggio da inserire (history_msg_t definito in history_msg.h)
@@ -113,16 +142,141 @@ void history_iterator_close(history_iterator_t iterator);
  */
 history_msg_t* history_iterate(history_iterator_t iterator);
 
-/**	Inserisce il nome di un file nella tabella name_files_rcvd
+/**	Restituisce il numero di sequenza dell'ultimo messaggio inserito nella history (0 se nessuno)
  * 
  * 	\param user_data:	puntatore alla struttura dati user_data_t
- * 	\param file_name: nome del file
- * 	\return:				se user_data == NULL || file_name == NULL allora ILLEGAL_ARGUMENT
- * 							se è già presente un match con la chiave file_name in name_files_rcvd allora ALREADY_INSERTED
+ * 	\param seq:			indirizzo della variabile in cui salvare il numero di sequenza
+ * 	\return:				se user_data == NULL || seq == NULL allora ILLEGAL_ARGUMENT
+ * 							altrimenti REQUEST_OK
+ */
+op_res_t get_last_seq(user_data_t* user_data, unsigned long* seq);
+
+/**	Effettua uno snapshot dei messaggi della history con numero di sequenza maggiore di after_seq,
+ * 	dal meno recente al più recente e al più max_msgs (se max_msgs == 0 allora tutti).
+ * 	Se la history è stata riversata su disco viene prima ricaricata in memoria (normalmente il chiamante
+ * 	la ricarica prima con history_budget_restore, senza mantenere la mutex durante la lettura dal disco).
+ * 	Per ogni messaggio dello snapshot viene acquisito un riferimento, in modo che il chiamante
+ * 	possa inviarli dopo aver rilasciato la mutex sul blocco logico dell'utente
+ * 
+ * 	\param user_data:	puntatore alla struttura dati user_data_t
+ * 	\param after_seq:	numero di sequenza dopo il quale iniziare lo snapshot
+ * 	\param max_msgs:		numero massimo di messaggi dello snapshot (0 nessun limite)
+ * 	\param snapshot:		indirizzo in cui salvare l'array allocato dei messaggi (NULL se vuoto)
+ * 	\param n:				indirizzo in cui salvare il numero di messaggi dello snapshot
+ * 	\return:				se user_data == NULL || snapshot == NULL || n == NULL allora ILLEGAL_ARGUMENT
  * 							se c'è un errore nella gestione della memoria dinamica allora SYSTEM_ERROR
  * 							altrimenti REQUEST_OK
  */
-op_res_t insert_file_name(user_data_t* user_data, char* file_name);
+op_res_t history_snapshot(user_data_t* user_data, unsigned long after_seq, size_t max_msgs, history_msg_t*** snapshot, size_t* n);
+
+/**	Rilascia i riferimenti acquisiti con history_snapshot e dealloca l'array
+ * 	Deve essere chiamata in mutua esclusione sul blocco logico dell'utente
+ * 
+ * 	\param user_data:	puntatore alla struttura dati user_data_t
+ * 	\param snapshot:		array dei messaggi dello snapshot
+ * 	\param n:				numero di messaggi dello snapshot
+ */
+void history_snapshot_release(user_data_t* user_data, history_msg_t** snapshot, size_t n);
+
+/**	Prima fase dello spill: acquisisce i riferimenti ai messaggi della history in memoria
+ * 	Deve essere chiamata in mutua esclusione sul blocco logico dell'utente
+ * 	Se è in corso uno snapshot della history o la history in memoria è vuota allora spill -> n == 0 (niente da riversare)
+ * 
+ * 	\param user_data:	puntatore alla struttura dati user_data_t
+ * 	\param spill:		stato dello spill da inizializzare
+ * 	\return:				se user_data == NULL || spill == NULL allora ILLEGAL_ARGUMENT
+ * 							se c'è un errore di allocazione della memoria allora SYSTEM_ERROR
+ * 							altrimenti REQUEST_OK
+ */
+op_res_t history_spill_prepare(user_data_t* user_data, history_disk_t* spill);
+
+/**	Seconda fase dello spill: scrive su un file temporaneo i messaggi più recenti già su disco seguiti
+ * 	da quelli in memoria, mantenendone al più max (la dimensione della history). Non richiede mutex
+ * 
+ * 	\param spill:	stato dello spill
+ * 	\return:		se spill == NULL allora ILLEGAL_ARGUMENT
+ * 					se c'è un errore di lettura o scrittura su disco allora SYSTEM_ERROR
+ * 					altrimenti REQUEST_OK
+ */
+op_res_t history_spill_write(history_disk_t* spill);
+
+/**	Ultima fase dello spill: se la history non è cambiata dalla prepare sostituisce il file della history con
+ * 	quello temporaneo ed elimina dalla memoria i messaggi riversati, altrimenti elimina il file temporaneo.
+ * 	In ogni caso rilascia i riferimenti acquisiti con history_spill_prepare.
+ * 	Deve essere chiamata in mutua esclusione sul blocco logico dell'utente
+ * 
+ * 	\param user_data:	puntatore alla struttura dati user_data_t (NULL se l'utente è stato deregistrato)
+ * 	\param spill:		stato dello spill
+ * 	\param written:		TRUE se e solo se history_spill_write ha avuto successo
+ * 	\param nmsgs:		indirizzo in cui salvare il numero di messaggi riversati
+ */
+void history_spill_commit(user_data_t* user_data, history_disk_t* spill, boolean_t written, int* nmsgs);
+
+/**	Prima fase del restore: verifica se la history è riversata su disco
+ * 	Deve essere chiamata in mutua esclusione sul blocco logico dell'utente
+ * 
+ * 	\param user_data:	puntatore alla struttura dati user_data_t
+ * 	\param restore:		stato del restore da inizializzare (restore -> file_msgs == 0 se non c'è niente da ricaricare)
+ * 	\return:				se user_data == NULL || restore == NULL allora ILLEGAL_ARGUMENT
+ * 							altrimenti REQUEST_OK
+ */
+op_res_t history_restore_prepare(user_data_t* user_data, history_disk_t* restore);
+
+/**	Seconda fase del restore: legge dal disco i messaggi della history (al più max, i più recenti). Non richiede mutex
+ * 
+ * 	\param restore:	stato del restore
+ * 	\return:			se restore == NULL allora ILLEGAL_ARGUMENT
+ * 						se c'è un errore di lettura o di allocazione della memoria allora SYSTEM_ERROR
+ * 						altrimenti REQUEST_OK
+ */
+op_res_t history_restore_load(history_disk_t* restore);
+
+/**	Ultima fase del restore: se la history non è cambiata dalla prepare inserisce i messaggi letti prima di quelli
+ * 	in memoria ed elimina il file, altrimenti dealloca i messaggi letti.
+ * 	Deve essere chiamata in mutua esclusione sul blocco logico dell'utente
+ * 
+ * 	\param user_data:	puntatore alla struttura dati user_data_t (NULL se l'utente è stato deregistrato)
+ * 	\param restore:		stato del restore
+ * 	\return:				TRUE se e solo se la history è stata ricaricata
+ */
+boolean_t history_restore_commit(user_data_t* user_data, history_disk_t* restore);
+
+/**	Elimina i messaggi della history dell'utente presenti in memoria
+ * 	Se è in corso uno snapshot della history allora la history non viene eliminata
+ * 
+ * 	\param user_data:	puntatore alla struttura dati user_data_t
+ * 	\param nmsgs:		indirizzo in cui salvare il numero di messaggi eliminati
+ * 	\return:				se user_data == NULL || nmsgs == NULL allora ILLEGAL_ARGUMENT
+ * 							altrimenti REQUEST_OK
+ */
+op_res_t history_drop(user_data_t* user_data, int* nmsgs);
+
+/**	Costruisce un nome per il file file_name non ancora presente tra i file ricevuti dall'utente,
+ * 	aggiungendo se necessario un suffisso (i). Il prossimo suffisso da usare per ogni nome è mantenuto
+ * 	in next_suffix, quindi il costo non dipende dal numero di file con lo stesso nome
+ * 
+ * 	\param user_data:	puntatore alla struttura dati user_data_t
+ * 	\param file_name:	nome del file
+ * 	\param unique:		buffer in cui scrivere il nome
+ * 	\param size:		dimensione del buffer
+ * 	\return:				se user_data == NULL || file_name == NULL || unique == NULL o il buffer è troppo piccolo allora ILLEGAL_ARGUMENT
+ * 							se c'è un errore di allocazione della memoria allora SYSTEM_ERROR
+ * 							altrimenti REQUEST_OK
+ */
+op_res_t unique_file_name(user_data_t* user_data, char* file_name, char* unique, size_t size);
+
+/**	Inserisce il nome di un file nella tabella name_files_rcvd associandolo alla chiave del file nello store
+ * 	e acquisisce un riferimento al file (vedere file_store.h)
+ * 
+ * 	\param user_data:	puntatore alla struttura dati user_data_t
+ * 	\param file_name: nome del file visto dall'utente
+ * 	\param file_key:	chiave del file nello store
+ * 	\return:				se user_data == NULL || file_name == NULL || file_key == NULL allora ILLEGAL_ARGUMENT
+ * 							se è già presente un match con la chiave file_name in name_files_rcvd allora ALREADY_INSERTED
+ * 							se c'è un errore nella gestione della memoria dinamica o il file non è nello store allora SYSTEM_ERROR
+ * 							altrimenti REQUEST_OK
+ */
+op_res_t insert_file_name(user_data_t* user_data, char* file_name, char* file_key);
 
 /**	Controlla se il file file_name è stato inviato all'utente
  * 	
@@ -134,14 +288,24 @@ op_res_t insert_file_name(user_data_t* user_data, char* file_name);
  */
 op_res_t search_file_name(user_data_t* user_data, char* file_name);
 
-/**	Rimuove tutti i file dell'utente dalla directory dir_name
+/**	Restituisce la chiave nello store del file file_name inviato all'utente
+ * 	
+ * 	\param user_data:	puntatore alla struttura dati user_data_t
+ * 	\param file_name:	nome del file
+ * 	\param file_key:	buffer di almeno STORE_KEY_LENGTH byte in cui salvare la chiave
+ * 	\return:				se user_data == NULL || file_name == NULL || file_key == NULL allora ILLEGAL_ARGUMENT
+ * 							se non è presente un match con la chiave file_name in name_file_rcvd allora NOT_FOUND
+ * 							altrimenti REQUEST_OK
+ */
+op_res_t get_file_key(user_data_t* user_data, char* file_name, char* file_key);
+
+/**	Rilascia i riferimenti ai file dell'utente, i file non più destinati ad alcun utente vengono rimossi dallo store
  * 
  * 	\param user_data:	puntatore alla struttura dati user_data_t
- * 	\param dir_name:	nome directory in cui sono salvati i file
- * 	\return:				se user_data == NULL || dir_name == NULL allora ILLEGAL_ARGUMENT
+ * 	\return:				se user_data == NULL allora ILLEGAL_ARGUMENT
  * 							se c'è un errore di gestione della memoria dinamica allora SYSTEM_ERROR
  * 							altrimenti REQUEST_OK
  */
-op_res_t remove_all_file(user_data_t* user_data, char* dir_name);
+op_res_t remove_all_file(user_data_t* user_data);
 
-#endif /* USER_DATA_H_ */
+#endif /* USER_DATA_H_ */
\ No newline at end of file
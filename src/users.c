@@ -6,8 +6,10 @@
      */  
 
 #include <stdlib.h>
+#include <string.h>
 #include "users.h"
 #include "parser.h"
+#include "lock_profile.h"
 
 static inline unsigned int fnv_hash_function( void *key, int len ) {
    unsigned char *p = (unsigned char*)key;
@@ -50,6 +52,9 @@ users_t* users_init(int dim, int num_logical_block, int max_conn) {
 	users -> fd_to_nick = icl_hash_create(MaxConnections, uint_hash_function, uint_key_compare);
 	if (users -> fd_to_nick == NULL) goto error;
 
+	users -> groups = icl_hash_create(dim, NULL, NULL);
+	if (users -> groups == NULL) goto error;
+
 	//num_logical_block != 0 se multiThreaded
 	if (num_logical_block != 0) {
 		users -> mtx_reg_users = (pthread_mutex_t*) malloc(num_logical_block*sizeof(pthread_mutex_t));
@@ -71,6 +76,11 @@ users_t* users_init(int dim, int num_logical_block, int max_conn) {
 		}
 
 		if (pthread_mutex_init(&(users -> mtx_num_users), NULL) != 0) goto error;
+
+		if (pthread_mutex_init(&(users -> mtx_groups), NULL) != 0) {
+			pthread_mutex_destroy(&(users -> mtx_num_users));
+			goto error;
+		}
 	}
 	//num_logical_block = 0 se non c'è bisogno di mutex (versione singleThreaded)
 	else {
@@ -90,6 +100,7 @@ users_t* users_init(int dim, int num_logical_block, int max_conn) {
 		if (users) {
 			if (users -> reg_users) icl_hash_destroy(users -> reg_users, NULL, NULL);
 			if (users -> fd_to_nick) icl_hash_destroy(users -> fd_to_nick, NULL, NULL);
+			if (users -> groups) icl_hash_destroy(users -> groups, NULL, NULL);
 			if (users -> mtx_reg_users) {
 				for (int i = 0; i < nmtx_reg_user_init; i++)
 					pthread_mutex_destroy((users -> mtx_reg_users) + i);
@@ -112,6 +123,8 @@ void users_destroy(users_t* users) {
 	if (users -> reg_users) icl_hash_destroy(users -> reg_users, free_key, user_data_destroy);
 	
 	if (users -> fd_to_nick) icl_hash_destroy(users -> fd_to_nick, free_key, free_key);
+
+	if (users -> groups) icl_hash_destroy(users -> groups, free_key, group_destroy);
 	
 	if (users -> num_logical_block != 0) {
 		if (users -> mtx_reg_users) {
@@ -127,6 +140,7 @@ void users_destroy(users_t* users) {
 		}
 
 		pthread_mutex_destroy(&(users -> mtx_num_users));
+		pthread_mutex_destroy(&(users -> mtx_groups));
 	}
 
 	free(users);
@@ -138,7 +152,7 @@ op_res_t users_table_lock(users_t* users, char* nick) {
 	
 	if (users -> num_logical_block != 0) {
 		int hash_val = (* users -> reg_users -> hash_function)(nick) % (users -> reg_users -> nbuckets);
-		pthread_mutex_lock((users -> mtx_reg_users) + (hash_val/(users -> num_logical_block)));
+		LP_LOCK(LP_USERS, hash_val/(users -> num_logical_block), (users -> mtx_reg_users) + (hash_val/(users -> num_logical_block)));
 	}
 
 	return REQUEST_OK;
@@ -150,7 +164,7 @@ op_res_t users_table_unlock(users_t* users, char* nick) {
 	
 	if (users -> num_logical_block != 0) {
 		int hash_val = (* users -> reg_users -> hash_function)(nick) % (users -> reg_users -> nbuckets);
-		pthread_mutex_unlock((users -> mtx_reg_users) + (hash_val/(users -> num_logical_block)));
+		LP_UNLOCK(LP_USERS, hash_val/(users -> num_logical_block), (users -> mtx_reg_users) + (hash_val/(users -> num_logical_block)));
 	}
 
 	return REQUEST_OK;
@@ -162,7 +176,7 @@ op_res_t users_table_lock_all(users_t* users) {
 
    if (users -> num_logical_block != 0) {
       for (int i = 0; i < (users -> num_logical_block); i++)
-         pthread_mutex_lock((users -> mtx_reg_users) + i);
+         LP_LOCK(LP_USERS_ALL, i, (users -> mtx_reg_users) + i);
    }
 
    return REQUEST_OK;
@@ -174,12 +188,43 @@ op_res_t users_table_unlock_all(users_t* users) {
 
    if (users -> num_logical_block != 0) {
       for (int i = (users -> num_logical_block)-1; i >= 0; i--)
-         pthread_mutex_unlock((users -> mtx_reg_users) + i);
+         LP_UNLOCK(LP_USERS_ALL, i, (users -> mtx_reg_users) + i);
    }
 
    return REQUEST_OK;
 }
 
+int users_table_block(users_t* users, char* nick) {
+	if (!users || !nick)
+		return -1;
+
+	if (users -> num_logical_block == 0)
+		return 0;
+
+	int hash_val = (* users -> reg_users -> hash_function)(nick) % (users -> reg_users -> nbuckets);
+	return hash_val/(users -> num_logical_block);
+}
+
+op_res_t users_table_lock_block(users_t* users, int block) {
+	if (!users || block < 0)
+		return ILLEGAL_ARGUMENT;
+
+	if (users -> num_logical_block != 0)
+		LP_LOCK(LP_USERS, block, (users -> mtx_reg_users) + block);
+
+	return REQUEST_OK;
+}
+
+op_res_t users_table_unlock_block(users_t* users, int block) {
+	if (!users || block < 0)
+		return ILLEGAL_ARGUMENT;
+
+	if (users -> num_logical_block != 0)
+		LP_UNLOCK(LP_USERS, block, (users -> mtx_reg_users) + block);
+
+	return REQUEST_OK;
+}
+
 op_res_t fd_to_nick_table_lock(users_t* users, int fd) {
 	if (!users)
 		return ILLEGAL_ARGUMENT;
@@ -189,7 +234,7 @@ op_res_t fd_to_nick_table_lock(users_t* users, int fd) {
 	
 	if (users -> num_logical_block != 0) {
 		int hash_val = (* users -> fd_to_nick -> hash_function)(&fd) % (users -> fd_to_nick -> nbuckets);
-		pthread_mutex_lock((users -> mtx_fd_to_nick) + (hash_val/(users -> num_logical_block)));
+		LP_LOCK(LP_FD_TO_NICK, hash_val/(users -> num_logical_block), (users -> mtx_fd_to_nick) + (hash_val/(users -> num_logical_block)));
 	}
 
 	return REQUEST_OK;
@@ -204,7 +249,7 @@ op_res_t fd_to_nick_table_unlock(users_t* users, int fd) {
 	
 	if (users -> num_logical_block != 0) {
 		int hash_val = (* users -> fd_to_nick -> hash_function)(&fd) % (users -> fd_to_nick -> nbuckets);
-		pthread_mutex_unlock((users -> mtx_fd_to_nick) + (hash_val/(users -> num_logical_block)));
+		LP_UNLOCK(LP_FD_TO_NICK, hash_val/(users -> num_logical_block), (users -> mtx_fd_to_nick) + (hash_val/(users -> num_logical_block)));
 	}
 
 	return REQUEST_OK;
@@ -215,7 +260,7 @@ op_res_t num_users_lock(users_t* users) {
 		return ILLEGAL_ARGUMENT;
 
 	if (users -> num_logical_block != 0)
-		pthread_mutex_lock(&(users -> mtx_num_users));
+		LP_LOCK(LP_NUM_USERS, 0, &(users -> mtx_num_users));
 
 	return REQUEST_OK;
 }
@@ -225,7 +270,7 @@ op_res_t num_users_unlock(users_t* users) {
 		return ILLEGAL_ARGUMENT;
 
 	if (users -> num_logical_block != 0)
-		pthread_mutex_unlock(&(users -> mtx_num_users));
+		LP_UNLOCK(LP_NUM_USERS, 0, &(users -> mtx_num_users));
 
 	return REQUEST_OK;
 }
@@ -392,3 +437,92 @@ op_res_t get_num_users_reg(users_t* users, int* num) {
 
    return REQUEST_OK;
 }
+
+op_res_t groups_table_lock(users_t* users) {
+	if (!users)
+		return ILLEGAL_ARGUMENT;
+
+	if (users -> num_logical_block != 0)
+		LP_LOCK(LP_GROUPS, 0, &(users -> mtx_groups));
+
+	return REQUEST_OK;
+}
+
+op_res_t groups_table_unlock(users_t* users) {
+	if (!users)
+		return ILLEGAL_ARGUMENT;
+
+	if (users -> num_logical_block != 0)
+		LP_UNLOCK(LP_GROUPS, 0, &(users -> mtx_groups));
+
+	return REQUEST_OK;
+}
+
+op_res_t groups_table_insert(users_t* users, char* name, group_t* group) {
+	if (!users || !(users -> groups) || !name || !group)
+		return ILLEGAL_ARGUMENT;
+
+	if (icl_hash_find(users -> groups, name) != NULL)
+		return ALREADY_INSERTED;
+
+	if (icl_hash_insert(users -> groups, name, group) == NULL)
+		return SYSTEM_ERROR;
+
+	return REQUEST_OK;
+}
+
+op_res_t groups_table_delete(users_t* users, char* name) {
+	if (!users || !(users -> groups) || !name)
+		return ILLEGAL_ARGUMENT;
+
+	if (icl_hash_delete(users -> groups, name, free_key, group_destroy) == -1)
+		return NOT_FOUND;
+
+	return REQUEST_OK;
+}
+
+group_t* get_group(users_t* users, char* name) {
+	if (!users || !(users -> groups) || !name)
+		return NULL;
+
+	return icl_hash_find(users -> groups, name);
+}
+
+op_res_t groups_remove_member_all(users_t* users, char* nick) {
+	if (!users || !(users -> groups) || !nick)
+		return ILLEGAL_ARGUMENT;
+
+	icl_iterator_t* iterator = icl_iterator_create(users -> groups);
+	if (!iterator)
+		return SYSTEM_ERROR;
+
+	/* NON POSSO CANCELLARE DURANTE L'ITERAZIONE ==> SALVO I NOMI DEI GRUPPI RIMASTI VUOTI */
+	char (*empty)[MAX_NAME_LENGTH+1] = NULL;
+	int num_empty = 0, max_empty = 0;
+	op_res_t result = REQUEST_OK;
+	icl_entry_t* entry;
+	while ((entry = icl_hash_iterate(iterator)) != NULL) {
+		group_t* group = entry -> data;
+		if (group_remove_member(group, nick) == REQUEST_OK && group -> num_members == 0) {
+			if (num_empty == max_empty) {
+				void* tmp = realloc(empty, (max_empty+4)*sizeof(*empty));
+				if (!tmp) {
+					result = SYSTEM_ERROR;
+					continue;
+				}
+				empty = tmp;
+				max_empty += 4;
+			}
+			memset(empty[num_empty], '\0', MAX_NAME_LENGTH+1);
+			strncpy(empty[num_empty], group -> name, MAX_NAME_LENGTH);
+			num_empty++;
+		}
+	}
+	icl_iterator_destroy(iterator);
+
+	for (int i = 0; i < num_empty; i++)
+		groups_table_delete(users, empty[i]);
+	if (empty) free(empty);
+
+	return result;
+}
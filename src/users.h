@@ -12,6 +12,7 @@
 #include "icl_hash.h"
 #include "op_res.h"
 #include "user_data.h"
+#include "groups.h"
 
 /**   Struttura dati per la gestione degli utenti   
  *    Le funzioni di interfaccia che agiscono sui campi della struttura non sono thread-safe,
@@ -32,6 +33,10 @@ typedef struct users {
    int num_users_conn;                 /**<  Numero di utenti connessi                                                                    */
    int num_users_reg;                  /**<  Numero di utenti registrati                                                                  */
    pthread_mutex_t mtx_num_users;      /**<  Mutex associata a num_users_conn e num_users_reg                                             */ 
+   icl_hash_t* groups;                 /**<  Tabella hash che associa al nome del gruppo la struttura dati definita in groups.h           */
+   pthread_mutex_t mtx_groups;         /**<  Mutex associata a groups: se si deve acquisire anche una mutex su reg_users
+                                        *    allora quest'ultima deve essere acquisita per prima
+                                        */
 } users_t;
 
 /**   Struttura dati iteratore su tabella hash
@@ -99,6 +104,33 @@ op_res_t users_table_lock_all(users_t* users);
  */
 op_res_t users_table_unlock_all(users_t* users);
 
+/**   Restituisce l'indice del blocco logico di reg_users a cui appartiene nick
+ *
+ *    \param users:  puntatore alla struttura dati users_t
+ *    \param nick:   nickname dell'utente
+ *    \return:       se users == NULL || nick == NULL allora -1
+ *                   altrimenti l'indice del blocco logico (0 se non ci sono mutex)
+ */
+int users_table_block(users_t* users, char* nick);
+
+/**   Acquisisce mutex sul blocco logico di reg_users di indice block (vedere users_table_block)
+ *
+ *    \param users:  puntatore alla struttura dati users_t
+ *    \param block:  indice del blocco logico
+ *    \return:       se users == NULL || block < 0 allora ILLEGAL_ARGUMENT
+ *                   altrimenti REQUEST_OK
+ */
+op_res_t users_table_lock_block(users_t* users, int block);
+
+/**   Rilascia mutex sul blocco logico di reg_users di indice block (vedere users_table_block)
+ *
+ *    \param users:  puntatore alla struttura dati users_t
+ *    \param block:  indice del blocco logico
+ *    \return:       se users == NULL || block < 0 allora ILLEGAL_ARGUMENT
+ *                   altrimenti REQUEST_OK
+ */
+op_res_t users_table_unlock_block(users_t* users, int block);
+
 /**   Acquisisce mutex su blocco logico di fd_to_nick
  * 
  *    \param users:  puntatore alla struttura dati users_t
@@ -276,4 +308,62 @@ op_res_t dec_num_users_reg(users_t* users);
  */
 op_res_t get_num_users_reg(users_t*users, int* num);
 
+/**   Acquisisce mutex sulla tabella dei gruppi
+ *
+ *    \param users:  puntatore alla struttura dati users_t
+ *    \return:       se users == NULL allora ILLEGAL_ARGUMENT
+ * 						altrimenti REQUEST_OK
+ */
+op_res_t groups_table_lock(users_t* users);
+
+/**   Rilascia mutex sulla tabella dei gruppi
+ *
+ *    \param users:  puntatore alla struttura dati users_t
+ *    \return:       se users == NULL allora ILLEGAL_ARGUMENT
+ * 						altrimenti REQUEST_OK
+ */
+op_res_t groups_table_unlock(users_t* users);
+
+/**   Inserisce associazione name -> group nella tabella dei gruppi
+ *
+ *    \param users:  puntatore alla struttura dati users_t
+ *    \param name:   nome del gruppo (allocato dinamicamente, la tabella ne acquisisce la proprietà)
+ *    \param group:  puntatore alla struttura dati group_t
+ *    \return:       se users == NULL || name == NULL || group == NULL allora ILLEGAL_ARGUMENT
+ * 						se la chiave name è già presente allora ALREADY_INSERTED
+ * 						se c'è un errore di allocazione della memoria allora SYSTEM_ERROR
+ * 						altrimenti REQUEST_OK
+ */
+op_res_t groups_table_insert(users_t* users, char* name, group_t* group);
+
+/**   Cancella il gruppo name dalla tabella dei gruppi
+ *
+ *    \param users:  puntatore alla struttura dati users_t
+ *    \param name:   nome del gruppo
+ *    \return:       se users == NULL || name == NULL allora ILLEGAL_ARGUMENT
+ * 						se non c'è nessun match con la chiave name allora NOT_FOUND
+ * 						altrimenti REQUEST_OK
+ */
+op_res_t groups_table_delete(users_t* users, char* name);
+
+/**   Restituisce puntatore alla struttura dati group_t associata a name
+ *
+ *    \param users:  puntatore alla struttura dati users_t
+ *    \param name:   nome del gruppo
+ *    \return:       se users == NULL || name == NULL allora NULL
+ * 						se non c'è un match con la chiave name allora NULL
+ * 						altrimenti puntatore alla struttura group_t associata a name
+ */
+group_t* get_group(users_t* users, char* name);
+
+/**   Rimuove nick da tutti i gruppi di cui è membro, i gruppi rimasti senza membri vengono cancellati
+ *
+ *    \param users:  puntatore alla struttura dati users_t
+ *    \param nick:   nickname dell'utente
+ *    \return:       se users == NULL || nick == NULL allora ILLEGAL_ARGUMENT
+ * 						se c'è un errore di allocazione della memoria allora SYSTEM_ERROR
+ * 						altrimenti REQUEST_OK
+ */
+op_res_t groups_remove_member_all(users_t* users, char* nick);
+
 #endif /* USERS_H_ */
@@ -9,33 +9,57 @@
 #include <string.h>
 #include "users_list.h"
 #include "config.h"
+#include "lock_profile.h"
 
-/** Cerca la prima occorrenza della stringa to_search nella stringa str_nick che ha dimensione dim 
+/**	Dimensione di uno slot della stringa
+ */
+#define SLOT_DIM (MAX_NAME_LENGTH + 1)
+
+
+/**	Capacità minima della stringa (in slot)
+ */
+#define MIN_SLOTS 64
+
+/**	Elemento dell'indice: il nick è la chiave, slot la posizione nella stringa (in caratteri)
+ */
+typedef struct {
+	char nick[SLOT_DIM];
+	int slot;
+} users_list_entry_t;
+
+/** Rialloca la stringa con capacità cap caratteri
 */
-static char* search_substring(char *str_nick, char *to_search, int dim) {
-	char *curr = str_nick;
-	
-	for (int bytes_read = 0; bytes_read < dim; bytes_read += (MAX_NAME_LENGTH + 1)) {
-		if (strcmp(to_search, curr) == 0) return curr;
-		curr += (MAX_NAME_LENGTH + 1);
-	}
+static op_res_t resize(users_list_t* users_list, int cap) {
+	char *str = realloc(users_list -> str, cap);
+	if (str == NULL)
+		return SYSTEM_ERROR;
 
-	return NULL;
+	users_list -> str = str;
+	users_list -> cap = cap;
+
+	return REQUEST_OK;
 }
 
 /* FUNZIONI DI INTERFACCIA */
-users_list_t* users_list_init() {
+users_list_t* users_list_init(int dim) {
+	if (dim <= 0)
+		return NULL;
+
 	users_list_t* users_list = (users_list_t*) malloc(sizeof(users_list_t));
 	if (!users_list)
 		return NULL;
 
-	if (pthread_mutex_init(&(users_list -> mtx), NULL) != 0) {
+	users_list -> str = (char*) malloc(MIN_SLOTS * SLOT_DIM);
+	users_list -> index = icl_hash_create(dim, NULL, NULL);
+	if (!(users_list -> str) || !(users_list -> index) || pthread_mutex_init(&(users_list -> mtx), NULL) != 0) {
+		if (users_list -> str) free(users_list -> str);
+		if (users_list -> index) icl_hash_destroy(users_list -> index, NULL, NULL);
 		free(users_list);
 		return NULL;
 	}
 
-	users_list -> str = NULL;
 	users_list -> dim = 0;
+	users_list -> cap = MIN_SLOTS * SLOT_DIM;
 
 	return users_list;
 }
@@ -43,6 +67,8 @@ users_list_t* users_list_init() {
 void users_list_destroy(users_list_t* users_list) {
 	if (users_list) {
 		if (users_list -> str) free(users_list -> str);
+		/* LA CHIAVE È IL CAMPO nick DELL'ELEMENTO, BASTA DEALLOCARE L'ELEMENTO */
+		if (users_list -> index) icl_hash_destroy(users_list -> index, NULL, free);
 		pthread_mutex_destroy(&(users_list -> mtx));
 		free(users_list);
 	}
@@ -52,7 +78,7 @@ op_res_t users_list_lock(users_list_t* users_list) {
 	if (!users_list) 
 		return ILLEGAL_ARGUMENT;
 
-	pthread_mutex_lock(&(users_list -> mtx));
+	LP_LOCK(LP_USERS_LIST, 0, &(users_list -> mtx));
 
 	return REQUEST_OK;
 }
@@ -61,7 +87,7 @@ op_res_t users_list_unlock(users_list_t* users_list) {
 	if (!users_list) 
 		return ILLEGAL_ARGUMENT;
 
-	pthread_mutex_unlock(&(users_list -> mtx));
+	LP_UNLOCK(LP_USERS_LIST, 0, &(users_list -> mtx));
 
 	return REQUEST_OK;
 }
@@ -72,56 +98,62 @@ op_res_t users_list_insert(users_list_t* users_list, char* nick) {
 
 	if (!nick || strlen(nick) > MAX_NAME_LENGTH)
 		return ILLEGAL_ARGUMENT;
-	
-	int dim_copy = users_list -> dim;
 
-	users_list -> dim += (MAX_NAME_LENGTH + 1);
+	if (icl_hash_find(users_list -> index, nick) != NULL)
+		return ALREADY_INSERTED;
 
-	char *str = realloc(users_list -> str, users_list -> dim);
-	if (str == NULL) 
+	/* STRINGA PIENA: RADDOPPIO LA CAPACITÀ */
+	if (users_list -> dim == users_list -> cap) {
+		if (resize(users_list, 2 * users_list -> cap) != REQUEST_OK)
+			return SYSTEM_ERROR;
+	}
+
+	users_list_entry_t* entry = (users_list_entry_t*) malloc(sizeof(users_list_entry_t));
+	if (entry == NULL)
 		return SYSTEM_ERROR;
-	
-	users_list -> str = str;
+	memset(entry -> nick, '\0', SLOT_DIM);
+	strncpy(entry -> nick, nick, strlen(nick));
+	entry -> slot = users_list -> dim;
+
+	if (icl_hash_insert(users_list -> index, entry -> nick, entry) == NULL) {
+		free(entry);
+		return SYSTEM_ERROR;
+	}
 
-	char* curr = (users_list -> str) + dim_copy;
-	memset(curr, '\0', MAX_NAME_LENGTH + 1);
-	strncpy(curr, nick, strlen(nick));
+	memcpy((users_list -> str) + entry -> slot, entry -> nick, SLOT_DIM);
+	users_list -> dim += SLOT_DIM;
 
 	return REQUEST_OK;
 }
 
 op_res_t users_list_remove(users_list_t* users_list, char* nick) {
-	if (!users_list || !(users_list -> str))
+	if (!users_list)
 		return ILLEGAL_ARGUMENT;
 	
 	if (!nick || strlen(nick) > MAX_NAME_LENGTH)
 		return ILLEGAL_ARGUMENT;
 
-	char *to_cancel = search_substring(users_list -> str, nick, users_list -> dim);
-	if (to_cancel == NULL) return REQUEST_OK;
-	
-	memset(to_cancel, '\0', MAX_NAME_LENGTH + 1);
-
-	char *last_nick = (users_list -> str) + (users_list -> dim) - (MAX_NAME_LENGTH + 1);
-
-	char *ptr_last_nick = last_nick;
-	while ((*ptr_last_nick) != '\0') {
-		*to_cancel = *ptr_last_nick;
-		to_cancel++;
-		ptr_last_nick++;
+	users_list_entry_t* entry = icl_hash_find(users_list -> index, nick);
+	if (entry == NULL) return REQUEST_OK;
+
+	/* SPOSTO L'ULTIMO SLOT AL POSTO DI QUELLO RIMOSSO E AGGIORNO LA SUA POSIZIONE NELL'INDICE */
+	int slot = entry -> slot;
+	int last = (users_list -> dim) - SLOT_DIM;
+	if (slot != last) {
+		users_list_entry_t* moved = icl_hash_find(users_list -> index, (users_list -> str) + last);
+		if (moved == NULL)
+			return SYSTEM_ERROR;
+		memcpy((users_list -> str) + slot, (users_list -> str) + last, SLOT_DIM);
+		moved -> slot = slot;
 	}
-	memset(last_nick, '\0', MAX_NAME_LENGTH + 1);
+	users_list -> dim -= SLOT_DIM;
 
-	users_list -> dim -= (MAX_NAME_LENGTH + 1);
-	if (users_list -> dim == 0) {
-		free(users_list -> str);
-		users_list -> str = NULL;
-	}
-	else {
-		char *str = realloc(users_list -> str, users_list -> dim);
-		if (str == NULL) return SYSTEM_ERROR;
-		users_list -> str = str;
-	}
+	icl_hash_delete(users_list -> index, entry -> nick, NULL, free);
+
+	/* STRINGA OCCUPATA PER MENO DI UN QUARTO: DIMEZZO LA CAPACITÀ (SE LA realloc FALLISCE IL BUFFER ATTUALE
+	 * RESTA VALIDO E LA RIMOZIONE È COMUNQUE AVVENUTA) */
+	if (users_list -> cap > MIN_SLOTS * SLOT_DIM && users_list -> dim < users_list -> cap / 4)
+		resize(users_list, users_list -> cap / 2);
 
 	return REQUEST_OK;
 }
@@ -10,20 +10,28 @@
 
 #include <pthread.h>
 #include "op_res.h"
+#include "icl_hash.h"
 
 /** Struttura di supporto alla gestione della stringa degli utenti connessi
+ *  La stringa è un array di slot da MAX_NAME_LENGTH+1 caratteri, uno per utente, senza buchi. L'indice associa ad
+ *  ogni nick la posizione del suo slot: la rimozione sposta l'ultimo slot al posto di quello rimosso, così inserimento
+ *  e rimozione costano O(1). La capacità raddoppia quando la stringa è piena e si dimezza quando è occupata per meno
+ *  di un quarto, quindi la stringa non viene riallocata ad ogni modifica
  */
 typedef struct users_list {
    char* str;                 /**<  Stringa degli utenti connessi       */   
    int dim;                   /**<  Numero di caratteri della stringa   */
+   int cap;                   /**<  Numero di caratteri allocati        */
+   icl_hash_t* index;         /**<  Indice nick -> posizione dello slot */
    pthread_mutex_t mtx;       /**<  Mutex per la struttura dati         */
 } users_list_t;
 
-/**   Alloca la struttra dati users_list ed inizializza il campo str a NULL e dim a 0
+/**   Alloca la struttra dati users_list con la stringa vuota
  *    
- *    \return:  puntatore alla struttura dati allocata
+ *    \param dim:    numero di bucket dell'indice dei nick (ad esempio il numero massimo di utenti connessi)
+ *    \return:       puntatore alla struttura dati allocata
  */
-users_list_t* users_list_init();
+users_list_t* users_list_init(int dim);
 
 /**   Dealloca la struttura dati users_list
  * 
@@ -53,6 +61,7 @@ op_res_t users_list_unlock(users_list_t* users_list);
  *    \param nick:         nickname da inserire
  *    \return:             se users_list == NULL || nick == NULL allora ILLEGAL_ARGUMENT
  *                         se il numero di caratteri > MAX_NAME_LENGTH allora ILLEGAL_ARGUMENT (macro definita in config.h)
+ *                         se il nick è già presente allora ALREADY_INSERTED
  *                         se c'è un errore di gestione della memoria dinamica allora SYSTEM_ERROR
  *                         altrimenti REQUEST_OK
  */
@@ -64,7 +73,7 @@ op_res_t users_list_insert(users_list_t* users_list, char* nick);
  *    \param nick:         nickname da rimuovere
  *    \return:             se users_list == NULL || nick == NULL allora ILLEGAL_ARGUMENT
  *                         se il numero di caratteri > MAX_NAME_LENGTH allora ILLEGAL_ARGUMENT (macro definita in config.h)
- *                         se c'è un errore di gestione della memoria dinamica allora SYSTEM_ERROR
+ *                         se la struttura dati è incoerente allora SYSTEM_ERROR (il mancato ridimensionamento non è un errore)
  *                         altrimenti REQUEST_OK          
  */
 op_res_t users_list_remove(users_list_t* users_list, char* nick);
@@ -0,0 +1,323 @@
+
+/** \file wire.c
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/select.h>
+#include "wire.h"
+#include "conn.h"
+#include "connections.h"
+#include "compress.h"
+#include "parser.h"
+
+/**	Lunghezza massima di un varint che codifica un intero a 32 bit
+ */
+#define VARINT_MAX 5
+
+/**	Lunghezza massima dell'header WIRE_V2 e del prefisso (receiver, len e lunghezza compressa) della parte dati WIRE_V2
+ */
+#define V2_PREFIX_MAX (1 + 3*VARINT_MAX + MAX_NAME_LENGTH)
+
+/**	Margine (byte) oltre il contenuto più lungo accettato per le intestazioni nella parte dati delle richieste
+ * 	(file_range_t, upload_chunk_t, nome del file)
+ */
+#define V2_DATA_SLACK 4096
+
+/**	Formato dei frame di ogni descrittore (0 equivale a WIRE_V1), i descrittori oltre FD_SETSIZE usano sempre WIRE_V1
+ */
+static volatile unsigned char wire_version[FD_SETSIZE];
+
+/**	Id dell'ultima richiesta letta da ogni descrittore (WIRE_V2)
+ */
+static volatile unsigned long request_id[FD_SETSIZE];
+
+/**	Numero di connessioni in formato WIRE_V2_LZ (se 0 wire_pack non comprime)
+ */
+static volatile int lz_conns = 0;
+
+/**	Lunghezza massima della parte dati di un frame WIRE_V2 letto: il contenuto più lungo accettato (MaxMsgSize byte
+ * 	o MaxFileSize KB) più V2_DATA_SLACK. Se nessuno dei due è configurato (lato client) non c'è limite
+ */
+static unsigned long max_data_len() {
+	long max = (MaxMsgSize > MaxFileSize*1000) ? MaxMsgSize : MaxFileSize*1000;
+	return (max > 0) ? (unsigned long)max + V2_DATA_SLACK : 0xFFFFFFFFUL;
+}
+
+/**	Codifica value come varint in buf, ritorna il numero di byte scritti
+ */
+static int put_varint(unsigned char* buf, unsigned long value) {
+	int n = 0;
+	while (value >= 0x80) {
+		buf[n++] = (unsigned char)(value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	buf[n++] = (unsigned char)value;
+	return n;
+}
+
+/**	Legge un varint di al più VARINT_MAX byte, ritorna 1 in caso di successo, 0 se la connessione è chiusa
+ * 	o il varint è malformato, -1 in caso di errore
+ */
+static int read_varint(long fd, unsigned long* value) {
+	unsigned char byte;
+	int k;
+
+	*value = 0;
+	for (int i = 0; i < VARINT_MAX; i++) {
+		if ((k = readn(fd, &byte, 1)) <= 0) return k;
+		*value |= (unsigned long)(byte & 0x7F) << (7*i);
+		if (!(byte & 0x80)) return 1;
+	}
+	return 0;
+}
+
+/**	Codifica in buf un nome (lunghezza e caratteri senza '\0'), ritorna il numero di byte scritti
+ */
+static int put_name(unsigned char* buf, char* name) {
+	char* end = memchr(name, '\0', MAX_NAME_LENGTH+1);
+	size_t len = (end != NULL) ? (size_t)(end - name) : MAX_NAME_LENGTH;
+	int n = put_varint(buf, len);
+	memcpy(buf + n, name, len);
+	return n + len;
+}
+
+/**	Legge in name (di MAX_NAME_LENGTH+1 byte) un nome codificato da put_name, stessi valori di ritorno di read_varint
+ */
+static int read_name(long fd, char* name) {
+	unsigned long len;
+	int k;
+
+	memset(name, '\0', MAX_NAME_LENGTH+1);
+	if ((k = read_varint(fd, &len)) <= 0) return k;
+	if (len > MAX_NAME_LENGTH) return 0;
+	if (len > 0 && (k = readn(fd, name, len)) <= 0) return k;
+	return 1;
+}
+
+/**	Codifica in buf l'header WIRE_V2 con id della richiesta id, ritorna il numero di byte scritti
+ */
+static int put_header_v2(unsigned char* buf, message_hdr_t* hdr, unsigned long id) {
+	int n = 0;
+	buf[n++] = WIRE_V2_MAGIC;
+	n += put_varint(buf + n, (unsigned long)hdr -> op);
+	n += put_varint(buf + n, id);
+	n += put_name(buf + n, hdr -> sender);
+	return n;
+}
+
+/**	Codifica in buf il prefisso (receiver e len) della parte dati WIRE_V2, ritorna il numero di byte scritti.
+ * 	Se lz != 0 (WIRE_V2_LZ) len è seguita dal flag di compressione e, se packed_len > 0, dalla lunghezza compressa
+ */
+static int put_data_prefix_v2(unsigned char* buf, message_data_hdr_t* hdr, int lz, unsigned long packed_len) {
+	int n = put_name(buf, hdr -> receiver);
+	if (!lz) return n + put_varint(buf + n, hdr -> len);
+	n += put_varint(buf + n, 2*(unsigned long)hdr -> len + (packed_len > 0));
+	if (packed_len > 0) n += put_varint(buf + n, packed_len);
+	return n;
+}
+
+/**	Legge un header WIRE_V2 salvando in id l'id della richiesta, stessi valori di ritorno di read_varint
+ */
+static int read_header_v2(long fd, message_hdr_t* hdr, unsigned long* id) {
+	unsigned char magic;
+	unsigned long op;
+	int k;
+
+	memset(hdr, 0, sizeof(message_hdr_t));
+	if ((k = readn(fd, &magic, 1)) <= 0) return k;
+	if (magic != WIRE_V2_MAGIC) return 0;
+	if ((k = read_varint(fd, &op)) <= 0) return k;
+	hdr -> op = (op_t)op;
+	if ((k = read_varint(fd, id)) <= 0) return k;
+	return read_name(fd, hdr -> sender);
+}
+
+/**	Legge una parte dati WIRE_V2 (il buffer viene allocato come in readData) decomprimendola se lz != 0 (WIRE_V2_LZ)
+ * 	e il contenuto è compresso, stessi valori di ritorno di read_varint
+ */
+static int read_data_v2(long fd, message_data_t* data, int lz) {
+	unsigned long len, packed_len = 0;
+	int k;
+
+	if ((k = read_name(fd, data -> hdr.receiver)) <= 0) return k;
+	if ((k = read_varint(fd, &len)) <= 0) return k;
+	if (lz) {
+		if ((len & 1) && (k = read_varint(fd, &packed_len)) <= 0) return k;
+		len >>= 1;
+		if ((lz = (packed_len > 0)) && packed_len >= len) return 0;
+	}
+	/* LA LUNGHEZZA DICHIARATA DAL CLIENT VIENE CONTROLLATA PRIMA DI ALLOCARE IL BUFFER */
+	if (len > 0xFFFFFFFFUL || len > max_data_len()) return 0;
+	data -> hdr.len = (unsigned int)len;
+
+	if (len != 0) {
+		data -> buf = (char*) malloc(len);
+		if (data -> buf == NULL)
+			return -1;
+		memset(data -> buf, '\0', len);
+		if (!lz) {
+			if ((k = readn(fd, data -> buf, len)) <= 0) return k;
+			return 1;
+		}
+		char* packed = (char*) malloc(packed_len);
+		if (packed == NULL)
+			return -1;
+		/* UN CONTENUTO COMPRESSO MALFORMATO RENDE MALFORMATO IL FRAME */
+		if ((k = readn(fd, packed, packed_len)) > 0) k = (decompress_buffer(packed, packed_len, data -> buf, len) == -1) ? 0 : 1;
+		free(packed);
+		return k;
+	}
+
+	return 1;
+}
+
+void wire_set_version(long fd, int version) {
+	if (fd >= 0 && fd < FD_SETSIZE) {
+		version = (version == WIRE_V2 || version == WIRE_V2_LZ) ? version : WIRE_V1;
+		if (wire_version[fd] == WIRE_V2_LZ && version != WIRE_V2_LZ) __sync_sub_and_fetch(&lz_conns, 1);
+		else if (wire_version[fd] != WIRE_V2_LZ && version == WIRE_V2_LZ) __sync_add_and_fetch(&lz_conns, 1);
+		wire_version[fd] = version;
+		request_id[fd] = 0;
+	}
+}
+
+int wire_get_version(long fd) {
+	if (fd >= 0 && fd < FD_SETSIZE && wire_version[fd] != 0) return wire_version[fd];
+	return WIRE_V1;
+}
+
+void wire_negotiate(long fd, message_t* msg) {
+	if (msg -> data.buf == NULL) return;
+	if (msg -> data.hdr.len == strlen(WIRE_V2_CAPABILITY) + 1 && memcmp(msg -> data.buf, WIRE_V2_CAPABILITY, msg -> data.hdr.len) == 0)
+		wire_set_version(fd, WIRE_V2);
+	else if (msg -> data.hdr.len == strlen(WIRE_V2_LZ_CAPABILITY) + 1 && memcmp(msg -> data.buf, WIRE_V2_LZ_CAPABILITY, msg -> data.hdr.len) == 0)
+		wire_set_version(fd, WIRE_V2_LZ);
+}
+
+void wire_set_request_id(long fd, unsigned long id) {
+	if (fd >= 0 && fd < FD_SETSIZE) request_id[fd] = id;
+}
+
+unsigned long wire_get_request_id(long fd) {
+	if (wire_get_version(fd) == WIRE_V1) return 0;
+	return request_id[fd];
+}
+
+int wire_read_header(long fd, message_hdr_t* hdr) {
+	if (wire_get_version(fd) == WIRE_V1)
+		return readHeader(fd, hdr);
+
+	unsigned long id = 0;
+	errno = 0;
+	int k = read_header_v2(fd, hdr, &id);
+	if (k == 1) request_id[fd] = id;
+	if (k == -1 && errno == ECONNRESET) k = 0;
+	else if (k == -1) perror("Errore read header");
+
+	return k;
+}
+
+int wire_read_msg(long fd, message_t* msg) {
+	int version = wire_get_version(fd);
+	if (version == WIRE_V1)
+		return readMsg(fd, msg);
+
+	unsigned long id = 0;
+	errno = 0;
+	int k = read_header_v2(fd, &(msg -> hdr), &id);
+	if (k == 1) k = read_data_v2(fd, &(msg -> data), version == WIRE_V2_LZ);
+	/* LE RICHIESTE DI UNA CONNESSIONE SONO GESTITE UNA ALLA VOLTA ==> L'ID RESTA VALIDO FINO ALLA PROSSIMA LETTURA */
+	if (k == 1) request_id[fd] = id;
+	if (k == -1 && errno == ECONNRESET) k = 0;
+	else if (k == -1) perror("Errore read messaggio");
+
+	return k;
+}
+
+int wire_read_data(long fd, message_data_t* data) {
+	int version = wire_get_version(fd);
+	if (version == WIRE_V1)
+		return readData(fd, data);
+
+	errno = 0;
+	int k = read_data_v2(fd, data, version == WIRE_V2_LZ);
+	if (k == -1 && errno == ECONNRESET) k = 0;
+	else if (k == -1) perror("Errore read data");
+
+	return k;
+}
+
+int wire_send_header(long fd, message_hdr_t* hdr) {
+	if (wire_get_version(fd) == WIRE_V1)
+		return sendHeader(fd, hdr);
+
+	/* LE NOTIFICHE NON RISPONDONO A NESSUNA RICHIESTA DELLA CONNESSIONE */
+	unsigned long id = (hdr -> op == TXT_MESSAGE || hdr -> op == FILE_MESSAGE) ? 0 : request_id[fd];
+	unsigned char buf[V2_PREFIX_MAX];
+	if (writen(fd, buf, put_header_v2(buf, hdr, id)) == -1)
+		return -1;
+
+	return 1;
+}
+
+void wire_pack(message_data_t* data, wire_packed_t* packed) {
+	packed -> buf = data -> buf;
+	packed -> len = data -> hdr.len;
+	packed -> packed = NULL;
+	packed -> packed_len = 0;
+	packed -> done = (lz_conns == 0 || data -> hdr.len == 0);
+
+	/* SE LA COMPRESSIONE NON RIDUCE IL CONTENUTO (O FALLISCE L'ALLOCAZIONE) IL CONTENUTO VIENE INVIATO COSÌ COM'È */
+	if (!(packed -> done)) {
+		if ((packed -> packed_len = compress_buffer(data -> buf, data -> hdr.len, &(packed -> packed))) < 0) packed -> packed_len = 0;
+		packed -> done = 1;
+	}
+}
+
+void wire_packed_free(wire_packed_t* packed) {
+	if (packed -> packed) free(packed -> packed);
+	packed -> packed = NULL;
+	packed -> packed_len = 0;
+}
+
+int wire_send_data_packed(long fd, message_data_t* data, wire_packed_t* packed) {
+	int version = wire_get_version(fd);
+	if (version == WIRE_V1)
+		return sendData(fd, data);
+
+	unsigned char buf[V2_PREFIX_MAX];
+	wire_packed_t own;
+	int result = 1;
+
+	/* CONTENUTO NON COMPRESSO IN ANTICIPO (O DIVERSO DA QUELLO COMPRESSO) ==> LO COMPRIMO ORA PER QUESTA CONNESSIONE */
+	if (packed == NULL || packed -> buf != data -> buf || packed -> len != data -> hdr.len || (version == WIRE_V2_LZ && !(packed -> done))) {
+		packed = &own;
+		own.buf = data -> buf;
+		own.len = data -> hdr.len;
+		own.packed = NULL;
+		own.packed_len = 0;
+		if (version == WIRE_V2_LZ && data -> hdr.len > 0 && (own.packed_len = compress_buffer(data -> buf, data -> hdr.len, &(own.packed))) < 0)
+			own.packed_len = 0;
+	}
+	long packed_len = (version == WIRE_V2_LZ) ? packed -> packed_len : 0;
+
+	if (writen(fd, buf, put_data_prefix_v2(buf, &(data -> hdr), version == WIRE_V2_LZ, packed_len)) == -1)
+		result = -1;
+	else if (packed_len > 0 && writen(fd, packed -> packed, packed_len) == -1)
+		result = -1;
+	else if (packed_len == 0 && data -> hdr.len > 0 && writen(fd, data -> buf, data -> hdr.len) == -1)
+		result = -1;
+	if (packed == &own) wire_packed_free(&own);
+
+	return result;
+}
+
+int wire_send_data(long fd, message_data_t* data) {
+	return wire_send_data_packed(fd, data, NULL);
+}
@@ -0,0 +1,126 @@
+
+/** \file wire.h
+       \author Giuseppe Muntoni
+       Si dichiara che il contenuto di questo file e' in ogni sua parte opera
+       originale dell'autore
+     */
+
+#if !defined(WIRE_H_)
+#define WIRE_H_
+
+#include "message.h"
+
+/**   Formati dei frame sulle connessioni lato server.
+ *    WIRE_V1 è il formato originale di connections.h (strutture message_hdr_t e message_data_hdr_t inviate
+ *    così come sono in memoria). WIRE_V2 è il formato compatto, con layout esplicito indipendente dal compilatore:
+ *       header:     WIRE_V2_MAGIC, op (varint), id della richiesta (varint), lunghezza del sender (varint),
+ *                   sender (senza '\0')
+ *       parte dati: lunghezza del receiver (varint), receiver (senza '\0'), len (varint), buf
+ *    dove varint è un intero senza segno codificato in little-endian a gruppi di 7 bit (LEB128).
+ *    Il client chiede WIRE_V2 inviando WIRE_V2_CAPABILITY come parte dati di REGISTER_OP o CONNECT_OP (in WIRE_V1):
+ *    la risposta e tutto il traffico successivo sulla connessione sono in WIRE_V2, riconoscibile dal primo byte
+ *    WIRE_V2_MAGIC (nessun op di WIRE_V1 ha quel valore nel primo byte). I client che non lo chiedono restano in WIRE_V1,
+ *    come quelli la cui richiesta ha un sender non valido (la risposta OP_FAIL è in WIRE_V1).
+ *    L'id della richiesta è scelto dal client; le risposte (OP_OK e codici di errore) riportano l'id della richiesta
+ *    a cui rispondono, le notifiche e i messaggi della history (TXT_MESSAGE e FILE_MESSAGE) hanno id 0. Il client può
+ *    quindi inviare più richieste senza attendere le risposte, che arrivano nell'ordine delle richieste.
+ *    WIRE_V2_LZ (chiesto con WIRE_V2_LZ_CAPABILITY) è WIRE_V2 con la parte dati eventualmente compressa (vedere compress.h):
+ *       parte dati: lunghezza del receiver (varint), receiver (senza '\0'), 2*len+c (varint), se c == 1 la lunghezza
+ *                   del contenuto compresso (varint, minore di len) seguita dal contenuto compresso, altrimenti buf
+ *    Il server comprime i contenuti di almeno CompressThreshold byte; il client può comprimere qualsiasi contenuto.
+ *    Le funzioni di lettura e scrittura hanno gli stessi valori di ritorno delle corrispondenti di connections.h;
+ *    un frame WIRE_V2 malformato viene trattato come la chiusura della connessione, come una parte dati più lunga
+ *    del contenuto più lungo accettato dal server (MaxMsgSize byte o MaxFileSize KB, più le intestazioni delle richieste).
+ */
+#define WIRE_V1              1
+#define WIRE_V2              2
+#define WIRE_V2_MAGIC        0xC2
+#define WIRE_V2_LZ           3
+#define WIRE_V2_CAPABILITY   "wire-v2"
+#define WIRE_V2_LZ_CAPABILITY "wire-v2+lz"
+
+/**   Imposta il formato dei frame della connessione (i descrittori mai impostati usano WIRE_V1)
+ *
+ *    \param fd:        descrittore della connessione
+ *    \param version:   WIRE_V1, WIRE_V2 o WIRE_V2_LZ
+ */
+void wire_set_version(long fd, int version);
+
+/**   Restituisce il formato dei frame della connessione
+ *
+ *    \param fd:        descrittore della connessione
+ *    \return:          WIRE_V1, WIRE_V2 o WIRE_V2_LZ
+ */
+int wire_get_version(long fd);
+
+/**   Se la richiesta (REGISTER_OP o CONNECT_OP) chiede il formato WIRE_V2 o WIRE_V2_LZ (la parte dati è
+ *    WIRE_V2_CAPABILITY o WIRE_V2_LZ_CAPABILITY) lo imposta sulla connessione, altrimenti non modifica il formato
+ *
+ *    \param fd:        descrittore della connessione
+ *    \param msg:       puntatore alla richiesta
+ */
+void wire_negotiate(long fd, message_t* msg);
+
+/**   Imposta l'id delle richieste inviate sulla connessione con wire_send_header (lato client, WIRE_V2)
+ *
+ *    \param fd:        descrittore della connessione
+ *    \param id:        id della richiesta
+ */
+void wire_set_request_id(long fd, unsigned long id);
+
+/**   Restituisce l'id dell'ultimo header letto dalla connessione (WIRE_V2): lato server l'id della richiesta
+ *    in corso, lato client l'id della richiesta a cui risponde l'ultima risposta letta (0 per le notifiche)
+ *
+ *    \param fd:        descrittore della connessione
+ *    \return:          id dell'ultimo header letto (0 in WIRE_V1)
+ */
+unsigned long wire_get_request_id(long fd);
+
+/**   Legge l'header di un messaggio nel formato della connessione (vedere readHeader)
+ */
+int wire_read_header(long fd, message_hdr_t* hdr);
+
+/**   Legge l'intero messaggio nel formato della connessione (vedere readMsg)
+ */
+int wire_read_msg(long fd, message_t* msg);
+
+/**   Legge la parte dati di un messaggio nel formato della connessione (vedere readData)
+ */
+int wire_read_data(long fd, message_data_t* data);
+
+/**   Invia l'header di un messaggio nel formato della connessione (vedere sendHeader)
+ */
+int wire_send_header(long fd, message_hdr_t* hdr);
+
+/**   Invia la parte dati di un messaggio nel formato della connessione (vedere sendData)
+ */
+int wire_send_data(long fd, message_data_t* data);
+
+/**   Contenuto compresso una sola volta per l'invio a più connessioni WIRE_V2_LZ (vedere wire_pack)
+ */
+typedef struct {
+   char* buf;              //Contenuto originale
+   unsigned int len;       //Lunghezza del contenuto originale
+   char* packed;           //Contenuto compresso (NULL se viene inviato così com'è)
+   long packed_len;        //Lunghezza del contenuto compresso (0 se viene inviato così com'è)
+   int done;               //1 se la compressione è già stata tentata (o non serve: nessuna connessione WIRE_V2_LZ)
+} wire_packed_t;
+
+/**   Comprime in anticipo (tipicamente fuori dalle mutex) la parte dati data da inviare a più connessioni,
+ *    solo se ci sono connessioni WIRE_V2_LZ. Il contenuto di data non deve cambiare fino a wire_packed_free
+ *
+ *    \param data:      parte dati da inviare
+ *    \param packed:    struttura in cui salvare il contenuto compresso (da rilasciare con wire_packed_free)
+ */
+void wire_pack(message_data_t* data, wire_packed_t* packed);
+
+/**   Come wire_send_data, ma sulle connessioni WIRE_V2_LZ invia il contenuto compresso in packed (se packed è NULL
+ *    o non corrisponde a data il contenuto viene compresso per questa connessione)
+ */
+int wire_send_data_packed(long fd, message_data_t* data, wire_packed_t* packed);
+
+/**   Rilascia il contenuto compresso da wire_pack
+ */
+void wire_packed_free(wire_packed_t* packed);
+
+#endif /* WIRE_H_ */
@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# uso: testbatch.sh unix_path
+# richieste POSTTXTBATCH con destinatari registrati e non: loadgen controlla l'esito di ogni messaggio
+
+# controlla che l'operazione $2 nell'output $1 sia stata completata almeno una volta e senza errori
+function controlla {
+    line=$(echo "$1" | grep "^op $2 ")
+    count=$(echo "$line" | cut -d' ' -f4)
+    errors=$(echo "$line" | cut -d' ' -f6)
+    if [[ -z "$count" || $count == 0 || $errors != 0 ]]; then
+        echo "$2: completate ${count:-0}, fallite ${errors:-?}"
+        echo "$1"
+        exit 1
+    fi
+}
+
+OUT=$(./loadgen -l $1 -u 8 -c 2 -d 1 -m batch=1)
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+controlla "$OUT" POSTTXTBATCH
+
+# anche in WIRE_V2 con piu' richieste in sospeso per connessione
+OUT=$(./loadgen -l $1 -u 8 -c 2 -d 1 -w v2 -q 4 -m batch=1,prev=1)
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+controlla "$OUT" POSTTXTBATCH
+controlla "$OUT" GETPREVMSGS
+
+# i messaggi consegnati sono nella history dei destinatari
+OUT=$(./client -l $1 -k lg0 -p)
+if [[ $? != 0 || $(echo "$OUT" | grep -c "^\[lg[0-9]*:\] x") == 0 ]]; then
+    echo "history di lg0 senza messaggi"
+    exit 1
+fi
+
+echo "Test OK!"
+exit 0
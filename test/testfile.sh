@@ -99,24 +99,29 @@ if [[ $? != 0 ]]; then
     exit 1
 fi
 
+# pippo rimanda a minni lo stesso file che ha mandato a pluto
+./client -l $1 -k pippo -s ./client:minni
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+
 # controllo che i file siano arrivati al server e che siano corretti
+# i file sono salvati nello store per contenuto: ogni file deve comparire una ed una sola volta
 md51=$(md5sum ./client | cut -d " " -f 1)
 md52=$(md5sum ./chatty | cut -d " " -f 1)
 md53=$(md5sum ./libchatty.a | cut -d " " -f 1)
-md5client=$(md5sum $2/client | cut -d " " -f 1)
-md5chatty=$(md5sum $2/chatty | cut -d " " -f 1)
-md5lib=$(md5sum $2/libchatty.a | cut -d " " -f 1)
+md5store=$(find $2/.store -type f -exec md5sum {} + | cut -d " " -f 1)
 
-if [[ $md5client != $md51 ]]; then
-    echo "./client e $2/client differiscono!"
+if [[ $(echo "$md5store" | grep -c $md51) != 1 ]]; then
+    echo "./client non e' presente una sola volta in $2/.store!"
     exit 1
 fi
-if [[ $md5chatty != $md52 ]]; then
-    echo "./chatty e $2/chatty differiscono!"
+if [[ $(echo "$md5store" | grep -c $md52) != 1 ]]; then
+    echo "./chatty non e' presente una sola volta in $2/.store!"
     exit 1
 fi
-if [[ $md5lib != $md53 ]]; then
-    echo "./libchatty.a e $2/libchatty.a differiscono!"
+if [[ $(echo "$md5store" | grep -c $md53) != 1 ]]; then
+    echo "./libchatty.a non e' presente una sola volta in $2/.store!"
     exit 1
 fi
 
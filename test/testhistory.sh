@@ -0,0 +1,86 @@
+#!/bin/bash
+
+# uso: testhistory.sh unix_path spill|drop dir_name
+# il server deve essere avviato con MaxHistMemory = 1 e MaxHistMsgs = 16
+
+# registro il mittente e il destinatario (che resta offline)
+./client -l $1 -c pippo
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+./client -l $1 -c lontano
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+
+# invia a lontano i messaggi da $1 a $2 (tutti della stessa lunghezza)
+function invia {
+    args=()
+    for ((i=$1; i<=$2; i++)); do
+        args+=(-S "$(printf 'messaggio %03d per riempire la history oltre il budget di memoria' $i)":lontano)
+    done
+    ./client -l $UNIX_PATH -k pippo "${args[@]}"
+}
+UNIX_PATH=$1
+
+# 40 messaggi occupano piu' di 1KB ==> la history di lontano viene riversata su disco (o eliminata)
+invia 1 40
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+
+HIST_FILE=$3/.history/$(printf '%s' lontano | od -An -tx1 | tr -d ' \n')
+
+if [[ $2 == spill ]]; then
+    # il file della history contiene al piu' MaxHistMsgs messaggi: la sua dimensione non cresce con altri messaggi
+    if [[ ! -f $HIST_FILE ]]; then
+        echo "history non riversata su disco"
+        exit 1
+    fi
+    size1=$(stat -c %s $HIST_FILE)
+    invia 41 80
+    if [[ $? != 0 ]]; then
+        exit 1
+    fi
+    size2=$(stat -c %s $HIST_FILE)
+    if [[ $size1 != $size2 ]]; then
+        echo "file della history cresciuto da $size1 a $size2 byte"
+        exit 1
+    fi
+
+    # la history ricaricata dal disco contiene gli ultimi MaxHistMsgs messaggi in ordine
+    OUT=$(./client -l $1 -k lontano -p)
+    if [[ $? != 0 ]]; then
+        exit 1
+    fi
+    n=$(echo "$OUT" | grep -c "^\[pippo:\] messaggio")
+    if [[ $n != 16 ]]; then
+        echo "ricevuti $n messaggi invece di 16"
+        exit 1
+    fi
+    first=$(echo "$OUT" | grep "^\[pippo:\] messaggio" | head -1 | cut -d' ' -f3)
+    last=$(echo "$OUT" | grep "^\[pippo:\] messaggio" | tail -1 | cut -d' ' -f3)
+    if [[ $first != 065 || $last != 080 ]]; then
+        echo "history non corretta: messaggi da $first a $last"
+        exit 1
+    fi
+else
+    # con la politica drop i messaggi in eccesso sono persi e non viene scritto niente su disco
+    if [[ -e $HIST_FILE ]]; then
+        echo "history riversata su disco con la politica drop"
+        exit 1
+    fi
+    OUT=$(./client -l $1 -k lontano -p)
+    if [[ $? != 0 ]]; then
+        exit 1
+    fi
+    n=$(echo "$OUT" | grep -c "^\[pippo:\] messaggio")
+    last=$(echo "$OUT" | grep "^\[pippo:\] messaggio" | tail -1 | cut -d' ' -f3)
+    if [[ $n -ge 16 || ( $n -gt 0 && $last != 040 ) ]]; then
+        echo "history non corretta: $n messaggi, ultimo $last"
+        exit 1
+    fi
+fi
+
+echo "Test OK!"
+exit 0
@@ -0,0 +1,47 @@
+#!/bin/bash
+
+# uso: testprevafter.sh unix_path
+# verifica il recupero della history a partire da un numero di sequenza (opzione -P del client)
+
+./client -l $1 -c pippo
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+./client -l $1 -c pluto
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+
+# pippo invia 5 messaggi a pluto (numeri di sequenza da 1 a 5)
+./client -l $1 -k pippo -S "uno":pluto -S "due":pluto -S "tre":pluto -S "quattro":pluto -S "cinque":pluto
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+
+# controlla l'intestazione della pagina ($2) e i messaggi ricevuti ($3) con l'opzione -P $1
+function pagina {
+    OUT=$(./client -l $UNIX_PATH -k pluto -P $1)
+    if [[ $? != 0 ]]; then
+        echo "-P $1 fallita"
+        exit 1
+    fi
+    hdr=$(echo "$OUT" | grep "^\[messaggi da")
+    msgs=$(echo "$OUT" | grep "^\[pippo:\]" | cut -d' ' -f2 | tr '\n' ' ')
+    if [[ "$hdr" != "$2" || "$msgs" != "$3" ]]; then
+        echo "-P $1: ricevuto '$hdr' '$msgs' invece di '$2' '$3'"
+        exit 1
+    fi
+}
+UNIX_PATH=$1
+
+# prima pagina di 2 messaggi
+pagina 0:2 "[messaggi da 1 a 2, ultimo nella history 5]" "uno due "
+# pagina successiva di 2 messaggi
+pagina 2:2 "[messaggi da 3 a 4, ultimo nella history 5]" "tre quattro "
+# tutti i messaggi dopo il numero di sequenza 2
+pagina 2 "[messaggi da 3 a 5, ultimo nella history 5]" "tre quattro cinque "
+# nessun messaggio dopo l'ultimo
+pagina 5 "[messaggi da 0 a 5, ultimo nella history 5]" ""
+
+echo "Test OK!"
+exit 0
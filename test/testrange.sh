@@ -0,0 +1,22 @@
+#!/bin/bash
+
+# uso: testrange.sh unix_path
+# scarica segmenti casuali dei file (GETFILERANGE) con il generatore di carico, che controlla il contenuto ricevuto;
+# una richiesta su 8 inizia oltre la fine del file e deve fallire senza chiudere la connessione
+
+OUT=$(./loadgen -l $1 -u 8 -c 2 -d 2 -f 3000 -m range=1)
+if [[ $? != 0 ]]; then
+    echo "$OUT"
+    exit 1
+fi
+line=$(echo "$OUT" | grep "^op GETFILERANGE ")
+count=$(echo "$line" | cut -d' ' -f4)
+errors=$(echo "$line" | cut -d' ' -f6)
+if [[ -z "$count" || $count == 0 || $errors != 0 ]]; then
+    echo "segmenti scaricati: ${count:-0}, errori: ${errors:-?}"
+    echo "$OUT"
+    exit 1
+fi
+
+echo "Test OK!"
+exit 0
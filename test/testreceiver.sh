@@ -0,0 +1,63 @@
+#!/bin/bash
+
+# uso: testreceiver.sh unix_path
+# verifica il destinatario dei messaggi ricevuti: il nick dell'utente per i messaggi diretti (anche a piu' destinatari
+# e a tutti) e il nome del gruppo per i messaggi al gruppo (il client stampa "[mittente -> gruppo:] testo")
+
+./client -l $1 -c pippo &
+./client -l $1 -c pluto &
+./client -l $1 -c minni &
+wait
+
+./client -l $1 -k pippo -g gruppo1
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+./client -l $1 -k pluto -a gruppo1
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+
+# pluto resta in attesa di un messaggio mentre pippo lo invia a piu' destinatari
+./client -l $1 -k pluto -R 1 > /tmp/testreceiver.out &
+pid=$!
+sleep 1
+./client -l $1 -k pippo -S "ciao a due":pluto,minni
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+wait $pid
+if [[ $? != 0 || $(grep -c "^\[pippo:\] ciao a due" /tmp/testreceiver.out) != 1 ]]; then
+    echo "messaggio a piu' destinatari ricevuto con destinatario errato"
+    exit 1
+fi
+rm -f /tmp/testreceiver.out
+
+# messaggio al gruppo e a tutti
+./client -l $1 -k pippo -S "ciao gruppo":gruppo1 -S "ciao a tutti":
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+
+# controlla la riga $2 nella history di $1
+function controlla {
+    OUT=$(./client -l $UNIX_PATH -k $1 -p)
+    if [[ $? != 0 ]]; then
+        exit 1
+    fi
+    if [[ $(echo "$OUT" | grep -c -F "$2") != 1 || $(echo "$OUT" | grep -c -F -- "-> :]") != 0 ]]; then
+        echo "history di $1: '$2' non trovato"
+        echo "$OUT"
+        exit 1
+    fi
+}
+UNIX_PATH=$1
+
+controlla pluto "[pippo:] ciao a due"
+controlla minni "[pippo:] ciao a due"
+controlla pluto "[pippo -> gruppo1:] ciao gruppo"
+controlla pluto "[pippo:] ciao a tutti"
+controlla minni "[pippo:] ciao a tutti"
+
+echo "Test OK!"
+exit 0
@@ -0,0 +1,44 @@
+#!/bin/bash
+
+# uso: testupload.sh unix_path
+# il server deve essere avviato con MaxUploadsPerUser = 2 e UploadIdleTimeout = 2
+# caricamenti a blocchi completi (con ripresa), limite dei caricamenti aperti per utente e scadenza di quelli inattivi
+
+# controlla che l'operazione $2 nell'output $1 sia stata completata $3 volte (o almeno una volta se $3 == +)
+# e che sia fallita $4 volte (o almeno una volta se $4 == +)
+function controlla {
+    line=$(echo "$1" | grep "^op $2 ")
+    count=$(echo "$line" | cut -d' ' -f4)
+    errors=$(echo "$line" | cut -d' ' -f6)
+    if [[ -z "$count" || ( $3 == + && $count == 0 ) || ( $3 != + && $count != $3 ) ||
+          ( $4 == + && $errors == 0 ) || ( $4 != + && $errors != $4 ) ]]; then
+        echo "$2: completate ${count:-0} (attese $3), fallite ${errors:-?} (attese $4)"
+        echo "$1"
+        exit 1
+    fi
+}
+
+# caricamenti completi: ognuno viene chiuso, quindi il limite non viene mai raggiunto
+OUT=$(./loadgen -l $1 -u 4 -c 2 -d 1 -f 3000 -m upload=1)
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+controlla "$OUT" UPLOAD + 0
+
+# caricamenti abbandonati da un solo utente: solo i primi 2 vengono aperti
+OUT=$(./loadgen -l $1 -u 1 -c 1 -d 1 -p ab -m begin=1)
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+controlla "$OUT" UPLOADBEGIN 2 +
+
+# dopo la scadenza i caricamenti abbandonati vengono annullati e se ne possono aprire altri 2
+sleep 3
+OUT=$(./loadgen -l $1 -u 1 -c 1 -d 1 -p ab -m begin=1)
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+controlla "$OUT" UPLOADBEGIN 2 +
+
+echo "Test OK!"
+exit 0
@@ -0,0 +1,70 @@
+#!/bin/bash
+
+# uso: testwire.sh unix_path
+# carico con tutte le operazioni su connessioni in formato WIRE_V2 (vedere wire.h) insieme a connessioni WIRE_V1,
+# anche con piu' richieste in sospeso per connessione
+
+# controlla che l'operazione $2 nell'output $1 sia stata completata almeno una volta e senza errori
+function controlla {
+    line=$(echo "$1" | grep "^op $2 ")
+    count=$(echo "$line" | cut -d' ' -f4)
+    errors=$(echo "$line" | cut -d' ' -f6)
+    if [[ -z "$count" || $count == 0 || $errors != 0 ]]; then
+        echo "$2: completate ${count:-0}, fallite ${errors:-?}"
+        echo "$1"
+        exit 1
+    fi
+}
+
+# utenti WIRE_V2 e WIRE_V1 contemporaneamente
+./loadgen -l $1 -u 8 -c 2 -d 2 -p vd -w v1 -m txt=5,file=1,get=1,prev=1,list=1 > /tmp/testwire.v1 &
+pid=$!
+OUT=$(./loadgen -l $1 -u 8 -c 2 -d 2 -w v2 -m txt=30,all=2,file=5,get=10,prev=10,list=10,range=10,upload=5)
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+for op in POSTTXT POSTTXTALL POSTFILE GETFILE GETPREVMSGS USRLIST GETFILERANGE UPLOAD; do
+    controlla "$OUT" $op
+done
+wait $pid
+if [[ $? != 0 ]]; then
+    exit 1
+fi
+OUT=$(cat /tmp/testwire.v1)
+rm -f /tmp/testwire.v1
+for op in POSTTXT POSTFILE GETFILE GETPREVMSGS USRLIST; do
+    controlla "$OUT" $op
+done
+
+# richieste in pipelining: loadgen fallisce se una risposta non riporta l'id della richiesta a cui risponde
+for q in 4 16; do
+    OUT=$(./loadgen -l $1 -u 8 -c 2 -d 1 -w v2 -q $q -m txt=30,all=2,file=5,get=10,prev=10,list=10,range=10,upload=5)
+    if [[ $? != 0 ]]; then
+        echo "pipelining con $q richieste fallito"
+        exit 1
+    fi
+    for op in POSTTXT POSTFILE GETFILE GETPREVMSGS USRLIST GETFILERANGE UPLOAD; do
+        controlla "$OUT" $op
+    done
+done
+
+# i messaggi inviati in WIRE_V2 vengono ricevuti da un client WIRE_V1 (la history di lg0 contiene messaggi di lg*)
+OUT=$(./client -l $1 -k lg0 -p)
+if [[ $? != 0 || $(echo "$OUT" | grep -c "^\[lg[0-9]*:\] x") == 0 ]]; then
+    echo "history di lg0 senza messaggi inviati in WIRE_V2"
+    exit 1
+fi
+
+# formato compresso (WIRE_V2_LZ): il generatore comprime i contenuti inviati, il server quelli oltre la propria soglia
+# (utenti lz*: i file di lg* hanno un'altra dimensione e i messaggi a tutti riempirebbero la history di lg0)
+OUT=$(./loadgen -l $1 -u 8 -c 2 -d 1 -w lz -q 4 -s 500 -f 5000 -p lz -m txt=30,all=2,file=5,get=10,prev=10,list=10,range=10,upload=5,batch=5)
+if [[ $? != 0 ]]; then
+    echo "formato compresso fallito"
+    exit 1
+fi
+for op in POSTTXT POSTFILE GETFILE GETPREVMSGS USRLIST GETFILERANGE UPLOAD POSTTXTBATCH; do
+    controlla "$OUT" $op
+done
+
+echo "Test OK!"
+exit 0